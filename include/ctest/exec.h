@@ -2,30 +2,112 @@
 #define CTEST__EXEC_H__INCLUDED__
 
 #include <ctest/_annotations.h>
+#include <ctest/exec/cancel.h>
+#include <ctest/exec/concurrency.h>
 #include <ctest/exec/exec_hooks.h>
 #include <ctest/exec/failure.h>
+#include <ctest/exec/journal.h>
 #include <ctest/exec/output.h>
+#include <ctest/exec/placement.h>
 #include <ctest/exec/reporter.h>
 #include <ctest/exec/result.h>
 #include <ctest/exec/runner.h>
+#include <ctest/exec/runner_config.h>
+#include <ctest/exec/shard.h>
 #include <ctest/exec/stacktrace.h>
 #include <ctest/exec/stage.h>
 #include <ctest/exec/suite.h>
+#include <ctest/exec/timings.h>
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/**
+ * Flags controlling what the console reporter prints, in addition to the
+ * result of each test case.
+ */
+enum ctest_console_flags {
+	/**
+	 * Once all results have been reported, print a summary of the time
+	 * taken to create the processes in which test cases were run.
+	 */
+	CTEST_CONSOLE_SPAWN_STATS = 0x01,
+};
+
 extern ctest_reporter_t *ctest_create_console_reporter(void);
+extern ctest_reporter_t *ctest_create_console_reporter_with_flags(unsigned int flags);
 extern ctest_runner_t *ctest_create_direct_runner(void);
+
+/**
+ * Create a runner that runs test cases one at a time within the calling
+ * process. Only the cancellation and retry settings of <code>config</code>
+ * apply; a <code>SIGINT</code> or <code>SIGTERM</code> caught while a test
+ * case runs cancels the run (rather than failing the test case) when
+ * <code>config->cancel</code> is set.
+ */
+CTEST_ALL_NONNULL_ARGS__
+extern ctest_runner_t *ctest_create_direct_runner_with_config(const ctest_runner_config_t *config);
+
 extern ctest_runner_t *ctest_create_forking_runner(void);
 
+CTEST_ALL_NONNULL_ARGS__
+extern ctest_runner_t *ctest_create_forking_runner_with_config(const ctest_runner_config_t *config);
+
+/**
+ * Create a runner that runs test cases concurrently on a pool of
+ * <code>jobs</code> threads, within the calling process.
+ *
+ * Like the direct runner, test cases aren't isolated from each other, so only
+ * test cases that don't share state should be run this way. Output written to
+ * <code>stdout</code> and <code>stderr</code> through the standard streams is
+ * captured for each test case; output written directly to the file
+ * descriptors is not. Test suite modules must have been built against this
+ * version of the test stub for test cases of the same suite to run
+ * concurrently.
+ */
+CTEST_ALL_NONNULL_ARGS__
+extern ctest_runner_t *ctest_create_threaded_runner_with_config(const ctest_runner_config_t *config);
+
 CTEST_ALL_NONNULL_ARGS__
 extern ctest_testsuite_t *ctest_create_testing_testsuite(const char *name);
 
+/**
+ * Load a test suite from a module file.
+ *
+ * Loading fails (with <code>errno</code> set to <code>EINVAL</code>, and why
+ * printed to <code>stderr</code>) if a test of the suite depends on a test the
+ * suite doesn't have, tests depend on one another in a cycle, or a test uses
+ * a malformed resource.
+ */
 CTEST_ALL_NONNULL_ARGS__
 extern ctest_testsuite_t *ctest_load_testsuite(const char *filename);
 
+/**
+ * The entry point of the <code>ctest-worker</code> helper, used by the forking
+ * runner to run a single test case in a freshly spawned process.
+ *
+ * Usage: <code>ctest-worker [options] events-fd suite index</code>, where
+ * <code>events-fd</code> is the file descriptor on which to report execution
+ * events, <code>suite</code> is the module file containing the test suite, and
+ * <code>index</code> is the position of the test case within the suite
+ * (counting the test cases of all tests in order). Output of the test case is
+ * written to <code>stdout</code>. The options carry the limits on the
+ * resources of the test case (see <code>ctest_limits_t</code>):
+ * <code>-m</code> memory bytes, <code>-t</code> CPU nanoseconds,
+ * <code>-f</code> file descriptors, <code>-p</code> processes, and
+ * <code>-c</code> the file descriptor of the <code>cgroup.procs</code> file of
+ * the cgroup in which to run it; and its placement: <code>-a</code> the CPU
+ * to which to restrict it. <code>-l</code> is the file descriptor of the pool
+ * of loopback ports of the run, from which the test case leases ports (see
+ * <code>CT_LEASE_PORT</code>), and <code>-s</code> has it run in a sandbox of
+ * its own.
+ *
+ * @return The exit status of the worker, if it returns at all.
+ */
+CTEST_ALL_NONNULL_ARGS__
+extern int ctest_worker_main(int argc, char *argv[]);
+
 #ifdef __cplusplus
 }
 #endif
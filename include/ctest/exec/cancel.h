@@ -0,0 +1,79 @@
+/**
+ * Run Cancellation
+ *
+ * A <code>ctest_cancel_t</code> lets a run be cancelled from outside the
+ * runner, e.g., from a <code>SIGINT</code> handler. Runners given one (see
+ * <code>ctest_runner_config_t</code>) stop starting test cases once it has
+ * been requested, stop the test cases in flight (where they can), and report
+ * every test case that didn't run to completion as
+ * <code>CTEST_RESULT_CANCELLED</code>, so the report of the run is still
+ * complete.
+ *
+ * A runner also requests cancellation itself when it gives up on a run (e.g.,
+ * after too many failures), so its caller can tell the run was cut short.
+ */
+#ifndef CTEST__EXEC__CANCEL_H__INCLUDED__
+#define CTEST__EXEC__CANCEL_H__INCLUDED__
+
+#include <stdbool.h>
+
+#include <ctest/_annotations.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct ctest_cancel ctest_cancel_t;
+
+/**
+ * Create a cancellation token, not yet requested.
+ *
+ * @return The new token, or <code>NULL</code> (with <code>errno</code> set)
+ *         on failure.
+ */
+extern ctest_cancel_t *ctest_cancel_create(void);
+
+/**
+ * Destroy a cancellation token, freeing resources associated with it.
+ *
+ * @param cancel The token to destroy.
+ */
+CTEST_ALL_NONNULL_ARGS__
+extern void ctest_cancel_destroy(ctest_cancel_t *cancel);
+
+/**
+ * Request cancellation. Requesting it more than once has no further effect.
+ *
+ * This is async-signal-safe, so it may be called from a signal handler.
+ *
+ * @param cancel The token through which to request cancellation.
+ */
+CTEST_ALL_NONNULL_ARGS__
+extern void ctest_cancel_request(ctest_cancel_t *cancel);
+
+/**
+ * Check whether cancellation has been requested.
+ *
+ * @param cancel The token to check.
+ *
+ * @return Whether cancellation has been requested.
+ */
+CTEST_ALL_NONNULL_ARGS__
+extern bool ctest_cancel_is_requested(const ctest_cancel_t *cancel);
+
+/**
+ * Get a file descriptor that becomes readable once cancellation has been
+ * requested (and stays readable), for waiting on it along with other file
+ * descriptors. It must not be read from or closed.
+ *
+ * @param cancel The token.
+ *
+ * @return The file descriptor.
+ */
+CTEST_ALL_NONNULL_ARGS__
+extern int ctest_cancel_get_fd(const ctest_cancel_t *cancel);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* CTEST__EXEC__CANCEL_H__INCLUDED__ */
@@ -0,0 +1,154 @@
+/**
+ * Adaptive Concurrency
+ *
+ * A <code>ctest_concurrency_t</code> decides how many test cases a runner
+ * executes at once (see <code>ctest_runner_config_t</code>), from how busy the
+ * system is rather than from a fixed number of jobs, so a run neither
+ * overloads a host it shares with others nor leaves an idle host idle.
+ *
+ * The controller reads the pressure stall information of the system
+ * (<code>/proc/pressure/{cpu,memory,io}</code>): the share of time tasks were
+ * stalled waiting on the CPU, on memory, or on I/O. While the stall time stays
+ * below the target and no task is left waiting for a CPU (going by the
+ * runnable tasks of <code>/proc/loadavg</code>), the limit is raised by one
+ * job at a time, as long as the runner actually had that many jobs in flight;
+ * once the stall time exceeds twice the target, the limit is cut by a quarter.
+ * On systems without pressure stall information, CPU stall time is estimated
+ * from the runnable tasks instead.
+ *
+ * Every change of the limit is kept, along with the pressure that led to it,
+ * so the concurrency of a run can be reported after the fact.
+ */
+#ifndef CTEST__EXEC__CONCURRENCY_H__INCLUDED__
+#define CTEST__EXEC__CONCURRENCY_H__INCLUDED__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <ctest/_annotations.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct ctest_concurrency ctest_concurrency_t;
+
+/**
+ * A change of the limit of a concurrency controller.
+ */
+typedef struct ctest_concurrency_change ctest_concurrency_change_t;
+struct ctest_concurrency_change {
+	/**
+	 * When the limit changed, since the controller was created.
+	 */
+	uint64_t elapsed_ns;
+
+	/**
+	 * The number of jobs that may be in flight from then on.
+	 */
+	unsigned int limit;
+
+	/**
+	 * The share of time, in tenths of a percent, that tasks were stalled
+	 * waiting on the CPU, on memory, and on I/O, since the previous
+	 * sample.
+	 */
+	unsigned int cpu_stall;
+	unsigned int memory_stall;
+	unsigned int io_stall;
+
+	/**
+	 * The number of runnable tasks (other than the controller's own), and
+	 * the load average over the last minute, in hundredths.
+	 */
+	unsigned int runnable;
+	unsigned int load;
+};
+
+/**
+ * Create a concurrency controller.
+ *
+ * The limit starts out at the number of CPUs the calling process is allowed
+ * to run on.
+ *
+ * @param max_jobs       The most jobs the controller may let be in flight at
+ *                       once, or zero for four per CPU.
+ * @param target_percent The share of time tasks may be stalled (on the CPU,
+ *                       memory or I/O) for the limit to be raised.
+ *
+ * @return The new controller, or <code>NULL</code> (with <code>errno</code>
+ *         set) on failure.
+ */
+extern ctest_concurrency_t *ctest_concurrency_create(unsigned int max_jobs, unsigned int target_percent);
+
+/**
+ * Destroy a concurrency controller, freeing resources associated with it.
+ *
+ * @param concurrency The controller to destroy.
+ */
+CTEST_ALL_NONNULL_ARGS__
+extern void ctest_concurrency_destroy(ctest_concurrency_t *concurrency);
+
+/**
+ * Get the most jobs a controller may let be in flight at once.
+ *
+ * @param concurrency The controller.
+ *
+ * @return The number of jobs, at least one.
+ */
+CTEST_ALL_NONNULL_ARGS__
+extern unsigned int ctest_concurrency_get_max_jobs(const ctest_concurrency_t *concurrency);
+
+/**
+ * Get whether a controller reads the pressure stall information of the
+ * system, rather than estimating it from the runnable tasks.
+ *
+ * @param concurrency The controller.
+ *
+ * @return <code>true</code> if pressure stall information is available.
+ */
+CTEST_ALL_NONNULL_ARGS__
+extern bool ctest_concurrency_has_pressure(const ctest_concurrency_t *concurrency);
+
+/**
+ * Get the number of jobs that may be in flight at once, sampling the pressure
+ * on the system (at most every half second) and adjusting the limit first.
+ *
+ * @param concurrency The controller.
+ * @param in_flight   The number of jobs in flight; the limit is only raised
+ *                    when as many jobs as it allows have been in flight
+ *                    since the pressure was last sampled.
+ *
+ * @return The limit, at least one.
+ */
+CTEST_ALL_NONNULL_ARGS__
+extern unsigned int ctest_concurrency_update(ctest_concurrency_t *concurrency, size_t in_flight);
+
+/**
+ * Get the changes of the limit of a controller, oldest first. The first is
+ * the limit the controller started out with.
+ *
+ * @param concurrency    The controller.
+ * @param p_change_count Populated with the number of changes, at least one.
+ *
+ * @return The changes, valid until the limit next changes.
+ */
+CTEST_ALL_NONNULL_ARGS__
+extern const ctest_concurrency_change_t *ctest_concurrency_get_changes(const ctest_concurrency_t *concurrency, size_t *p_change_count);
+
+/**
+ * Get the mean limit of a controller, weighed by how long each limit held,
+ * from its creation until now.
+ *
+ * @param concurrency The controller.
+ *
+ * @return The mean number of jobs that could be in flight at once.
+ */
+CTEST_ALL_NONNULL_ARGS__
+extern double ctest_concurrency_get_mean_limit(const ctest_concurrency_t *concurrency);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* CTEST__EXEC__CONCURRENCY_H__INCLUDED__ */
@@ -0,0 +1,146 @@
+/**
+ * Run Journal
+ *
+ * A <code>ctest_journal_t</code> keeps the result of each test case of a run
+ * on disk as soon as the test case completes, so a run that is cut short
+ * (e.g., because the host it ran on was preempted) can be resumed rather than
+ * started over. Runners given a journal (see
+ * <code>ctest_runner_config_t</code>) record the final result of every test
+ * case they run, and don't run the test cases whose results were loaded from
+ * an earlier run; their recorded results are reported instead, in order, so
+ * the report of the resumed run is still complete.
+ *
+ * Results of test cases that were cancelled are never recorded, since those
+ * test cases didn't get to run. Neither are the failures of the attempts
+ * before the last one of a test case that was retried.
+ *
+ * The journal is stored as a text file, appended to one test case per line:
+ * <code>suite&lt;TAB&gt;test case&lt;TAB&gt;result&lt;TAB&gt;attempt&lt;TAB&gt;nanoseconds</code>,
+ * followed by <code>&lt;TAB&gt;stage&lt;TAB&gt;file&lt;TAB&gt;line&lt;TAB&gt;description</code>
+ * of the failure (a stage of <code>-</code>, and empty fields, if there is
+ * none), <code>&lt;TAB&gt;output</code>, and <code>&lt;TAB&gt;checksum</code>
+ * of the rest of the line. Backslashes, tabs, newlines, carriage returns and
+ * NUL bytes within fields are escaped as in C. Lines are only written whole,
+ * and synced to disk in batches; a line cut short by a crash fails its
+ * checksum and is ignored, as are lines starting with <code>#</code>. When a
+ * test case has more than one line, the last one counts.
+ */
+#ifndef CTEST__EXEC__JOURNAL_H__INCLUDED__
+#define CTEST__EXEC__JOURNAL_H__INCLUDED__
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include <ctest/_annotations.h>
+#include <ctest/exec/result.h>
+#include <ctest/exec/suite.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct ctest_journal ctest_journal_t;
+
+/**
+ * Create a journal that has no results loaded and records to no file.
+ *
+ * @return The new journal, or <code>NULL</code> on failure.
+ */
+extern ctest_journal_t *ctest_journal_create(void);
+
+/**
+ * Destroy a journal, syncing and closing the file it records to (if any) and
+ * freeing resources associated with it.
+ *
+ * @param journal The journal to destroy.
+ */
+CTEST_ALL_NONNULL_ARGS__
+extern void ctest_journal_destroy(ctest_journal_t *journal);
+
+/**
+ * Load the results recorded in a file, to be reported instead of running
+ * their test cases again.
+ *
+ * A file that doesn't exist is treated as empty; malformed lines are ignored.
+ *
+ * @param journal        The journal into which to load the results.
+ * @param filename       The file to load.
+ * @param replay_failed  Whether to load the results of test cases that didn't
+ *                       pass (i.e., that failed, timed out, were skipped,
+ *                       ...) too, or to leave those test cases to be run
+ *                       again.
+ *
+ * @return Zero on success, non-zero (with <code>errno</code> set) on failure.
+ */
+CTEST_ALL_NONNULL_ARGS__
+extern int ctest_journal_load(ctest_journal_t *journal, const char *filename, bool replay_failed);
+
+/**
+ * Open a file to which to append the results recorded from then on, creating
+ * it if it doesn't exist.
+ *
+ * @param journal  The journal.
+ * @param filename The file to append to; it may be the file results were
+ *                 loaded from, to which the results of the test cases that
+ *                 weren't loaded are then added.
+ *
+ * @return Zero on success, non-zero (with <code>errno</code> set) on failure.
+ */
+CTEST_ALL_NONNULL_ARGS__
+extern int ctest_journal_open(ctest_journal_t *journal, const char *filename);
+
+/**
+ * Get the number of results that were loaded into a journal.
+ *
+ * @param journal The journal.
+ *
+ * @return The number of test cases with a loaded result.
+ */
+CTEST_ALL_NONNULL_ARGS__
+extern size_t ctest_journal_get_loaded_count(const ctest_journal_t *journal);
+
+/**
+ * Get the result loaded for a test case, if any, to report instead of running
+ * the test case.
+ *
+ * @param journal    The journal.
+ * @param testcase   The test case.
+ * @param p_result   Populated with a new result (owned by the caller) if one
+ *                   was loaded for the test case, or <code>NULL</code> if
+ *                   not.
+ *
+ * @return Zero on success, non-zero if the result can't be created.
+ */
+CTEST_ALL_NONNULL_ARGS__
+extern int ctest_journal_replay(ctest_journal_t *journal, ctest_testcase_t *testcase, ctest_result_t **p_result);
+
+/**
+ * Append the final result of a test case to the file of a journal (unless the
+ * test case was cancelled), syncing it to disk along with the other results
+ * recorded since the last sync once there are enough of them, or enough time
+ * has passed.
+ *
+ * @param journal  The journal.
+ * @param testcase The test case.
+ * @param result   The result of the test case.
+ *
+ * @return Zero on success (including when the journal has no file), non-zero
+ *         (with <code>errno</code> set) on failure.
+ */
+CTEST_ALL_NONNULL_ARGS__
+extern int ctest_journal_record(ctest_journal_t *journal, ctest_testcase_t *testcase, const ctest_result_t *result);
+
+/**
+ * Sync the results recorded so far to disk.
+ *
+ * @param journal The journal.
+ *
+ * @return Zero on success, non-zero (with <code>errno</code> set) on failure.
+ */
+CTEST_ALL_NONNULL_ARGS__
+extern int ctest_journal_sync(ctest_journal_t *journal);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* CTEST__EXEC__JOURNAL_H__INCLUDED__ */
@@ -0,0 +1,129 @@
+/**
+ * CPU Placement
+ *
+ * A <code>ctest_placement_t</code> decides on which CPU each of the forking
+ * runner's child processes runs (see <code>ctest_runner_config_t</code>), so
+ * concurrent test cases don't migrate between CPUs, and so the timings of
+ * test cases are comparable from run to run.
+ *
+ * Only the CPUs the calling process is allowed to run on (its cpuset) are
+ * used. Children are spread over physical cores first, alternating between
+ * packages (sockets), and only share a core with another child (as an SMT
+ * sibling) once every core is in use. Some cores can be reserved for the
+ * runner itself (along with the reporter), so the test cases don't compete
+ * with it.
+ */
+#ifndef CTEST__EXEC__PLACEMENT_H__INCLUDED__
+#define CTEST__EXEC__PLACEMENT_H__INCLUDED__
+
+#include <stddef.h>
+
+#include <ctest/_annotations.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct ctest_placement ctest_placement_t;
+
+/**
+ * A CPU (a hardware thread), along with where it is in the topology of the
+ * system.
+ */
+typedef struct ctest_cpu ctest_cpu_t;
+struct ctest_cpu {
+	/**
+	 * The number of the CPU, as used by <code>sched_setaffinity</code>.
+	 */
+	int id;
+
+	/**
+	 * The physical package (socket) of the CPU.
+	 */
+	int package;
+
+	/**
+	 * The physical core of the CPU, within its package; CPUs of the same
+	 * core are SMT siblings.
+	 */
+	int core;
+};
+
+/**
+ * Decide on the placement of child processes on the CPUs the calling process
+ * is allowed to run on.
+ *
+ * @param reserved_cores The number of physical cores (all of their CPUs) to
+ *                       keep for the runner rather than for children. The
+ *                       lowest numbered cores are reserved, as those are the
+ *                       ones the system tends to use for itself.
+ *
+ * @return The new placement, or <code>NULL</code> (with <code>errno</code>
+ *         set) on failure, including when reserving the cores would leave
+ *         none for children (<code>EINVAL</code>).
+ */
+extern ctest_placement_t *ctest_placement_create(unsigned int reserved_cores);
+
+/**
+ * Destroy a placement, freeing resources associated with it.
+ *
+ * @param placement The placement to destroy.
+ */
+CTEST_ALL_NONNULL_ARGS__
+extern void ctest_placement_destroy(ctest_placement_t *placement);
+
+/**
+ * Get the number of CPUs on which children are placed.
+ *
+ * @param placement The placement.
+ *
+ * @return The number of CPUs, at least one.
+ */
+CTEST_ALL_NONNULL_ARGS__
+extern size_t ctest_placement_get_cpu_count(const ctest_placement_t *placement);
+
+/**
+ * Get the CPU of a child slot (i.e., of a job).
+ *
+ * Slots are placed in order; once every CPU has a slot, slots wrap around and
+ * share CPUs.
+ *
+ * @param placement The placement.
+ * @param slot      The slot, counting from zero.
+ *
+ * @return The CPU of the slot.
+ */
+CTEST_ALL_NONNULL_ARGS__ CTEST_RETURNS_NONNULL__
+extern const ctest_cpu_t *ctest_placement_get_cpu(const ctest_placement_t *placement, size_t slot);
+
+/**
+ * Get the CPUs reserved for the runner.
+ *
+ * @param placement     The placement.
+ * @param p_cpu_count   Populated with the number of reserved CPUs, which is
+ *                      zero if no cores are reserved.
+ *
+ * @return The reserved CPUs.
+ */
+CTEST_ALL_NONNULL_ARGS__
+extern const ctest_cpu_t *ctest_placement_get_reserved(const ctest_placement_t *placement, size_t *p_cpu_count);
+
+/**
+ * Restrict the calling thread (and the processes and threads it starts from
+ * then on) to the CPUs reserved for the runner; if none are reserved, the
+ * thread is left as is.
+ *
+ * Children placed on other CPUs are moved there as they are started, so this
+ * doesn't affect them.
+ *
+ * @param placement The placement.
+ *
+ * @return Zero on success, non-zero (with <code>errno</code> set) on failure.
+ */
+CTEST_ALL_NONNULL_ARGS__
+extern int ctest_placement_reserve(const ctest_placement_t *placement);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* CTEST__EXEC__PLACEMENT_H__INCLUDED__ */
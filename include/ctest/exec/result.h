@@ -7,6 +7,9 @@
 #ifndef CTEST__EXEC__RESULT_H__INCLUDED__
 #define CTEST__EXEC__RESULT_H__INCLUDED__
 
+#include <stdbool.h>
+#include <stdint.h>
+
 #include <ctest/_annotations.h>
 #include <ctest/exec/failure.h>
 #include <ctest/exec/output.h>
@@ -49,6 +52,54 @@ enum ctest_result_type {
 	 * For example, a unit test may have failed because a system call used
 	 * by the runner (e.g., memory allocation) may have failed. */
 	CTEST_RESULT_ERROR,
+
+	/**
+	 * The test did not complete within its time limit and was killed by
+	 * the runner.
+	 *
+	 * The associated <code>ctest_failure_t</code> object records the stage
+	 * the test was in when its time ran out.
+	 */
+	CTEST_RESULT_TIMEOUT,
+
+	/**
+	 * The test was cancelled along with the rest of the run (see
+	 * <code>ctest_cancel_t</code>), either before it started or while it
+	 * was running.
+	 *
+	 * The associated <code>ctest_failure_t</code> object records why the
+	 * run was cancelled and the stage the test was in.
+	 */
+	CTEST_RESULT_CANCELLED,
+
+	/**
+	 * The test failed, but passed when retried (see
+	 * <code>previous_attempt</code>).
+	 *
+	 * There is no associated <code>ctest_failure_t</code>; the failures
+	 * are those of the previous attempts.
+	 */
+	CTEST_RESULT_FLAKY,
+
+	/**
+	 * The test used more of a resource than its limits allow (see
+	 * <code>ctest_limits_t</code>) and was stopped by the system.
+	 *
+	 * The associated <code>ctest_failure_t</code> object records which
+	 * limit was exceeded, how much of the resource had been used, and the
+	 * stage the test was in.
+	 */
+	CTEST_RESULT_LIMIT_EXCEEDED,
+
+	/**
+	 * The test passed, but left the state of the process it was run in
+	 * changed (see <code>ctest_runner_config_t.check_state</code>), which
+	 * could affect the tests run after it in the same process.
+	 *
+	 * The associated <code>ctest_failure_t</code> object describes what
+	 * was changed.
+	 */
+	CTEST_RESULT_ISOLATION_VIOLATION,
 };
 
 /**
@@ -76,9 +127,62 @@ struct ctest_result {
 	 *   <li><code>CTEST_RESULT_FAIL</code></li>
 	 *   <li><code>CTEST_RESULT_SKIP</code></li>
 	 *   <li><code>CTEST_RESULT_ERROR</code><li>
+	 *   <li><code>CTEST_RESULT_TIMEOUT</code><li>
+	 *   <li><code>CTEST_RESULT_CANCELLED</code><li>
+	 *   <li><code>CTEST_RESULT_LIMIT_EXCEEDED</code><li>
+	 *   <li><code>CTEST_RESULT_ISOLATION_VIOLATION</code><li>
 	 * <ul>
 	 */
 	ctest_failure_t *failure;
+
+	/**
+	 * The time, in nanoseconds, it took to create the process in which the
+	 * test case was run, or zero if it wasn't run in a process of its own.
+	 */
+	uint64_t spawn_ns;
+
+	/**
+	 * The time, in nanoseconds, from the start of the test case to its
+	 * completion, as seen by the runner, or zero if it wasn't measured.
+	 */
+	uint64_t duration_ns;
+
+	/**
+	 * The most memory, in bytes, used at any one time by the process in
+	 * which the test case was run (along with the processes it started),
+	 * beyond what that process started out with (e.g., a shared fixture
+	 * it was forked with), or zero if it wasn't measured (e.g., because
+	 * the runner records no timings, or the process ran other test cases
+	 * too).
+	 */
+	uint64_t peak_memory_bytes;
+
+	/**
+	 * The CPU to which the process in which the test case was run was
+	 * restricted (see <code>ctest_placement_t</code>), or <code>-1</code>
+	 * if it wasn't.
+	 */
+	int cpu;
+
+	/**
+	 * Whether the test case was run in a child process, rather than within
+	 * the runner's own process (or not at all, e.g., if it was cancelled
+	 * before it started).
+	 */
+	bool forked;
+
+	/**
+	 * Which attempt at running the test case this is the result of,
+	 * counting from one.
+	 */
+	unsigned int attempt;
+
+	/**
+	 * The result of the previous attempt at running the test case, which
+	 * failed (so the test case was retried), or <code>NULL</code> if this
+	 * is the first attempt. Owned by this result.
+	 */
+	ctest_result_t *previous_attempt;
 };
 
 /**
@@ -131,9 +235,26 @@ extern int ctest_result_set_failure(ctest_result_t *result, ctest_result_type_t
 CTEST_NONNULL_ARGS__(1)
 extern int ctest_result_set_output(ctest_result_t *result, ctest_output_t *output);
 
+/**
+ * Record the result of a failed attempt at running the test case as the
+ * previous attempt of a result (of the retry), numbering the attempt of the
+ * result accordingly.
+ *
+ * If a previous attempt was already associated with the result, the
+ * resources associated with it will be released.
+ *
+ * @param result   The <code>ctest_result_t</code> to update.
+ * @param previous The result of the previous attempt. Ownership of
+ *                 <code>previous</code> is passed on to <code>result</code>.
+ *
+ * @return Zero if result is updated, non-zero if the update failed.
+ */
+CTEST_ALL_NONNULL_ARGS__
+extern int ctest_result_set_previous_attempt(ctest_result_t *result, ctest_result_t *previous);
+
 /**
  * Destroy a <code>ctest_result_t</code> object, freeing resources associated
- * with it.
+ * with it (including the results of its previous attempts).
  *
  * @param result The <code>ctest_result_t</code> object to destroy.
  */
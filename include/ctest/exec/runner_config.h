@@ -0,0 +1,411 @@
+/**
+ * Runner Configuration
+ *
+ * Runners that can be tuned (e.g., the forking runner) accept a
+ * <code>ctest_runner_config_t</code> when they are created. A configuration
+ * should always be initialized with <code>ctest_runner_config_init</code>
+ * before being customized, so that any settings that are not explicitly set
+ * take on their default values.
+ */
+#ifndef CTEST__EXEC__RUNNER_CONFIG_H__INCLUDED__
+#define CTEST__EXEC__RUNNER_CONFIG_H__INCLUDED__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <ctest/_annotations.h>
+#include <ctest/exec/cancel.h>
+#include <ctest/exec/concurrency.h>
+#include <ctest/exec/journal.h>
+#include <ctest/exec/placement.h>
+#include <ctest/exec/timings.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * How the forking runner creates the process in which a test case is run.
+ */
+typedef enum ctest_spawn_mode ctest_spawn_mode_t;
+enum ctest_spawn_mode {
+	/**
+	 * Fork each test case's process directly from the runner.
+	 */
+	CTEST_SPAWN_FORK,
+
+	/**
+	 * Fork each test case's process from a zygote: a small template
+	 * process that is forked from the runner when a run starts (after the
+	 * test suites have been loaded). Since the zygote doesn't grow with
+	 * the results of the run, the cost of each fork stays flat.
+	 */
+	CTEST_SPAWN_ZYGOTE,
+
+	/**
+	 * Start each test case's process by spawning (with
+	 * <code>posix_spawn</code>) the <code>ctest-worker</code> helper,
+	 * which loads only the test suite module it needs and runs a single
+	 * test case. The runner's address space is never copied, so the cost
+	 * doesn't depend on the size of the runner.
+	 *
+	 * Only test suites loaded with <code>ctest_load_testsuite</code> can be
+	 * run this way.
+	 */
+	CTEST_SPAWN_WORKER,
+};
+
+/**
+ * Which test cases the forking runner runs in the same child process: the
+ * granularity at which test cases are isolated from one another.
+ */
+typedef enum ctest_isolation ctest_isolation_t;
+enum ctest_isolation {
+	/**
+	 * Run each test case in a process of its own.
+	 */
+	CTEST_ISOLATION_TESTCASE,
+
+	/**
+	 * Run the test cases of each test back to back in a process of their
+	 * own.
+	 */
+	CTEST_ISOLATION_TEST,
+
+	/**
+	 * Run the test cases of each test suite back to back in a process of
+	 * their own.
+	 */
+	CTEST_ISOLATION_SUITE,
+
+	/**
+	 * Run each test case within the runner's own process, like the direct
+	 * runner, unless it needs a process of its own: if its test is tagged
+	 * <code>"unsafe"</code> (see <code>CT_TEST_TAGS</code>) or has a time
+	 * limit of its own, if it has crashed within the runner's process
+	 * before (as recorded in <code>timings</code>), if it is being retried,
+	 * or if another test case of its suite has crashed within the
+	 * runner's process during the run. Such a test case is run in a
+	 * process of its own, like with <code>CTEST_ISOLATION_TESTCASE</code>.
+	 *
+	 * Test cases run within the runner's process are run one at a time on
+	 * the runner's thread (while children run alongside), can't be timed
+	 * out or limited, and see what the test cases before them did to the
+	 * process; <code>ctest_result_t.forked</code> records which way each
+	 * test case was run.
+	 */
+	CTEST_ISOLATION_AUTO,
+};
+
+/**
+ * Limits on the resources a test case may use, applied by the forking runner
+ * to the process in which the test case is run, before the test case starts.
+ * Zero means no limit.
+ *
+ * The limits are set with <code>setrlimit</code>, except that, when the
+ * process is run in a cgroup of its own (see
+ * <code>ctest_runner_config_t.cgroup_path</code>), the cgroup enforces the
+ * memory and process limits instead: it accounts for what the test case
+ * actually uses, and notices when the limits are reached. A test case stopped
+ * for going over a limit that is noticed (memory or process in a cgroup, CPU
+ * time regardless) is reported as <code>CTEST_RESULT_LIMIT_EXCEEDED</code>;
+ * otherwise, running into a limit shows up as whatever the test case makes of
+ * the failed allocation, <code>open</code>, or <code>fork</code>.
+ *
+ * A pooled process is limited as a whole, across the test cases it runs.
+ */
+typedef struct ctest_limits ctest_limits_t;
+struct ctest_limits {
+	/**
+	 * The most memory, in bytes: the limit on the size of the address
+	 * space (<code>RLIMIT_AS</code>) or, in a cgroup, on the memory
+	 * charged to it (<code>memory.max</code>, without swap).
+	 */
+	uint64_t memory_bytes;
+
+	/**
+	 * The most CPU time, in nanoseconds, rounded up to whole seconds
+	 * (<code>RLIMIT_CPU</code>).
+	 */
+	uint64_t cpu_ns;
+
+	/**
+	 * The most open file descriptors (<code>RLIMIT_NOFILE</code>).
+	 */
+	unsigned int fd_count;
+
+	/**
+	 * The most processes (and threads): <code>RLIMIT_NPROC</code>, which
+	 * counts every process of the user, or, in a cgroup, the processes in
+	 * it (<code>pids.max</code>).
+	 */
+	unsigned int process_count;
+};
+
+/**
+ * Settings that control how a runner executes test cases.
+ */
+typedef struct ctest_runner_config ctest_runner_config_t;
+struct ctest_runner_config {
+	/**
+	 * The maximum number of test cases to execute concurrently (the number
+	 * of child processes or, for the threaded runner, threads).
+	 *
+	 * Regardless of how many test cases are executed concurrently,
+	 * results are always reported in suite, test, and test case order.
+	 * Zero is treated as one.
+	 */
+	unsigned int jobs;
+
+	/**
+	 * The controller that decides how many of the <code>jobs</code> may be
+	 * in flight at any one time, from the pressure on the system, or
+	 * <code>NULL</code> to always run up to <code>jobs</code> test cases
+	 * concurrently. The controller must outlive the runner.
+	 */
+	ctest_concurrency_t *concurrency;
+
+	/**
+	 * How test case processes are created.
+	 */
+	ctest_spawn_mode_t spawn;
+
+	/**
+	 * The path of the <code>ctest-worker</code> helper, used with
+	 * <code>CTEST_SPAWN_WORKER</code>.
+	 *
+	 * If <code>NULL</code>, the <code>CTEST_WORKER</code> environment
+	 * variable is used, if set, otherwise the installed helper.
+	 */
+	const char *worker_path;
+
+	/**
+	 * Keep a pool of child processes for the whole run, each running test
+	 * cases back to back, instead of creating a process for every test
+	 * case.
+	 *
+	 * A test case that fails or is skipped doesn't take its process down
+	 * with it; a process that dies (e.g., on a signal) is replaced, and the
+	 * test case it was running is reported with the stage it was in. Test
+	 * cases run in a pooled process can observe state left behind by the
+	 * test cases run before them. Not supported with
+	 * <code>CTEST_SPAWN_WORKER</code>.
+	 */
+	bool pool;
+
+	/**
+	 * Which test cases share a child process, unless <code>pool</code> is
+	 * set (in which case a child is shared by every test case run on its
+	 * slot).
+	 *
+	 * The test cases of a group (a test, or a test suite) are all run on
+	 * the same child slot, back to back, in a child process started for
+	 * the group; the result of each test case is still reported on its
+	 * own. A test case that fails or is skipped doesn't take the process
+	 * down with it; if the process dies, the rest of the group is run in
+	 * a new one, starting with the next test case. Retries are run in a
+	 * fresh process of their own. Groups of test cases are scheduled
+	 * whole, so with recorded durations, they are not started longest
+	 * first. Only <code>CTEST_ISOLATION_TESTCASE</code> and
+	 * <code>CTEST_ISOLATION_AUTO</code> are supported with
+	 * <code>CTEST_SPAWN_WORKER</code>, and only the former with
+	 * <code>pool</code>.
+	 */
+	ctest_isolation_t isolation;
+
+	/**
+	 * The recorded durations of test cases, or <code>NULL</code>.
+	 *
+	 * If set, concurrently executed test cases are started longest first
+	 * (test cases without a recorded duration are assumed to take the
+	 * average time), and the measured duration of every test case that is
+	 * run is recorded in the database, which must outlive the runner.
+	 * So is the peak memory use of every test case run in a child process
+	 * of its own (see <code>memory_budget_bytes</code>).
+	 */
+	ctest_timings_t *timings;
+
+	/**
+	 * The journal of the run, or <code>NULL</code>.
+	 *
+	 * If set, the test cases whose results were loaded into the journal
+	 * aren't run; their loaded results are reported instead. The final
+	 * result of every test case that is run is recorded in the journal,
+	 * which must outlive the runner.
+	 */
+	ctest_journal_t *journal;
+
+	/**
+	 * The time limit, in nanoseconds, of each test case that doesn't have
+	 * a time limit of its own, or zero for no limit.
+	 *
+	 * A test case that runs out of time is sent <code>SIGTERM</code>
+	 * (along with every process it started), then <code>SIGKILL</code> if
+	 * it still hasn't exited a moment later, and is reported as
+	 * <code>CTEST_RESULT_TIMEOUT</code>. Time limits are only enforced by
+	 * the forking runner.
+	 */
+	uint64_t timeout_ns;
+
+	/**
+	 * The number of failed test cases after which the rest of the run is
+	 * cancelled, or zero to run every test case regardless.
+	 *
+	 * Test cases that are skipped or cancelled don't count as failures.
+	 */
+	unsigned int fail_fast;
+
+	/**
+	 * How many times a test case that fails (or errs, or runs out of time)
+	 * is retried, or zero to report the first failure.
+	 *
+	 * Retries are run in a fresh child process, by runners that use them,
+	 * and only once no first attempt is left to start (except by the
+	 * direct runner, which retries right away). A test case that passes
+	 * when retried is reported as <code>CTEST_RESULT_FLAKY</code>; one
+	 * that doesn't with the result of its last attempt. Either way, the
+	 * results of the earlier attempts are kept (see
+	 * <code>ctest_result_t.previous_attempt</code>). Only the final
+	 * result of a test case counts towards <code>fail_fast</code>.
+	 */
+	unsigned int retries;
+
+	/**
+	 * The token through which the run can be cancelled, or
+	 * <code>NULL</code>.
+	 *
+	 * Once cancellation is requested, no more test cases are started and
+	 * those in flight are stopped: child processes are sent
+	 * <code>SIGTERM</code> (then <code>SIGKILL</code>), while test cases
+	 * running in the runner's own process are left to finish. Every test
+	 * case that didn't run to completion is reported as
+	 * <code>CTEST_RESULT_CANCELLED</code>. The runner also requests
+	 * cancellation through the token when <code>fail_fast</code> cuts a
+	 * run short. The token must outlive the runner.
+	 */
+	ctest_cancel_t *cancel;
+
+	/**
+	 * The limits on the resources used by each test case, enforced only
+	 * by the forking runner.
+	 */
+	ctest_limits_t limits;
+
+	/**
+	 * The path of a cgroup (v2) directory delegated to the runner, or
+	 * <code>NULL</code>.
+	 *
+	 * If set, the forking runner runs each child process in a cgroup of
+	 * its own, created in this directory (and removed once the process is
+	 * done), to enforce the memory and process limits and to measure the
+	 * peak memory use of its test cases. The <code>memory</code> (and, for
+	 * a process limit, <code>pids</code>) controllers must be available
+	 * in the directory. If the directory holds the runner's own process,
+	 * the runner moves itself into a <code>ctester</code> cgroup within
+	 * it, since only a cgroup without processes of its own can hand
+	 * controllers down.
+	 */
+	const char *cgroup_path;
+
+	/**
+	 * The CPUs on which to place child processes, or <code>NULL</code> to
+	 * leave them wherever the system puts them.
+	 *
+	 * If set, the forking runner restricts the process of each child slot
+	 * (i.e., each job) to the CPU the placement gives the slot, before the
+	 * child runs anything (and, for <code>CTEST_SPAWN_WORKER</code>,
+	 * before it is executed), and records the CPU in the result of each
+	 * test case. The placement must outlive the runner.
+	 */
+	const ctest_placement_t *placement;
+
+	/**
+	 * Check that each test case run within the runner's own process (by
+	 * the direct runner, or with <code>CTEST_ISOLATION_AUTO</code>) leaves
+	 * the process as it found it: the static data (<code>.data</code> and
+	 * <code>.bss</code>) of the modules of the test suites run so far, the
+	 * open file descriptors, the working directory, the environment, and
+	 * the number of threads.
+	 *
+	 * A test case that passes but changes any of them is reported as
+	 * <code>CTEST_RESULT_ISOLATION_VIOLATION</code>, along with what it
+	 * changed; with <code>CTEST_ISOLATION_AUTO</code>, it is then treated
+	 * as if it had crashed. What a test case that doesn't pass leaves
+	 * behind isn't reported, nor blamed on the test cases after it.
+	 * Shared fixtures are set up before the state is first looked at. Not
+	 * supported by the threaded runner, whose test cases share the process
+	 * at the same time.
+	 */
+	bool check_state;
+
+	/**
+	 * Run each child process of the forking runner in a sandbox of its
+	 * own: unprivileged user, network and mount namespaces, with a private
+	 * loopback interface and a private <code>tmpfs</code> mounted over
+	 * <code>/tmp</code>. Test cases that bind fixed loopback ports or
+	 * write fixed paths under <code>/tmp</code> can then run concurrently.
+	 *
+	 * The test cases sharing a child (with <code>pool</code>, or an
+	 * isolation other than <code>CTEST_ISOLATION_TESTCASE</code>) share
+	 * its sandbox, as do those forked from the host of a shared fixture,
+	 * which sets the fixture up in it. If the system doesn't allow
+	 * unprivileged namespaces, a warning is printed and children are run
+	 * without a sandbox.
+	 */
+	bool sandbox;
+
+	/**
+	 * The capacities of the shared resources test cases use (see
+	 * <code>ctest_test_get_resources</code>), as a
+	 * <code>NULL</code>-terminated array of "name=capacity" (e.g.,
+	 * "bigmem=32"), or <code>NULL</code>.
+	 *
+	 * Runners that run test cases concurrently never start one while,
+	 * together with those in flight, it would need more of a resource
+	 * than its capacity; other test cases are started ahead of it in the
+	 * meantime. A resource without a capacity has a capacity of one, and
+	 * a test case needing more of a resource than its capacity uses all
+	 * of it.
+	 */
+	const char *const *resources;
+
+	/**
+	 * The range of loopback ports test cases lease (see
+	 * <code>CT_LEASE_PORT</code>), from <code>first_port</code> to
+	 * <code>last_port</code> (inclusive). Ports are handed out in turn,
+	 * however test cases are run, so a port is only handed out again once
+	 * every other port of the range has been. By default, the ports from
+	 * 20000 to 29999, below the range Linux picks ephemeral ports from.
+	 */
+	unsigned int first_port;
+	unsigned int last_port;
+
+	/**
+	 * How much memory, in bytes, the test cases the forking runner runs
+	 * at once may use together, or zero for no limit.
+	 *
+	 * Each test case is expected to use as much memory as it did when
+	 * last run (see <code>timings</code>); one that hasn't been measured
+	 * is conservatively expected to use as much as the most any of the
+	 * test cases being run has used, and never less than an even share of
+	 * the budget among the jobs. A test case is only started once its
+	 * expected use fits within the budget, together with that of the test
+	 * cases in flight (or nothing else is in flight); the test cases to be
+	 * started after it wait for it, rather than take the memory it is
+	 * waiting for.
+	 */
+	uint64_t memory_budget_bytes;
+};
+
+/**
+ * Initialize a runner configuration with the default settings.
+ *
+ * @param config The configuration to initialize.
+ */
+CTEST_ALL_NONNULL_ARGS__
+extern void ctest_runner_config_init(ctest_runner_config_t *config);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* CTEST__EXEC__RUNNER_CONFIG_H__INCLUDED__ */
@@ -0,0 +1,57 @@
+/**
+ * Test Case Sharding
+ *
+ * A run can be split across several machines (or invocations) by giving each
+ * one a shard: its index among a fixed number of shards. Every test case is
+ * assigned to exactly one shard, determined only by the test cases being run
+ * (and, optionally, their recorded durations), so every shard agrees on the
+ * assignment without any coordination.
+ */
+#ifndef CTEST__EXEC__SHARD_H__INCLUDED__
+#define CTEST__EXEC__SHARD_H__INCLUDED__
+
+#include <stddef.h>
+
+#include <ctest/_annotations.h>
+#include <ctest/exec/suite.h>
+#include <ctest/exec/timings.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Select the test cases that belong to a shard.
+ *
+ * Without a timing database (or if none of the test cases has a recorded
+ * duration), each test case is assigned by a stable hash of its suite and
+ * test case names, so its shard doesn't depend on which other test cases are
+ * being run.
+ *
+ * Otherwise, the test cases are balanced across the shards by their predicted
+ * duration (see <code>ctest_timings_order</code>): longest first, each goes
+ * to the shard predicted to finish first. The assignment then depends on the
+ * whole collection, so every shard must be given the same test cases (in any
+ * order) and the same timings.
+ *
+ * @param timings        The timing database with which to balance the shards,
+ *                       or <code>NULL</code> to assign by hash alone.
+ * @param testcases      The test cases of the whole run.
+ * @param testcase_count The number of test cases.
+ * @param index          The shard to select (from zero).
+ * @param count          The number of shards (more than <code>index</code>).
+ * @param selected       Filled in with the test cases of the shard, in the
+ *                       order they appear in <code>testcases</code>; it must
+ *                       have room for <code>testcase_count</code> entries,
+ *                       and may be <code>testcases</code> itself.
+ * @param p_selected_count Updated with the number of test cases selected.
+ *
+ * @return Zero on success, non-zero (with <code>errno</code> set) on failure.
+ */
+CTEST_NONNULL_ARGS__(6, 7)
+extern int ctest_shard_select(const ctest_timings_t *timings, ctest_testcase_t *const*testcases, size_t testcase_count, unsigned int index, unsigned int count, ctest_testcase_t **selected, size_t *p_selected_count);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* CTEST__EXEC__SHARD_H__INCLUDED__ */
@@ -24,7 +24,10 @@
 #ifndef CTEST__EXEC__SUITE_H__INCLUDED__
 #define CTEST__EXEC__SUITE_H__INCLUDED__
 
+#include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
+#include <string.h>
 
 #include <ctest/_annotations.h>
 #include <ctest/exec/exec_hooks.h>
@@ -64,6 +67,111 @@ typedef struct ctest_test ctest_test_t;
  */
 typedef struct ctest_testsuite ctest_testsuite_t;
 
+/**
+ * State shared by the test cases of one or more tests.
+ *
+ * A shared fixture is set up once for its scope (see
+ * <code>ctest_fixture_scope_t</code>), rather than by each test case, either
+ * in the runner's process or in a process from which the test cases using it
+ * are then forked. Once it has been set up in a process, test cases executed
+ * in that process (or in one forked from it) use it instead of setting up a
+ * fixture of their own.
+ */
+typedef struct ctest_fixture ctest_fixture_t;
+
+/**
+ * The test cases among which a fixture is shared.
+ */
+typedef enum ctest_fixture_scope {
+	/**
+	 * The test cases of a single test.
+	 */
+	CTEST_FIXTURE_SCOPE_TEST,
+
+	/**
+	 * The test cases of every test of a suite using the fixture.
+	 */
+	CTEST_FIXTURE_SCOPE_SUITE,
+} ctest_fixture_scope_t;
+
+/*
+ * Fixture
+ */
+typedef const struct ctest_fixture_ops ctest_fixture_ops_t;
+struct ctest_fixture_ops {
+	CTEST_ALL_NONNULL_ARGS__ CTEST_RETURNS_NONNULL__
+	const char *(*get_name)(ctest_fixture_t *);
+
+	CTEST_ALL_NONNULL_ARGS__
+	ctest_fixture_scope_t (*get_scope)(ctest_fixture_t *);
+
+	CTEST_ALL_NONNULL_ARGS__
+	void (*setup)(ctest_fixture_t *, ctest_exec_hooks_t *);
+
+	CTEST_ALL_NONNULL_ARGS__
+	void (*teardown)(ctest_fixture_t *, ctest_exec_hooks_t *);
+};
+struct ctest_fixture {
+	ctest_fixture_ops_t *ops;
+};
+
+/**
+ * Get the human-readable name of the fixture.
+ *
+ * @param fixture The fixture for which to get the human-readable name.
+ * @return The human-readable name of the fixture.
+ */
+CTEST_ALL_NONNULL_ARGS__ CTEST_RETURNS_NONNULL__
+static inline const char *ctest_fixture_get_name(ctest_fixture_t *fixture)
+{
+	return (*fixture->ops->get_name)(fixture);
+}
+
+/**
+ * Get the scope of the fixture.
+ *
+ * A fixture with the scope of a test is only ever used by the test cases of
+ * that test; one with the scope of a suite, by those of the suite.
+ *
+ * @param fixture The fixture for which to get the scope.
+ * @return The scope of the fixture.
+ */
+CTEST_ALL_NONNULL_ARGS__
+static inline ctest_fixture_scope_t ctest_fixture_get_scope(ctest_fixture_t *fixture)
+{
+	return (*fixture->ops->get_scope)(fixture);
+}
+
+/**
+ * Set up the fixture in the calling process.
+ *
+ * Failures are reported (in the set up stage) through the hooks, like those of
+ * a test case; the fixture is only set up if this returns.
+ *
+ * @param fixture The fixture to set up.
+ * @param hooks   The hooks to handle failures.
+ */
+CTEST_ALL_NONNULL_ARGS__
+static inline void ctest_fixture_setup(ctest_fixture_t *fixture, ctest_exec_hooks_t *hooks)
+{
+	return (*fixture->ops->setup)(fixture, hooks);
+}
+
+/**
+ * Tear down the fixture, previously set up in the calling process.
+ *
+ * Failures are reported (in the tear down stage) through the hooks; the
+ * fixture is no longer set up either way.
+ *
+ * @param fixture The fixture to tear down.
+ * @param hooks   The hooks to handle failures.
+ */
+CTEST_ALL_NONNULL_ARGS__
+static inline void ctest_fixture_teardown(ctest_fixture_t *fixture, ctest_exec_hooks_t *hooks)
+{
+	return (*fixture->ops->teardown)(fixture, hooks);
+}
+
 /*
  * Test Case
  */
@@ -139,6 +247,21 @@ struct ctest_test_ops {
 
 	CTEST_ALL_NONNULL_ARGS__ CTEST_RETURNS_NONNULL__
 	ctest_testcase_t *const*(*get_testcases)(ctest_test_t *);
+
+	CTEST_ALL_NONNULL_ARGS__
+	uint64_t (*get_timeout_ns)(ctest_test_t *);
+
+	CTEST_ALL_NONNULL_ARGS__
+	ctest_fixture_t *(*get_shared_fixture)(ctest_test_t *);
+
+	CTEST_ALL_NONNULL_ARGS__ CTEST_RETURNS_NONNULL__
+	const char *const *(*get_tags)(ctest_test_t *);
+
+	CTEST_ALL_NONNULL_ARGS__ CTEST_RETURNS_NONNULL__
+	ctest_test_t *const *(*get_prerequisites)(ctest_test_t *);
+
+	CTEST_ALL_NONNULL_ARGS__ CTEST_RETURNS_NONNULL__
+	const char *const *(*get_resources)(ctest_test_t *);
 };
 struct ctest_test {
 	ctest_test_ops_t *ops;
@@ -195,6 +318,102 @@ static inline ctest_testcase_t *const*ctest_test_get_testcases(ctest_test_t *tes
 	return (*test->ops->get_testcases)(test);
 }
 
+/**
+ * Get the time limit of each of the test's test cases, as set by the test
+ * itself.
+ *
+ * @param test The test for which to get the time limit.
+ * @return The time limit, in nanoseconds, or zero if the test doesn't have a
+ *         time limit of its own (and the runner's default applies).
+ */
+CTEST_ALL_NONNULL_ARGS__
+static inline uint64_t ctest_test_get_timeout_ns(ctest_test_t *test)
+{
+	return (*test->ops->get_timeout_ns)(test);
+}
+
+/**
+ * Get the fixture the test's test cases share, if any.
+ *
+ * The same fixture is returned for every test of a suite using it, if its
+ * scope is the suite.
+ *
+ * @param test The test for which to get the shared fixture.
+ * @return The shared fixture, or <code>NULL</code> if the test's test cases
+ *         don't share one (each sets up its own fixture, if it has one).
+ */
+CTEST_ALL_NONNULL_ARGS__
+static inline ctest_fixture_t *ctest_test_get_shared_fixture(ctest_test_t *test)
+{
+	return (*test->ops->get_shared_fixture)(test);
+}
+
+/**
+ * Get the tags of the test (see <code>CT_TEST_TAGS</code>).
+ *
+ * @param test The test for which to get the tags.
+ * @return The tags, as a <code>NULL</code>-terminated array (which is empty
+ *         if the test has no tags).
+ */
+CTEST_ALL_NONNULL_ARGS__ CTEST_RETURNS_NONNULL__
+static inline const char *const *ctest_test_get_tags(ctest_test_t *test)
+{
+	return (*test->ops->get_tags)(test);
+}
+
+/**
+ * Determine whether a test is tagged with a given tag.
+ *
+ * @param test The test to check.
+ * @param tag  The tag to look for.
+ * @return Whether the test has the tag.
+ */
+CTEST_ALL_NONNULL_ARGS__
+static inline bool ctest_test_has_tag(ctest_test_t *test, const char *tag)
+{
+	const char *const *tags;
+
+	for (tags = ctest_test_get_tags(test); *tags != NULL; ++tags) {
+		if (strcmp(*tags, tag) == 0)
+			return true;
+	}
+	return false;
+}
+
+/**
+ * Get the tests the test depends on (see <code>CT_TEST_DEPENDS_ON</code>).
+ *
+ * A test's test cases should only be run once every test case of each of its
+ * prerequisites has passed, and be skipped if one doesn't. Prerequisites are
+ * always tests of the same suite, and never (even indirectly) depend on the
+ * test itself.
+ *
+ * @param test The test for which to get the prerequisites.
+ * @return The prerequisites, as a <code>NULL</code>-terminated array (which
+ *         is empty if the test has none).
+ */
+CTEST_ALL_NONNULL_ARGS__ CTEST_RETURNS_NONNULL__
+static inline ctest_test_t *const *ctest_test_get_prerequisites(ctest_test_t *test)
+{
+	return (*test->ops->get_prerequisites)(test);
+}
+
+/**
+ * Get the shared resources the test uses (see <code>CT_TEST_RESOURCES</code>).
+ *
+ * Each resource is a name, optionally followed by a colon and the (positive)
+ * amount of the resource the test needs, e.g., "gpu0" or "bigmem:8".
+ *
+ * @param test The test for which to get the resources.
+ * @return The resources, as a <code>NULL</code>-terminated array (which is
+ *         empty if the test uses none).
+ */
+CTEST_ALL_NONNULL_ARGS__ CTEST_RETURNS_NONNULL__
+static inline const char *const *ctest_test_get_resources(ctest_test_t *test)
+{
+	return (*test->ops->get_resources)(test);
+}
+
 /*
  * Test Suite
  */
@@ -209,6 +428,12 @@ struct ctest_testsuite_ops {
 	CTEST_ALL_NONNULL_ARGS__ CTEST_RETURNS_NONNULL__
 	ctest_test_t *const*(*get_tests)(ctest_testsuite_t *);
 
+	CTEST_ALL_NONNULL_ARGS__
+	const char *(*get_filename)(ctest_testsuite_t *);
+
+	CTEST_ALL_NONNULL_ARGS__
+	bool (*supports_threads)(ctest_testsuite_t *);
+
 	CTEST_ALL_NONNULL_ARGS__
 	void (*destroy)(ctest_testsuite_t *);
 };
@@ -256,6 +481,38 @@ static inline ctest_test_t *const*ctest_testsuite_get_tests(ctest_testsuite_t *t
 	return (*testsuite->ops->get_tests)(testsuite);
 }
 
+/**
+ * Get the name of the module file from which the test suite was loaded.
+ *
+ * @param testsuite The test suite for which to get the module file.
+ * @return The name of the module file, as passed to
+ *         <code>ctest_load_testsuite</code>, or <code>NULL</code> if the test
+ *         suite wasn't loaded from a module.
+ */
+CTEST_ALL_NONNULL_ARGS__
+static inline const char *ctest_testsuite_get_filename(ctest_testsuite_t *testsuite)
+{
+	return (*testsuite->ops->get_filename)(testsuite);
+}
+
+/**
+ * Determine whether test cases of the test suite may be run concurrently on
+ * different threads of the same process.
+ *
+ * Modules built against an older stub report failures through a single,
+ * global, set of dynamic operations, so only one of their test cases may be
+ * in flight within a process at a time.
+ *
+ * @param testsuite The test suite to check.
+ * @return Whether the test suite's test cases may be run concurrently within
+ *         a process.
+ */
+CTEST_ALL_NONNULL_ARGS__
+static inline bool ctest_testsuite_supports_threads(ctest_testsuite_t *testsuite)
+{
+	return (*testsuite->ops->supports_threads)(testsuite);
+}
+
 /**
  * Destroy a test suite, freeing any resources it may have.
  *
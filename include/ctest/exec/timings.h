@@ -0,0 +1,170 @@
+/**
+ * Test Case Timings
+ *
+ * A <code>ctest_timings_t</code> is a database of the duration of each test
+ * case, as measured by previous runs, keyed by the name of the test suite and
+ * the name of the test case. Runners given a timing database (see
+ * <code>ctest_runner_config_t</code>) start the test cases that are expected
+ * to take the longest first, so a few long test cases started last don't
+ * dominate the duration of a parallel run, and record the duration of every
+ * test case they run.
+ *
+ * The database also keeps the number of times each test case crashed while
+ * run within the runner's own process, so a runner can run it in a child
+ * process of its own from then on, and the most memory each test case used
+ * when run in a child process of its own, so a runner can keep the test cases
+ * it runs at once from using more memory than there is.
+ *
+ * The database is stored as a text file, one test case per line:
+ * <code>suite&lt;TAB&gt;test case&lt;TAB&gt;nanoseconds</code>, followed by
+ * <code>&lt;TAB&gt;crashes</code> for a test case that has crashed or whose
+ * memory use was measured, and then <code>&lt;TAB&gt;bytes</code> for the
+ * latter.
+ */
+#ifndef CTEST__EXEC__TIMINGS_H__INCLUDED__
+#define CTEST__EXEC__TIMINGS_H__INCLUDED__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <ctest/_annotations.h>
+#include <ctest/exec/suite.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct ctest_timings ctest_timings_t;
+
+/**
+ * Create an empty timing database.
+ *
+ * @return The new timing database, or <code>NULL</code> on failure.
+ */
+extern ctest_timings_t *ctest_timings_create(void);
+
+/**
+ * Destroy a timing database, freeing resources associated with it.
+ *
+ * @param timings The timing database to destroy.
+ */
+CTEST_ALL_NONNULL_ARGS__
+extern void ctest_timings_destroy(ctest_timings_t *timings);
+
+/**
+ * Load the timings stored in a file, adding them to (or replacing those in)
+ * the database.
+ *
+ * A file that doesn't exist is treated as empty; malformed lines are ignored.
+ *
+ * @param timings  The timing database to load into.
+ * @param filename The file from which to load the timings.
+ *
+ * @return Zero on success, non-zero (with <code>errno</code> set) on failure.
+ */
+CTEST_ALL_NONNULL_ARGS__
+extern int ctest_timings_load(ctest_timings_t *timings, const char *filename);
+
+/**
+ * Store the timings in a file, replacing its contents.
+ *
+ * @param timings  The timing database to store.
+ * @param filename The file in which to store the timings.
+ *
+ * @return Zero on success, non-zero (with <code>errno</code> set) on failure.
+ */
+CTEST_ALL_NONNULL_ARGS__
+extern int ctest_timings_save(const ctest_timings_t *timings, const char *filename);
+
+/**
+ * Record the duration of a test case, replacing any previously recorded
+ * duration.
+ *
+ * @return Zero on success, non-zero (with <code>errno</code> set) on failure.
+ */
+CTEST_ALL_NONNULL_ARGS__
+extern int ctest_timings_record(ctest_timings_t *timings, ctest_testcase_t *testcase, uint64_t duration_ns);
+
+/**
+ * Record that a test case crashed (i.e., was stopped by a signal such as
+ * <code>SIGSEGV</code>) while run within the runner's own process.
+ *
+ * @return Zero on success, non-zero (with <code>errno</code> set) on failure.
+ */
+CTEST_ALL_NONNULL_ARGS__
+extern int ctest_timings_record_crash(ctest_timings_t *timings, ctest_testcase_t *testcase);
+
+/**
+ * Record the most memory a test case used at any one time (see
+ * <code>ctest_result_t.peak_memory_bytes</code>), replacing any previously
+ * recorded peak.
+ *
+ * @return Zero on success, non-zero (with <code>errno</code> set) on failure.
+ */
+CTEST_ALL_NONNULL_ARGS__
+extern int ctest_timings_record_memory(ctest_timings_t *timings, ctest_testcase_t *testcase, uint64_t peak_memory_bytes);
+
+/**
+ * Look up the recorded duration of a test case.
+ *
+ * @param timings        The timing database.
+ * @param testcase       The test case to look up.
+ * @param p_duration_ns  Updated with the recorded duration, if any.
+ *
+ * @return Whether a duration was recorded for the test case.
+ */
+CTEST_ALL_NONNULL_ARGS__
+extern bool ctest_timings_lookup(const ctest_timings_t *timings, ctest_testcase_t *testcase, uint64_t *p_duration_ns);
+
+/**
+ * Look up how many times a test case has crashed while run within the
+ * runner's own process.
+ *
+ * @param timings  The timing database.
+ * @param testcase The test case to look up.
+ *
+ * @return The number of recorded crashes, zero if there are none.
+ */
+CTEST_ALL_NONNULL_ARGS__
+extern unsigned int ctest_timings_get_crash_count(const ctest_timings_t *timings, ctest_testcase_t *testcase);
+
+/**
+ * Look up the most memory a test case used at any one time, when it was last
+ * measured.
+ *
+ * @param timings             The timing database.
+ * @param testcase            The test case to look up.
+ * @param p_peak_memory_bytes Updated with the recorded peak, if any.
+ *
+ * @return Whether a peak was recorded for the test case.
+ */
+CTEST_ALL_NONNULL_ARGS__
+extern bool ctest_timings_lookup_memory(const ctest_timings_t *timings, ctest_testcase_t *testcase, uint64_t *p_peak_memory_bytes);
+
+/**
+ * Predict how long each of a collection of test cases will take and order
+ * them longest first.
+ *
+ * Test cases without a recorded duration are predicted to take the average of
+ * the recorded durations of the other test cases. Test cases predicted to
+ * take the same time keep their relative order.
+ *
+ * @param timings        The timing database.
+ * @param testcases      The test cases to order.
+ * @param testcase_count The number of test cases.
+ * @param order          Filled in with the indexes of the test cases (in
+ *                       <code>testcases</code>), longest first.
+ * @param predicted_ns   If not <code>NULL</code>, filled in with the predicted
+ *                       duration of each test case (indexed like
+ *                       <code>testcases</code>).
+ *
+ * @return The number of test cases with a recorded duration.
+ */
+CTEST_NONNULL_ARGS__(1, 4)
+extern size_t ctest_timings_order(const ctest_timings_t *timings, ctest_testcase_t *const*testcases, size_t testcase_count, size_t *order, uint64_t *predicted_ns);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* CTEST__EXEC__TIMINGS_H__INCLUDED__ */
@@ -3,6 +3,7 @@
 
 #include <ctest/tests/assert.h>
 #include <ctest/tests/fixtures.h>
+#include <ctest/tests/ports.h>
 #include <ctest/tests/tests.h>
 
 #endif /* CTEST__TESTS_H__INCLUDED__ */
@@ -0,0 +1,28 @@
+#ifndef CTEST__TESTS__PORTS_H__INCLUDED__
+#define CTEST__TESTS__PORTS_H__INCLUDED__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Lease a TCP port on the loopback interface for the test case to use,
+ * e.g., to start a server on:
+ *
+ *     const int port = CT_LEASE_PORT();
+ *
+ * Ports are leased in turn from a range shared by every test case of the run
+ * (see the --ports option of ctester), even those running concurrently in
+ * other processes, so a port is only handed out again once every other port
+ * of the range has been; a port in use by another process is skipped. The
+ * test case fails if no port can be leased.
+ */
+#define CT_LEASE_PORT()                         ctest_lease_port(__FILE__, __LINE__)
+
+extern int ctest_lease_port(const char *file, int line);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CTEST__TESTS__PORTS_H__INCLUDED__ */
@@ -39,12 +39,56 @@
 	static void CTEST_FIXTURE_TEARDOWN_NAME__(name)(struct CTEST_FIXTURE_NAME__(name) *fixture)
 #define CT_FIXTURE(name) \
 	typedef struct CTEST_FIXTURE_NAME__(name) CTEST_FIXTURE_TYPE_NAME__(name); \
+	static const int CTEST_FIXTURE_SCOPE_NAME__(name); \
 	static ctest_def_fixture_provider_t__ CTEST_FIXTURE_NAME__(name) = { \
 		(void(*)(void*))&CTEST_FIXTURE_SETUP_NAME__(name), \
 		(void(*)(void*))&CTEST_FIXTURE_TEARDOWN_NAME__(name), \
 		sizeof(CTEST_FIXTURE_TYPE_NAME__(name)), \
+		CTEST_STRINGIZE__(name), \
+		&CTEST_FIXTURE_SCOPE_NAME__(name), \
 	}
 
+/**
+ * Fixture Scopes
+ *
+ * A fixture defined with CT_FIXTURE is set up for each test case using it. One
+ * defined with CT_SUITE_FIXTURE or CT_TEST_FIXTURE instead is set up once, and
+ * handed to every test case of its scope using it: those of the suite, or
+ * those of a single test (e.g., each of the test cases of a data provider). It
+ * is torn down once the last of those test cases is done.
+ *
+ * When each test case is run in a child process of its own, the children of
+ * a scope are forked from a process in which the fixture has been set up, so
+ * each of them sees its own (copy-on-write) copy of the fixture, and the
+ * fixture is torn down even if test cases crash. When test cases are run in
+ * the runner's process, they're handed the same fixture (and see what test
+ * cases before them did to it); test cases run concurrently (e.g., by threads)
+ * mustn't change it. If setting the fixture up fails, the test cases of its
+ * scope fail without being run.
+ */
+#define CT_SUITE_FIXTURE(name) \
+	static const int CTEST_FIXTURE_SCOPE_NAME__(name) = CTEST_FIXTURE_SCOPE_SUITE__; \
+	CT_FIXTURE(name)
+#define CT_TEST_FIXTURE(name) \
+	static const int CTEST_FIXTURE_SCOPE_NAME__(name) = CTEST_FIXTURE_SCOPE_TEST__; \
+	CT_FIXTURE(name)
+
+/**
+ * Fixture Attributes
+ *
+ * Like test attributes, these are given with a separate declaration, either
+ * before or after the fixture itself, e.g.:
+ *
+ *     CT_FIXTURE_SHARED(index);
+ */
+
+/**
+ * Share a fixture defined with CT_FIXTURE among the test cases of its suite,
+ * as if it had been defined with CT_SUITE_FIXTURE.
+ */
+#define CT_FIXTURE_SHARED(name) \
+	static const int CTEST_FIXTURE_SCOPE_NAME__(name) = CTEST_FIXTURE_SCOPE_SUITE__
+
 /*
  * Tests
  */
@@ -92,6 +136,62 @@
 	CTEST_TEST_DEF__(name, &CTEST_FIXTURE_NAME__(fixture_name), &CTEST_DATA_PROVIDER_NAME__(data_name)); \
 	static void CTEST_TEST_NAME__(name)(CTEST_FIXTURE_TYPE_NAME__(fixture_name) *fixture, CTEST_DATA_TYPE_NAME__(data_name) *data)
 
+/**
+ * Test Attributes
+ *
+ * Attributes are given to a test with a separate declaration, either before
+ * or after the test itself, e.g.:
+ *
+ *     CT_TEST_TIMEOUT(slow_test, 30);
+ */
+
+/**
+ * Limit how long (in seconds) each test case of the test may take, overriding
+ * the runner's default time limit.
+ */
+#define CT_TEST_TIMEOUT(name, seconds) \
+	static const double CTEST_TEST_TIMEOUT_NAME__(name) = (seconds)
+
+/**
+ * Tag the test with one or more labels (strings) that runners act on, e.g.:
+ *
+ *     CT_TEST_TAGS(fork_bomb, "unsafe");
+ *
+ * A test tagged "unsafe" is always run in a child process of its own, even by
+ * a runner that otherwise runs test cases within its own process; a runner
+ * that never forks (the threaded runner) runs its test cases alone instead,
+ * with no other test case in flight.
+ */
+#define CT_TEST_TAGS(name, ...) \
+	static const char *const *const CTEST_TEST_TAGS_NAME__(name) = (const char *const[]){ __VA_ARGS__, NULL }
+
+/**
+ * Make the test depend on one or more other tests of the same suite, by name
+ * (strings), e.g.:
+ *
+ *     CT_TEST_DEPENDS_ON(queries_run, "schema_loads", "data_loads");
+ *
+ * The test cases of the test are only run once every test case of each of
+ * its prerequisites has passed; if one doesn't, they are skipped instead.
+ * Tests that don't depend on one another may still be run concurrently.
+ */
+#define CT_TEST_DEPENDS_ON(name, ...) \
+	static const char *const *const CTEST_TEST_DEPENDS_ON_NAME__(name) = (const char *const[]){ __VA_ARGS__, NULL }
+
+/**
+ * Declare the shared resources (strings) the test uses, each optionally
+ * followed by a colon and the amount of it the test needs (one by default),
+ * e.g.:
+ *
+ *     CT_TEST_RESOURCES(train_model, "gpu0", "bigmem:8");
+ *
+ * Runners never run test cases concurrently if together they would need more
+ * of a resource than it has (see the --resource option of ctester); a
+ * resource with no declared capacity is used by one test case at a time.
+ */
+#define CT_TEST_RESOURCES(name, ...) \
+	static const char *const *const CTEST_TEST_RESOURCES_NAME__(name) = (const char *const[]){ __VA_ARGS__, NULL }
+
 /*
  * Test Suite
  */
@@ -120,33 +220,61 @@
 #define CTEST_TEST_DEF_NAME__(name)                     CTEST_GLUE3__(ctest_test__,name,__def__)
 #define CTEST_TEST_CALLER_NAME__(name)                  CTEST_GLUE3__(ctest_test__,name,__caller__)
 #define CTEST_TEST_NAME__(name)                         CTEST_GLUE3__(ctest_test__,name,__)
+#define CTEST_TEST_TIMEOUT_NAME__(name)                 CTEST_GLUE3__(ctest_test__,name,__timeout__)
+#define CTEST_TEST_TAGS_NAME__(name)                    CTEST_GLUE3__(ctest_test__,name,__tags__)
+#define CTEST_TEST_DEPENDS_ON_NAME__(name)              CTEST_GLUE3__(ctest_test__,name,__depends_on__)
+#define CTEST_TEST_RESOURCES_NAME__(name)               CTEST_GLUE3__(ctest_test__,name,__resources__)
 #define CTEST_FIXTURE_TYPE_NAME__(name)                 CTEST_GLUE3__(ctest_fixture__,name,__t__)
 #define CTEST_FIXTURE_SETUP_NAME__(name)                CTEST_GLUE3__(ctest_fixture__,name,__setup__)
 #define CTEST_FIXTURE_TEARDOWN_NAME__(name)             CTEST_GLUE3__(ctest_fixture__,name,__teardown__)
+#define CTEST_FIXTURE_SCOPE_NAME__(name)                CTEST_GLUE3__(ctest_fixture__,name,__scope__)
 #define CTEST_FIXTURE_NAME__(name)                      CTEST_GLUE3__(ctest_fixture__,name,__)
 #define CTEST_SUITE_TESTS_NAME__(name)                  CTEST_GLUE3__(ctest_suite__,name,__tests__)
 #define CTEST_SUITE_NAME__(name)                        CTEST_GLUE3__(ctest_suite__,name,__)
 
 /**
  * Define a test definition.
+ *
+ * Each attribute is a tentative definition, so it is zero unless the test's
+ * attribute macro (which may appear before or after the test) defines it.
  */
 #define CTEST_TEST_DEF__(name, fixture, data) \
+	static const double CTEST_TEST_TIMEOUT_NAME__(name); \
+	static const char *const *const CTEST_TEST_TAGS_NAME__(name); \
+	static const char *const *const CTEST_TEST_DEPENDS_ON_NAME__(name); \
+	static const char *const *const CTEST_TEST_RESOURCES_NAME__(name); \
 	static ctest_def_test_t__ CTEST_TEST_DEF_NAME__(name) = { \
 		CTEST_STRINGIZE__(name), \
 		&CTEST_TEST_CALLER_NAME__(name), \
 		fixture, \
 		data, \
+		&CTEST_TEST_TIMEOUT_NAME__(name), \
+		&CTEST_TEST_TAGS_NAME__(name), \
+		&CTEST_TEST_DEPENDS_ON_NAME__(name), \
+		&CTEST_TEST_RESOURCES_NAME__(name), \
 	}
 
 #define CTEST_SUITE_SYMBOL__    ctest_suite__
 #define CTEST_SUITE_MAGIC__     0x72db2d
-#define CTEST_SUITE_VERSION__   0x00000000
+#define CTEST_SUITE_VERSION__   0x00000005
+
+#define CTEST_FIXTURE_SCOPE_TESTCASE__  0
+#define CTEST_FIXTURE_SCOPE_SUITE__     1
+#define CTEST_FIXTURE_SCOPE_TEST__      2
 
 typedef const struct ctest_def_fixture_provider__ ctest_def_fixture_provider_t__;
 struct ctest_def_fixture_provider__ {
 	void (*setup)(void *fixture);
 	void (*teardown)(void *fixture);
 	size_t size;
+
+	/* Since version 2. */
+	const char *name;
+
+	/* Since version 2; the scope of the fixture (one of
+	 * CTEST_FIXTURE_SCOPE_xxx__), or NULL if it is set up for each test
+	 * case. */
+	const int *scope;
 };
 
 typedef const struct ctest_def_data_provider__ ctest_def_data_provider_t__;
@@ -163,6 +291,21 @@ struct ctest_def_test__ {
 	void (*caller)(void *, const void *);
 	ctest_def_fixture_provider_t__ *fixture_provider;
 	ctest_def_data_provider_t__ *data_provider;
+
+	/* Since version 1; zero if the test has no time limit of its own. */
+	const double *timeout;
+
+	/* Since version 3; a NULL-terminated array, or NULL if the test has no
+	 * tags. */
+	const char *const *const *tags;
+
+	/* Since version 4; a NULL-terminated array of the names of the tests
+	 * (of the same suite) the test depends on, or NULL if it has none. */
+	const char *const *const *depends_on;
+
+	/* Since version 5; a NULL-terminated array of the resources the test
+	 * uses (each "name" or "name:amount"), or NULL if it uses none. */
+	const char *const *const *resources;
 };
 
 typedef const struct ctest_def_suite__ ctest_def_suite_t__;
@@ -1,10 +1,14 @@
 #include <errno.h>
+#include <getopt.h>
+#include <inttypes.h>
 #include <limits.h>
+#include <signal.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sysexits.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
 #include <ctest/exec.h>
@@ -24,7 +28,6 @@ struct command_options {
  * Option Parsing
  */
 
-#if 0
 static int parse_uint__(unsigned int *p_val, const char *str) {
 	char *end;
 	unsigned long val;
@@ -39,7 +42,132 @@ static int parse_uint__(unsigned int *p_val, const char *str) {
 		*p_val = (unsigned int)val;
 	return 0;
 }
-#endif
+
+/**
+ * Parse a (positive, possibly fractional) number of seconds into nanoseconds.
+ */
+static int parse_seconds__(uint64_t *p_ns, const char *str) {
+	char *end;
+	double val;
+
+	errno = 0;
+
+	val = strtod(str, &end);
+	if (errno != 0 || end == str || *end != '\0' || !(val > 0) || val > (double)(UINT64_MAX / 1000000000u))
+		return 1;
+
+	if (p_ns != NULL)
+		*p_ns = (uint64_t)(val * 1e9);
+	return 0;
+}
+
+/**
+ * Parse a (positive) size in bytes, optionally followed by a binary unit (K,
+ * M, G, or T).
+ */
+static int parse_size__(uint64_t *p_bytes, const char *str) {
+	static const char units[] = "KMGT";
+	const char *unit;
+	char *end;
+	unsigned long long val;
+	int shift = 0;
+
+	errno = 0;
+
+	val = strtoull(str, &end, 10);
+	if (errno != 0 || end == str || *str == '-' || val == 0)
+		return 1;
+	if (*end != '\0') {
+		if ((unit = strchr(units, *end)) == NULL || end[1] != '\0')
+			return 1;
+		shift = 10 * (int)(unit - units + 1);
+	}
+	if (val > (UINT64_MAX >> shift))
+		return 1;
+
+	if (p_bytes != NULL)
+		*p_bytes = (uint64_t)val << shift;
+	return 0;
+}
+
+/**
+ * Parse a shard, given as <code>index/count</code> (with the index counted
+ * from one), into its index (counted from zero) and count.
+ */
+static int parse_shard__(unsigned int *p_index, unsigned int *p_count, const char *str) {
+	const char *const slash = strchr(str, '/');
+	char index_str[16];
+	unsigned int index, count;
+
+	if (slash == NULL || (size_t)(slash - str) >= sizeof(index_str))
+		return 1;
+	memcpy(index_str, str, slash - str);
+	index_str[slash - str] = '\0';
+
+	if (parse_uint__(&index, index_str) != 0 || parse_uint__(&count, slash + 1) != 0)
+		return 1;
+	if (index < 1 || index > count)
+		return 1;
+
+	*p_index = index - 1;
+	*p_count = count;
+	return 0;
+}
+
+/**
+ * Parse the capacity of a resource, given as <code>name=count</code> (with a
+ * positive count).
+ */
+static int parse_resource__(const char *str) {
+	const char *const equals = strchr(str, '=');
+	unsigned int count;
+
+	if (equals == NULL || equals == str)
+		return 1;
+	if (parse_uint__(&count, equals + 1) != 0 || count == 0)
+		return 1;
+	return 0;
+}
+
+/**
+ * Parse a range of ports, given as <code>first-last</code>.
+ */
+static int parse_ports__(unsigned int *p_first, unsigned int *p_last, const char *str) {
+	const char *const dash = strchr(str, '-');
+	char first_str[16];
+	unsigned int first, last;
+
+	if (dash == NULL || (size_t)(dash - str) >= sizeof(first_str))
+		return 1;
+	memcpy(first_str, str, dash - str);
+	first_str[dash - str] = '\0';
+
+	if (parse_uint__(&first, first_str) != 0 || parse_uint__(&last, dash + 1) != 0)
+		return 1;
+	if (first < 1 || first > last || last > 65535)
+		return 1;
+
+	*p_first = first;
+	*p_last = last;
+	return 0;
+}
+
+/**
+ * Add the capacity of a resource to a <code>NULL</code>-terminated array of
+ * them.
+ *
+ * @return Zero on success, non-zero on failure.
+ */
+static int add_resource__(const char ***p_resources, size_t *p_count, const char *resource) {
+	const char **resources;
+
+	if ((resources = realloc(*p_resources, (*p_count + 2) * sizeof(*resources))) == NULL)
+		return 1;
+	resources[(*p_count)++] = resource;
+	resources[*p_count] = NULL;
+	*p_resources = resources;
+	return 0;
+}
 
 /*
  * Miscellaneous
@@ -119,14 +247,259 @@ static void destroy_testsuite_collection__(testsuite_collection_t *collection) {
 	free(collection);
 }
 
+/**
+ * Gather the test cases of every suite of a collection, in order, keeping
+ * only those of one shard if <code>shard_count</code> is non-zero.
+ *
+ * @param timings      The timing database with which to balance the shards,
+ *                     or <code>NULL</code>.
+ * @param timings_file The file the timing database was loaded from, if any.
+ *
+ * @return The test cases (to be freed by the caller), or <code>NULL</code> on
+ *         failure.
+ */
+static ctest_testcase_t **collect_testcases__(testsuite_collection_t *collection, const ctest_timings_t *timings, const char *timings_file, unsigned int shard_index, unsigned int shard_count, size_t *p_testcase_count) {
+	ctest_testcase_t **testcases;
+	size_t i, j, testcase_count = 0, known = 0;
+
+	for (i = 0; i < collection->count; ++i) {
+		ctest_testsuite_t *const ts = collection->testsuites[i];
+		for (j = 0; j < ctest_testsuite_get_test_count(ts); ++j)
+			testcase_count += ctest_test_get_testcase_count(ctest_testsuite_get_tests(ts)[j]);
+	}
+
+	if ((testcases = calloc(testcase_count + 1, sizeof(*testcases))) == NULL) {
+		fprintf(stderr, "%s: error allocating memory for test cases: %s\n", self__, strerror(errno));
+		return NULL;
+	}
+
+	testcase_count = 0;
+	for (i = 0; i < collection->count; ++i) {
+		ctest_testsuite_t *const ts = collection->testsuites[i];
+		for (j = 0; j < ctest_testsuite_get_test_count(ts); ++j) {
+			ctest_test_t *const test = ctest_testsuite_get_tests(ts)[j];
+			memcpy(testcases + testcase_count, ctest_test_get_testcases(test), ctest_test_get_testcase_count(test) * sizeof(*testcases));
+			testcase_count += ctest_test_get_testcase_count(test);
+		}
+	}
+
+	/* Test cases without a recorded duration are still assigned the same
+	 * way on every shard given the same file, but a file that doesn't
+	 * cover the run is likely out of date, or not the same everywhere. */
+	if (shard_count > 0 && timings != NULL) {
+		uint64_t ignored;
+
+		for (i = 0; i < testcase_count; ++i)
+			known += ctest_timings_lookup(timings, testcases[i], &ignored);
+		if (known == 0)
+			fprintf(stderr, "%s: warning: none of the %zu test cases has a duration in %s; assigning shards by name\n", self__, testcase_count, timings_file);
+		else if (known < testcase_count)
+			fprintf(stderr, "%s: warning: %zu of the %zu test cases have no duration in %s; shards only agree if every one is given the same file\n",
+			        self__, testcase_count - known, testcase_count, timings_file);
+	}
+
+	if (shard_count > 0 && ctest_shard_select(timings, testcases, testcase_count, shard_index, shard_count, testcases, &testcase_count) != 0) {
+		fprintf(stderr, "%s: error selecting shard %u/%u: %s\n", self__, shard_index + 1, shard_count, strerror(errno));
+		free(testcases);
+		return NULL;
+	}
+
+	*p_testcase_count = testcase_count;
+	return testcases;
+}
+
+/**
+ * Load the timing database with which to balance shards (see
+ * <code>--shard-timings</code>).
+ *
+ * Unlike the database recorded with <code>--timings</code>, it is only ever
+ * read, so every machine given the same file assigns the same test cases to
+ * the same shards.
+ *
+ * @return The timing database, or <code>NULL</code> (having reported why) on
+ *         failure.
+ */
+static ctest_timings_t *load_shard_timings__(const char *filename)
+{
+	ctest_timings_t *timings;
+
+	/* A missing file would quietly fall back to assigning by name. */
+	if (access(filename, R_OK) != 0) {
+		fprintf(stderr, "%s: unable to read shard timings from %s: %s\n", self__, filename, strerror(errno));
+		return NULL;
+	}
+	if ((timings = ctest_timings_create()) == NULL) {
+		fprintf(stderr, "Error creating timing database: %s\n", strerror(errno));
+		return NULL;
+	}
+	if (ctest_timings_load(timings, filename) != 0) {
+		fprintf(stderr, "%s: unable to load shard timings from %s: %s\n", self__, filename, strerror(errno));
+		ctest_timings_destroy(timings);
+		return NULL;
+	}
+	return timings;
+}
+
+/**
+ * Check whether two paths name the same file (as far as can be told).
+ */
+static bool same_file__(const char *lhs, const char *rhs)
+{
+	struct stat lhs_st, rhs_st;
+
+	if (strcmp(lhs, rhs) == 0)
+		return true;
+	return stat(lhs, &lhs_st) == 0 && stat(rhs, &rhs_st) == 0 && lhs_st.st_dev == rhs_st.st_dev && lhs_st.st_ino == rhs_st.st_ino;
+}
+
 /*
  * run Command
  */
 
+/**
+ * Print the predicted schedule of a run, without running anything.
+ *
+ * Test cases are assigned, in the order the runner starts them, to whichever
+ * job is predicted to become free first.
+ *
+ * @return Zero on success, non-zero on failure.
+ */
+static void print_cpus__(FILE *fp, const ctest_cpu_t *cpus, size_t cpu_count)
+{
+	size_t i;
+
+	for (i = 0; i < cpu_count; ++i)
+		fprintf(fp, "%scpu %d (package %d, core %d)", i > 0 ? ", " : "", cpus[i].id, cpus[i].package, cpus[i].core);
+}
+
+/**
+ * Print the CPU on which each job runs its tests, and those reserved for
+ * ctester.
+ */
+static void print_placement__(FILE *fp, const ctest_placement_t *placement, unsigned int jobs)
+{
+	size_t reserved_count;
+	const ctest_cpu_t *const reserved = ctest_placement_get_reserved(placement, &reserved_count);
+	unsigned int i;
+
+	fprintf(fp, "Placement:\n");
+	if (reserved_count > 0) {
+		fprintf(fp, "    ctester: ");
+		print_cpus__(fp, reserved, reserved_count);
+		fprintf(fp, "\n");
+	}
+	for (i = 0; i < jobs; ++i) {
+		fprintf(fp, "    job %u: ", i + 1);
+		print_cpus__(fp, ctest_placement_get_cpu(placement, i), 1);
+		fprintf(fp, "%s\n", i >= ctest_placement_get_cpu_count(placement) ? " (shared)" : "");
+	}
+	fflush(fp);
+}
+
+/**
+ * Print how many jobs the concurrency controller let run at once over the
+ * course of the run, and the pressure on the system that made it change.
+ */
+static void print_concurrency__(FILE *fp, const ctest_concurrency_t *concurrency)
+{
+	size_t change_count, i;
+	const ctest_concurrency_change_t *const changes = ctest_concurrency_get_changes(concurrency, &change_count);
+	unsigned int min_limit = changes[0].limit, max_limit = changes[0].limit;
+
+	for (i = 1; i < change_count; ++i) {
+		if (changes[i].limit < min_limit)
+			min_limit = changes[i].limit;
+		if (changes[i].limit > max_limit)
+			max_limit = changes[i].limit;
+	}
+	fprintf(fp, "Concurrency: %.1f jobs on average, %u to %u of up to %u%s\n",
+		ctest_concurrency_get_mean_limit(concurrency), min_limit, max_limit,
+		ctest_concurrency_get_max_jobs(concurrency),
+		ctest_concurrency_has_pressure(concurrency) ? "" : " (CPU stalls estimated from runnable tasks)");
+	for (i = 0; i < change_count; ++i) {
+		fprintf(fp, "    %7.1fs: %u jobs; load %u.%02u, %u runnable", (double)changes[i].elapsed_ns / 1e9, changes[i].limit,
+			changes[i].load / 100, changes[i].load % 100, changes[i].runnable);
+		if (i > 0)
+			fprintf(fp, "; stalled: cpu %u.%u%%, memory %u.%u%%, io %u.%u%%",
+				changes[i].cpu_stall / 10, changes[i].cpu_stall % 10,
+				changes[i].memory_stall / 10, changes[i].memory_stall % 10,
+				changes[i].io_stall / 10, changes[i].io_stall % 10);
+		fprintf(fp, "\n");
+	}
+	fflush(fp);
+}
+
+static int print_plan__(FILE *fp, ctest_testcase_t *const*testcases, size_t testcase_count, ctest_timings_t *timings, unsigned int jobs, bool in_order)
+{
+	size_t *order = NULL;
+	uint64_t *predicted_ns = NULL, *job_free_ns = NULL, wall_ns = 0;
+	size_t i, j, known;
+	int result = -1;
+
+	if ((order = calloc(testcase_count + 1, sizeof(*order))) == NULL ||
+	    (predicted_ns = calloc(testcase_count + 1, sizeof(*predicted_ns))) == NULL ||
+	    (job_free_ns = calloc(jobs, sizeof(*job_free_ns))) == NULL) {
+		fprintf(stderr, "%s: error allocating memory for plan: %s\n", self__, strerror(errno));
+		goto alloc_failed;
+	}
+
+	known = ctest_timings_order(timings, testcases, testcase_count, order, predicted_ns);
+	if (known == 0 || jobs == 1 || in_order) {
+		/* The runner keeps the suite order. */
+		for (i = 0; i < testcase_count; ++i)
+			order[i] = i;
+	}
+
+	fprintf(fp, "Plan: %zu test cases on %u jobs, %s (%zu with recorded timings)\n",
+		testcase_count, jobs, known > 0 && jobs > 1 && !in_order ? "longest first" : "in suite order", known);
+	fprintf(fp, "  %4s %10s %10s  %s\n", "job", "start", "duration", "test case");
+	for (i = 0; i < testcase_count; ++i) {
+		ctest_testcase_t *const testcase = testcases[order[i]];
+		ctest_testsuite_t *const ts = ctest_test_get_testsuite(ctest_testcase_get_test(testcase));
+		const uint64_t duration_ns = predicted_ns[order[i]];
+		uint64_t ignored;
+		size_t i_job = 0;
+
+		for (j = 1; j < jobs; ++j) {
+			if (job_free_ns[j] < job_free_ns[i_job])
+				i_job = j;
+		}
+
+		fprintf(fp, "  %4zu %9.3fs %9.3fs%s %s:%s\n", i_job + 1,
+			job_free_ns[i_job] / 1e9, duration_ns / 1e9,
+			ctest_timings_lookup(timings, testcase, &ignored) ? " " : "~",
+			get_testsuite_name__(ts), ctest_testcase_get_name(testcase));
+
+		job_free_ns[i_job] += duration_ns;
+		if (job_free_ns[i_job] > wall_ns)
+			wall_ns = job_free_ns[i_job];
+	}
+	if (known < testcase_count)
+		fprintf(fp, "(~ no recorded timing; assumed to take the average)\n");
+	fprintf(fp, "Expected wall time: %.3fs\n", wall_ns / 1e9);
+	result = 0;
+
+alloc_failed:
+	(void)free(job_free_ns);
+	(void)free(predicted_ns);
+	(void)free(order);
+	return result;
+}
+
 static void run_usage__(FILE *fp)
 {
 	fprintf(fp,
-		"usage: %1$s run [-n] suite [suite [...]]\n"
+		"usage: %1$s run [-n] [-j jobs | -j auto] [--pressure-target=percent]\n"
+		"           [-t seconds] [--spawn=mode] [--pool]\n"
+		"           [--isolation=level] [--spawn-stats] [--timings=file | --no-timings]\n"
+		"           [--plan] [--shard=index/count [--shard-timings=file]]\n"
+		"           [--fail-fast[=count]]\n"
+		"           [--retries=count] [--limit-memory=size] [--limit-cpu=seconds]\n"
+		"           [--limit-fds=count] [--limit-procs=count] [--cgroup=dir] [--pin]\n"
+		"           [--reserve-cores=count] [--check-state] [--sandbox]\n"
+		"           [--resource=name=count] [--ports=first-last] [--mem-budget=size]\n"
+		"           [--journal=file | --resume=file [--rerun-failed]]\n"
+		"           suite [suite [...]]\n"
 		"       %1$s run -h\n",
 		self__);
 }
@@ -148,25 +521,527 @@ static void run_help__(FILE *fp)
 		"                much faster, but may result in a failed tests impacting other\n"
 		"                tests. This is useful when running the tests in a debugger or\n"
 		"                memory leak detector.\n"
+		"    -j jobs     Run up to <jobs> tests concurrently, each in its own child\n"
+		"                process. Results are reported in the same order regardless of\n"
+		"                the number of jobs. With -n, the tests are run on <jobs>\n"
+		"                threads within ctester instead; only tests that don't share\n"
+		"                state can be run this way, and tests tagged unsafe are run\n"
+		"                with no other test in flight. (default: 1)\n"
+		"    -j auto     Decide how many tests to run concurrently as the run goes,\n"
+		"                from the pressure on the system (/proc/pressure and\n"
+		"                /proc/loadavg): starting at one per CPU, up to four per\n"
+		"                CPU, one more is let run while tasks are rarely stalled on\n"
+		"                the CPU, memory or I/O and no task waits for a CPU, and a\n"
+		"                quarter fewer once they are stalled more than twice as\n"
+		"                often as the target. How many ran over time is printed\n"
+		"                after the results.\n"
+		"    --pressure-target=percent\n"
+		"                How much of the time tasks may be stalled for -j auto to\n"
+		"                let more tests run at once. (default: 10)\n"
+		"    -t seconds  Limit how long each test may take, unless the test sets its\n"
+		"                own limit (with CT_TEST_TIMEOUT). A test that runs out of\n"
+		"                time is terminated (then killed), along with any process it\n"
+		"                started, and reported as timed out. Not supported with -n.\n"
+		"    --spawn=mode\n"
+		"                How to create the child process for each test. Where <mode>\n"
+		"                is one of:\n"
+		"                    fork    Fork each child from ctester itself. (default)\n"
+		"                    zygote  Fork each child from a small template process,\n"
+		"                            started once the suites are loaded. The cost of\n"
+		"                            each fork stays flat as the run progresses.\n"
+		"                    worker  Spawn the ctest-worker helper (set CTEST_WORKER to\n"
+		"                            override its location), which loads only the\n"
+		"                            suite it needs to run a single test.\n"
+		"    --pool      Keep a pool of child processes (one per job) for the whole\n"
+		"                run, each running tests back to back; a child that crashes is\n"
+		"                replaced. Faster, but a test may observe state left behind\n"
+		"                by the tests run before it. Not supported with worker.\n"
+		"    --isolation=level\n"
+		"                Which tests share a child process, run back to back. Where\n"
+		"                <level> is one of:\n"
+		"                    testcase  Each test runs in a child of its own.\n"
+		"                              (default)\n"
+		"                    test      The cases of each test (e.g., of a data-driven\n"
+		"                              test) share a child.\n"
+		"                    suite     The tests of each suite share a child.\n"
+		"                    none      Same as -n.\n"
+		"                    auto      Like none, except for the tests that need a\n"
+		"                              child of their own: those tagged unsafe,\n"
+		"                              with a time limit of their own, that crashed\n"
+		"                              in an earlier run (per --timings), that are\n"
+		"                              retried, or in a suite in which a test has\n"
+		"                              crashed. -t and the limits apply to those\n"
+		"                              only.\n"
+		"                The tests of a group run on the same job, in order, and\n"
+		"                each is still reported on its own. If a child crashes, the\n"
+		"                rest of its group runs in a new one. With test or suite,\n"
+		"                tests are never started longest first. Test and suite are\n"
+		"                not supported with --pool or worker, auto with --pool.\n"
+		"    --spawn-stats\n"
+		"                Once all tests have run, print the mean and maximum time taken\n"
+		"                to create each child process and, with auto, how many tests\n"
+		"                were run in one.\n"
+		"    --timings=file\n"
+		"                Where the duration (and peak memory use, when run in a child\n"
+		"                of its own) of each test is recorded after every run. With\n"
+		"                -j, tests are started longest first, according to the\n"
+		"                recorded durations. (default: none)\n"
+		"    --no-timings\n"
+		"                Neither use nor record the duration of tests. (default)\n"
+		"    --plan      Print the order in which tests would be started on each job,\n"
+		"                with their recorded durations and the expected wall time,\n"
+		"                without running any of them.\n"
+		"    --shard=index/count\n"
+		"                Run only the tests of one of <count> shards (counting from\n"
+		"                one), for splitting a run across machines. Each test goes to\n"
+		"                the same shard on every machine: by a hash of its name or,\n"
+		"                with --shard-timings, balanced by its expected duration.\n"
+		"                See also ls --shard.\n"
+		"    --shard-timings=file\n"
+		"                The recorded durations with which to balance the shards. The\n"
+		"                file is only read (so it can't be the --timings file), and\n"
+		"                every shard must be given the same suites and the same file\n"
+		"                (e.g., merged from the --timings files of an earlier run).\n"
+		"    --fail-fast[=count]\n"
+		"                Stop the run once <count> tests have failed (default: 1);\n"
+		"                tests in flight are terminated (then killed), and every test\n"
+		"                that didn't get to finish is reported as cancelled. The run\n"
+		"                is stopped the same way on SIGINT (e.g., Ctrl-C) or SIGTERM;\n"
+		"                a second one stops ctester right away.\n"
+		"    --retries=count\n"
+		"                Retry a test that fails (or times out) up to <count> times,\n"
+		"                in a fresh child process, once every test has been started.\n"
+		"                A test that passes when retried is reported as flaky, along\n"
+		"                with the failures of its earlier attempts, and doesn't fail\n"
+		"                the run. (default: 0)\n"
+		"    --limit-memory=size\n"
+		"                Limit the memory each test may use, in bytes or with a unit\n"
+		"                of K, M, G, or T (e.g., 512M): the size of its address space\n"
+		"                or, with --cgroup, the memory charged to its cgroup.\n"
+		"    --limit-cpu=seconds\n"
+		"                Limit the CPU time each test may use, rounded up to whole\n"
+		"                seconds.\n"
+		"    --limit-fds=count\n"
+		"                Limit the number of files each test may have open.\n"
+		"    --limit-procs=count\n"
+		"                Limit the number of processes (and threads): of the user\n"
+		"                running ctester, or, with --cgroup, in the test's cgroup.\n"
+		"    --cgroup=dir\n"
+		"                Run each child process in a cgroup of its own, created in\n"
+		"                the delegated cgroup v2 directory <dir>, which enforces the\n"
+		"                memory and process limits and measures peak memory use (set\n"
+		"                CTEST_CGROUP to use one by default). A test stopped for going\n"
+		"                over its memory or CPU limit, or failing at its process\n"
+		"                limit in a cgroup, is reported as over its limit, with what\n"
+		"                it used. The limits are not supported with -n.\n"
+		"    --pin       Run each job's tests on a CPU of its own, among those ctester\n"
+		"                may run on: on separate physical cores first (alternating\n"
+		"                between sockets), then on their SMT siblings; jobs share\n"
+		"                CPUs only once every CPU has one. The CPU of every job is\n"
+		"                printed before the run, and that of every test with its\n"
+		"                result. Not supported with -n.\n"
+		"    --reserve-cores=count\n"
+		"                Keep <count> physical cores (the lowest numbered) for ctester\n"
+		"                itself, away from the jobs. Implies --pin.\n"
+		"    --check-state\n"
+		"                Check that each test run within ctester itself (with -n or\n"
+		"                --isolation=auto) leaves it as it found it: the static data\n"
+		"                of the suites, the open files, the working directory, the\n"
+		"                environment and the threads. A test that passes but changes\n"
+		"                any of them is reported as an isolation violation, with what\n"
+		"                it changed; with auto, the rest of its suite then runs in\n"
+		"                children, as does the test in later runs. Not supported\n"
+		"                with -n -j.\n"
+		"    --sandbox   Run each child process in unprivileged user, network and\n"
+		"                mount namespaces of its own, with a private loopback\n"
+		"                interface and a private /tmp, so tests that bind fixed ports\n"
+		"                or write fixed paths under /tmp can run concurrently. Tests\n"
+		"                sharing a child (or a shared fixture) share its sandbox.\n"
+		"                Without unprivileged namespaces, a warning is printed and\n"
+		"                children run as usual. Not supported with -n.\n"
+		"    --resource=name=count\n"
+		"                How much there is of a resource that tests use (with\n"
+		"                CT_TEST_RESOURCES), e.g., --resource=bigmem=32. With -j,\n"
+		"                a test is never started while, together with the tests\n"
+		"                running, it would need more of a resource than there is;\n"
+		"                other tests are started ahead of it. May be repeated, once\n"
+		"                for each resource. (default: 1)\n"
+		"    --ports=first-last\n"
+		"                The loopback ports tests lease (with CT_LEASE_PORT), in\n"
+		"                turn: a port is only leased again once every other port of\n"
+		"                the range has been. Ports in use are skipped.\n"
+		"                (default: 20000-29999)\n"
+		"    --mem-budget=size\n"
+		"                How much memory the tests running at once may use together,\n"
+		"                in bytes or with a unit of K, M, G, or T (e.g., 48G). Each\n"
+		"                test is expected to use as much as it did when last run\n"
+		"                (its peak, recorded with --timings), and is only started\n"
+		"                once that fits; a test never measured is expected to use as\n"
+		"                much as the biggest one, and at least the budget divided by\n"
+		"                the number of jobs. Not supported with -n.\n"
+		"    --journal=file\n"
+		"                Append the result of each test to <file> as soon as it\n"
+		"                completes (synced to disk in batches), so the run can be\n"
+		"                resumed with --resume if it is cut short.\n"
+		"    --resume=file\n"
+		"                Resume the run journaled to <file>: the tests that already\n"
+		"                have a result there are reported with it rather than run,\n"
+		"                and the results of the others are added to it.\n"
+		"    --rerun-failed\n"
+		"                With --resume, run the tests whose recorded result isn't a\n"
+		"                pass (i.e., that failed, timed out, were skipped, ...)\n"
+		"                again, rather than report that result; tests that passed\n"
+		"                are still not run.\n"
 		"    -h          Print this help message.\n"
 		"\n");
 }
 
+/*
+ * The run in progress, cancelled on SIGINT or SIGTERM. Handlers are reset once
+ * one is caught, so a second signal stops ctester outright (taking any child
+ * processes with it).
+ */
+static ctest_cancel_t *run_cancel__ = NULL;
+static volatile sig_atomic_t run_cancel_signum__ = 0;
+
+static void run_on_cancel_signal__(int signum)
+{
+	run_cancel_signum__ = signum;
+	ctest_cancel_request(run_cancel__);
+}
+
+static const int run_cancel_signals__[] = { SIGINT, SIGTERM };
+#define RUN_CANCEL_SIGNAL_COUNT__ (sizeof(run_cancel_signals__) / sizeof(run_cancel_signals__[0]))
+
+static int run_catch_cancel_signals__(struct sigaction *old_actions)
+{
+	struct sigaction action;
+	size_t i;
+
+	memset(&action, 0, sizeof(action));
+	action.sa_handler = &run_on_cancel_signal__;
+	action.sa_flags = SA_RESETHAND | SA_RESTART;
+	sigemptyset(&action.sa_mask);
+	for (i = 0; i < RUN_CANCEL_SIGNAL_COUNT__; ++i) {
+		if (sigaction(run_cancel_signals__[i], &action, old_actions + i) != 0)
+			goto sigaction_failed;
+	}
+	return 0;
+
+sigaction_failed:
+	while (i-- > 0)
+		(void)sigaction(run_cancel_signals__[i], old_actions + i, NULL);
+	return -1;
+}
+
+static void run_restore_cancel_signals__(const struct sigaction *old_actions)
+{
+	size_t i;
+
+	for (i = 0; i < RUN_CANCEL_SIGNAL_COUNT__; ++i)
+		(void)sigaction(run_cancel_signals__[i], old_actions + i, NULL);
+}
+
+static int parse_spawn_mode__(ctest_spawn_mode_t *p_mode, const char *str)
+{
+	if (strcmp(str, "fork") == 0) {
+		*p_mode = CTEST_SPAWN_FORK;
+	} else if (strcmp(str, "zygote") == 0) {
+		*p_mode = CTEST_SPAWN_ZYGOTE;
+	} else if (strcmp(str, "worker") == 0) {
+		*p_mode = CTEST_SPAWN_WORKER;
+	} else {
+		return 1;
+	}
+	return 0;
+}
+
+static int parse_isolation__(ctest_isolation_t *p_isolation, bool *p_run_isolated, const char *str)
+{
+	if (strcmp(str, "testcase") == 0) {
+		*p_isolation = CTEST_ISOLATION_TESTCASE;
+	} else if (strcmp(str, "test") == 0) {
+		*p_isolation = CTEST_ISOLATION_TEST;
+	} else if (strcmp(str, "suite") == 0) {
+		*p_isolation = CTEST_ISOLATION_SUITE;
+	} else if (strcmp(str, "auto") == 0) {
+		*p_isolation = CTEST_ISOLATION_AUTO;
+	} else if (strcmp(str, "none") == 0) {
+		*p_isolation = CTEST_ISOLATION_TESTCASE;
+		*p_run_isolated = false;
+		return 0;
+	} else {
+		return 1;
+	}
+	*p_run_isolated = true;
+	return 0;
+}
+
 static int run__(command_options_t *unused(options), int argc, char *argv[])
 {
+	enum {
+		OPT_SPAWN = 0x100,
+		OPT_SPAWN_STATS,
+		OPT_POOL,
+		OPT_ISOLATION,
+		OPT_TIMINGS,
+		OPT_NO_TIMINGS,
+		OPT_PLAN,
+		OPT_SHARD,
+		OPT_SHARD_TIMINGS,
+		OPT_FAIL_FAST,
+		OPT_RETRIES,
+		OPT_LIMIT_MEMORY,
+		OPT_LIMIT_CPU,
+		OPT_LIMIT_FDS,
+		OPT_LIMIT_PROCS,
+		OPT_CGROUP,
+		OPT_PIN,
+		OPT_RESERVE_CORES,
+		OPT_CHECK_STATE,
+		OPT_SANDBOX,
+		OPT_RESOURCE,
+		OPT_PORTS,
+		OPT_MEM_BUDGET,
+		OPT_PRESSURE_TARGET,
+		OPT_JOURNAL,
+		OPT_RESUME,
+		OPT_RERUN_FAILED,
+	};
+	static const struct option long_options[] = {
+		{ "jobs",               required_argument,      NULL,   'j' },
+		{ "timeout",            required_argument,      NULL,   't' },
+		{ "spawn",              required_argument,      NULL,   OPT_SPAWN },
+		{ "spawn-stats",        no_argument,            NULL,   OPT_SPAWN_STATS },
+		{ "pool",               no_argument,            NULL,   OPT_POOL },
+		{ "isolation",          required_argument,      NULL,   OPT_ISOLATION },
+		{ "timings",            required_argument,      NULL,   OPT_TIMINGS },
+		{ "no-timings",         no_argument,            NULL,   OPT_NO_TIMINGS },
+		{ "plan",               no_argument,            NULL,   OPT_PLAN },
+		{ "shard",              required_argument,      NULL,   OPT_SHARD },
+		{ "shard-timings",      required_argument,      NULL,   OPT_SHARD_TIMINGS },
+		{ "fail-fast",          optional_argument,      NULL,   OPT_FAIL_FAST },
+		{ "retries",            required_argument,      NULL,   OPT_RETRIES },
+		{ "limit-memory",       required_argument,      NULL,   OPT_LIMIT_MEMORY },
+		{ "limit-cpu",          required_argument,      NULL,   OPT_LIMIT_CPU },
+		{ "limit-fds",          required_argument,      NULL,   OPT_LIMIT_FDS },
+		{ "limit-procs",        required_argument,      NULL,   OPT_LIMIT_PROCS },
+		{ "cgroup",             required_argument,      NULL,   OPT_CGROUP },
+		{ "pin",                no_argument,            NULL,   OPT_PIN },
+		{ "reserve-cores",      required_argument,      NULL,   OPT_RESERVE_CORES },
+		{ "check-state",        no_argument,            NULL,   OPT_CHECK_STATE },
+		{ "sandbox",            no_argument,            NULL,   OPT_SANDBOX },
+		{ "resource",           required_argument,      NULL,   OPT_RESOURCE },
+		{ "ports",              required_argument,      NULL,   OPT_PORTS },
+		{ "mem-budget",         required_argument,      NULL,   OPT_MEM_BUDGET },
+		{ "pressure-target",    required_argument,      NULL,   OPT_PRESSURE_TARGET },
+		{ "journal",            required_argument,      NULL,   OPT_JOURNAL },
+		{ "resume",             required_argument,      NULL,   OPT_RESUME },
+		{ "rerun-failed",       no_argument,            NULL,   OPT_RERUN_FAILED },
+		{ "help",               no_argument,            NULL,   'h' },
+		{ NULL,                 0,                      NULL,   0 },
+	};
 	int opt;
+	unsigned int reporter_flags = 0;
 	int result = EX_UNAVAILABLE;
 	int failure_count;
 	bool run_isolated = true;
+	bool plan_only = false;
+	bool pin = false;
+	unsigned int reserved_cores = 0;
+	ctest_placement_t *placement = NULL;
+	bool jobs_auto = false;
+	unsigned int pressure_target = 10;
+	ctest_concurrency_t *concurrency = NULL;
+	unsigned int shard_index = 0, shard_count = 0;
+	const char *shard_timings_file = NULL;
+	ctest_timings_t *shard_timings = NULL;
+	const char *timings_file = NULL;
+	ctest_timings_t *timings = NULL;
+	const char *journal_file = NULL, *resume_file = NULL;
+	bool rerun_failed = false;
+	ctest_journal_t *journal = NULL;
+	const char **resources = NULL;
+	size_t resource_count = 0;
+	ctest_testcase_t **testcases;
+	size_t testcase_count;
+	ctest_runner_config_t config;
 	ctest_runner_t *runner;
 	ctest_reporter_t *reporter;
 	testsuite_collection_t *testsuite_collection;
+	struct sigaction old_actions[RUN_CANCEL_SIGNAL_COUNT__];
 
-	while ((opt = getopt(argc, argv, "+nh")) != -1) {
+	ctest_runner_config_init(&config);
+	config.cgroup_path = getenv("CTEST_CGROUP");
+	while ((opt = getopt_long(argc, argv, "+nj:t:h", long_options, NULL)) != -1) {
 		switch (opt) {
 		case 'n':
 			run_isolated = false;
 			break;
+		case 'j':
+			if (strcmp(optarg, "auto") == 0) {
+				jobs_auto = true;
+				break;
+			}
+			jobs_auto = false;
+			if (parse_uint__(&config.jobs, optarg) != 0 || config.jobs == 0) {
+				fprintf(stderr, "%s: invalid number of jobs: %s\n", self__, optarg);
+				run_usage__(stderr);
+				return EX_USAGE;
+			}
+			break;
+		case 't':
+			if (parse_seconds__(&config.timeout_ns, optarg) != 0) {
+				fprintf(stderr, "%s: invalid timeout: %s\n", self__, optarg);
+				run_usage__(stderr);
+				return EX_USAGE;
+			}
+			break;
+		case OPT_SPAWN:
+			if (parse_spawn_mode__(&config.spawn, optarg) != 0) {
+				fprintf(stderr, "%s: invalid spawn mode: %s\n", self__, optarg);
+				run_usage__(stderr);
+				return EX_USAGE;
+			}
+			break;
+		case OPT_SPAWN_STATS:
+			reporter_flags |= CTEST_CONSOLE_SPAWN_STATS;
+			break;
+		case OPT_POOL:
+			config.pool = true;
+			break;
+		case OPT_ISOLATION:
+			if (parse_isolation__(&config.isolation, &run_isolated, optarg) != 0) {
+				fprintf(stderr, "%s: invalid isolation level: %s\n", self__, optarg);
+				run_usage__(stderr);
+				return EX_USAGE;
+			}
+			break;
+		case OPT_TIMINGS:
+			timings_file = optarg;
+			break;
+		case OPT_NO_TIMINGS:
+			timings_file = NULL;
+			break;
+		case OPT_PLAN:
+			plan_only = true;
+			break;
+		case OPT_SHARD:
+			if (parse_shard__(&shard_index, &shard_count, optarg) != 0) {
+				fprintf(stderr, "%s: invalid shard: %s\n", self__, optarg);
+				run_usage__(stderr);
+				return EX_USAGE;
+			}
+			break;
+		case OPT_SHARD_TIMINGS:
+			shard_timings_file = optarg;
+			break;
+		case OPT_FAIL_FAST:
+			if (optarg == NULL) {
+				config.fail_fast = 1;
+			} else if (parse_uint__(&config.fail_fast, optarg) != 0 || config.fail_fast == 0) {
+				fprintf(stderr, "%s: invalid number of failures: %s\n", self__, optarg);
+				run_usage__(stderr);
+				return EX_USAGE;
+			}
+			break;
+		case OPT_RETRIES:
+			if (parse_uint__(&config.retries, optarg) != 0) {
+				fprintf(stderr, "%s: invalid number of retries: %s\n", self__, optarg);
+				run_usage__(stderr);
+				return EX_USAGE;
+			}
+			break;
+		case OPT_LIMIT_MEMORY:
+			if (parse_size__(&config.limits.memory_bytes, optarg) != 0) {
+				fprintf(stderr, "%s: invalid memory limit: %s\n", self__, optarg);
+				run_usage__(stderr);
+				return EX_USAGE;
+			}
+			break;
+		case OPT_LIMIT_CPU:
+			if (parse_seconds__(&config.limits.cpu_ns, optarg) != 0) {
+				fprintf(stderr, "%s: invalid CPU time limit: %s\n", self__, optarg);
+				run_usage__(stderr);
+				return EX_USAGE;
+			}
+			break;
+		case OPT_LIMIT_FDS:
+			if (parse_uint__(&config.limits.fd_count, optarg) != 0 || config.limits.fd_count == 0) {
+				fprintf(stderr, "%s: invalid file limit: %s\n", self__, optarg);
+				run_usage__(stderr);
+				return EX_USAGE;
+			}
+			break;
+		case OPT_LIMIT_PROCS:
+			if (parse_uint__(&config.limits.process_count, optarg) != 0 || config.limits.process_count == 0) {
+				fprintf(stderr, "%s: invalid process limit: %s\n", self__, optarg);
+				run_usage__(stderr);
+				return EX_USAGE;
+			}
+			break;
+		case OPT_CGROUP:
+			config.cgroup_path = optarg;
+			break;
+		case OPT_PIN:
+			pin = true;
+			break;
+		case OPT_RESERVE_CORES:
+			if (parse_uint__(&reserved_cores, optarg) != 0) {
+				fprintf(stderr, "%s: invalid number of cores: %s\n", self__, optarg);
+				run_usage__(stderr);
+				return EX_USAGE;
+			}
+			pin = true;
+			break;
+		case OPT_CHECK_STATE:
+			config.check_state = true;
+			break;
+		case OPT_SANDBOX:
+			config.sandbox = true;
+			break;
+		case OPT_RESOURCE:
+			if (parse_resource__(optarg) != 0) {
+				fprintf(stderr, "%s: invalid resource: %s\n", self__, optarg);
+				run_usage__(stderr);
+				return EX_USAGE;
+			}
+			if (add_resource__(&resources, &resource_count, optarg) != 0) {
+				fprintf(stderr, "Error adding resource: %s\n", strerror(errno));
+				return EX_UNAVAILABLE;
+			}
+			config.resources = resources;
+			break;
+		case OPT_PORTS:
+			if (parse_ports__(&config.first_port, &config.last_port, optarg) != 0) {
+				fprintf(stderr, "%s: invalid range of ports: %s\n", self__, optarg);
+				run_usage__(stderr);
+				return EX_USAGE;
+			}
+			break;
+		case OPT_MEM_BUDGET:
+			if (parse_size__(&config.memory_budget_bytes, optarg) != 0) {
+				fprintf(stderr, "%s: invalid memory budget: %s\n", self__, optarg);
+				run_usage__(stderr);
+				return EX_USAGE;
+			}
+			break;
+		case OPT_PRESSURE_TARGET:
+			if (parse_uint__(&pressure_target, optarg) != 0 || pressure_target == 0 || pressure_target > 100) {
+				fprintf(stderr, "%s: invalid pressure target: %s\n", self__, optarg);
+				run_usage__(stderr);
+				return EX_USAGE;
+			}
+			break;
+		case OPT_JOURNAL:
+			journal_file = optarg;
+			break;
+		case OPT_RESUME:
+			resume_file = optarg;
+			break;
+		case OPT_RERUN_FAILED:
+			rerun_failed = true;
+			break;
 		case 'h':
 			run_help__(stdout);
 			return EX_OK;
@@ -179,40 +1054,222 @@ static int run__(command_options_t *unused(options), int argc, char *argv[])
 	argc -= optind;
 	argv += optind;
 
+	if (config.pool && config.spawn == CTEST_SPAWN_WORKER) {
+		fprintf(stderr, "%s: --pool is not supported with --spawn=worker\n", self__);
+		run_usage__(stderr);
+		return EX_USAGE;
+	}
+	if (run_isolated && (config.isolation == CTEST_ISOLATION_TEST || config.isolation == CTEST_ISOLATION_SUITE) && (config.pool || config.spawn == CTEST_SPAWN_WORKER)) {
+		fprintf(stderr, "%s: --isolation=%s is not supported with %s\n", self__,
+		        config.isolation == CTEST_ISOLATION_TEST ? "test" : "suite", config.pool ? "--pool" : "--spawn=worker");
+		run_usage__(stderr);
+		return EX_USAGE;
+	}
+	if (run_isolated && config.isolation == CTEST_ISOLATION_AUTO && config.pool) {
+		fprintf(stderr, "%s: --isolation=auto is not supported with --pool\n", self__);
+		run_usage__(stderr);
+		return EX_USAGE;
+	}
+	if (!run_isolated)
+		config.isolation = CTEST_ISOLATION_TESTCASE;
+	if (config.timeout_ns > 0 && !run_isolated) {
+		fprintf(stderr, "%s: -t is not supported with -n\n", self__);
+		run_usage__(stderr);
+		return EX_USAGE;
+	}
+	if ((config.limits.memory_bytes > 0 || config.limits.cpu_ns > 0 || config.limits.fd_count > 0 || config.limits.process_count > 0) && !run_isolated) {
+		fprintf(stderr, "%s: resource limits are not supported with -n\n", self__);
+		run_usage__(stderr);
+		return EX_USAGE;
+	}
+	if (pin && !run_isolated) {
+		fprintf(stderr, "%s: --pin is not supported with -n\n", self__);
+		run_usage__(stderr);
+		return EX_USAGE;
+	}
+	if (config.sandbox && !run_isolated) {
+		fprintf(stderr, "%s: --sandbox is not supported with -n\n", self__);
+		run_usage__(stderr);
+		return EX_USAGE;
+	}
+	if (config.memory_budget_bytes > 0 && !run_isolated) {
+		fprintf(stderr, "%s: --mem-budget is not supported with -n\n", self__);
+		run_usage__(stderr);
+		return EX_USAGE;
+	}
+	if (config.check_state && run_isolated && config.isolation != CTEST_ISOLATION_AUTO) {
+		fprintf(stderr, "%s: --check-state is only supported with -n or --isolation=auto\n", self__);
+		run_usage__(stderr);
+		return EX_USAGE;
+	}
+	if (config.check_state && !run_isolated && (config.jobs > 1 || jobs_auto)) {
+		fprintf(stderr, "%s: --check-state is not supported with -n -j\n", self__);
+		run_usage__(stderr);
+		return EX_USAGE;
+	}
+	if (shard_timings_file != NULL && shard_count == 0) {
+		fprintf(stderr, "%s: --shard-timings requires --shard\n", self__);
+		run_usage__(stderr);
+		return EX_USAGE;
+	}
+	if (shard_timings_file != NULL && timings_file != NULL && same_file__(shard_timings_file, timings_file)) {
+		fprintf(stderr, "%s: --shard-timings can't be the file recorded with --timings\n", self__);
+		run_usage__(stderr);
+		return EX_USAGE;
+	}
+	if (journal_file != NULL && resume_file != NULL) {
+		fprintf(stderr, "%s: --journal and --resume are mutually exclusive\n", self__);
+		run_usage__(stderr);
+		return EX_USAGE;
+	}
+	if (rerun_failed && resume_file == NULL) {
+		fprintf(stderr, "%s: --rerun-failed requires --resume\n", self__);
+		run_usage__(stderr);
+		return EX_USAGE;
+	}
+	if (config.cgroup_path != NULL && *config.cgroup_path == '\0')
+		config.cgroup_path = NULL;
+
 	if ((testsuite_collection = load_testsuites__(argc, argv)) == NULL) {
 		fprintf(stderr, "Error loading test suites: %s\n", strerror(errno));
 		goto testsuite_load_failed;
 	}
 
-	if ((reporter = ctest_create_console_reporter()) == NULL) {
+	if ((timings = ctest_timings_create()) == NULL) {
+		fprintf(stderr, "Error creating timing database: %s\n", strerror(errno));
+		goto timings_creation_failed;
+	}
+	if (timings_file != NULL && ctest_timings_load(timings, timings_file) != 0)
+		fprintf(stderr, "%s: warning: unable to load timings from %s: %s\n", self__, timings_file, strerror(errno));
+	if (shard_timings_file != NULL && (shard_timings = load_shard_timings__(shard_timings_file)) == NULL)
+		goto shard_timings_load_failed;
+
+	if (jobs_auto) {
+		if ((concurrency = ctest_concurrency_create(0, pressure_target)) == NULL) {
+			fprintf(stderr, "Error creating concurrency controller: %s\n", strerror(errno));
+			goto concurrency_creation_failed;
+		}
+		config.jobs = ctest_concurrency_get_max_jobs(concurrency);
+		config.concurrency = concurrency;
+	}
+
+	if ((testcases = collect_testcases__(testsuite_collection, shard_timings, shard_timings_file, shard_index, shard_count, &testcase_count)) == NULL)
+		goto testcase_collection_failed;
+
+	if (plan_only) {
+		if (print_plan__(stdout, testcases, testcase_count, timings, run_isolated || config.jobs > 1 ? config.jobs : 1,
+		                 run_isolated && (config.isolation == CTEST_ISOLATION_TEST || config.isolation == CTEST_ISOLATION_SUITE)) == 0)
+			result = EX_OK;
+		goto plan_printed;
+	}
+	if (timings_file != NULL)
+		config.timings = timings;
+
+	if (journal_file != NULL || resume_file != NULL) {
+		if ((journal = ctest_journal_create()) == NULL) {
+			fprintf(stderr, "Error creating journal: %s\n", strerror(errno));
+			goto journal_creation_failed;
+		}
+		if (resume_file != NULL) {
+			if (ctest_journal_load(journal, resume_file, !rerun_failed) != 0) {
+				fprintf(stderr, "Error loading journal from %s: %s\n", resume_file, strerror(errno));
+				goto journal_open_failed;
+			}
+			printf("Resuming: %zu test cases have a result in %s\n", ctest_journal_get_loaded_count(journal), resume_file);
+			journal_file = resume_file;
+		}
+		if (ctest_journal_open(journal, journal_file) != 0) {
+			fprintf(stderr, "Error opening journal %s: %s\n", journal_file, strerror(errno));
+			goto journal_open_failed;
+		}
+		config.journal = journal;
+	}
+
+	if ((run_cancel__ = ctest_cancel_create()) == NULL) {
+		fprintf(stderr, "Error creating cancellation token: %s\n", strerror(errno));
+		goto cancel_creation_failed;
+	}
+	config.cancel = run_cancel__;
+
+	if (pin) {
+		if ((placement = ctest_placement_create(reserved_cores)) == NULL) {
+			fprintf(stderr, "Error placing jobs on CPUs: %s\n", strerror(errno));
+			goto placement_creation_failed;
+		}
+		if (ctest_placement_reserve(placement) != 0)
+			fprintf(stderr, "%s: warning: unable to reserve CPUs for ctester: %s\n", self__, strerror(errno));
+		print_placement__(stdout, placement, config.jobs);
+		config.placement = placement;
+	}
+
+	if ((reporter = ctest_create_console_reporter_with_flags(reporter_flags)) == NULL) {
 		fprintf(stderr, "Error creating reporter: %s\n", strerror(errno));
 		goto reporter_creation_failed;
 	}
 	if (run_isolated) {
-		runner = ctest_create_forking_runner();
+		runner = ctest_create_forking_runner_with_config(&config);
+	} else if (config.jobs > 1) {
+		runner = ctest_create_threaded_runner_with_config(&config);
 	} else {
-		runner = ctest_create_direct_runner();
+		runner = ctest_create_direct_runner_with_config(&config);
 	}
 	if (runner == NULL) {
 		fprintf(stderr, "Error creating runner: %s\n", strerror(errno));
 		goto runner_creation_failed;
 	}
 
-	failure_count = ctest_runner_run_testsuites(runner, reporter, testsuite_collection->testsuites, testsuite_collection->count);
+	if (run_catch_cancel_signals__(old_actions) != 0) {
+		fprintf(stderr, "Error installing signal handlers: %s\n", strerror(errno));
+		goto catch_signals_failed;
+	}
+	if (shard_count > 0)
+		failure_count = ctest_runner_run_testcases(runner, reporter, testcases, testcase_count);
+	else
+		failure_count = ctest_runner_run_testsuites(runner, reporter, testsuite_collection->testsuites, testsuite_collection->count);
+	run_restore_cancel_signals__(old_actions);
 	if (failure_count < 0) {
 		fprintf(stderr, "Error running testsuite: %s\n", strerror(errno));
 		goto runner_failure;
 	}
-	if (failure_count == 0)
+	if (run_cancel_signum__ != 0)
+		result = 128 + run_cancel_signum__;
+	else if (failure_count == 0)
 		result = EX_OK;
+	if (config.timings != NULL && ctest_timings_save(timings, timings_file) != 0)
+		fprintf(stderr, "%s: warning: unable to save timings to %s: %s\n", self__, timings_file, strerror(errno));
+	if (concurrency != NULL)
+		print_concurrency__(stdout, concurrency);
 
 runner_failure:
+catch_signals_failed:
 	ctest_runner_destroy(runner);
 runner_creation_failed:
 	ctest_reporter_destroy(reporter);
 reporter_creation_failed:
+	if (placement != NULL)
+		ctest_placement_destroy(placement);
+placement_creation_failed:
+	ctest_cancel_destroy(run_cancel__);
+	run_cancel__ = NULL;
+cancel_creation_failed:
+journal_open_failed:
+	if (journal != NULL)
+		ctest_journal_destroy(journal);
+journal_creation_failed:
+plan_printed:
+	free(testcases);
+testcase_collection_failed:
+	if (concurrency != NULL)
+		ctest_concurrency_destroy(concurrency);
+concurrency_creation_failed:
+	if (shard_timings != NULL)
+		ctest_timings_destroy(shard_timings);
+shard_timings_load_failed:
+	ctest_timings_destroy(timings);
+timings_creation_failed:
 	destroy_testsuite_collection__(testsuite_collection);
 testsuite_load_failed:
+	free(resources);
 	return result;
 }
 
@@ -223,9 +1280,10 @@ testsuite_load_failed:
 static void ls_usage__(FILE *fp)
 {
 	fprintf(fp,
-		"usage: %s ls <suite> [<suite> [...]]\n"
-		"       %s ls -h\n",
-		self__, self__);
+		"usage: %1$s ls [--shard=index/count [--shard-timings=file]]\n"
+		"           <suite> [<suite> [...]]\n"
+		"       %1$s ls -h\n",
+		self__);
 }
 
 static void ls_help__(FILE *fp)
@@ -239,18 +1297,73 @@ static void ls_help__(FILE *fp)
 		"    Where <suite> is the module file containing the suite.\n"
 		"\n"
 		"Options:\n"
+		"    --shard=index/count\n"
+		"                 List the test cases that run --shard would run, one per\n"
+		"                 line, instead of the tests.\n"
+		"    --shard-timings=file\n"
+		"                 The recorded durations with which the shards are balanced,\n"
+		"                 as with run --shard-timings.\n"
 		"    -h           Print this help message.\n"
 		"\n");
 }
 
+/**
+ * List the test cases of a shard, as <code>suite:testcase</code>.
+ */
+static int ls_shard__(testsuite_collection_t *testsuite_collection, const char *timings_file, unsigned int shard_index, unsigned int shard_count)
+{
+	ctest_timings_t *timings = NULL;
+	ctest_testcase_t **testcases;
+	size_t i, testcase_count;
+
+	if (timings_file != NULL && (timings = load_shard_timings__(timings_file)) == NULL)
+		return 1;
+
+	testcases = collect_testcases__(testsuite_collection, timings, timings_file, shard_index, shard_count, &testcase_count);
+	if (timings != NULL)
+		ctest_timings_destroy(timings);
+	if (testcases == NULL)
+		return 1;
+
+	for (i = 0; i < testcase_count; ++i) {
+		ctest_testsuite_t *const ts = ctest_test_get_testsuite(ctest_testcase_get_test(testcases[i]));
+		printf("%s:%s\n", get_testsuite_name__(ts), ctest_testcase_get_name(testcases[i]));
+	}
+
+	free(testcases);
+	return 0;
+}
+
 static int ls__(command_options_t *unused(options), int argc, char *argv[])
 {
+	enum {
+		OPT_SHARD = 0x100,
+		OPT_SHARD_TIMINGS,
+	};
+	static const struct option long_options[] = {
+		{ "shard",              required_argument,      NULL,   OPT_SHARD },
+		{ "shard-timings",      required_argument,      NULL,   OPT_SHARD_TIMINGS },
+		{ "help",               no_argument,            NULL,   'h' },
+		{ NULL,                 0,                      NULL,   0 },
+	};
 	size_t i_ts;
 	int opt;
+	unsigned int shard_index = 0, shard_count = 0;
+	const char *timings_file = NULL;
 	testsuite_collection_t *testsuite_collection;
 
-	while ((opt = getopt(argc, argv, "+h")) != -1) {
+	while ((opt = getopt_long(argc, argv, "+h", long_options, NULL)) != -1) {
 		switch (opt) {
+		case OPT_SHARD:
+			if (parse_shard__(&shard_index, &shard_count, optarg) != 0) {
+				fprintf(stderr, "%s: invalid shard: %s\n", self__, optarg);
+				ls_usage__(stderr);
+				return 1;
+			}
+			break;
+		case OPT_SHARD_TIMINGS:
+			timings_file = optarg;
+			break;
 		case 'h':
 			ls_help__(stdout);
 			return 0;
@@ -264,11 +1377,23 @@ static int ls__(command_options_t *unused(options), int argc, char *argv[])
 	argc -= optind;
 	argv += optind;
 
+	if (timings_file != NULL && shard_count == 0) {
+		fprintf(stderr, "%s: --shard-timings requires --shard\n", self__);
+		ls_usage__(stderr);
+		return 1;
+	}
+
 	if ((testsuite_collection = load_testsuites__(argc, argv)) == NULL) {
 		fprintf(stderr, "Error loading test suites: %s\n", strerror(errno));
 		return 1;
 	}
 
+	if (shard_count > 0) {
+		const int result = ls_shard__(testsuite_collection, timings_file, shard_index, shard_count);
+		destroy_testsuite_collection__(testsuite_collection);
+		return result;
+	}
+
 	for (i_ts = 0; i_ts < testsuite_collection->count; ++i_ts) {
 		ctest_testsuite_t *const ts = testsuite_collection->testsuites[i_ts];
 		const char *const ts_name = get_testsuite_name__(ts);
@@ -0,0 +1,10 @@
+#include <ctest/exec.h>
+
+/*
+ * Helper spawned by the forking runner to run a single test case (see
+ * ctest_worker_main).
+ */
+int main(int argc, char *argv[])
+{
+	return ctest_worker_main(argc, argv);
+}
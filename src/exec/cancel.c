@@ -0,0 +1,79 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <ctest/_annotations.h>
+#include <ctest/exec/cancel.h>
+
+struct ctest_cancel {
+	volatile sig_atomic_t requested;
+
+	/* A byte is written to the pipe when cancellation is requested, and
+	 * never read, so the read end stays readable. */
+	int pipe_fds[2];
+};
+
+ctest_cancel_t *ctest_cancel_create(void)
+{
+	ctest_cancel_t *cancel;
+	size_t i;
+
+	if ((cancel = calloc(1, sizeof(*cancel))) == NULL)
+		goto alloc_cancel_failed;
+	if (pipe(cancel->pipe_fds) != 0)
+		goto pipe_failed;
+	for (i = 0; i < 2; ++i) {
+		if (fcntl(cancel->pipe_fds[i], F_SETFD, FD_CLOEXEC) != 0 ||
+		    fcntl(cancel->pipe_fds[i], F_SETFL, O_NONBLOCK) != 0)
+			goto fcntl_failed;
+	}
+	cancel->requested = 0;
+	return cancel;
+
+fcntl_failed:
+	(void)close(cancel->pipe_fds[0]);
+	(void)close(cancel->pipe_fds[1]);
+pipe_failed:
+	(void)free(cancel);
+alloc_cancel_failed:
+	return NULL;
+}
+
+CTEST_ALL_NONNULL_ARGS__
+void ctest_cancel_destroy(ctest_cancel_t *cancel)
+{
+	(void)close(cancel->pipe_fds[0]);
+	(void)close(cancel->pipe_fds[1]);
+	memset(cancel, 0, sizeof(*cancel));
+	(void)free(cancel);
+}
+
+CTEST_ALL_NONNULL_ARGS__
+void ctest_cancel_request(ctest_cancel_t *cancel)
+{
+	const int saved_errno = errno;
+	const char byte = 0;
+
+	if (cancel->requested)
+		return;
+	cancel->requested = 1;
+	while (write(cancel->pipe_fds[1], &byte, 1) < 0 && errno == EINTR)
+		;
+	errno = saved_errno;
+}
+
+CTEST_ALL_NONNULL_ARGS__
+bool ctest_cancel_is_requested(const ctest_cancel_t *cancel)
+{
+	return cancel->requested != 0;
+}
+
+CTEST_ALL_NONNULL_ARGS__
+int ctest_cancel_get_fd(const ctest_cancel_t *cancel)
+{
+	return cancel->pipe_fds[0];
+}
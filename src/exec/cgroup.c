@@ -0,0 +1,260 @@
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <ctest/_annotations.h>
+
+#include "cgroup.h"
+
+/**
+ * The cgroup, within a delegated directory holding the runner's process, into
+ * which the runner moves itself.
+ */
+#define SUPERVISOR_NAME__ "ctester"
+
+/**
+ * How many times, and how often, removing a cgroup is retried when its root
+ * is closed, while its processes go away.
+ */
+#define REMOVE_ATTEMPTS__       100
+#define REMOVE_INTERVAL_NS__    (10 * 1000000L)
+
+/**
+ * Open a file of a cgroup.
+ *
+ * @param dir_fd The delegated directory.
+ * @param name   The name of the cgroup within the directory, or
+ *               <code>NULL</code> for the directory itself.
+ * @param file   The name of the file.
+ * @param flags  The flags with which to open the file.
+ *
+ * @return The file descriptor, or <code>-1</code> on failure.
+ */
+static int cgroup_open__(int dir_fd, const char *name, const char *file, int flags)
+{
+	char path[sizeof(((cgroup_t *)NULL)->name) + 64];
+
+	if (name == NULL)
+		return openat(dir_fd, file, flags | O_CLOEXEC);
+	snprintf(path, sizeof(path), "%s/%s", name, file);
+	return openat(dir_fd, path, flags | O_CLOEXEC);
+}
+
+CTEST_PRINTF__(4, 5)
+static int cgroup_write__(int dir_fd, const char *name, const char *file, const char *fmt, ...)
+{
+	char buf[64];
+	va_list args;
+	ssize_t rc;
+	int fd, saved_errno;
+
+	va_start(args, fmt);
+	vsnprintf(buf, sizeof(buf), fmt, args);
+	va_end(args);
+
+	if ((fd = cgroup_open__(dir_fd, name, file, O_WRONLY)) < 0)
+		return -1;
+	while ((rc = write(fd, buf, strlen(buf))) < 0 && errno == EINTR)
+		;
+	saved_errno = errno;
+	(void)close(fd);
+	errno = saved_errno;
+	return rc < 0 ? -1 : 0;
+}
+
+/**
+ * Read a (small) file of a cgroup into a string.
+ *
+ * @return Zero on success, non-zero on failure.
+ */
+static int cgroup_read__(int dir_fd, const char *name, const char *file, char *buf, size_t size)
+{
+	ssize_t rc;
+	int fd;
+
+	if ((fd = cgroup_open__(dir_fd, name, file, O_RDONLY)) < 0)
+		return -1;
+	while ((rc = read(fd, buf, size - 1)) < 0 && errno == EINTR)
+		;
+	(void)close(fd);
+	if (rc < 0)
+		return -1;
+	buf[rc] = '\0';
+	return 0;
+}
+
+/**
+ * Find the value of a key in a flat keyed file (e.g.,
+ * <code>memory.events</code>), which has a "key value" pair on each line.
+ *
+ * @return The value, or zero if the key isn't found.
+ */
+static uint64_t find_keyed_value__(const char *buf, const char *key)
+{
+	const size_t key_len = strlen(key);
+	const char *line;
+
+	for (line = buf; *line != '\0'; ) {
+		const char *const end = strchr(line, '\n');
+		if (strncmp(line, key, key_len) == 0 && line[key_len] == ' ')
+			return strtoull(line + key_len + 1, NULL, 10);
+		if (end == NULL)
+			break;
+		line = end + 1;
+	}
+	return 0;
+}
+
+/**
+ * Write the prefix of the names of the cgroups created by this process.
+ */
+static void format_prefix__(char *buf, size_t size)
+{
+	snprintf(buf, size, "ctest-%ld-", (long)getpid());
+}
+
+CTEST_ALL_NONNULL_ARGS__
+int cgroup_root_open(cgroup_root_t *root, const char *path, const ctest_limits_t *limits)
+{
+	const char *const controllers = limits->process_count > 0 ? "+memory +pids" : "+memory";
+	int dir_fd, saved_errno;
+
+	if ((dir_fd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC)) < 0)
+		goto open_failed;
+	if (cgroup_write__(dir_fd, NULL, "cgroup.subtree_control", "%s", controllers) != 0) {
+		/* Controllers can't be handed down from a cgroup with
+		 * processes of its own; if it's the runner's, move out of
+		 * the way and try again. */
+		if (errno != EBUSY)
+			goto enable_failed;
+		if (mkdirat(dir_fd, SUPERVISOR_NAME__, 0755) != 0 && errno != EEXIST)
+			goto enable_failed;
+		if (cgroup_write__(dir_fd, SUPERVISOR_NAME__, "cgroup.procs", "0") != 0 ||
+		    cgroup_write__(dir_fd, NULL, "cgroup.subtree_control", "%s", controllers) != 0)
+			goto enable_failed;
+	}
+
+	root->dir_fd = dir_fd;
+	root->created_count = 0;
+	return 0;
+
+enable_failed:
+	saved_errno = errno;
+	(void)close(dir_fd);
+	errno = saved_errno;
+open_failed:
+	return -1;
+}
+
+CTEST_ALL_NONNULL_ARGS__
+void cgroup_root_close(cgroup_root_t *root)
+{
+	struct timespec interval = { 0, REMOVE_INTERVAL_NS__ };
+	struct dirent *entry;
+	char prefix[32];
+	size_t prefix_len;
+	DIR *dir;
+	int fd;
+
+	format_prefix__(prefix, sizeof(prefix));
+	prefix_len = strlen(prefix);
+	if ((fd = dup(root->dir_fd)) >= 0 && (dir = fdopendir(fd)) != NULL) {
+		while ((entry = readdir(dir)) != NULL) {
+			unsigned int attempt;
+
+			if (strncmp(entry->d_name, prefix, prefix_len) != 0)
+				continue;
+			(void)cgroup_write__(root->dir_fd, entry->d_name, "cgroup.kill", "1");
+			for (attempt = 1; unlinkat(root->dir_fd, entry->d_name, AT_REMOVEDIR) != 0; ++attempt) {
+				if (errno != EBUSY || attempt == REMOVE_ATTEMPTS__)
+					break;
+				(void)nanosleep(&interval, NULL);
+			}
+		}
+		(void)closedir(dir);
+	} else if (fd >= 0) {
+		(void)close(fd);
+	}
+
+	(void)close(root->dir_fd);
+	root->dir_fd = -1;
+}
+
+CTEST_ALL_NONNULL_ARGS__
+int cgroup_create(cgroup_root_t *root, const ctest_limits_t *limits, cgroup_t *cgroup)
+{
+	char prefix[32];
+	int procs_fd, saved_errno;
+
+	format_prefix__(prefix, sizeof(prefix));
+	snprintf(cgroup->name, sizeof(cgroup->name), "%s%lu", prefix, ++root->created_count);
+	if (mkdirat(root->dir_fd, cgroup->name, 0755) != 0)
+		goto mkdir_failed;
+
+	if (limits->memory_bytes > 0) {
+		if (cgroup_write__(root->dir_fd, cgroup->name, "memory.max", "%" PRIu64, limits->memory_bytes) != 0)
+			goto limit_failed;
+		/* Otherwise, going over the limit swaps rather than kills; the
+		 * file only exists if swap is accounted for. */
+		(void)cgroup_write__(root->dir_fd, cgroup->name, "memory.swap.max", "0");
+	}
+	/* Take down every process of the test case together, rather than
+	 * leaving the rest of them to make sense of the one that is gone. */
+	(void)cgroup_write__(root->dir_fd, cgroup->name, "memory.oom.group", "1");
+	if (limits->process_count > 0 &&
+	    cgroup_write__(root->dir_fd, cgroup->name, "pids.max", "%u", limits->process_count) != 0)
+		goto limit_failed;
+
+	if ((procs_fd = cgroup_open__(root->dir_fd, cgroup->name, "cgroup.procs", O_WRONLY)) < 0)
+		goto limit_failed;
+	return procs_fd;
+
+limit_failed:
+	saved_errno = errno;
+	(void)unlinkat(root->dir_fd, cgroup->name, AT_REMOVEDIR);
+	errno = saved_errno;
+mkdir_failed:
+	cgroup->name[0] = '\0';
+	return -1;
+}
+
+int cgroup_enter(int procs_fd)
+{
+	ssize_t rc;
+
+	while ((rc = write(procs_fd, "0", 1)) < 0 && errno == EINTR)
+		;
+	return rc == 1 ? 0 : -1;
+}
+
+CTEST_ALL_NONNULL_ARGS__
+void cgroup_get_stats(const cgroup_root_t *root, const cgroup_t *cgroup, cgroup_stats_t *stats)
+{
+	char buf[512];
+
+	memset(stats, 0, sizeof(*stats));
+	if (cgroup_read__(root->dir_fd, cgroup->name, "memory.peak", buf, sizeof(buf)) == 0)
+		stats->peak_memory_bytes = strtoull(buf, NULL, 10);
+	if (cgroup_read__(root->dir_fd, cgroup->name, "memory.events", buf, sizeof(buf)) == 0)
+		stats->oom_kill_count = find_keyed_value__(buf, "oom_kill");
+	if (cgroup_read__(root->dir_fd, cgroup->name, "pids.events", buf, sizeof(buf)) == 0)
+		stats->process_max_count = find_keyed_value__(buf, "max");
+}
+
+CTEST_ALL_NONNULL_ARGS__
+void cgroup_remove(cgroup_root_t *root, cgroup_t *cgroup)
+{
+	/* Anything that outlived the child (e.g., a process that left its
+	 * group) goes now; cgroup.kill needs Linux 5.14. */
+	(void)cgroup_write__(root->dir_fd, cgroup->name, "cgroup.kill", "1");
+	(void)unlinkat(root->dir_fd, cgroup->name, AT_REMOVEDIR);
+	cgroup->name[0] = '\0';
+}
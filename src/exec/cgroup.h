@@ -0,0 +1,135 @@
+#ifndef PRIVATE__CGROUP_H__INCLUDED__
+#define PRIVATE__CGROUP_H__INCLUDED__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <ctest/_annotations.h>
+#include <ctest/exec/runner_config.h>
+
+/**
+ * A cgroup (v2) directory delegated to the runner, in which a cgroup is
+ * created for each child process.
+ *
+ * Only a cgroup without processes of its own can enable controllers for the
+ * cgroups in it, so if the directory holds the runner's process, the runner is
+ * moved into a <code>ctester</code> cgroup within it first.
+ */
+typedef struct cgroup_root cgroup_root_t;
+struct cgroup_root {
+	/**
+	 * The directory, or <code>-1</code> if not open.
+	 */
+	int dir_fd;
+
+	/**
+	 * The number of cgroups created so far, which numbers the next one.
+	 */
+	unsigned long created_count;
+};
+
+/**
+ * The cgroup of a child process, created in a <code>cgroup_root_t</code>.
+ */
+typedef struct cgroup cgroup_t;
+struct cgroup {
+	/**
+	 * The name of the cgroup within its root, or the empty string if there
+	 * is none.
+	 */
+	char name[64];
+};
+
+/**
+ * What was observed of the processes in a cgroup.
+ */
+typedef struct cgroup_stats cgroup_stats_t;
+struct cgroup_stats {
+	/**
+	 * The most memory, in bytes, charged to the cgroup at any one time,
+	 * or zero if unknown (<code>memory.peak</code> needs Linux 5.19).
+	 */
+	uint64_t peak_memory_bytes;
+
+	/**
+	 * The number of processes killed for going over the memory limit.
+	 */
+	uint64_t oom_kill_count;
+
+	/**
+	 * The number of times creating a process failed for going over the
+	 * process limit.
+	 */
+	uint64_t process_max_count;
+};
+
+/**
+ * Open a delegated cgroup directory, enabling the controllers needed to
+ * enforce the limits.
+ *
+ * @param root   The root to open.
+ * @param path   The path of the cgroup directory.
+ * @param limits The limits to enforce in the cgroups created in the root.
+ *
+ * @return Zero on success, non-zero (with <code>errno</code> set) on failure.
+ */
+CTEST_ALL_NONNULL_ARGS__
+extern int cgroup_root_open(cgroup_root_t *root, const char *path, const ctest_limits_t *limits);
+
+/**
+ * Close a delegated cgroup directory, removing any cgroups created in it that
+ * couldn't be removed earlier (waiting a little for their processes to go
+ * away).
+ *
+ * @param root The root to close.
+ */
+CTEST_ALL_NONNULL_ARGS__
+extern void cgroup_root_close(cgroup_root_t *root);
+
+/**
+ * Create a cgroup for a child process, enforcing the memory and process
+ * limits.
+ *
+ * @param root   The root in which to create the cgroup.
+ * @param limits The limits to enforce.
+ * @param cgroup Populated with the new cgroup.
+ *
+ * @return The (close-on-exec) <code>cgroup.procs</code> file of the cgroup,
+ *         through which the child moves itself into it (see
+ *         <code>cgroup_enter</code>), or <code>-1</code> (with
+ *         <code>errno</code> set) on failure.
+ */
+CTEST_ALL_NONNULL_ARGS__
+extern int cgroup_create(cgroup_root_t *root, const ctest_limits_t *limits, cgroup_t *cgroup);
+
+/**
+ * Move the calling process into a cgroup.
+ *
+ * @param procs_fd The <code>cgroup.procs</code> file of the cgroup.
+ *
+ * @return Zero on success, non-zero (with <code>errno</code> set) on failure.
+ */
+extern int cgroup_enter(int procs_fd);
+
+/**
+ * Read what was observed of the processes in a cgroup.
+ *
+ * @param root   The root of the cgroup.
+ * @param cgroup The cgroup.
+ * @param stats  Populated with the observations; those that can't be read
+ *               are zero.
+ */
+CTEST_ALL_NONNULL_ARGS__
+extern void cgroup_get_stats(const cgroup_root_t *root, const cgroup_t *cgroup, cgroup_stats_t *stats);
+
+/**
+ * Remove a cgroup, killing any process left in it. If the processes don't go
+ * away right away, the cgroup is removed when the root is closed.
+ *
+ * @param root   The root of the cgroup.
+ * @param cgroup The cgroup to remove.
+ */
+CTEST_ALL_NONNULL_ARGS__
+extern void cgroup_remove(cgroup_root_t *root, cgroup_t *cgroup);
+
+#endif /* PRIVATE__CGROUP_H__INCLUDED__ */
@@ -0,0 +1,302 @@
+#define _GNU_SOURCE     /* sched_getaffinity */
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <ctest/_annotations.h>
+#include <ctest/exec/concurrency.h>
+
+/* How often the pressure on the system is sampled. */
+#define SAMPLE_INTERVAL_NS__    500000000u
+
+/**
+ * A reading of the pressure stall information and the load of the system.
+ */
+typedef struct pressure_sample__ pressure_sample_t__;
+struct pressure_sample__ {
+	uint64_t ns;
+
+	/* The total time, in microseconds, some tasks were stalled on each
+	 * resource. */
+	uint64_t cpu_us;
+	uint64_t memory_us;
+	uint64_t io_us;
+
+	unsigned int runnable;
+	unsigned int load;
+};
+
+struct ctest_concurrency {
+	unsigned int cpu_count;
+	unsigned int max_jobs;
+	unsigned int target;    /* In tenths of a percent. */
+	unsigned int limit;
+	bool has_pressure;
+
+	/* The most jobs in flight since the last sample. */
+	size_t busiest;
+
+	pressure_sample_t__ last;
+	uint64_t created_ns;
+
+	ctest_concurrency_change_t *changes;
+	size_t change_count;
+	size_t change_capacity;
+};
+
+static uint64_t now_ns__(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000000000u + now.tv_nsec;
+}
+
+/**
+ * Read the total time some tasks were stalled on a resource from its file in
+ * <code>/proc/pressure</code>.
+ *
+ * @return Zero on success, non-zero if the file can't be read (e.g., the
+ *         kernel has no pressure stall information).
+ */
+static int read_pressure__(const char *resource, uint64_t *p_total_us)
+{
+	char path[64];
+	unsigned long long total;
+	FILE *fp;
+	int result = -1;
+
+	snprintf(path, sizeof(path), "/proc/pressure/%s", resource);
+	if ((fp = fopen(path, "re")) == NULL)
+		return -1;
+	if (fscanf(fp, "some avg10=%*f avg60=%*f avg300=%*f total=%llu", &total) == 1) {
+		*p_total_us = total;
+		result = 0;
+	}
+	(void)fclose(fp);
+	return result;
+}
+
+/**
+ * Read the load average over the last minute and the number of runnable tasks
+ * from <code>/proc/loadavg</code>; both are left at zero if it can't be read.
+ */
+static void read_load__(pressure_sample_t__ *sample)
+{
+	double load;
+	unsigned int runnable;
+	FILE *fp;
+
+	sample->load = 0;
+	sample->runnable = 0;
+	if ((fp = fopen("/proc/loadavg", "re")) == NULL)
+		return;
+	if (fscanf(fp, "%lf %*f %*f %u/", &load, &runnable) == 2) {
+		sample->load = (unsigned int)(load * 100 + 0.5);
+		/* Not counting the reading task itself. */
+		sample->runnable = runnable > 0 ? runnable - 1 : 0;
+	}
+	(void)fclose(fp);
+}
+
+/**
+ * Sample the pressure on the system.
+ *
+ * @return Whether pressure stall information is available.
+ */
+static bool take_sample__(pressure_sample_t__ *sample)
+{
+	sample->ns = now_ns__();
+	read_load__(sample);
+	if (read_pressure__("cpu", &sample->cpu_us) != 0 ||
+	    read_pressure__("memory", &sample->memory_us) != 0 ||
+	    read_pressure__("io", &sample->io_us) != 0) {
+		sample->cpu_us = sample->memory_us = sample->io_us = 0;
+		return false;
+	}
+	return true;
+}
+
+/**
+ * Get the share of an interval, in tenths of a percent, that tasks were
+ * stalled on a resource.
+ */
+static unsigned int stall__(uint64_t before_us, uint64_t after_us, uint64_t interval_ns)
+{
+	const uint64_t interval_us = interval_ns / 1000;
+	uint64_t stall;
+
+	if (after_us <= before_us || interval_us == 0)
+		return 0;
+	stall = (after_us - before_us) * 1000 / interval_us;
+	return stall < 1000 ? (unsigned int)stall : 1000;
+}
+
+static unsigned int count_cpus__(void)
+{
+	cpu_set_t allowed;
+	int count;
+
+	if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0 || (count = CPU_COUNT(&allowed)) < 1)
+		return 1;
+	return (unsigned int)count;
+}
+
+/**
+ * Record the limit of a controller having changed.
+ *
+ * @return Zero on success, non-zero on failure.
+ */
+CTEST_ALL_NONNULL_ARGS__
+static int add_change__(ctest_concurrency_t *concurrency, const ctest_concurrency_change_t *change)
+{
+	if (concurrency->change_count == concurrency->change_capacity) {
+		const size_t capacity = concurrency->change_capacity > 0 ? concurrency->change_capacity * 2 : 16;
+		ctest_concurrency_change_t *changes;
+
+		if ((changes = realloc(concurrency->changes, capacity * sizeof(*changes))) == NULL)
+			return -1;
+		concurrency->changes = changes;
+		concurrency->change_capacity = capacity;
+	}
+	concurrency->changes[concurrency->change_count++] = *change;
+	return 0;
+}
+
+ctest_concurrency_t *ctest_concurrency_create(unsigned int max_jobs, unsigned int target_percent)
+{
+	ctest_concurrency_t *concurrency;
+	ctest_concurrency_change_t initial;
+
+	if ((concurrency = calloc(1, sizeof(*concurrency))) == NULL)
+		goto alloc_failed;
+
+	concurrency->cpu_count = count_cpus__();
+	concurrency->max_jobs = max_jobs > 0 ? max_jobs : 4 * concurrency->cpu_count;
+	concurrency->target = target_percent * 10;
+	concurrency->limit = concurrency->cpu_count < concurrency->max_jobs ? concurrency->cpu_count : concurrency->max_jobs;
+	concurrency->has_pressure = take_sample__(&concurrency->last);
+	concurrency->created_ns = concurrency->last.ns;
+
+	memset(&initial, 0, sizeof(initial));
+	initial.limit = concurrency->limit;
+	initial.runnable = concurrency->last.runnable;
+	initial.load = concurrency->last.load;
+	if (add_change__(concurrency, &initial) != 0)
+		goto add_change_failed;
+
+	return concurrency;
+
+add_change_failed:
+	(void)free(concurrency);
+alloc_failed:
+	return NULL;
+}
+
+CTEST_ALL_NONNULL_ARGS__
+void ctest_concurrency_destroy(ctest_concurrency_t *concurrency)
+{
+	(void)free(concurrency->changes);
+	(void)free(concurrency);
+}
+
+CTEST_ALL_NONNULL_ARGS__
+unsigned int ctest_concurrency_get_max_jobs(const ctest_concurrency_t *concurrency)
+{
+	return concurrency->max_jobs;
+}
+
+CTEST_ALL_NONNULL_ARGS__
+bool ctest_concurrency_has_pressure(const ctest_concurrency_t *concurrency)
+{
+	return concurrency->has_pressure;
+}
+
+CTEST_ALL_NONNULL_ARGS__
+unsigned int ctest_concurrency_update(ctest_concurrency_t *concurrency, size_t in_flight)
+{
+	pressure_sample_t__ sample;
+	ctest_concurrency_change_t change;
+	unsigned int limit = concurrency->limit, stall;
+	size_t busiest;
+
+	if (in_flight > concurrency->busiest)
+		concurrency->busiest = in_flight;
+	if (now_ns__() - concurrency->last.ns < SAMPLE_INTERVAL_NS__)
+		return limit;
+
+	if (!take_sample__(&sample) && concurrency->has_pressure) {
+		/* Pressure stall information went away; leave the limit as
+		 * is rather than mistake the missing totals for no stalls. */
+		concurrency->last = sample;
+		concurrency->has_pressure = false;
+		return limit;
+	}
+
+	memset(&change, 0, sizeof(change));
+	change.elapsed_ns = sample.ns - concurrency->created_ns;
+	change.runnable = sample.runnable;
+	change.load = sample.load;
+	if (concurrency->has_pressure) {
+		change.cpu_stall = stall__(concurrency->last.cpu_us, sample.cpu_us, sample.ns - concurrency->last.ns);
+		change.memory_stall = stall__(concurrency->last.memory_us, sample.memory_us, sample.ns - concurrency->last.ns);
+		change.io_stall = stall__(concurrency->last.io_us, sample.io_us, sample.ns - concurrency->last.ns);
+	} else if (sample.runnable > concurrency->cpu_count) {
+		/* The share of runnable tasks left without a CPU. */
+		change.cpu_stall = (sample.runnable - concurrency->cpu_count) * 1000 / sample.runnable;
+	}
+	concurrency->last = sample;
+	busiest = concurrency->busiest;
+	concurrency->busiest = in_flight;
+
+	stall = change.cpu_stall;
+	if (change.memory_stall > stall)
+		stall = change.memory_stall;
+	if (change.io_stall > stall)
+		stall = change.io_stall;
+
+	/* Additive increase, multiplicative decrease: ramp up slowly while
+	 * there's room to spare, back off quickly once there isn't. Between
+	 * the target and twice the target, the limit holds. */
+	if (stall > 2 * concurrency->target) {
+		const unsigned int cut = limit / 4 > 0 ? limit / 4 : 1;
+		limit = limit > cut ? limit - cut : 1;
+	} else if (stall < concurrency->target && sample.runnable <= concurrency->cpu_count &&
+	           busiest >= limit && limit < concurrency->max_jobs) {
+		limit += 1;
+	}
+
+	if (limit != concurrency->limit) {
+		change.limit = limit;
+		/* Without the record the limit still changes; only the
+		 * report of the run is incomplete. */
+		(void)add_change__(concurrency, &change);
+		concurrency->limit = limit;
+	}
+	return limit;
+}
+
+CTEST_ALL_NONNULL_ARGS__
+const ctest_concurrency_change_t *ctest_concurrency_get_changes(const ctest_concurrency_t *concurrency, size_t *p_change_count)
+{
+	*p_change_count = concurrency->change_count;
+	return concurrency->changes;
+}
+
+CTEST_ALL_NONNULL_ARGS__
+double ctest_concurrency_get_mean_limit(const ctest_concurrency_t *concurrency)
+{
+	const uint64_t elapsed_ns = now_ns__() - concurrency->created_ns;
+	double weighted = 0;
+	size_t i;
+
+	if (elapsed_ns == 0)
+		return concurrency->limit;
+	for (i = 0; i < concurrency->change_count; ++i) {
+		const uint64_t until_ns = i + 1 < concurrency->change_count ? concurrency->changes[i + 1].elapsed_ns : elapsed_ns;
+		weighted += (double)concurrency->changes[i].limit * (double)(until_ns - concurrency->changes[i].elapsed_ns);
+	}
+	return weighted / (double)elapsed_ns;
+}
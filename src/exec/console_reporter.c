@@ -1,6 +1,7 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -72,6 +73,118 @@ probe_failed:
 	return NULL;
 }
 
+/*
+ * Statistics
+ */
+
+/**
+ * Statistics gathered over all test cases reported by a console reporter.
+ */
+typedef struct reporter_stats__ reporter_stats_t__;
+struct reporter_stats__ {
+	size_t passed_count;
+	size_t failed_count;
+	size_t skipped_count;
+	size_t cancelled_count;
+	size_t flaky_count;
+
+	size_t spawn_count;
+	uint64_t spawn_total_ns;
+	uint64_t spawn_max_ns;
+
+	/* Test cases run within the runner's process alongside others run in
+	 * children (e.g., with CTEST_ISOLATION_AUTO). */
+	size_t in_process_count;
+	size_t forked_count;
+};
+
+static void reporter_stats_add__(reporter_stats_t__ *stats, const ctest_result_t *result)
+{
+	switch (result->type) {
+	case CTEST_RESULT_PASS:
+		stats->passed_count += 1;
+		break;
+	case CTEST_RESULT_SKIPPED:
+		stats->skipped_count += 1;
+		break;
+	case CTEST_RESULT_CANCELLED:
+		stats->cancelled_count += 1;
+		break;
+	case CTEST_RESULT_FLAKY:
+		stats->passed_count += 1;
+		stats->flaky_count += 1;
+		break;
+	case CTEST_RESULT_FAIL:
+	case CTEST_RESULT_ERROR:
+	case CTEST_RESULT_TIMEOUT:
+	case CTEST_RESULT_LIMIT_EXCEEDED:
+	case CTEST_RESULT_ISOLATION_VIOLATION:
+		stats->failed_count += 1;
+		break;
+	}
+
+	if (result->forked)
+		stats->forked_count += 1;
+	else if (result->type != CTEST_RESULT_CANCELLED)
+		stats->in_process_count += 1;
+
+	if (result->spawn_ns > 0) {
+		stats->spawn_count += 1;
+		stats->spawn_total_ns += result->spawn_ns;
+		if (result->spawn_ns > stats->spawn_max_ns)
+			stats->spawn_max_ns = result->spawn_ns;
+	}
+}
+
+/**
+ * Summarize a run that was cancelled, as the test cases that didn't run are
+ * otherwise easily lost among those that did.
+ */
+static void reporter_stats_print_cancelled__(FILE *fp, const reporter_stats_t__ *stats)
+{
+	if (stats->cancelled_count == 0)
+		return;
+
+	fprintf(fp, "Run cancelled: %zu passed, %zu failed, %zu skipped, %zu cancelled\n",
+		stats->passed_count,
+		stats->failed_count,
+		stats->skipped_count,
+		stats->cancelled_count);
+}
+
+static void reporter_stats_print_flaky__(FILE *fp, const reporter_stats_t__ *stats)
+{
+	if (stats->flaky_count == 0)
+		return;
+
+	fprintf(fp, "Flaky: %zu test cases passed only when retried\n", stats->flaky_count);
+}
+
+static void reporter_stats_print_spawn__(FILE *fp, const reporter_stats_t__ *stats)
+{
+	if (stats->spawn_count == 0)
+		return;
+
+	fprintf(fp, "Spawned %zu processes: mean %.1fus, max %.1fus\n",
+		stats->spawn_count,
+		(double)stats->spawn_total_ns / stats->spawn_count / 1000.0,
+		(double)stats->spawn_max_ns / 1000.0);
+}
+
+/**
+ * Summarize where test cases were run, when some were run in children and
+ * the rest weren't, to see how many processes that spared.
+ */
+static void reporter_stats_print_isolation__(FILE *fp, const reporter_stats_t__ *stats)
+{
+	if (stats->in_process_count == 0 || stats->forked_count == 0)
+		return;
+
+	fprintf(fp, "Ran %zu test cases in-process and %zu in a child process\n",
+		stats->in_process_count,
+		stats->forked_count);
+}
+
 /*
  * Testcase Reporter
  */
@@ -88,6 +201,7 @@ struct testcase_reporter__ {
 	ctest_testcase_reporter_t base;
 
 	FILE *fp;
+	reporter_stats_t__ *stats;
 	ctest_testcase_t *testcase;
 	testcase_state_t__ state;
 };
@@ -132,6 +246,47 @@ static void testcase_reporter_report_output__(testcase_reporter_t__ *reporter, c
 	}
 }
 
+static const char *describe_result_type__(ctest_result_type_t type)
+{
+	switch (type) {
+	case CTEST_RESULT_PASS:
+		return "OK";
+	case CTEST_RESULT_FAIL:
+		return "FAILED";
+	case CTEST_RESULT_SKIPPED:
+		return "SKIPPED";
+	case CTEST_RESULT_ERROR:
+		return "INTERNAL ERROR";
+	case CTEST_RESULT_TIMEOUT:
+		return "TIMED OUT";
+	case CTEST_RESULT_CANCELLED:
+		return "CANCELLED";
+	case CTEST_RESULT_FLAKY:
+		return "FLAKY";
+	case CTEST_RESULT_LIMIT_EXCEEDED:
+		return "LIMIT EXCEEDED";
+	case CTEST_RESULT_ISOLATION_VIOLATION:
+		return "ISOLATION VIOLATION";
+	}
+	return "UNKNOWN";
+}
+
+/**
+ * Report the failed attempts that preceded the final result of a test case,
+ * oldest first.
+ */
+static void testcase_reporter_report_attempts__(testcase_reporter_t__ *reporter, const ctest_result_t *attempt)
+{
+	if (attempt->previous_attempt != NULL)
+		testcase_reporter_report_attempts__(reporter, attempt->previous_attempt);
+
+	fprintf(reporter->fp, "Attempt %u: %s\n", attempt->attempt, describe_result_type__(attempt->type));
+	if (attempt->failure != NULL)
+		testcase_repoter_report_failure__(reporter, attempt->failure);
+	if (attempt->output != NULL)
+		testcase_reporter_report_output__(reporter, attempt->output);
+}
+
 CTEST_ALL_NONNULL_ARGS__
 static void testcase_reporter_op_start__(ctest_testcase_reporter_t *ctest_reporter)
 {
@@ -157,7 +312,12 @@ static void testcase_reporter_op_complete__(ctest_testcase_reporter_t *ctest_rep
 		return;
 
 	fprintf(reporter->fp, "%s:%s ... ", ctest_testsuite_get_name(testsuite), ctest_testcase_get_name(testcase));
+	/* Placement is only ever asked for, so it's shown whenever known, to
+	 * trace odd timings back to where the test case ran. */
+	if (result->cpu >= 0)
+		fprintf(reporter->fp, "[cpu %d] ", result->cpu);
 	reporter->state = CONSOLE_TESTCASE_COMPLETED;
+	reporter_stats_add__(reporter->stats, result);
 
 	switch(result->type) {
 	case CTEST_RESULT_PASS:
@@ -182,10 +342,42 @@ static void testcase_reporter_op_complete__(ctest_testcase_reporter_t *ctest_rep
 		}
 	case CTEST_RESULT_SKIPPED:
 		fprintf(reporter->fp, "SKIPPED\n");
+		/* Say why (e.g., which prerequisite didn't pass), if known. */
+		if (failure != NULL)
+			testcase_repoter_report_failure__(reporter, failure);
 		goto done;
 	case CTEST_RESULT_ERROR:
 		fprintf(reporter->fp, "INTERNAL ERROR\n");
 		goto fail;
+	case CTEST_RESULT_TIMEOUT:
+		{
+			const ctest_stage_t stage = failure != NULL ? failure->stage : CTEST_STAGE_EXECUTION;
+			switch (stage) {
+			case CTEST_STAGE_SETUP:
+				fprintf(reporter->fp, "SETUP TIMED OUT\n");
+				goto fail;
+			case CTEST_STAGE_EXECUTION:
+				fprintf(reporter->fp, "TIMED OUT\n");
+				goto fail;
+			case CTEST_STAGE_TEARDOWN:
+				fprintf(reporter->fp, "TEARDOWN TIMED OUT\n");
+				goto fail;
+			}
+			fprintf(reporter->fp, "TIMED OUT (unknown stage %d)\n", stage);
+			goto fail;
+		}
+	case CTEST_RESULT_CANCELLED:
+		fprintf(reporter->fp, "CANCELLED\n");
+		goto fail;
+	case CTEST_RESULT_LIMIT_EXCEEDED:
+		fprintf(reporter->fp, "LIMIT EXCEEDED\n");
+		goto fail;
+	case CTEST_RESULT_ISOLATION_VIOLATION:
+		fprintf(reporter->fp, "ISOLATION VIOLATION\n");
+		goto fail;
+	case CTEST_RESULT_FLAKY:
+		fprintf(reporter->fp, "FLAKY (passed on attempt %u)\n", result->attempt);
+		goto done;
 	}
 
 	fprintf(reporter->fp, "INTERNAL_FAILURE (unknown result: %d)\n", result->type);
@@ -196,6 +388,8 @@ fail:
 done:
 	if (show_output && result->output != NULL)
 		testcase_reporter_report_output__(reporter, result->output);
+	if (result->previous_attempt != NULL)
+		testcase_reporter_report_attempts__(reporter, result->previous_attempt);
 	ctest_result_destroy(result);
 
 	/* Flush immediately, so there is no data that *could* be flushed
@@ -212,7 +406,7 @@ static void testcase_reporter_op_destroy__(ctest_testcase_reporter_t *ctest_repo
 }
 
 CTEST_ALL_NONNULL_ARGS__
-static testcase_reporter_t__ *testcase_reporter_create__(FILE *fp, ctest_testcase_t *testcase)
+static testcase_reporter_t__ *testcase_reporter_create__(FILE *fp, reporter_stats_t__ *stats, ctest_testcase_t *testcase)
 {
 	static ctest_testcase_reporter_ops_t ops = {
 		&testcase_reporter_op_start__,
@@ -226,6 +420,7 @@ static testcase_reporter_t__ *testcase_reporter_create__(FILE *fp, ctest_testcas
 
 	reporter->base.ops = &ops;
 	reporter->fp = fp;
+	reporter->stats = stats;
 	reporter->testcase = testcase;
 	reporter->state = CONSOLE_TESTCASE_PENDING;
 	return reporter;
@@ -244,6 +439,7 @@ struct test_reporter__ {
 	ctest_test_reporter_t base;
 
 	FILE *fp;
+	reporter_stats_t__ *stats;
 	ctest_test_t *test;
 };
 
@@ -265,7 +461,7 @@ static ctest_testcase_reporter_t *test_reporter_op_report_testcase__(ctest_test_
 		goto invalid_parameters;
 	}
 
-	if ((testcase_reporter = testcase_reporter_create__(reporter->fp, testcase)) == NULL)
+	if ((testcase_reporter = testcase_reporter_create__(reporter->fp, reporter->stats, testcase)) == NULL)
 		goto testcase_reporter_creation_failed;
 
 	return &testcase_reporter->base;
@@ -284,7 +480,7 @@ static void test_reporter_op_destroy__(ctest_test_reporter_t *ctest_reporter)
 }
 
 CTEST_ALL_NONNULL_ARGS__
-static test_reporter_t__ *test_reporter_create__(FILE *fp, ctest_test_t *test)
+static test_reporter_t__ *test_reporter_create__(FILE *fp, reporter_stats_t__ *stats, ctest_test_t *test)
 {
 	static ctest_test_reporter_ops_t ops = {
 		&test_reporter_op_report_testcase__,
@@ -297,6 +493,7 @@ static test_reporter_t__ *test_reporter_create__(FILE *fp, ctest_test_t *test)
 
 	reporter->base.ops = &ops;
 	reporter->fp = fp;
+	reporter->stats = stats;
 	reporter->test = test;
 	return reporter;
 
@@ -313,6 +510,7 @@ struct testsuite_reporter__ {
 	ctest_testsuite_reporter_t base;
 
 	FILE *fp;
+	reporter_stats_t__ *stats;
 	ctest_testsuite_t *testsuite;
 };
 
@@ -332,7 +530,7 @@ static ctest_test_reporter_t *testsuite_reporter_op_report_test__(ctest_testsuit
 		goto invalid_parameters;
 	}
 
-	if ((test_reporter = test_reporter_create__(reporter->fp, test)) == NULL)
+	if ((test_reporter = test_reporter_create__(reporter->fp, reporter->stats, test)) == NULL)
 		goto test_reporter_creation_failed;
 
 	return &test_reporter->base;
@@ -351,7 +549,7 @@ static void testsuite_reporter_op_destroy__(ctest_testsuite_reporter_t *ctest_re
 }
 
 CTEST_ALL_NONNULL_ARGS__
-static testsuite_reporter_t__ *testsuite_reporter_create__(FILE *fp, ctest_testsuite_t *testsuite)
+static testsuite_reporter_t__ *testsuite_reporter_create__(FILE *fp, reporter_stats_t__ *stats, ctest_testsuite_t *testsuite)
 {
 	static ctest_testsuite_reporter_ops_t ops = {
 		&testsuite_reporter_op_report_test__,
@@ -364,6 +562,7 @@ static testsuite_reporter_t__ *testsuite_reporter_create__(FILE *fp, ctest_tests
 
 	reporter->base.ops = &ops;
 	reporter->fp = fp;
+	reporter->stats = stats;
 	reporter->testsuite = testsuite;
 	return reporter;
 
@@ -379,6 +578,8 @@ typedef struct reporter__ reporter_t__;
 struct reporter__ {
 	ctest_reporter_t base;
 	FILE *fp;
+	unsigned int flags;
+	reporter_stats_t__ stats;
 };
 
 static reporter_t__ *upcast_reporter__(ctest_reporter_t *reporter)
@@ -391,7 +592,7 @@ static ctest_testsuite_reporter_t *reporter_op_report_testsuite__(ctest_reporter
 	reporter_t__ *const reporter = upcast_reporter__(ctest_reporter);
 	testsuite_reporter_t__ *testsuite_reporter;
 
-	if ((testsuite_reporter = testsuite_reporter_create__(reporter->fp, testsuite)) == NULL)
+	if ((testsuite_reporter = testsuite_reporter_create__(reporter->fp, &reporter->stats, testsuite)) == NULL)
 		goto create_failed;
 
 	return &testsuite_reporter->base;
@@ -404,12 +605,20 @@ CTEST_ALL_NONNULL_ARGS__
 static void reporter_op_destroy__(ctest_reporter_t *ctest_reporter) {
 	reporter_t__ *const reporter = upcast_reporter__(ctest_reporter);
 	FILE *fp = reporter->fp;
+
+	reporter_stats_print_flaky__(fp, &reporter->stats);
+	reporter_stats_print_cancelled__(fp, &reporter->stats);
+	if (reporter->flags & CTEST_CONSOLE_SPAWN_STATS) {
+		reporter_stats_print_isolation__(fp, &reporter->stats);
+		reporter_stats_print_spawn__(fp, &reporter->stats);
+	}
+
 	memset(reporter, 0, sizeof(*reporter));
 	(void)free(reporter);
 	(void)fclose(fp);
 }
 
-extern ctest_reporter_t *ctest_create_console_reporter(void) {
+extern ctest_reporter_t *ctest_create_console_reporter_with_flags(unsigned int flags) {
 	static ctest_reporter_ops_t ops = {
 		&reporter_op_report_testsuite__,
 		&reporter_op_destroy__,
@@ -428,6 +637,7 @@ extern ctest_reporter_t *ctest_create_console_reporter(void) {
 
 	reporter->base.ops = &ops;
 	reporter->fp = fp;
+	reporter->flags = flags;
 	return &reporter->base;
 
 dup_failed:
@@ -435,3 +645,7 @@ dup_failed:
 alloc_reporter_failed:
 	return NULL;
 }
+
+extern ctest_reporter_t *ctest_create_console_reporter(void) {
+	return ctest_create_console_reporter_with_flags(0);
+}
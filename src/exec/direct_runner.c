@@ -2,6 +2,7 @@
 #include <fcntl.h>
 #include <limits.h>
 #include <setjmp.h>
+#include <signal.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -11,11 +12,19 @@
 #include <ctest/_annotations.h>
 #include <ctest/exec/stage.h>
 #include <ctest/exec/result.h>
+#include <ctest/exec/runner_config.h>
+#include <ctest/exec.h>
+#include "direct_runner.h"
+#include "ports.h"
 #include "runner_utils.h"
 #include "sig.h"
+#include "state.h"
 #include "utils.h"
 
 
+/* How much of what a test case changed is described. */
+#define STATE_CHANGES_SIZE__		512
+
 /* Return values from setjmp indicating how the test completed. */
 #define RESULT_TYPE_NORMAL__		1
 #define RESULT_TYPE_SIGNAL__		2
@@ -169,9 +178,56 @@ static void exec_hooks_init__(exec_hooks_t__ *hooks)
  * Runner
  */
 
+/**
+ * A shared fixture set up in the runner's process, and handed to each test case
+ * using it as is.
+ *
+ * Test cases are run in order, with those of the same test (and of the same
+ * suite) back to back, so a shared fixture is done with once a test case of
+ * another test (or suite, depending on its scope) comes up.
+ */
+typedef struct shared_fixture__ shared_fixture_t__;
+struct shared_fixture__ {
+	ctest_fixture_t *fixture;
+	ctest_testsuite_t *testsuite;
+	shared_fixture_t__ *next;
+	bool set_up;
+
+	/**
+	 * How setting the fixture up failed, if it did; each test case using
+	 * the fixture then fails the same way, without being run.
+	 */
+	ctest_result_type_t failure_type;
+	ctest_failure_t *failure;
+};
+
 typedef struct direct_runner__ direct_runner_t__;
 struct direct_runner__ {
 	ctest_runner_t base;
+	runner_cancellation_t cancellation;
+	unsigned int retries;
+	ctest_journal_t *journal;
+
+	/**
+	 * The shared fixtures in use, and the one being set up by the test
+	 * case being run, if any.
+	 */
+	shared_fixture_t__ *fixtures;
+	shared_fixture_t__ *setting_up;
+
+	/**
+	 * Whether to check the state test cases leave behind, and addresses
+	 * within the modules of the suites run so far, to checksum.
+	 */
+	bool check_state;
+	const void **anchors;
+	size_t anchor_count;
+
+	/**
+	 * The range of loopback ports test cases lease during a run.
+	 */
+	unsigned int first_port;
+	unsigned int last_port;
 };
 
 static inline direct_runner_t__ *upcast_ctest_runner__(ctest_runner_t *runner)
@@ -186,14 +242,239 @@ static void handle_signal__(int signum, void *cookie)
 	siglongjmp(hooks->env, RESULT_TYPE_SIGNAL__);
 }
 
+/*
+ * Shared Fixtures
+ */
+
+/**
+ * Tear down a shared fixture, catching the signals it raises.
+ *
+ * @return What went wrong (in <code>buf</code>, or the failure of
+ *         <code>hooks</code>), or <code>NULL</code> if nothing did.
+ */
 CTEST_ALL_NONNULL_ARGS__
-static int runner_run_testcase__(ctest_runner_t *unused(runner), ctest_testcase_reporter_t *reporter, ctest_testcase_t *testcase)
+static const char *shared_fixture_teardown__(shared_fixture_t__ *shared, exec_hooks_t__ *hooks, char *buf, size_t size)
+{
+	switch (sigsetjmp(hooks->env, 1)) {
+	case 0:
+		sigcapture__(handle_signal__, hooks);
+		ctest_fixture_teardown(shared->fixture, &hooks->base);
+		sigrestore__();
+		return NULL;
+	case RESULT_TYPE_NORMAL__:
+		sigrestore__();
+		return hooks->result->failure != NULL ? hooks->result->failure->description : "failed";
+	default:
+		sigrestore__();
+		snprintf(buf, size, "Caught unexpected signal: %d", hooks->error);
+		return buf;
+	}
+}
+
+/**
+ * Tear down a shared fixture (if it was set up) and free it.
+ *
+ * Whatever the fixture writes is discarded, and there's no test case left to
+ * blame if tearing it down fails, so a warning is printed instead.
+ */
+CTEST_ALL_NONNULL_ARGS__
+static void shared_fixture_destroy__(shared_fixture_t__ *shared)
 {
 	exec_hooks_t__ exec_hooks;
-	int rc, result = 1;
+	int stdout_saved, stderr_saved, null_fd;
+	const char *problem;
+	char buf[64];
+
+	if (!shared->set_up)
+		goto done;
+	exec_hooks_init__(&exec_hooks);
+	if (exec_hooks.result == NULL)
+		goto done;
+
+	fflush(stdout);
+	fflush(stderr);
+	stdout_saved = dup(STDOUT_FILENO);
+	stderr_saved = dup(STDERR_FILENO);
+	if ((null_fd = open("/dev/null", O_WRONLY | O_CLOEXEC)) >= 0 && stdout_saved >= 0 && stderr_saved >= 0) {
+		dup2(null_fd, STDOUT_FILENO);
+		dup2(null_fd, STDERR_FILENO);
+	}
+
+	problem = shared_fixture_teardown__(shared, &exec_hooks, buf, sizeof(buf));
+
+	fflush(stdout);
+	fflush(stderr);
+	if (null_fd >= 0 && stdout_saved >= 0 && stderr_saved >= 0) {
+		dup2(stdout_saved, STDOUT_FILENO);
+		dup2(stderr_saved, STDERR_FILENO);
+	}
+	if (null_fd >= 0)
+		(void)close(null_fd);
+	if (stderr_saved >= 0)
+		(void)close(stderr_saved);
+	if (stdout_saved >= 0)
+		(void)close(stdout_saved);
+	if (problem != NULL)
+		fprintf(stderr, "warning: tearing down shared fixture %s failed: %s\n", ctest_fixture_get_name(shared->fixture), problem);
+	ctest_result_destroy(exec_hooks.result);
+
+done:
+	if (shared->failure != NULL)
+		ctest_failure_destroy(shared->failure);
+	memset(shared, 0, sizeof(*shared));
+	(void)free(shared);
+}
+
+/**
+ * Tear down the shared fixtures the test cases from a given one on are done
+ * with: those with the scope of another test, or of another suite (all of
+ * them, if there's no test case).
+ */
+CTEST_NONNULL_ARGS__(1)
+static void runner_release_fixtures__(direct_runner_t__ *runner, ctest_testcase_t *testcase)
+{
+	ctest_test_t *const test = testcase != NULL ? ctest_testcase_get_test(testcase) : NULL;
+	ctest_fixture_t *const fixture = test != NULL ? ctest_test_get_shared_fixture(test) : NULL;
+	ctest_testsuite_t *const testsuite = test != NULL ? ctest_test_get_testsuite(test) : NULL;
+	shared_fixture_t__ **p_shared = &runner->fixtures;
+
+	while (*p_shared != NULL) {
+		shared_fixture_t__ *const shared = *p_shared;
+		if (shared->fixture == fixture || (shared->testsuite == testsuite && ctest_fixture_get_scope(shared->fixture) == CTEST_FIXTURE_SCOPE_SUITE)) {
+			p_shared = &shared->next;
+			continue;
+		}
+		*p_shared = shared->next;
+		shared_fixture_destroy__(shared);
+	}
+}
+
+/**
+ * Make sure the shared fixture of the test case being run is set up, setting
+ * it up if it's the first test case using it. If setting it up fails (now, or
+ * for a test case before), the test case fails the same way.
+ */
+CTEST_ALL_NONNULL_ARGS__
+static void runner_use_fixture__(direct_runner_t__ *runner, ctest_fixture_t *fixture, ctest_testsuite_t *testsuite, exec_hooks_t__ *hooks)
+{
+	shared_fixture_t__ *shared;
+
+	for (shared = runner->fixtures; shared != NULL; shared = shared->next) {
+		if (shared->fixture != fixture)
+			continue;
+		if (!shared->set_up)
+			exec_hooks_on_short_circuit__(&hooks->base, shared->failure_type, shared->failure != NULL ? ctest_failure_clone(shared->failure) : NULL);
+		return;
+	}
+
+	if ((shared = calloc(1, sizeof(*shared))) == NULL)
+		exec_hooks_on_short_circuit__(&hooks->base, CTEST_RESULT_ERROR, ctest_failure_create(CTEST_STAGE_SETUP, "shared fixture allocation failure: %s", NULL, NULL, strerror(errno)));
+	shared->fixture = fixture;
+	shared->testsuite = testsuite;
+	shared->failure_type = CTEST_RESULT_ERROR;
+	shared->next = runner->fixtures;
+	runner->fixtures = shared;
+
+	/* If this doesn't return, the test case settles how it failed. */
+	runner->setting_up = shared;
+	ctest_fixture_setup(fixture, &hooks->base);
+	runner->setting_up = NULL;
+	shared->set_up = true;
+}
+
+/**
+ * Record how setting up a shared fixture failed, once the test case setting it
+ * up has been cut short.
+ */
+CTEST_ALL_NONNULL_ARGS__
+static void runner_settle_fixture__(direct_runner_t__ *runner, const ctest_result_t *result)
+{
+	shared_fixture_t__ *const shared = runner->setting_up;
+
+	runner->setting_up = NULL;
+	shared->failure_type = result->type;
+	if (result->failure != NULL)
+		shared->failure = ctest_failure_clone(result->failure);
+}
+
+/*
+ * State Checks
+ */
+
+/**
+ * Take a snapshot of the state of the runner's process, checksumming the
+ * modules of the suites run so far, that of the test case included.
+ *
+ * @return Zero on success, non-zero (with <code>errno</code> set) on failure.
+ */
+CTEST_ALL_NONNULL_ARGS__
+static int runner_take_snapshot__(direct_runner_t__ *runner, ctest_testcase_t *testcase, state_snapshot_t *snapshot)
+{
+	ctest_testsuite_t *const testsuite = ctest_test_get_testsuite(ctest_testcase_get_test(testcase));
+	/* The name of a suite is defined by its module, so it locates it. */
+	const void *const anchor = ctest_testsuite_get_name(testsuite);
+	const void **anchors;
+	size_t i;
+
+	for (i = 0; i < runner->anchor_count && runner->anchors[i] != anchor; ++i)
+		;
+	if (i == runner->anchor_count) {
+		if ((anchors = realloc(runner->anchors, (runner->anchor_count + 1) * sizeof(*anchors))) == NULL)
+			return -1;
+		anchors[runner->anchor_count++] = anchor;
+		runner->anchors = anchors;
+	}
+	return state_snapshot_take(snapshot, runner->anchors, runner->anchor_count);
+}
+
+/**
+ * Check that a test case that passed left the state of the runner's process as
+ * it found it, reporting it as <code>CTEST_RESULT_ISOLATION_VIOLATION</code>
+ * otherwise.
+ */
+CTEST_ALL_NONNULL_ARGS__
+static void runner_check_state__(direct_runner_t__ *runner, const state_snapshot_t *before, ctest_result_t *result)
+{
+	char changes[STATE_CHANGES_SIZE__];
+	state_snapshot_t after;
+
+	if (result->type != CTEST_RESULT_PASS)
+		return;
+	if (state_snapshot_take(&after, runner->anchors, runner->anchor_count) != 0) {
+		ctest_failure_t *const failure = ctest_failure_create(CTEST_STAGE_TEARDOWN, "unable to check the state of the process: %s", NULL, NULL, strerror(errno));
+		ctest_result_set_failure(result, CTEST_RESULT_ERROR, failure);
+		return;
+	}
+	if (state_snapshot_compare(before, &after, changes, sizeof(changes)) > 0) {
+		ctest_failure_t *const failure = ctest_failure_create(CTEST_STAGE_TEARDOWN, "changed the state of the process: %s", NULL, NULL, changes);
+		ctest_result_set_failure(result, CTEST_RESULT_ISOLATION_VIOLATION, failure);
+	}
+	state_snapshot_clear(&after);
+}
+
+/**
+ * Run a test case within the runner's process, catching the signals it raises
+ * and capturing what it writes to <code>stdout</code> and <code>stderr</code>.
+ *
+ * @return The result of the test case, or <code>NULL</code> (with
+ *         <code>errno</code> set) if it couldn't be run.
+ */
+CTEST_ALL_NONNULL_ARGS__
+static ctest_result_t *runner_execute__(direct_runner_t__ *runner, ctest_testcase_t *testcase, int *p_signum)
+{
+	ctest_test_t *const test = ctest_testcase_get_test(testcase);
+	ctest_fixture_t *const fixture = ctest_test_get_shared_fixture(test);
+	exec_hooks_t__ exec_hooks;
+	ctest_result_t *result = NULL;
+	state_snapshot_t before;
+	volatile bool checking = false;
+	int rc, forward_signum = 0, saved_errno;
 	int stdin_saved, stdout_saved, stderr_saved, stdin_new, stdout_new;
 
+	*p_signum = 0;
 	exec_hooks_init__(&exec_hooks);
+	if (exec_hooks.result == NULL)
+		goto result_alloc_failed;
 
 	/* Save existing stdin, stdout, stderr for redirection. */
 	if ((stdin_saved = dup(STDIN_FILENO)) < 0)
@@ -212,7 +493,6 @@ static int runner_run_testcase__(ctest_runner_t *unused(runner), ctest_testcase_
 	switch (rc = sigsetjmp(exec_hooks.env, 1)) {
 	case 0:
 		/* return from setjmp */
-		ctest_testcase_reporter_start(reporter);
 
 		/* Redirect stdin/stdout/stderr */
 		fflush(stdout);
@@ -225,9 +505,15 @@ static int runner_run_testcase__(ctest_runner_t *unused(runner), ctest_testcase_
 		dup2(stdout_new, STDERR_FILENO);
 
 		sigcapture__(handle_signal__, &exec_hooks);
+		if (fixture != NULL)
+			runner_use_fixture__(runner, fixture, ctest_test_get_testsuite(test), &exec_hooks);
+		if (runner->check_state && runner_take_snapshot__(runner, testcase, &before) != 0) {
+			exec_hooks.error = errno;
+			siglongjmp(exec_hooks.env, RESULT_TYPE_ERRNO__);
+		}
+		checking = runner->check_state;
 		ctest_testcase_execute(testcase, &exec_hooks.base);
 		exec_hooks.result->type = CTEST_RESULT_PASS;
-		result = 0;
 		break;
 
 	case RESULT_TYPE_NORMAL__:
@@ -236,10 +522,21 @@ static int runner_run_testcase__(ctest_runner_t *unused(runner), ctest_testcase_
 
 	case RESULT_TYPE_SIGNAL__:
 		/* return from siglongjmp due to caught signal. */
-		{
+		if (runner->cancellation.cancel != NULL && (exec_hooks.error == SIGINT || exec_hooks.error == SIGTERM)) {
+			/* Meant for the runner (e.g., Ctrl-C), which is
+			 * listening for it; the test case is merely in the
+			 * way. It is passed on to whoever would have caught
+			 * it once signals are restored. */
+			forward_signum = exec_hooks.error;
+			runner_cancellation_cancel(&runner->cancellation);
+			ctest_result_destroy(exec_hooks.result);
+			if ((exec_hooks.result = runner_cancellation_create_result(&runner->cancellation, exec_hooks.stage, "interrupted")) == NULL)
+				exec_hooks.result = ctest_result_create_empty();
+		} else {
 			ctest_failure_t *const failure = ctest_failure_create(exec_hooks.stage, "Caught unexpected signal: %d", NULL, NULL, exec_hooks.error);
 			/* FIXME: What if signal happens during setup/teardown? */
 			ctest_result_set_failure(exec_hooks.result, CTEST_RESULT_FAIL, failure);
+			*p_signum = exec_hooks.error;
 		}
 		break;
 
@@ -260,6 +557,10 @@ static int runner_run_testcase__(ctest_runner_t *unused(runner), ctest_testcase_
 		break;
 	}
 	sigrestore__();
+	if (runner->setting_up != NULL)
+		runner_settle_fixture__(runner, exec_hooks.result);
+	if (forward_signum != 0)
+		(void)raise(forward_signum);
 
 	/* Undo redirection stdin/stdout/stderr */
 	fflush(stdout);
@@ -271,49 +572,128 @@ static int runner_run_testcase__(ctest_runner_t *unused(runner), ctest_testcase_
 	dup2(stdout_saved, STDOUT_FILENO);
 	dup2(stderr_saved, STDERR_FILENO);
 
-	ctest_result_set_output(exec_hooks.result, read_output__(stdout_new));
-	ctest_testcase_reporter_complete(reporter, exec_hooks.result);
+	/* Once the redirection is undone, the same file descriptors are open
+	 * as when the snapshot was taken. */
+	if (checking) {
+		if (exec_hooks.result != NULL)
+			runner_check_state__(runner, &before, exec_hooks.result);
+		state_snapshot_clear(&before);
+	}
+
+	result = exec_hooks.result;
+	exec_hooks.result = NULL;
+	if (result != NULL)
+		ctest_result_set_output(result, read_output__(stdout_new));
 
 	(void)close(stdout_new);
 stdout_new_failed:
+	saved_errno = errno;
 	(void)close(stdin_new);
+	errno = saved_errno;
 stdin_new_failed:
+	saved_errno = errno;
 	(void)close(stderr_saved);
+	errno = saved_errno;
 stderr_saved_failed:
+	saved_errno = errno;
 	(void)close(stdout_saved);
+	errno = saved_errno;
 stdout_saved_failed:
+	saved_errno = errno;
 	(void)close(stdin_saved);
+	errno = saved_errno;
 stdin_saved_failed:
+	if (exec_hooks.result != NULL)
+		ctest_result_destroy(exec_hooks.result);
+result_alloc_failed:
 	return result;
 }
 
 CTEST_ALL_NONNULL_ARGS__
-static int runner_op_run_testsuites__(ctest_runner_t *runner, ctest_reporter_t *reporter, ctest_testsuite_t *const* testsuites, size_t testsuite_count)
+static int runner_run_testcase__(ctest_runner_t *ctest_runner, ctest_testcase_reporter_t *reporter, ctest_testcase_t *testcase)
+{
+	direct_runner_t__ *const runner = upcast_ctest_runner__(ctest_runner);
+	ctest_result_t *result;
+	bool passed;
+	int signum;
+
+	runner_release_fixtures__(runner, testcase);
+	ctest_testcase_reporter_start(reporter);
+	if ((result = runner_execute__(runner, testcase, &signum)) == NULL) {
+		ctest_failure_t *const failure = ctest_failure_create(CTEST_STAGE_SETUP, "unable to redirect output: %s", NULL, NULL, strerror(errno));
+		if ((result = ctest_result_create_empty()) == NULL) {
+			if (failure != NULL)
+				ctest_failure_destroy(failure);
+			return -1;
+		}
+		ctest_result_set_failure(result, CTEST_RESULT_ERROR, failure);
+	}
+	passed = result->type == CTEST_RESULT_PASS;
+	ctest_testcase_reporter_complete(reporter, result);
+	return passed ? 0 : 1;
+}
+
+CTEST_ALL_NONNULL_ARGS__
+static int runner_op_run_testsuites__(ctest_runner_t *ctest_runner, ctest_reporter_t *reporter, ctest_testsuite_t *const* testsuites, size_t testsuite_count)
 {
-	return runner_run_testsuites(runner, reporter, testsuites, testsuite_count, &runner_run_testcase__);
+	direct_runner_t__ *const runner = upcast_ctest_runner__(ctest_runner);
+	int result;
+
+	if (ports_open(runner->first_port, runner->last_port) != 0)
+		return -1;
+	result = runner_run_testsuites(ctest_runner, reporter, testsuites, testsuite_count, &runner->cancellation, runner->retries, &runner_run_testcase__, runner->journal);
+	runner_release_fixtures__(runner, NULL);
+	ports_close();
+	return result;
 }
 
 CTEST_ALL_NONNULL_ARGS__
-static int runner_op_run_tests__(ctest_runner_t *runner, ctest_reporter_t *reporter, ctest_test_t *const*tests, size_t test_count)
+static int runner_op_run_tests__(ctest_runner_t *ctest_runner, ctest_reporter_t *reporter, ctest_test_t *const*tests, size_t test_count)
 {
-	return runner_run_tests(runner, reporter, tests, test_count, &runner_run_testcase__);
+	direct_runner_t__ *const runner = upcast_ctest_runner__(ctest_runner);
+	int result;
+
+	if (ports_open(runner->first_port, runner->last_port) != 0)
+		return -1;
+	result = runner_run_tests(ctest_runner, reporter, tests, test_count, &runner->cancellation, runner->retries, &runner_run_testcase__, runner->journal);
+	runner_release_fixtures__(runner, NULL);
+	ports_close();
+	return result;
 }
 
 CTEST_ALL_NONNULL_ARGS__
-static int runner_op_run_testcases__(ctest_runner_t *runner, ctest_reporter_t *reporter, ctest_testcase_t *const*testcases, size_t testcase_count)
+static int runner_op_run_testcases__(ctest_runner_t *ctest_runner, ctest_reporter_t *reporter, ctest_testcase_t *const*testcases, size_t testcase_count)
 {
-	return runner_run_testcases(runner, reporter, testcases, testcase_count, &runner_run_testcase__);
+	direct_runner_t__ *const runner = upcast_ctest_runner__(ctest_runner);
+	int result;
+
+	if (ports_open(runner->first_port, runner->last_port) != 0)
+		return -1;
+	result = runner_run_testcases(ctest_runner, reporter, testcases, testcase_count, &runner->cancellation, runner->retries, &runner_run_testcase__, runner->journal);
+	runner_release_fixtures__(runner, NULL);
+	ports_close();
+	return result;
 }
 
 CTEST_ALL_NONNULL_ARGS__
 static void runner_op_destroy__(ctest_runner_t *ctest_runner)
 {
 	direct_runner_t__ *const runner = upcast_ctest_runner__(ctest_runner);
+	runner_release_fixtures__(runner, NULL);
+	(void)free(runner->anchors);
 	memset(runner, 0, sizeof(*runner));
 	(void)free(runner);
 }
 
 ctest_runner_t *ctest_create_direct_runner(void)
+{
+	ctest_runner_config_t config;
+	ctest_runner_config_init(&config);
+	return ctest_create_direct_runner_with_config(&config);
+}
+
+CTEST_ALL_NONNULL_ARGS__
+ctest_runner_t *ctest_create_direct_runner_with_config(const ctest_runner_config_t *config)
 {
 	static ctest_runner_ops_t ops = {
 		&runner_op_run_testsuites__,
@@ -328,8 +708,37 @@ ctest_runner_t *ctest_create_direct_runner(void)
 		goto alloc_runner_failed;
 
 	runner->base.ops = &ops;
+	runner_cancellation_init(&runner->cancellation, config);
+	runner->retries = config->retries;
+	runner->journal = config->journal;
+	runner->check_state = config->check_state;
+	runner->first_port = config->first_port;
+	runner->last_port = config->last_port;
 	return &runner->base;
 
 alloc_runner_failed:
 	return NULL;
 }
+
+CTEST_ALL_NONNULL_ARGS__
+ctest_result_t *direct_runner_execute(ctest_runner_t *ctest_runner, ctest_testcase_t *testcase, int *p_signum)
+{
+	return runner_execute__(upcast_ctest_runner__(ctest_runner), testcase, p_signum);
+}
+
+CTEST_NONNULL_ARGS__(1)
+void direct_runner_release_fixture(ctest_runner_t *ctest_runner, ctest_fixture_t *fixture)
+{
+	direct_runner_t__ *const runner = upcast_ctest_runner__(ctest_runner);
+	shared_fixture_t__ **p_shared = &runner->fixtures;
+
+	while (*p_shared != NULL) {
+		shared_fixture_t__ *const shared = *p_shared;
+		if (fixture != NULL && shared->fixture != fixture) {
+			p_shared = &shared->next;
+			continue;
+		}
+		*p_shared = shared->next;
+		shared_fixture_destroy__(shared);
+	}
+}
@@ -0,0 +1,49 @@
+#ifndef PRIVATE__DIRECT_RUNNER_H__INCLUDED__
+#define PRIVATE__DIRECT_RUNNER_H__INCLUDED__
+
+#include <ctest/_annotations.h>
+#include <ctest/exec/result.h>
+#include <ctest/exec/runner.h>
+#include <ctest/exec/suite.h>
+
+/**
+ * Running individual test cases with a direct runner (see
+ * <code>ctest_create_direct_runner_with_config</code>), on behalf of another
+ * runner that runs some of its test cases within its own process (e.g., the
+ * forking runner, with <code>CTEST_ISOLATION_AUTO</code>).
+ *
+ * The other runner schedules and reports the test cases; the direct runner
+ * only runs them, catching the signals they raise and capturing their output.
+ */
+
+/**
+ * Run a test case within the calling process.
+ *
+ * The shared fixture of the test case (if any) is set up by the first test
+ * case using it, and kept for those after it until it is released with
+ * <code>direct_runner_release_fixture</code>.
+ *
+ * @param runner   The direct runner with which to run the test case.
+ * @param testcase The test case to run.
+ * @param p_signum Populated with the signal that stopped the test case (e.g.,
+ *                 <code>SIGSEGV</code>), or zero if none did (including one
+ *                 that cancelled the run instead).
+ *
+ * @return The result of the test case, or <code>NULL</code> (with
+ *         <code>errno</code> set) if it couldn't be run.
+ */
+CTEST_ALL_NONNULL_ARGS__
+extern ctest_result_t *direct_runner_execute(ctest_runner_t *runner, ctest_testcase_t *testcase, int *p_signum);
+
+/**
+ * Tear down a shared fixture set up by <code>direct_runner_execute</code>, if
+ * it was.
+ *
+ * @param runner  The direct runner that set up the fixture.
+ * @param fixture The fixture to tear down, or <code>NULL</code> to tear down
+ *                every fixture that is set up.
+ */
+CTEST_NONNULL_ARGS__(1)
+extern void direct_runner_release_fixture(ctest_runner_t *runner, ctest_fixture_t *fixture);
+
+#endif /* PRIVATE__DIRECT_RUNNER_H__INCLUDED__ */
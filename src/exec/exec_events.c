@@ -13,6 +13,7 @@ typedef enum exec_event_type__ exec_event_type_t__;
 enum exec_event_type__ {
 	EXEC_EVENT_STAGE_CHANGE__,
 	EXEC_EVENT_FAILURE__,
+	EXEC_EVENT_COMPLETE__,
 };
 
 /*
@@ -66,6 +67,24 @@ static void exec_event_writer_op_on_failure__(exec_event_consumer_t *consumer, c
 		return;
 }
 
+static void exec_event_writer_op_on_complete__(exec_event_consumer_t *consumer, ctest_result_type_t type)
+{
+	exec_event_writer_t *const writer = upcast_exec_event_writer__(consumer);
+	struct {
+		exec_event_msg_header_t__ header;
+		ctest_result_type_t type;
+	} msg;
+
+	/* A single write, so the event arrives in one piece. */
+	memset(&msg, 0, sizeof(msg));
+	msg.header.length = sizeof(msg.type);
+	msg.header.type = EXEC_EVENT_COMPLETE__;
+	msg.type = type;
+
+	if (write(writer->fd, &msg, sizeof(msg)) != (int)sizeof(msg))
+		return;
+}
+
 /**
  * Initialize a new <code>exec_event_writer_t</code>.
  *
@@ -83,6 +102,7 @@ void exec_event_writer_init(exec_event_writer_t *writer, int fd)
 	static exec_event_consumer_ops_t ops = {
 		&exec_event_writer_op_on_stage_change__,
 		&exec_event_writer_op_on_failure__,
+		&exec_event_writer_op_on_complete__,
 	};
 
 	memset(writer, 0, sizeof(*writer));
@@ -124,6 +144,11 @@ static void reader_on_state_change_done__(exec_event_reader_t *reader)
 	exec_event_consumer_on_stage_change(reader->consumer, reader->state.read_body.msg.stage);
 }
 
+static void reader_on_complete_done__(exec_event_reader_t *reader)
+{
+	exec_event_consumer_on_complete(reader->consumer, reader->state.read_body.msg.type);
+}
+
 static void reader_on_failure_done__(exec_event_reader_t *reader)
 {
 	if (failure_storage_deserialize(reader->buf, reader->ofs) == 0) {
@@ -165,6 +190,14 @@ static void reader_on_msg_header_done__(exec_event_reader_t *reader)
 		reader->buf = reader->state.read_body.msg.failure = malloc(reader->len);
 		reader->state.read_body.on_done = &reader_on_failure_done__;
 		break;
+
+	case EXEC_EVENT_COMPLETE__:
+		if (reader->len >= sizeof(reader->state.read_body.msg.type)) {
+			reader->buf = &reader->state.read_body.msg.type;
+			reader->cap = sizeof(reader->state.read_body.msg.type);
+			reader->state.read_body.on_done = &reader_on_complete_done__;
+		}
+		break;
 	}
 
 	reader->on_done = &reader_on_msg_body_done__;
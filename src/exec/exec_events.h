@@ -5,6 +5,7 @@
 
 #include <ctest/_annotations.h>
 #include <ctest/exec/failure.h>
+#include <ctest/exec/result.h>
 #include <ctest/exec/stage.h>
 
 #include "poll_handler.h"
@@ -29,6 +30,9 @@ struct exec_event_consumer_ops {
 
 	CTEST_ALL_NONNULL_ARGS__
 	void (*on_failure)(exec_event_consumer_t *, ctest_failure_t *);
+
+	CTEST_ALL_NONNULL_ARGS__
+	void (*on_complete)(exec_event_consumer_t *, ctest_result_type_t);
 };
 struct exec_event_consumer {
 	exec_event_consumer_ops_t *ops;
@@ -61,6 +65,22 @@ static inline void exec_event_consumer_on_failure(exec_event_consumer_t *consume
 	return (*consumer->ops->on_failure)(consumer, failure);
 }
 
+/**
+ * Notify an <code>exec_event_consumer_t</code> that a test case has completed.
+ *
+ * Only processes that run more than one test case report completion; for all
+ * others, the end of the process marks the completion of its test case.
+ *
+ * @param consumer The consumer to notify.
+ * @param type     The type of result of the completed test case. Details of
+ *                 any failure were reported with a preceding failure event.
+ */
+CTEST_ALL_NONNULL_ARGS__
+static inline void exec_event_consumer_on_complete(exec_event_consumer_t *consumer, ctest_result_type_t type)
+{
+	return (*consumer->ops->on_complete)(consumer, type);
+}
+
 /*
  * Execution Event Writer
  */
@@ -107,6 +127,21 @@ static inline void exec_event_writer_on_failure(exec_event_writer_t *writer, cte
 	return exec_event_consumer_on_failure(&writer->consumer_base, failure);
 }
 
+/**
+ * Write a completion event.
+ *
+ * This is a blocking call that will return when the completion event is
+ * completely written to the writer's file descriptor.
+ *
+ * @param writer The writer to which to write the completion event.
+ * @param type   The result type to include in the written completion event.
+ */
+CTEST_ALL_NONNULL_ARGS__
+static inline void exec_event_writer_on_complete(exec_event_writer_t *writer, ctest_result_type_t type)
+{
+	return exec_event_consumer_on_complete(&writer->consumer_base, type);
+}
+
 CTEST_ALL_NONNULL_ARGS__
 extern void exec_event_writer_init(exec_event_writer_t *writer, int fd);
 
@@ -156,6 +191,7 @@ struct exec_event_reader {
 			union {
 				ctest_stage_t stage;
 				ctest_failure_t *failure;
+				ctest_result_type_t type;
 			} msg;
 			void (*on_done)(exec_event_reader_t *);
 		} read_body;
@@ -311,7 +311,6 @@ void ctest_failure_destroy(ctest_failure_t *failure)
 	(void)free(failure);
 }
 
-#if 0
 /**
  * Clone an existing failure object.
  *
@@ -321,9 +320,22 @@ void ctest_failure_destroy(ctest_failure_t *failure)
  * useful in building new failure objects. Simply populate a temporary
  * <code>ctest_failure_t</code> object with appropriate values, then
  * use <code>ctest_failure_clone</code> to build the final object.
+ *
+ * @param failure The failure to clone.
+ *
+ * @return The copy of <code>failure</code>, or <code>NULL</code> on error.
  */
 CTEST_ALL_NONNULL_ARGS__
 ctest_failure_t *ctest_failure_clone(const ctest_failure_t *failure)
 {
+	const size_t size = failure_storage_size(failure);
+	void *buf;
+
+	if ((buf = calloc(1, size)) == NULL)
+		return NULL;
+	if (failure_storage_format(buf, size, failure) < 0) {
+		(void)free(buf);
+		return NULL;
+	}
+	return buf;
 }
-#endif
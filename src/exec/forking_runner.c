@@ -1,25 +1,46 @@
+#define _GNU_SOURCE     /* sched_setaffinity */
 #include <errno.h>
 #include <fcntl.h>
 #include <inttypes.h>
+#include <limits.h>
 #include <poll.h>
+#include <sched.h>
+#include <setjmp.h>
 #include <signal.h>
+#include <spawn.h>
 #include <stdarg.h>
 #include <stdbool.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/timerfd.h>
 #include <sys/wait.h>
+#include <time.h>
 #include <unistd.h>
 
 #include <ctest/_annotations.h>
 #include <ctest/exec/runner.h>
+#include <ctest/exec/runner_config.h>
 
+#include <ctest/exec.h>
+
+#include "cgroup.h"
+#include "direct_runner.h"
 #include "exec_events.h"
 #include "output_reader.h"
 #include "poll_handler.h"
+#include "ports.h"
+#include "reactor.h"
 #include "runner_utils.h"
+#include "sandbox.h"
 #include "sig.h"
 #include "utils.h"
+#include "zygote.h"
 
 /**
  * Coerce <code>type</code> into a valid <code>ctest_result_type_t</code>.
@@ -41,6 +62,13 @@ static ctest_result_type_t coerce_result_type__(int type)
 	case CTEST_RESULT_SKIPPED:
 	case CTEST_RESULT_ERROR:
 		return result;
+	case CTEST_RESULT_TIMEOUT:
+	case CTEST_RESULT_CANCELLED:
+	case CTEST_RESULT_FLAKY:
+	case CTEST_RESULT_LIMIT_EXCEEDED:
+	case CTEST_RESULT_ISOLATION_VIOLATION:
+		/* Only ever determined by the parent. */
+		break;
 	}
 
 	return CTEST_RESULT_ERROR;
@@ -86,6 +114,19 @@ struct exec_hooks__ {
 	/**
 	 * The writer to use to send information to the parent process. */
 	exec_event_writer_t writer;
+
+	/**
+	 * Where to resume when a test case short-circuits, in a child that
+	 * runs more than one test case, or <code>NULL</code> if the child
+	 * exits when its (only) test case short-circuits.
+	 */
+	sigjmp_buf *env;
+
+	/**
+	 * The type of result of a test case that short-circuited, when
+	 * resuming at <code>env</code>.
+	 */
+	ctest_result_type_t result_type;
 };
 
 static inline exec_hooks_t__ *upcast_ctest_failure_hooks__(ctest_exec_hooks_t *hooks)
@@ -119,6 +160,10 @@ static void exec_hooks_on_short_circuit__(ctest_exec_hooks_t *ctest_hooks, ctest
 		exec_event_writer_on_failure(&hooks->writer, failure);
 		ctest_failure_destroy(failure);
 	}
+	if (hooks->env != NULL) {
+		hooks->result_type = result_type;
+		siglongjmp(*hooks->env, 1);
+	}
 	exec_hooks_destroy__(hooks);
 	exit_child__(result_type);
 }
@@ -152,6 +197,8 @@ static void exec_hooks_init__(exec_hooks_t__ *hooks, int fd)
 
 	hooks->base.ops = &ops;
 	hooks->stage = CTEST_STAGE_SETUP;
+	hooks->env = NULL;
+	hooks->result_type = CTEST_RESULT_PASS;
 	exec_event_writer_init(&hooks->writer, fd);
 }
 
@@ -181,6 +228,10 @@ struct child_event_consumer__ {
 	exec_event_consumer_t base;
 	ctest_stage_t stage;
 	ctest_failure_t *last_failure;
+
+	/* Set once a child running several test cases completes one. */
+	bool completed;
+	ctest_result_type_t result_type;
 };
 
 static inline child_event_consumer_t__ *upcast_child_event_consumer__(exec_event_consumer_t *consumer)
@@ -202,16 +253,40 @@ static void child_event_consumer_op_on_failure__(exec_event_consumer_t *exec_eve
 	consumer->last_failure = failure;
 }
 
+static void child_event_consumer_op_on_complete__(exec_event_consumer_t *exec_event_consumer, ctest_result_type_t type)
+{
+	child_event_consumer_t__ *const consumer = upcast_child_event_consumer__(exec_event_consumer);
+	consumer->completed = true;
+	consumer->result_type = coerce_result_type__(type);
+}
+
 static void child_event_consumer_init__(child_event_consumer_t__ *consumer)
 {
 	static exec_event_consumer_ops_t ops = {
 		&child_event_consumer_op_on_stage_change__,
 		&child_event_consumer_op_on_failure__,
+		&child_event_consumer_op_on_complete__,
 	};
 
 	consumer->base.ops = &ops;
 	consumer->stage = CTEST_STAGE_SETUP;
 	consumer->last_failure = NULL;
+	consumer->completed = false;
+	consumer->result_type = CTEST_RESULT_PASS;
+}
+
+/**
+ * Prepare the consumer for the next test case run by the same child.
+ */
+static void child_event_consumer_reset__(child_event_consumer_t__ *consumer)
+{
+	if (consumer->last_failure != NULL) {
+		ctest_failure_destroy(consumer->last_failure);
+		consumer->last_failure = NULL;
+	}
+	consumer->stage = CTEST_STAGE_SETUP;
+	consumer->completed = false;
+	consumer->result_type = CTEST_RESULT_PASS;
 }
 
 static void child_event_consumer_destroy__(child_event_consumer_t__ *consumer)
@@ -224,294 +299,2608 @@ static void child_event_consumer_destroy__(child_event_consumer_t__ *consumer)
 }
 
 /*
- * Runner
+ * Children
  */
 
 /**
- * A <code>ctest_runner_t</code> implementation that runs all tests isolated
- * in its own address space (by forking off and running the tests in a child).
+ * The state of a child process running test cases.
+ *
+ * The parent multiplexes the execution hooks and output pipes of all its
+ * children in a single poll loop; each child owns a reader for each pipe.
+ *
+ * A child either runs a single test case and exits or, when the runner keeps
+ * a pool of children (or isolates groups of test cases), runs the test cases
+ * it receives on its request socket back to back, reporting the completion of
+ * each with a completion event.
  */
-typedef struct forking_runner__ forking_runner_t__;
-struct forking_runner__ {
-	ctest_runner_t base;
-};
+typedef struct child__ child_t__;
 
-static forking_runner_t__ *upcast_from_ctest_runner__(ctest_runner_t *runner)
-{
-	return containerof(runner, forking_runner_t__, base);
-}
+/**
+ * A process in which a shared fixture is set up, and from which the children
+ * running the test cases using the fixture are spawned.
+ */
+typedef struct fixture_host__ fixture_host_t__;
 
 /**
- * Wait for the child process to complete execution of the unit test, capturing
- * the output and execution events it generates.
- *
- * @param result    The <code>ctest_result_t</code> object to update with the
- *                  results from running the test.
- * @param child     The PID of the child for which is being waited.
- * @param hooks_fd  The file descriptor of the pipe from which to read to
- *                  receive execution events from the child process.
- *                  This will be closed before returning.
- * @param output_fd The file descriptor of the pipe from which to read to
- *                  receive the output of the child process (stdout and stderr).
- *                  This will be closed before returning.
- *
- * @return Zero on success, non-zero on failure.
+ * A file descriptor of a child, registered with the runner's reactor: one of
+ * its pipes or, to learn when it exits, its <code>pidfd</code>.
  */
-static int wait_for_child__(ctest_result_t *result, pid_t child, int hooks_fd, int output_fd)
-{
-	child_event_consumer_t__ child_event_consumer;
-	exec_event_reader_t child_event_reader;
-	output_reader_t child_output_reader;
+typedef struct poll_source__ poll_source_t__;
+struct poll_source__ {
+	poll_handler_t base;
+	const char *name;
+	child_t__ *child;
 
-	struct {
-		const char *name;
-		int fd;
-		poll_handler_t *handler;
-	} poll_handlers[] = {
-		{ "execution hooks", hooks_fd,  &child_event_reader.poll_handler_base },
-		{ "output",          output_fd, &child_output_reader.poll_handler_base },
-	};
+	/**
+	 * The reader of the pipe, or <code>NULL</code> for the pidfd.
+	 */
+	poll_handler_t *handler;
+	int fd;
+	bool open;
+};
 
-	int child_result;
-	pid_t wait_result;
+struct child__ {
+	/**
+	 * The job the child is running, or <code>NULL</code> if the child is
+	 * idle (or this child slot is unused, in which case <code>pid</code> is
+	 * zero).
+	 */
+	runner_job_t *job;
 
-	int retval = -1;
+	/**
+	 * The result of the job, populated once the child has been reaped.
+	 */
+	ctest_result_t *result;
 
-	child_event_consumer_init__(&child_event_consumer);
-	exec_event_reader_init(&child_event_reader, hooks_fd, &child_event_consumer.base);
-	output_reader_init(&child_output_reader, output_fd);
+	pid_t pid;
+	child_event_consumer_t__ consumer;
+	exec_event_reader_t event_reader;
+	output_reader_t output_reader;
 
-	while (1) {
-		struct pollfd pollfds[countof(poll_handlers)];
-		size_t i;
-		int rc;
-
-		rc = 0;
-		memset(pollfds, 0, sizeof(pollfds));
-		for (i = 0; i < countof(poll_handlers); ++i) {
-			pollfds[i].fd = poll_handlers[i].fd;
-			pollfds[i].events = POLLIN;
-			if (poll_handlers[i].fd >= 0)
-				rc = 1;
-		}
-		/* If no files are still open, nothing left to consume. */
-		if (!rc) goto wait_for_child;
+	/**
+	 * The reactor with which the child's sources are registered, and the
+	 * sources themselves. Without pidfd support, the exit source is never
+	 * open, and the child is reaped as soon as its pipes are closed.
+	 */
+	reactor_t *reactor;
+	poll_source_t__ event_source;
+	poll_source_t__ output_source;
+	poll_source_t__ exit_source;
 
-		if ((rc = poll(pollfds, countof(poll_handlers), -1)) < 0) {
-			ctest_failure_t *const failure = ctest_failure_create(child_event_consumer.stage, "poll of child data failed: %s", NULL, NULL, strerror(errno));
-			retval = ctest_result_set_failure(result, CTEST_RESULT_ERROR, failure);
-			goto read_failure;
-		}
+	/**
+	 * Whether the child has exited and been waited for, and its exit
+	 * status and resource usage if so.
+	 */
+	bool exited;
+	int status;
+	struct rusage rusage;
 
-		for (i = 0; i < countof(poll_handlers); ++i) {
-			int f_close = 0;
-			if (pollfds[i].revents & POLLIN) {
-				rc = poll_handler_on_data_available(poll_handlers[i].handler);
-				if (rc < 0) {
-					ctest_failure_t *const failure = ctest_failure_create(child_event_consumer.stage, "consumption of %s from child failed: %s", NULL, NULL, poll_handlers[i].name, strerror(errno));
-					retval = ctest_result_set_failure(result, CTEST_RESULT_ERROR, failure);
-					f_close = 1;
-				} else if (rc == 0) {
-					/* Pipe has been closed */
-					f_close = 1;
-				}
-			} else if (pollfds[i].revents & POLLHUP) {
-				/* Pipe has been closed and all the data has been drained; */
-				f_close = 1;
-			}
+	/**
+	 * Whether the peak memory use of the child is measured (only when it
+	 * is recorded, along with the timings of the run), the number of jobs
+	 * handed to the child, and how much memory it had resident from the
+	 * start (that of the process it was forked from, e.g., a shared
+	 * fixture): the peak memory use of the child is only that of its job,
+	 * less what it started out with, if it ran no other.
+	 */
+	bool measure_memory;
+	unsigned int job_count;
+	uint64_t inherited_bytes;
 
-			if (f_close) {
-				/* Make negative so poll() will ignore it. */
-				poll_handlers[i].fd = -poll_handlers[i].fd;
-				poll_handler_on_close(poll_handlers[i].handler);
-			}
+	/**
+	 * The limits on the resources of the child, and the cgroup it is run
+	 * in (whose name is empty if it isn't run in one of its own).
+	 */
+	const ctest_limits_t *limits;
+	cgroup_root_t *cgroup_root;
+	cgroup_t cgroup;
+
+	/**
+	 * The CPU to which the child is restricted, or <code>-1</code>.
+	 */
+	int cpu;
+
+	/**
+	 * The socket on which test cases are sent to a pooled child, or
+	 * <code>-1</code> if the child runs a single test case.
+	 */
+	int request_fd;
+
+	/**
+	 * The fixture host from which the child is to be spawned, while the
+	 * host sets up its fixture, or <code>NULL</code>. Until then, the
+	 * child slot has a job but no process.
+	 */
+	fixture_host_t__ *waiting_host;
+
+	/**
+	 * The group of the test cases a pooled child has been running, when
+	 * the runner isolates groups of test cases; <code>SIZE_MAX</code> if
+	 * the child has only been running a retry.
+	 */
+	size_t group;
+
+	/**
+	 * When (in nanoseconds, on the monotonic clock) the watchdog next
+	 * acts on the child, or zero if the child's job has no time limit.
+	 */
+	uint64_t deadline_ns;
+
+	/**
+	 * The time limit of the child's job, in nanoseconds.
+	 */
+	uint64_t timeout_ns;
+
+	/**
+	 * The last signal the watchdog sent the child's process group, or
+	 * zero if the child's job hasn't run out of time (or been cancelled).
+	 */
+	int watchdog_signal;
+
+	/**
+	 * Whether the watchdog is stopping the child because the run was
+	 * cancelled, rather than because its job ran out of time.
+	 */
+	bool cancelled;
+
+	/**
+	 * The stage the child's job was in when it ran out of time (or was
+	 * cancelled).
+	 */
+	ctest_stage_t timeout_stage;
+};
+
+/**
+ * How long a child that has run out of time is given to exit after
+ * <code>SIGTERM</code>, before it is sent <code>SIGKILL</code>; a child still
+ * not gone this long after <code>SIGKILL</code> (e.g., because a process that
+ * left its group holds its pipes open) is reaped regardless.
+ */
+#define WATCHDOG_KILL_DELAY_NS__	(2 * UINT64_C(1000000000))
+
+static uint64_t monotonic_ns__(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000000000u + now.tv_nsec;
+}
+
+/**
+ * Send a signal to a child and every process in its process group.
+ */
+static void child_signal__(child_t__ *child, int signum)
+{
+	/* The child may not have moved into its own group yet. */
+	if (killpg(child->pid, signum) != 0)
+		(void)kill(child->pid, signum);
+}
+
+/**
+ * Open a pidfd referring to a child, which becomes readable once the child
+ * exits.
+ *
+ * @return The pidfd, or <code>-1</code> if it couldn't be opened (e.g., the
+ *         kernel doesn't support pidfds).
+ */
+static int pidfd_open__(pid_t pid)
+{
+#ifdef SYS_pidfd_open
+	return (int)syscall(SYS_pidfd_open, pid, 0);
+#else
+	(void)pid;
+	errno = ENOSYS;
+	return -1;
+#endif
+}
+
+/**
+ * Stop watching a source, closing it if the runner owns its file descriptor
+ * (i.e., it is the pidfd).
+ */
+static void poll_source_close__(poll_source_t__ *source)
+{
+	if (!source->open)
+		return;
+	reactor_remove(source->child->reactor, source->fd, &source->base);
+	source->open = false;
+	if (source->handler == NULL)
+		(void)close(source->fd);
+}
+
+/**
+ * Register the sources of a (newly started) child with its reactor.
+ *
+ * @return Zero on success, non-zero (with <code>errno</code> set) on failure;
+ *         the sources already registered remain open.
+ */
+static int child_watch__(child_t__ *child)
+{
+	poll_source_t__ *const sources[] = { &child->event_source, &child->output_source, &child->exit_source };
+	size_t i;
+
+	for (i = 0; i < sizeof(sources)/sizeof(sources[0]); ++i) {
+		if (sources[i]->fd < 0)
+			continue;
+		if (reactor_add(child->reactor, sources[i]->fd, &sources[i]->base) != 0) {
+			if (sources[i]->handler == NULL)
+				(void)close(sources[i]->fd);
+			return -1;
 		}
+		sources[i]->open = true;
 	}
+	return 0;
+}
 
-read_failure:
-	/* Failed to read from the child; just kill it. */
-	kill(child, SIGKILL);
+/**
+ * Stop watching all of a child's sources.
+ */
+static void child_unwatch__(child_t__ *child)
+{
+	poll_source_close__(&child->event_source);
+	poll_source_close__(&child->output_source);
+	poll_source_close__(&child->exit_source);
+}
 
-wait_for_child:
-	/* FIXME: Timeout waiting for the child, then forcible kill it. */
-	wait_result = waitpid(child, &child_result, 0);
-	if (wait_result < 0) {
-		ctest_failure_t *const failure = ctest_failure_create(child_event_consumer.stage, "error waiting for child: %s", NULL, NULL, strerror(errno));
-		retval = ctest_result_set_failure(result, CTEST_RESULT_ERROR, failure);
-		goto done;
-	} else if (wait_result != child) {
-		ctest_failure_t *const failure = ctest_failure_create(child_event_consumer.stage, "unexpected pid waited: %ji (expecting %ji)", NULL, NULL, (intmax_t) wait_result, (intmax_t) child);
-		retval = ctest_result_set_failure(result, CTEST_RESULT_ERROR, failure);
-		goto done;
-	}
+/**
+ * Determine the result of a child that has been reaped, based on its exit
+ * status and the events it reported.
+ *
+ * @param child        The child that has been reaped.
+ * @param result       The <code>ctest_result_t</code> object to update.
+ * @param child_result The exit status of the child, as reported by
+ *                     <code>waitpid</code>.
+ */
+static void child_set_result__(child_t__ *child, ctest_result_t *result, int child_result)
+{
+	child_event_consumer_t__ *const consumer = &child->consumer;
 
 	if (WIFEXITED(child_result)) {
 		ctest_result_type_t result_type = coerce_result_type__(WEXITSTATUS(child_result));
 		switch (result_type) {
 		case CTEST_RESULT_PASS:
 			ctest_result_set_failure(result, result_type, NULL);
-			retval = 0;
 			break;
 		case CTEST_RESULT_FAIL:
 		case CTEST_RESULT_ERROR:
 		case CTEST_RESULT_SKIPPED:
-			/* report a failure unless the test was skipped. */
-			retval = result_type != CTEST_RESULT_SKIPPED;
-			ctest_result_set_failure(result, result_type, child_event_consumer.last_failure);
-			child_event_consumer.last_failure = NULL;
+		case CTEST_RESULT_TIMEOUT:
+		case CTEST_RESULT_CANCELLED:
+		case CTEST_RESULT_FLAKY:
+		case CTEST_RESULT_LIMIT_EXCEEDED:
+		case CTEST_RESULT_ISOLATION_VIOLATION:
+			ctest_result_set_failure(result, result_type, consumer->last_failure);
+			consumer->last_failure = NULL;
 		}
 	} else if (WIFSIGNALED(child_result)) {
 		int signum = WTERMSIG(child_result);
-		ctest_failure_t *const failure = ctest_failure_create(child_event_consumer.stage, "terminated by signal: %s (%d)", NULL, NULL, strsignal(signum), signum);
-		retval = ctest_result_set_failure(result, CTEST_RESULT_ERROR, failure);
+		ctest_failure_t *const failure = ctest_failure_create(consumer->stage, "terminated by signal: %s (%d)", NULL, NULL, strsignal(signum), signum);
+		ctest_result_set_failure(result, CTEST_RESULT_ERROR, failure);
 	} else {
-		ctest_failure_t *const failure = ctest_failure_create(child_event_consumer.stage, "child exited with error: %#x", NULL, NULL, child_result);
-		retval = ctest_result_set_failure(result, CTEST_RESULT_ERROR, failure);
-		goto done;
+		ctest_failure_t *const failure = ctest_failure_create(consumer->stage, "child exited with error: %#x", NULL, NULL, child_result);
+		ctest_result_set_failure(result, CTEST_RESULT_ERROR, failure);
 	}
+}
 
-done:
-	result->output = output_reader_build(&child_output_reader);
+static double mib__(uint64_t bytes)
+{
+	return bytes / (1024.0 * 1024.0);
+}
 
-	exec_event_reader_destroy(&child_event_reader);
-	child_event_consumer_destroy__(&child_event_consumer);
-	output_reader_destroy(&child_output_reader);
-	return retval;
+static uint64_t timeval_ns__(const struct timeval *tv)
+{
+	return (uint64_t)tv->tv_sec * 1000000000u + (uint64_t)tv->tv_usec * 1000u;
 }
 
-static int runner_run_testcase__(ctest_runner_t *unused(runner), ctest_testcase_reporter_t *reporter, ctest_testcase_t *testcase)
+/**
+ * Determine whether a child whose job didn't pass was stopped for going over
+ * one of its limits and, if so, report the job as such (rather than, e.g., as
+ * killed by a signal).
+ *
+ * @param child        The child that has been reaped.
+ * @param result       The result of the child's job, as determined from its
+ *                     exit status.
+ * @param child_result The exit status of the child.
+ * @param stats        What was observed of the child's cgroup (all zero if
+ *                     it wasn't run in one).
+ */
+static void child_check_limits__(child_t__ *child, ctest_result_t *result, int child_result, const cgroup_stats_t *stats)
 {
-	ctest_result_t *result;
-	int retval = -1;
-	int hooks_pipe[2];              /* Pipe for sending hooks notifications to parent. */
-	int output_pipe[2];             /* Pipe for sending test output (stderr/stdout) to parent. */
+	const ctest_limits_t *const limits = child->limits;
+	const uint64_t cpu_limit_ns = (limits->cpu_ns + 999999999u) / 1000000000u * 1000000000u;
+	const uint64_t cpu_used_ns = timeval_ns__(&child->rusage.ru_utime) + timeval_ns__(&child->rusage.ru_stime);
+	ctest_failure_t *failure;
+
+	if (result->type == CTEST_RESULT_PASS || result->type == CTEST_RESULT_SKIPPED)
+		return;
+
+	if (stats->oom_kill_count > 0 && limits->memory_bytes > 0) {
+		failure = ctest_failure_create(child->consumer.stage, "memory limit of %.1f MiB exceeded (peak %.1f MiB); killed", NULL, NULL,
+		                               mib__(limits->memory_bytes), mib__(stats->peak_memory_bytes));
+	} else if (stats->oom_kill_count > 0) {
+		failure = ctest_failure_create(child->consumer.stage, "out of memory (peak %.1f MiB); killed", NULL, NULL,
+		                               mib__(stats->peak_memory_bytes));
+	} else if (cpu_limit_ns > 0 && ((WIFSIGNALED(child_result) && WTERMSIG(child_result) == SIGXCPU) || cpu_used_ns >= cpu_limit_ns)) {
+		failure = ctest_failure_create(child->consumer.stage, "CPU time limit of %.0fs exceeded (used %.1fs); killed", NULL, NULL,
+		                               cpu_limit_ns / 1e9, cpu_used_ns / 1e9);
+	} else if (stats->process_max_count > 0) {
+		failure = ctest_failure_create(child->consumer.stage, "process limit of %u reached", NULL, NULL, limits->process_count);
+	} else {
+		return;
+	}
+	ctest_result_set_failure(result, CTEST_RESULT_LIMIT_EXCEEDED, failure);
+}
 
-	if ((result = ctest_result_create_empty()) == NULL)
-		goto result_creation_failed;
+/**
+ * Reap a child whose pipes have been closed, completing its job (if any).
+ *
+ * @param child   The child to reap.
+ * @param failure If not <code>NULL</code>, the child is forcibly killed and
+ *                its job completed with an error describing this failure
+ *                instead of the child's own result.
+ */
+static void child_reap__(child_t__ *child, ctest_failure_t *failure)
+{
+	runner_job_t *const job = child->job;
+	ctest_result_t *const result = child->result;
+	cgroup_stats_t stats;
+	int child_result;
+	pid_t wait_result;
 
-	ctest_testcase_reporter_start(reporter);
+	child_unwatch__(child);
+	if (failure != NULL && !child->exited) {
+		/* Failed to read from the child; just kill it. */
+		child_signal__(child, SIGKILL);
+	}
+	if (child->request_fd >= 0)
+		(void)close(child->request_fd);
 
-	if (pipe(hooks_pipe) != 0) {
-		ctest_failure_t *const failure = ctest_failure_create(CTEST_STAGE_SETUP, "unable to create result pipe: %s", NULL, NULL, strerror(errno));
-		retval = ctest_result_set_failure(result, CTEST_RESULT_ERROR, failure);
-		goto hooks_pipe_failed;
+	if (child->exited) {
+		wait_result = child->pid;
+		child_result = child->status;
+	} else {
+		/* A child that outlives its time limit is killed by the
+		 * watchdog, so this doesn't wait forever. */
+		while ((wait_result = wait4(child->pid, &child_result, 0, &child->rusage)) < 0 && errno == EINTR)
+			;
 	}
-	if (pipe(output_pipe) != 0) {
-		ctest_failure_t *const failure = ctest_failure_create(CTEST_STAGE_SETUP, "unable to create output pipe: %s", NULL, NULL, strerror(errno));
-		retval = ctest_result_set_failure(result, CTEST_RESULT_ERROR, failure);
-		goto output_pipe_failed;
+
+	memset(&stats, 0, sizeof(stats));
+	if (child->cgroup.name[0] != '\0') {
+		cgroup_get_stats(child->cgroup_root, &child->cgroup, &stats);
+		cgroup_remove(child->cgroup_root, &child->cgroup);
+	}
+	/* A child that ran other jobs before this one peaked at the most any
+	 * of them used; that's no measure of this job. */
+	if (job != NULL && child->measure_memory && child->job_count == 1) {
+		const uint64_t maxrss_bytes = (uint64_t)child->rusage.ru_maxrss * 1024u;
+		const uint64_t page_bytes = (uint64_t)sysconf(_SC_PAGESIZE);
+
+		/* The inherited memory is only an estimate; a job that seems
+		 * to have used none of its own still used a page, rather than
+		 * go unmeasured (and be expected to use as much as any). */
+		if (stats.peak_memory_bytes > 0)
+			result->peak_memory_bytes = stats.peak_memory_bytes;
+		else if (maxrss_bytes > child->inherited_bytes + page_bytes)
+			result->peak_memory_bytes = maxrss_bytes - child->inherited_bytes;
+		else
+			result->peak_memory_bytes = page_bytes;
 	}
 
-	pid_t pid = fork();
-	if (pid < 0) {
-		ctest_failure_t *const failure = ctest_failure_create(CTEST_STAGE_SETUP, "unable to fork child process: %s", NULL, NULL, strerror(errno));
-		retval = ctest_result_set_failure(result, CTEST_RESULT_ERROR, failure);
-		goto fork_failed;
-	} else if (pid != 0) {
-		/* Parent */
-		const int hooks_fd = hooks_pipe[0];
-		const int output_fd = output_pipe[0];
+	if (job == NULL) {
+		/* An idle child; there's nothing to report. */
+		if (failure != NULL)
+			ctest_failure_destroy(failure);
+	} else if (failure != NULL) {
+		ctest_result_set_failure(result, CTEST_RESULT_ERROR, failure);
+	} else if (child->cancelled) {
+		failure = ctest_failure_create(child->timeout_stage, "run cancelled; %s", NULL, NULL,
+		                               child->watchdog_signal == SIGTERM ? "terminated" : "killed");
+		ctest_result_set_failure(result, CTEST_RESULT_CANCELLED, failure);
+	} else if (child->watchdog_signal != 0) {
+		/* Whatever the child did after it ran out of time (e.g., fail
+		 * on the signal) doesn't matter. */
+		failure = ctest_failure_create(child->timeout_stage, "time limit of %.3fs exceeded; %s", NULL, NULL,
+		                               child->timeout_ns / 1e9, child->watchdog_signal == SIGTERM ? "terminated" : "killed");
+		ctest_result_set_failure(result, CTEST_RESULT_TIMEOUT, failure);
+	} else if (wait_result < 0) {
+		failure = ctest_failure_create(child->consumer.stage, "error waiting for child: %s", NULL, NULL, strerror(errno));
+		ctest_result_set_failure(result, CTEST_RESULT_ERROR, failure);
+	} else if (wait_result != child->pid) {
+		failure = ctest_failure_create(child->consumer.stage, "unexpected pid waited: %ji (expecting %ji)", NULL, NULL, (intmax_t) wait_result, (intmax_t) child->pid);
+		ctest_result_set_failure(result, CTEST_RESULT_ERROR, failure);
+	} else {
+		child_set_result__(child, result, child_result);
+		child_check_limits__(child, result, child_result, &stats);
+	}
+	if (job != NULL)
+		ctest_result_set_output(result, output_reader_build(&child->output_reader));
+
+	exec_event_reader_destroy(&child->event_reader);
+	child_event_consumer_destroy__(&child->consumer);
+	output_reader_destroy(&child->output_reader);
+	memset(child, 0, sizeof(*child));
+	child->request_fd = -1;
 
-		/* Close the write end of the pipe; this ensures we get notified
-		 * when the child exist. */
-		(void)close(hooks_pipe[1]);
-		(void)close(output_pipe[1]);
+	if (job != NULL)
+		runner_job_complete(job, result);
+}
+
+/**
+ * Complete the job of a pooled child that has reported the completion of its
+ * test case; the child remains available for the next job.
+ *
+ * @param child The child whose job has completed.
+ */
+static void child_complete_job__(child_t__ *child)
+{
+	child_event_consumer_t__ *const consumer = &child->consumer;
+	runner_job_t *const job = child->job;
+	ctest_result_t *const result = child->result;
 
-		retval = wait_for_child__(result, pid, hooks_fd, output_fd);
+	/* Everything the test case wrote was flushed before its completion
+	 * was reported; collect it before the next test case starts. */
+	(void)output_reader_drain(&child->output_reader);
 
-		ctest_testcase_reporter_complete(reporter, result);
-		return retval;
+	if (consumer->result_type == CTEST_RESULT_PASS) {
+		ctest_result_set_failure(result, CTEST_RESULT_PASS, NULL);
 	} else {
-		/* Child */
-		exec_hooks_t__ exec_hooks;
-		const int hooks_fd = hooks_pipe[1];
-		const int output_fd = output_pipe[1];
-		int stdin_new;
+		ctest_result_set_failure(result, consumer->result_type, consumer->last_failure);
+		consumer->last_failure = NULL;
+	}
+	ctest_result_set_output(result, output_reader_build(&child->output_reader));
+	child_event_consumer_reset__(consumer);
+	child->job = NULL;
+	child->result = NULL;
+	child->deadline_ns = 0;
 
-		/* Open up a replacement for stdin */
-		stdin_new = open("/dev/null", O_RDONLY);
+	runner_job_complete(job, result);
+}
 
-		/* Close the read end of the pipe; this ensures we get notified
-		 * when the parent dies. */
-		(void)close(hooks_pipe[0]);
-		(void)close(output_pipe[0]);
+/**
+ * Wait for a child whose pidfd reports that it has exited.
+ */
+static void child_on_exit__(child_t__ *child)
+{
+	pid_t wait_result;
 
-		/* Redirect stdin/stderr/stdout. */
-		fflush(stdout);
-		fflush(stderr);
-		(void)close(STDIN_FILENO);
-		(void)close(STDOUT_FILENO);
-		(void)close(STDERR_FILENO);
-		dup2(stdin_new, STDIN_FILENO);
-		dup2(output_fd, STDOUT_FILENO);
-		dup2(output_fd, STDERR_FILENO);
-		(void)close(stdin_new);
-		(void)close(output_fd);
+	while ((wait_result = wait4(child->pid, &child->status, WNOHANG, &child->rusage)) < 0 && errno == EINTR)
+		;
+	if (wait_result == 0) {
+		/* Not quite gone yet; keep watching. */
+		return;
+	}
+	/* On error, the child is waited for (again) when it is reaped,
+	 * reporting the error. */
+	child->exited = wait_result == child->pid;
+	poll_source_close__(&child->exit_source);
+}
 
-		exec_hooks_init__(&exec_hooks, hooks_fd);
-		sigcapture__(&exec_hooks_on_signal__, &exec_hooks);
-		ctest_testcase_execute(testcase, &exec_hooks.base);
-		sigrestore__();
+/**
+ * Complete the job of a child, or reap it, once it is done with it.
+ */
+static void child_update__(child_t__ *child)
+{
+	/* A pooled child is done with its test case, but lives on (unless it
+	 * ran out of time first). */
+	if (child->job != NULL && child->consumer.completed && child->watchdog_signal == 0)
+		child_complete_job__(child);
+
+	if (child->event_source.open || child->output_source.open)
+		return;
+
+	/* No pipes are still open, so nothing is left to consume. The child has
+	 * usually exited by now; rather than waiting for its pidfd to report as
+	 * much, check right away. With a pidfd still open, the child is known
+	 * to still be running, so reaping it would block. */
+	if (child->exit_source.open)
+		child_on_exit__(child);
+	if (!child->exit_source.open)
+		child_reap__(child, NULL);
+}
 
-		exec_hooks_destroy__(&exec_hooks);
-		exit_child__(CTEST_RESULT_PASS);
+static int poll_source_op_on_data_available__(poll_handler_t *handler)
+{
+	poll_source_t__ *const source = containerof(handler, poll_source_t__, base);
+	child_t__ *const child = source->child;
+	int rc = 0;
+
+	if (source->handler == NULL) {
+		child_on_exit__(child);
+	} else if ((rc = poll_handler_on_data_available(source->handler)) < 0) {
+		ctest_failure_t *const failure = ctest_failure_create(child->consumer.stage, "consumption of %s from child failed: %s", NULL, NULL, source->name, strerror(errno));
+		child_reap__(child, failure);
+		return rc;
+	} else if (rc == 0) {
+		/* Pipe has been closed and all the data has been drained. */
+		poll_source_close__(source);
+		poll_handler_on_close(source->handler);
 	}
 
-fork_failed:
-	(void)close(output_pipe[0]);
-	(void)close(output_pipe[1]);
-output_pipe_failed:
-	(void)close(hooks_pipe[0]);
-	(void)close(hooks_pipe[1]);
-hooks_pipe_failed:
-	ctest_testcase_reporter_complete(reporter, result);
-result_creation_failed:
-	return retval;
+	child_update__(child);
+	return rc;
 }
 
-CTEST_ALL_NONNULL_ARGS__
-static int runner_op_run_testsuites__(ctest_runner_t *runner, ctest_reporter_t *reporter, ctest_testsuite_t *const* testsuites, size_t testsuite_count)
+static void poll_source_op_on_close__(poll_handler_t *unused(handler))
 {
-	return runner_run_testsuites(runner, reporter, testsuites, testsuite_count, &runner_run_testcase__);
 }
 
-CTEST_ALL_NONNULL_ARGS__
-static int runner_op_run_tests__(ctest_runner_t *runner, ctest_reporter_t *reporter, ctest_test_t *const*tests, size_t test_count)
+static void poll_source_init__(poll_source_t__ *source, const char *name, child_t__ *child, poll_handler_t *handler, int fd)
 {
-	return runner_run_tests(runner, reporter, tests, test_count, &runner_run_testcase__);
+	static poll_handler_ops_t ops = {
+		&poll_source_op_on_data_available__,
+		&poll_source_op_on_close__,
+	};
+
+	source->base.ops = &ops;
+	source->name = name;
+	source->child = child;
+	source->handler = handler;
+	source->fd = fd;
+	source->open = false;
 }
 
-CTEST_ALL_NONNULL_ARGS__
-static int runner_op_run_testcases__(ctest_runner_t *runner, ctest_reporter_t *reporter, ctest_testcase_t *const*testcases, size_t testcase_count)
+/**
+ * Act on a child whose deadline has passed: terminate it, kill it if it
+ * ignored being terminated, or reap it if it is still around after that.
+ *
+ * @param child  The child that has run out of time.
+ * @param now_ns The current time (in nanoseconds, on the monotonic clock).
+ */
+static void child_on_deadline__(child_t__ *child, uint64_t now_ns)
 {
-	return runner_run_testcases(runner, reporter, testcases, testcase_count, &runner_run_testcase__);
+	switch (child->watchdog_signal) {
+	case 0:
+		child->timeout_stage = child->consumer.stage;
+		child->watchdog_signal = SIGTERM;
+		child->deadline_ns = now_ns + WATCHDOG_KILL_DELAY_NS__;
+		child_signal__(child, SIGTERM);
+		break;
+	case SIGTERM:
+		child->watchdog_signal = SIGKILL;
+		child->deadline_ns = now_ns + WATCHDOG_KILL_DELAY_NS__;
+		child_signal__(child, SIGKILL);
+		break;
+	default:
+		child_reap__(child, NULL);
+		break;
+	}
 }
 
-CTEST_ALL_NONNULL_ARGS__
-static void runner_op_destroy__(ctest_runner_t *ctest_runner)
+/**
+ * Send a test case to a pooled child.
+ *
+ * Since every child is forked (directly or from the zygote) after the test
+ * suites are loaded, the test case's address is valid in the child.
+ *
+ * @return Zero on success, non-zero on failure.
+ */
+static int child_send_testcase__(child_t__ *child, ctest_testcase_t *testcase)
 {
-	forking_runner_t__ *const runner = upcast_from_ctest_runner__(ctest_runner);
-	memset(runner, 0, sizeof(*runner));
-	(void)free(runner);
+	ssize_t rc;
+
+	while ((rc = send(child->request_fd, &testcase, sizeof(testcase), MSG_NOSIGNAL)) < 0 && errno == EINTR)
+		;
+	if (rc >= 0 && (size_t)rc != sizeof(testcase))
+		errno = EPIPE;
+	return rc == (ssize_t)sizeof(testcase) ? 0 : -1;
 }
 
-ctest_runner_t *ctest_create_forking_runner(void)
+/**
+ * Move the (newly started) child process into a process group of its own, so
+ * the watchdog can signal it along with any process it starts, and have it
+ * killed if the runner goes away.
+ */
+static void child_enter_process_group__(void)
 {
-	static ctest_runner_ops_t ops = {
-		&runner_op_run_testsuites__,
-		&runner_op_run_tests__,
-		&runner_op_run_testcases__,
-		&runner_op_destroy__
-	};
+	(void)setpgid(0, 0);
+	(void)prctl(PR_SET_PDEATHSIG, SIGKILL);
+}
 
-	forking_runner_t__ *runner;
+/**
+ * Restrict the (newly started) child process to a single CPU.
+ */
+static void child_pin__(int cpu)
+{
+	cpu_set_t cpus;
 
-	if ((runner = calloc(1, sizeof(*runner))) == NULL)
-		goto alloc_runner_failed;
+	CPU_ZERO(&cpus);
+	CPU_SET(cpu, &cpus);
+	(void)sched_setaffinity(0, sizeof(cpus), &cpus);
+}
 
-	runner->base.ops = &ops;
-	return &runner->base;
+/**
+ * Redirect the standard streams of the (newly forked) child process.
+ *
+ * @param output_fd The write end of the pipe for sending output (stdout and
+ *                  stderr) to the parent. This is closed once redirected.
+ */
+static void child_redirect__(int output_fd)
+{
+	int stdin_new;
+
+	/* Open up a replacement for stdin */
+	stdin_new = open("/dev/null", O_RDONLY);
+
+	/* Redirect stdin/stderr/stdout. */
+	fflush(stdout);
+	fflush(stderr);
+	(void)close(STDIN_FILENO);
+	(void)close(STDOUT_FILENO);
+	(void)close(STDERR_FILENO);
+	dup2(stdin_new, STDIN_FILENO);
+	dup2(output_fd, STDOUT_FILENO);
+	dup2(output_fd, STDERR_FILENO);
+	(void)close(stdin_new);
+	(void)close(output_fd);
+}
 
-alloc_runner_failed:
-	return NULL;
+/**
+ * Lower the soft and hard limits of a resource of the (newly started) child
+ * process, short of raising the hard limit (which takes privileges).
+ *
+ * @return Zero on success, non-zero on failure.
+ */
+static int child_set_rlimit__(int resource, rlim_t soft, rlim_t hard)
+{
+	struct rlimit limit;
+
+	if (getrlimit(resource, &limit) != 0)
+		return -1;
+	limit.rlim_max = limit.rlim_max != RLIM_INFINITY && limit.rlim_max < hard ? limit.rlim_max : hard;
+	limit.rlim_cur = soft < limit.rlim_max ? soft : limit.rlim_max;
+	return setrlimit(resource, &limit);
+}
+
+/**
+ * Report that the (newly started) child process couldn't be readied to run its
+ * test cases, then exit.
+ *
+ * @param hooks The hooks through which to report the failure.
+ * @param what  What couldn't be done.
+ */
+CTEST_NORETURN__
+static void child_abort_setup__(exec_hooks_t__ *hooks, const char *what)
+{
+	ctest_failure_t failure;
+	char description[128];
+
+	memset(&failure, 0, sizeof(failure));
+	failure.stage = CTEST_STAGE_SETUP;
+	failure.description = description;
+	snprintf(description, sizeof(description), "unable to %s: %s", what, strerror(errno));
+
+	exec_event_writer_on_failure(&hooks->writer, &failure);
+	exec_hooks_destroy__(hooks);
+	exit_child__(CTEST_RESULT_ERROR);
+}
+
+/**
+ * Apply the runner's resource limits to the (newly started) child process,
+ * moving it into its cgroup first, if it has one; the limits the cgroup
+ * enforces aren't also set with <code>setrlimit</code>. If the limits can't
+ * be applied, the failure is reported and the child exits.
+ *
+ * @param hooks     The hooks through which to report a failure.
+ * @param limits    The limits to apply.
+ * @param cgroup_fd The <code>cgroup.procs</code> file of the child's cgroup
+ *                  (closed once the child is in it), or <code>-1</code>.
+ */
+static void child_apply_limits__(exec_hooks_t__ *hooks, const ctest_limits_t *limits, int cgroup_fd)
+{
+	const bool in_cgroup = cgroup_fd >= 0;
+	const rlim_t cpu_s = (rlim_t)((limits->cpu_ns + 999999999u) / 1000000000u);
+	const char *what = NULL;
+
+	if (in_cgroup) {
+		if (cgroup_enter(cgroup_fd) != 0)
+			what = "enter cgroup";
+		(void)close(cgroup_fd);
+	}
+	if (what == NULL && !in_cgroup && limits->memory_bytes > 0 &&
+	    child_set_rlimit__(RLIMIT_AS, (rlim_t)limits->memory_bytes, (rlim_t)limits->memory_bytes) != 0)
+		what = "limit address space";
+	/* SIGXCPU at the limit, which the parent recognizes; SIGKILL a second
+	 * later, should the child ignore it. */
+	if (what == NULL && cpu_s > 0 && child_set_rlimit__(RLIMIT_CPU, cpu_s, cpu_s + 1) != 0)
+		what = "limit CPU time";
+	if (what == NULL && limits->fd_count > 0 &&
+	    child_set_rlimit__(RLIMIT_NOFILE, limits->fd_count, limits->fd_count) != 0)
+		what = "limit open files";
+	if (what == NULL && !in_cgroup && limits->process_count > 0 &&
+	    child_set_rlimit__(RLIMIT_NPROC, limits->process_count, limits->process_count) != 0)
+		what = "limit processes";
+	if (what != NULL)
+		child_abort_setup__(hooks, what);
+}
+
+/**
+ * Run a test case in the (newly started) child process.
+ *
+ * @param testcase  The test case to run.
+ * @param hooks_fd  The write end of the pipe for sending execution events to
+ *                  the parent.
+ * @param output_fd The write end of the pipe for sending the test case's
+ *                  output (stdout and stderr) to the parent.
+ * @param limits    The limits on the resources of the child.
+ * @param cgroup_fd The <code>cgroup.procs</code> file of the child's cgroup,
+ *                  or <code>-1</code>.
+ * @param sandbox   Whether to move the child into a sandbox of its own (see
+ *                  <code>ctest_runner_config_t.sandbox</code>).
+ */
+CTEST_NORETURN__
+static void child_run_testcase__(ctest_testcase_t *testcase, int hooks_fd, int output_fd, const ctest_limits_t *limits, int cgroup_fd, bool sandbox)
+{
+	exec_hooks_t__ exec_hooks;
+
+	child_enter_process_group__();
+	child_redirect__(output_fd);
+
+	exec_hooks_init__(&exec_hooks, hooks_fd);
+	child_apply_limits__(&exec_hooks, limits, cgroup_fd);
+	if (sandbox && sandbox_enter() != 0)
+		child_abort_setup__(&exec_hooks, "enter sandbox");
+	sigcapture__(&exec_hooks_on_signal__, &exec_hooks);
+	ctest_testcase_execute(testcase, &exec_hooks.base);
+	sigrestore__();
+
+	exec_hooks_destroy__(&exec_hooks);
+	exit_child__(CTEST_RESULT_PASS);
+}
+
+/**
+ * Execute a test case in a pooled child, recovering when it short-circuits.
+ *
+ * @return The type of result of the test case.
+ */
+static ctest_result_type_t child_execute_testcase__(exec_hooks_t__ *exec_hooks, ctest_testcase_t *testcase)
+{
+	sigjmp_buf env;
+
+	exec_hooks->env = &env;
+	exec_hooks->stage = CTEST_STAGE_SETUP;
+	if (sigsetjmp(env, 1) != 0) {
+		exec_hooks->env = NULL;
+		return exec_hooks->result_type;
+	}
+	ctest_testcase_execute(testcase, &exec_hooks->base);
+	exec_hooks->env = NULL;
+	return CTEST_RESULT_PASS;
+}
+
+/**
+ * Run the test cases received from the parent, back to back, in a pooled child
+ * process, until the parent closes the request socket.
+ *
+ * Failures (and skips) are recovered from, so the child survives them; a
+ * caught signal ends the child, like it would a child running a single test
+ * case, and the parent replaces it.
+ *
+ * @param request_fd The socket on which test cases are received.
+ * @param hooks_fd   The write end of the pipe for sending execution events to
+ *                   the parent.
+ * @param output_fd  The write end of the pipe for sending the test cases'
+ *                   output (stdout and stderr) to the parent.
+ * @param limits     The limits on the resources of the child.
+ * @param cgroup_fd  The <code>cgroup.procs</code> file of the child's cgroup,
+ *                   or <code>-1</code>.
+ * @param sandbox    Whether to move the child into a sandbox of its own,
+ *                   which its test cases share.
+ */
+CTEST_NORETURN__
+static void child_serve_testcases__(int request_fd, int hooks_fd, int output_fd, const ctest_limits_t *limits, int cgroup_fd, bool sandbox)
+{
+	exec_hooks_t__ exec_hooks;
+	ctest_testcase_t *testcase;
+	ssize_t rc;
+
+	child_enter_process_group__();
+	child_redirect__(output_fd);
+
+	exec_hooks_init__(&exec_hooks, hooks_fd);
+	child_apply_limits__(&exec_hooks, limits, cgroup_fd);
+	if (sandbox && sandbox_enter() != 0)
+		child_abort_setup__(&exec_hooks, "enter sandbox");
+	sigcapture__(&exec_hooks_on_signal__, &exec_hooks);
+	while (1) {
+		ctest_result_type_t result_type;
+
+		while ((rc = recv(request_fd, &testcase, sizeof(testcase), MSG_WAITALL)) < 0 && errno == EINTR)
+			;
+		if (rc != (ssize_t)sizeof(testcase))
+			break;
+
+		result_type = child_execute_testcase__(&exec_hooks, testcase);
+
+		/* Flush the output of the test case before reporting its
+		 * completion, so the parent gets all of it. */
+		fflush(stdout);
+		fflush(stderr);
+		exec_event_writer_on_complete(&exec_hooks.writer, result_type);
+	}
+	sigrestore__();
+
+	(void)close(request_fd);
+	exec_hooks_destroy__(&exec_hooks);
+	exit_child__(CTEST_RESULT_PASS);
+}
+
+/*
+ * Worker
+ */
+
+/**
+ * The path of the installed <code>ctest-worker</code> helper.
+ */
+#ifndef CTEST_WORKER_PATH
+#define CTEST_WORKER_PATH "ctest-worker"
+#endif
+
+extern char **environ;
+
+/**
+ * Determine how a worker can find a test case: the module file of its suite
+ * and its position within the suite.
+ *
+ * @return Zero on success, non-zero if the test case can't be run by a worker.
+ */
+CTEST_ALL_NONNULL_ARGS__
+static int locate_testcase__(ctest_testcase_t *testcase, const char **p_filename, size_t *p_index)
+{
+	ctest_test_t *const test = ctest_testcase_get_test(testcase);
+	ctest_testsuite_t *const testsuite = ctest_test_get_testsuite(test);
+	ctest_test_t *const*const tests = ctest_testsuite_get_tests(testsuite);
+	const size_t test_count = ctest_testsuite_get_test_count(testsuite);
+	size_t i, index = 0;
+
+	if ((*p_filename = ctest_testsuite_get_filename(testsuite)) == NULL)
+		return -1;
+
+	for (i = 0; i < test_count && tests[i] != test; ++i)
+		index += ctest_test_get_testcase_count(tests[i]);
+	if (i < test_count) {
+		ctest_testcase_t *const*const testcases = ctest_test_get_testcases(test);
+		const size_t testcase_count = ctest_test_get_testcase_count(test);
+		for (i = 0; i < testcase_count; ++i, ++index) {
+			if (testcases[i] == testcase) {
+				*p_index = index;
+				return 0;
+			}
+		}
+	}
+
+	return -1;
+}
+
+/**
+ * Spawn a worker to run a test case.
+ *
+ * @param worker_path The path of the <code>ctest-worker</code> helper.
+ * @param testcase    The test case for the worker to run.
+ * @param hooks_fd    The write end of the pipe for sending execution events to
+ *                    the parent.
+ * @param output_fd   The write end of the pipe for sending the test case's
+ *                    output to the parent.
+ * @param limits      The limits on the resources of the worker.
+ * @param cgroup_fd   The <code>cgroup.procs</code> file of the worker's
+ *                    cgroup, or <code>-1</code>.
+ * @param cpu         The CPU to which to restrict the worker, or
+ *                    <code>-1</code>.
+ * @param sandbox     Whether the worker moves into a sandbox of its own.
+ *
+ * The worker shares the pool of ports of the run, if there is one.
+ *
+ * @return The PID of the worker, or <code>-1</code> on failure.
+ */
+CTEST_ALL_NONNULL_ARGS__
+static pid_t spawn_worker__(const char *worker_path, ctest_testcase_t *testcase, int hooks_fd, int output_fd, const ctest_limits_t *limits, int cgroup_fd, int cpu, bool sandbox)
+{
+	posix_spawn_file_actions_t actions;
+	posix_spawnattr_t attr;
+	char hooks_fd_arg[16];
+	char index_arg[32];
+	char option_args[7][32];
+	char *argv[21];
+	const char *filename;
+	const int ports_fd = ports_get_fd();
+	size_t index, argc = 0, option_count = 0;
+	pid_t pid;
+	int rc;
+
+	if (locate_testcase__(testcase, &filename, &index) != 0) {
+		errno = ENOTSUP;
+		return -1;
+	}
+	snprintf(hooks_fd_arg, sizeof(hooks_fd_arg), "%d", hooks_fd);
+	snprintf(index_arg, sizeof(index_arg), "%zu", index);
+	argv[argc++] = (char *)worker_path;
+	if (limits->memory_bytes > 0) {
+		snprintf(option_args[option_count], sizeof(option_args[0]), "%" PRIu64, limits->memory_bytes);
+		argv[argc++] = "-m";
+		argv[argc++] = option_args[option_count++];
+	}
+	if (limits->cpu_ns > 0) {
+		snprintf(option_args[option_count], sizeof(option_args[0]), "%" PRIu64, limits->cpu_ns);
+		argv[argc++] = "-t";
+		argv[argc++] = option_args[option_count++];
+	}
+	if (limits->fd_count > 0) {
+		snprintf(option_args[option_count], sizeof(option_args[0]), "%u", limits->fd_count);
+		argv[argc++] = "-f";
+		argv[argc++] = option_args[option_count++];
+	}
+	if (limits->process_count > 0) {
+		snprintf(option_args[option_count], sizeof(option_args[0]), "%u", limits->process_count);
+		argv[argc++] = "-p";
+		argv[argc++] = option_args[option_count++];
+	}
+	if (cgroup_fd >= 0) {
+		snprintf(option_args[option_count], sizeof(option_args[0]), "%d", cgroup_fd);
+		argv[argc++] = "-c";
+		argv[argc++] = option_args[option_count++];
+	}
+	if (cpu >= 0) {
+		snprintf(option_args[option_count], sizeof(option_args[0]), "%d", cpu);
+		argv[argc++] = "-a";
+		argv[argc++] = option_args[option_count++];
+	}
+	if (ports_fd >= 0) {
+		snprintf(option_args[option_count], sizeof(option_args[0]), "%d", ports_fd);
+		argv[argc++] = "-l";
+		argv[argc++] = option_args[option_count++];
+	}
+	if (sandbox)
+		argv[argc++] = "-s";
+	argv[argc++] = hooks_fd_arg;
+	argv[argc++] = (char *)filename;
+	argv[argc++] = index_arg;
+	argv[argc] = NULL;
+
+	if ((rc = posix_spawn_file_actions_init(&actions)) != 0)
+		goto actions_init_failed;
+	if ((rc = posix_spawn_file_actions_addopen(&actions, STDIN_FILENO, "/dev/null", O_RDONLY, 0)) != 0 ||
+	    (rc = posix_spawn_file_actions_adddup2(&actions, output_fd, STDOUT_FILENO)) != 0 ||
+	    (rc = posix_spawn_file_actions_adddup2(&actions, output_fd, STDERR_FILENO)) != 0)
+		goto actions_failed;
+
+	/* Start the worker in a process group of its own, like a forked
+	 * child. */
+	if ((rc = posix_spawnattr_init(&attr)) != 0)
+		goto actions_failed;
+	if ((rc = posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETPGROUP)) != 0 ||
+	    (rc = posix_spawnattr_setpgroup(&attr, 0)) != 0)
+		goto attr_failed;
+
+	/* Every other descriptor of ours is close-on-exec; the hooks pipe
+	 * (and cgroup and pool of ports) are the only ones the worker
+	 * inherits as is. */
+	(void)fcntl(hooks_fd, F_SETFD, 0);
+	if (cgroup_fd >= 0)
+		(void)fcntl(cgroup_fd, F_SETFD, 0);
+	if (ports_fd >= 0)
+		(void)fcntl(ports_fd, F_SETFD, 0);
+	rc = posix_spawn(&pid, worker_path, &actions, &attr, argv, environ);
+	(void)fcntl(hooks_fd, F_SETFD, FD_CLOEXEC);
+	if (cgroup_fd >= 0)
+		(void)fcntl(cgroup_fd, F_SETFD, FD_CLOEXEC);
+	if (ports_fd >= 0)
+		(void)fcntl(ports_fd, F_SETFD, FD_CLOEXEC);
+
+attr_failed:
+	posix_spawnattr_destroy(&attr);
+actions_failed:
+	posix_spawn_file_actions_destroy(&actions);
+actions_init_failed:
+	if (rc != 0) {
+		errno = rc;
+		return -1;
+	}
+	return pid;
+}
+
+/**
+ * Report a failure from a worker that couldn't run its test case, then exit.
+ */
+CTEST_NORETURN__ CTEST_PRINTF__(2, 3)
+static void worker_abort__(int hooks_fd, const char *fmt, ...)
+{
+	exec_event_writer_t writer;
+	ctest_failure_t *failure;
+	char description[256];
+	va_list args;
+
+	va_start(args, fmt);
+	vsnprintf(description, sizeof(description), fmt, args);
+	va_end(args);
+
+	if (hooks_fd >= 0) {
+		exec_event_writer_init(&writer, hooks_fd);
+		if ((failure = ctest_failure_create(CTEST_STAGE_SETUP, "%s", NULL, NULL, description)) != NULL) {
+			exec_event_writer_on_failure(&writer, failure);
+			ctest_failure_destroy(failure);
+		}
+		exec_event_writer_destroy(&writer);
+	} else {
+		fprintf(stderr, "%s\n", description);
+	}
+	exit_child__(CTEST_RESULT_ERROR);
+}
+
+/**
+ * Parse a numeric argument of a worker.
+ *
+ * @return Zero on success, non-zero if <code>arg</code> isn't a number no
+ *         greater than <code>max</code>.
+ */
+static int parse_worker_number__(const char *arg, uint64_t max, uint64_t *p_value)
+{
+	unsigned long long value;
+	char *end;
+
+	errno = 0;
+	value = strtoull(arg, &end, 10);
+	if (errno != 0 || end == arg || *end != '\0' || *arg == '-' || value > max)
+		return -1;
+	*p_value = value;
+	return 0;
+}
+
+CTEST_ALL_NONNULL_ARGS__
+int ctest_worker_main(int argc, char *argv[])
+{
+	ctest_testsuite_t *testsuite;
+	ctest_test_t *const*tests;
+	ctest_limits_t limits;
+	const char *suite_arg, *index_arg;
+	size_t i, test_count;
+	uint64_t hooks_fd, index, value;
+	int output_fd, cgroup_fd = -1, ports_fd = -1, opt;
+	bool sandbox = false;
+
+	memset(&limits, 0, sizeof(limits));
+	optind = 1;
+	while ((opt = getopt(argc, argv, "+m:t:f:p:c:a:l:s")) != -1) {
+		int rc = -1;
+		switch (opt) {
+		case 'm':
+			rc = parse_worker_number__(optarg, UINT64_MAX, &limits.memory_bytes);
+			break;
+		case 't':
+			rc = parse_worker_number__(optarg, UINT64_MAX, &limits.cpu_ns);
+			break;
+		case 'f':
+			if ((rc = parse_worker_number__(optarg, UINT_MAX, &value)) == 0)
+				limits.fd_count = (unsigned int)value;
+			break;
+		case 'p':
+			if ((rc = parse_worker_number__(optarg, UINT_MAX, &value)) == 0)
+				limits.process_count = (unsigned int)value;
+			break;
+		case 'c':
+			if ((rc = parse_worker_number__(optarg, INT_MAX, &value)) == 0)
+				cgroup_fd = (int)value;
+			break;
+		case 'a':
+			/* Before loading anything, so it all ends up near the
+			 * CPU. */
+			if ((rc = parse_worker_number__(optarg, CPU_SETSIZE - 1, &value)) == 0)
+				child_pin__((int)value);
+			break;
+		case 'l':
+			if ((rc = parse_worker_number__(optarg, INT_MAX, &value)) == 0)
+				ports_fd = (int)value;
+			break;
+		case 's':
+			sandbox = true;
+			rc = 0;
+			break;
+		}
+		if (rc != 0)
+			goto usage;
+	}
+	if (argc - optind != 3)
+		goto usage;
+	suite_arg = argv[optind + 1];
+	index_arg = argv[optind + 2];
+
+	if (parse_worker_number__(argv[optind], INT_MAX, &hooks_fd) != 0)
+		worker_abort__(-1, "%s: invalid events descriptor: %s", argv[0], argv[optind]);
+	(void)fcntl((int)hooks_fd, F_SETFD, FD_CLOEXEC);
+	if (cgroup_fd >= 0)
+		(void)fcntl(cgroup_fd, F_SETFD, FD_CLOEXEC);
+
+	if (parse_worker_number__(index_arg, SIZE_MAX, &index) != 0)
+		worker_abort__((int)hooks_fd, "invalid test case index: %s", index_arg);
+	if (ports_fd >= 0 && ports_attach(ports_fd) != 0)
+		worker_abort__((int)hooks_fd, "unable to share the pool of ports: %s", strerror(errno));
+
+	if ((testsuite = ctest_load_testsuite(suite_arg)) == NULL)
+		worker_abort__((int)hooks_fd, "unable to load suite from %s", suite_arg);
+
+	tests = ctest_testsuite_get_tests(testsuite);
+	test_count = ctest_testsuite_get_test_count(testsuite);
+	for (i = 0; i < test_count; ++i) {
+		const size_t testcase_count = ctest_test_get_testcase_count(tests[i]);
+		if (index < testcase_count)
+			break;
+		index -= testcase_count;
+	}
+	if (i == test_count)
+		worker_abort__((int)hooks_fd, "no test case at index %s in %s", index_arg, suite_arg);
+
+	/* The output pipe is already our stdout, but the test case gets its
+	 * own copy, just like a forked child. */
+	if ((output_fd = dup(STDOUT_FILENO)) < 0)
+		worker_abort__((int)hooks_fd, "unable to duplicate output: %s", strerror(errno));
+	child_run_testcase__(ctest_test_get_testcases(tests[i])[index], (int)hooks_fd, output_fd, &limits, cgroup_fd, sandbox);
+
+usage:
+	fprintf(stderr, "usage: %s [-m memory-bytes] [-t cpu-ns] [-f fds] [-p processes] [-c cgroup-fd] [-a cpu] [-l ports-fd] [-s] events-fd suite index\n", argv[0]);
+	return CTEST_RESULT_ERROR;
+}
+
+/*
+ * Runner
+ */
+
+/**
+ * A <code>ctest_runner_t</code> implementation that runs all tests isolated
+ * in its own address space (by forking off and running the tests in a child).
+ *
+ * Up to <code>jobs</code> children are run concurrently; the runner is also a
+ * <code>runner_executor_t</code>, with each child occupying one slot.
+ */
+typedef struct forking_runner__ forking_runner_t__;
+struct forking_runner__ {
+	ctest_runner_t base;
+	runner_executor_t executor;
+	ctest_runner_config_t config;
+
+	/**
+	 * The child slots, one for each concurrently running test case.
+	 */
+	child_t__ *children;
+	size_t child_count;
+
+	/**
+	 * The zygote from which children are forked, if enabled; only running
+	 * for the duration of a run.
+	 */
+	zygote_t zygote;
+
+	/**
+	 * The reactor driving the children: their pipes and pidfds, along with
+	 * the watchdog.
+	 */
+	reactor_t reactor;
+
+	/**
+	 * The watchdog timer (a <code>timerfd</code>), and the deadline for
+	 * which it is armed (zero if disarmed). It is armed for the earliest
+	 * deadline of any child, but only rearmed when it fires or an earlier
+	 * deadline is set, so it may fire early.
+	 */
+	int watchdog_fd;
+	poll_handler_t watchdog_handler;
+	uint64_t watchdog_armed_ns;
+
+	/**
+	 * Watches the cancellation token (if any) during a run, so a request
+	 * to cancel it interrupts the wait for children.
+	 */
+	poll_handler_t cancel_handler;
+	bool cancel_watched;
+
+	/**
+	 * The delegated cgroup directory in which a cgroup is created for each
+	 * child, if configured; only open for the duration of a run.
+	 */
+	cgroup_root_t cgroup_root;
+
+	/**
+	 * The hosts of the shared fixtures in use, started as the first test
+	 * case using each fixture is, and stopped once the last one is done
+	 * (or at the end of the run).
+	 */
+	fixture_host_t__ *hosts;
+
+	/**
+	 * With <code>CTEST_ISOLATION_AUTO</code>, the direct runner with which
+	 * test cases are run within the runner's process, and the suites in
+	 * which a test case has crashed doing so during the run (whose other
+	 * test cases are run in children from then on).
+	 */
+	ctest_runner_t *direct;
+	ctest_testsuite_t **crashed;
+	size_t crashed_count;
+};
+
+/*
+ * Shared Fixtures
+ */
+
+typedef enum fixture_host_state__ fixture_host_state_t__;
+enum fixture_host_state__ {
+	FIXTURE_HOST_SETTING_UP,
+	FIXTURE_HOST_READY,
+	FIXTURE_HOST_FAILED,
+};
+
+/**
+ * The host of a shared fixture: a zygote, forked from the runner, that sets up
+ * the fixture before serving any request, so every child spawned from it
+ * starts with the fixture set up (sharing its memory, copy-on-write), and
+ * tears the fixture down once stopped.
+ *
+ * The host sets up the fixture while the runner goes on with other jobs; the
+ * jobs using the fixture wait in their child slots until it is done.
+ */
+struct fixture_host__ {
+	forking_runner_t__ *runner;
+	ctest_fixture_t *fixture;
+	fixture_host_t__ *next;
+	fixture_host_state_t__ state;
+	zygote_t zygote;
+
+	/**
+	 * The pipe on which the host reports setting up (and tearing down) the
+	 * fixture: the runner reads from the one end, and the host writes to
+	 * the other with its execution hooks.
+	 */
+	int event_fds[2];
+	exec_hooks_t__ hooks;
+	child_event_consumer_t__ consumer;
+	exec_event_reader_t event_reader;
+	poll_handler_t event_handler;
+	bool watched;
+
+	/**
+	 * The (anonymous) file to which the output of the host itself goes,
+	 * or <code>-1</code> once it has been read.
+	 */
+	int output_fd;
+
+	/**
+	 * The time limit for setting up (and tearing down) the fixture, and
+	 * when (on the monotonic clock) setting it up runs out of time, or
+	 * zero.
+	 */
+	uint64_t timeout_ns;
+	uint64_t deadline_ns;
+	bool timed_out;
+
+	/**
+	 * Why setting up the fixture failed, and what the host wrote while
+	 * doing so, both given to every test case using the fixture.
+	 */
+	ctest_result_type_t failure_type;
+	ctest_failure_t *failure;
+	ctest_output_t *output;
+};
+
+static forking_runner_t__ *upcast_from_ctest_runner__(ctest_runner_t *runner)
+{
+	return containerof(runner, forking_runner_t__, base);
+}
+
+static forking_runner_t__ *upcast_from_runner_executor__(runner_executor_t *executor)
+{
+	return containerof(executor, forking_runner_t__, executor);
+}
+
+/**
+ * Run a child spawned from a zygote (or fixture host).
+ *
+ * The child is handed its hooks and output pipes, followed by its request
+ * socket if it is pooled (and has no test case), followed by its cgroup if it
+ * has one.
+ */
+CTEST_NORETURN__
+static void zygote_child_run__(const forking_runner_t__ *runner, void *arg, int *fds, size_t fd_count, bool sandbox)
+{
+	const size_t cgroup_index = arg == NULL ? 3 : 2;
+	const int cgroup_fd = fd_count > cgroup_index ? fds[cgroup_index] : -1;
+
+	if (arg == NULL)
+		child_serve_testcases__(fds[2], fds[0], fds[1], &runner->config.limits, cgroup_fd, sandbox);
+	child_run_testcase__(arg, fds[0], fds[1], &runner->config.limits, cgroup_fd, sandbox);
+}
+
+/**
+ * Entry point of a child spawned from the zygote.
+ */
+CTEST_NORETURN__
+static void zygote_child_main__(void *context, void *arg, int *fds, size_t fd_count)
+{
+	const forking_runner_t__ *const runner = context;
+	zygote_child_run__(runner, arg, fds, fd_count, runner->config.sandbox);
+}
+
+/**
+ * Close, in a newly forked child (or fixture host), the parent's ends of the
+ * other children's pipes and sockets, along with those of the zygote and the
+ * fixture hosts.
+ *
+ * A pooled child holding on to another child's request socket would keep that
+ * child from seeing the end of its requests.
+ */
+CTEST_ALL_NONNULL_ARGS__
+static void runner_close_inherited__(forking_runner_t__ *runner)
+{
+	fixture_host_t__ *host;
+	size_t i;
+
+	for (i = 0; i < runner->child_count; ++i) {
+		child_t__ *const child = runner->children + i;
+		if (child->pid <= 0)
+			continue;
+		(void)close(child->event_reader.fd);
+		(void)close(child->output_reader.fd);
+		if (child->request_fd >= 0)
+			(void)close(child->request_fd);
+		if (child->exit_source.open)
+			(void)close(child->exit_source.fd);
+	}
+	for (host = runner->hosts; host != NULL; host = host->next) {
+		/* Holding on to a host's control socket would keep it from
+		 * ever being stopped. */
+		if (host->zygote.pid > 0)
+			(void)close(host->zygote.control_fd);
+		if (host->event_fds[0] >= 0)
+			(void)close(host->event_fds[0]);
+		if (host->output_fd >= 0)
+			(void)close(host->output_fd);
+	}
+	if (runner->zygote.pid > 0)
+		(void)close(runner->zygote.control_fd);
+	(void)close(runner->watchdog_fd);
+	(void)close(runner->reactor.epoll_fd);
+	if (runner->cgroup_root.dir_fd >= 0)
+		(void)close(runner->cgroup_root.dir_fd);
+}
+
+/**
+ * Get how much anonymous memory a process has resident; a child forked from
+ * it starts out with as much counted toward its resident set.
+ *
+ * @return The size in bytes, or zero if it can't be read.
+ */
+static uint64_t resident_anon_bytes__(pid_t pid)
+{
+	char path[64];
+	unsigned long long resident, shared;
+	uint64_t bytes = 0;
+	FILE *fp;
+
+	if (pid <= 0)
+		return 0;
+	snprintf(path, sizeof(path), "/proc/%jd/statm", (intmax_t)pid);
+	if ((fp = fopen(path, "re")) == NULL)
+		return 0;
+	if (fscanf(fp, "%*u %llu %llu", &resident, &shared) == 2 && resident > shared)
+		bytes = (uint64_t)(resident - shared) * (uint64_t)sysconf(_SC_PAGESIZE);
+	(void)fclose(fp);
+	return bytes;
+}
+
+/**
+ * Create the child process in which to run a test case.
+ *
+ * @param runner       The runner creating the child.
+ * @param host         The fixture host from which to spawn the child, or
+ *                     <code>NULL</code>.
+ * @param testcase     The test case to run in the child, or <code>NULL</code>
+ *                     if the child is pooled.
+ * @param hooks_pipe   The pipe for sending execution events to the parent.
+ * @param output_pipe  The pipe for sending output to the parent.
+ * @param request_pair The socket pair for sending test cases to a pooled child
+ *                     (the parent's end first), or <code>NULL</code>.
+ * @param cgroup_fd    The <code>cgroup.procs</code> file of the child's
+ *                     cgroup, or <code>-1</code>.
+ * @param cpu          The CPU to which to restrict the child, or
+ *                     <code>-1</code>.
+ * @param p_spawn_ns   Updated with the time (in nanoseconds) spent creating the
+ *                     child.
+ *
+ * @return The PID of the child, or <code>-1</code> on failure.
+ */
+CTEST_NONNULL_ARGS__(1, 4, 5, 9)
+static pid_t runner_spawn_child__(forking_runner_t__ *runner, fixture_host_t__ *host, ctest_testcase_t *testcase, int hooks_pipe[2], int output_pipe[2], int *request_pair, int cgroup_fd, int cpu, uint64_t *p_spawn_ns)
+{
+	zygote_t *const zygote = host != NULL ? &host->zygote : &runner->zygote;
+	struct timespec start, end;
+	pid_t pid;
+
+	if (zygote->pid > 0) {
+		int fds[ZYGOTE_MAX_FDS];
+		size_t fd_count = 0;
+
+		fds[fd_count++] = hooks_pipe[1];
+		fds[fd_count++] = output_pipe[1];
+		if (request_pair != NULL)
+			fds[fd_count++] = request_pair[1];
+		if (cgroup_fd >= 0)
+			fds[fd_count++] = cgroup_fd;
+		return zygote_spawn(zygote, testcase, fds, fd_count, cpu, p_spawn_ns);
+	}
+
+	if (runner->config.spawn == CTEST_SPAWN_WORKER) {
+		const char *worker_path = runner->config.worker_path;
+		if (worker_path == NULL && (worker_path = getenv("CTEST_WORKER")) == NULL)
+			worker_path = CTEST_WORKER_PATH;
+
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		pid = spawn_worker__(worker_path, testcase, hooks_pipe[1], output_pipe[1], &runner->config.limits, cgroup_fd, cpu, runner->config.sandbox);
+		clock_gettime(CLOCK_MONOTONIC, &end);
+
+		*p_spawn_ns = (uint64_t)(end.tv_sec - start.tv_sec) * 1000000000u + end.tv_nsec - start.tv_nsec;
+		return pid;
+	}
+
+	/* Don't let the child inherit (and flush a second time) anything
+	 * buffered by the parent. */
+	fflush(stdout);
+	fflush(stderr);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	if ((pid = fork()) == 0) {
+		/* Child: close the read end of the pipe; this ensures we get
+		 * notified when the parent dies. */
+		(void)close(hooks_pipe[0]);
+		(void)close(output_pipe[0]);
+		runner_close_inherited__(runner);
+		if (cpu >= 0)
+			child_pin__(cpu);
+		if (request_pair != NULL) {
+			(void)close(request_pair[0]);
+			child_serve_testcases__(request_pair[1], hooks_pipe[1], output_pipe[1], &runner->config.limits, cgroup_fd, runner->config.sandbox);
+		}
+		child_run_testcase__(testcase, hooks_pipe[1], output_pipe[1], &runner->config.limits, cgroup_fd, runner->config.sandbox);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	/* Also done by the child; whichever comes first keeps the watchdog
+	 * from missing processes the child starts right away. */
+	if (pid > 0)
+		(void)setpgid(pid, pid);
+
+	*p_spawn_ns = (uint64_t)(end.tv_sec - start.tv_sec) * 1000000000u + end.tv_nsec - start.tv_nsec;
+	return pid;
+}
+
+/**
+ * Start a child process in a free child slot.
+ *
+ * @param runner     The runner starting the child.
+ * @param child      The (free) child slot.
+ * @param host       The fixture host from which to spawn the child, or
+ *                   <code>NULL</code>.
+ * @param testcase   The test case to run in the child, or <code>NULL</code> if
+ *                   the child is pooled.
+ * @param p_spawn_ns Updated with the time (in nanoseconds) spent creating the
+ *                   child.
+ *
+ * @return <code>NULL</code> on success, or a failure describing why the child
+ *         couldn't be started.
+ */
+CTEST_NONNULL_ARGS__(1, 2, 5)
+static ctest_failure_t *runner_start_child__(forking_runner_t__ *runner, child_t__ *child, fixture_host_t__ *host, ctest_testcase_t *testcase, uint64_t *p_spawn_ns)
+{
+	ctest_failure_t *failure;
+	int hooks_pipe[2];              /* Pipe for sending hooks notifications to parent. */
+	int output_pipe[2];             /* Pipe for sending test output (stderr/stdout) to parent. */
+	int request_pair[2] = { -1, -1 }; /* Socket for sending test cases to a pooled child. */
+	int cgroup_fd = -1;             /* The cgroup.procs file of the child's cgroup. */
+	const int cpu = runner->config.placement != NULL ? ctest_placement_get_cpu(runner->config.placement, (size_t)(child - runner->children))->id : -1;
+	const bool measure_memory = runner->config.timings != NULL;
+	uint64_t inherited_bytes = 0;
+	size_t i;
+	pid_t pid;
+
+	if (pipe(hooks_pipe) != 0) {
+		failure = ctest_failure_create(CTEST_STAGE_SETUP, "unable to create result pipe: %s", NULL, NULL, strerror(errno));
+		goto hooks_pipe_failed;
+	}
+	if (pipe(output_pipe) != 0) {
+		failure = ctest_failure_create(CTEST_STAGE_SETUP, "unable to create output pipe: %s", NULL, NULL, strerror(errno));
+		goto output_pipe_failed;
+	}
+	if (testcase == NULL && socketpair(AF_UNIX, SOCK_STREAM, 0, request_pair) != 0) {
+		failure = ctest_failure_create(CTEST_STAGE_SETUP, "unable to create request socket: %s", NULL, NULL, strerror(errno));
+		goto request_pair_failed;
+	}
+	/* Keep the pipes from leaking into spawned workers. */
+	for (i = 0; i < 2; ++i) {
+		(void)fcntl(hooks_pipe[i], F_SETFD, FD_CLOEXEC);
+		(void)fcntl(output_pipe[i], F_SETFD, FD_CLOEXEC);
+		if (request_pair[i] >= 0)
+			(void)fcntl(request_pair[i], F_SETFD, FD_CLOEXEC);
+	}
+
+	if (runner->cgroup_root.dir_fd >= 0 && (cgroup_fd = cgroup_create(&runner->cgroup_root, &runner->config.limits, &child->cgroup)) < 0) {
+		failure = ctest_failure_create(CTEST_STAGE_SETUP, "unable to create cgroup: %s", NULL, NULL, strerror(errno));
+		goto cgroup_failed;
+	}
+
+	/* A forked child starts out with the memory of the process it is
+	 * forked from resident (shared, until written to), which counts
+	 * toward its resident set; a spawned worker starts out afresh. Its
+	 * cgroup is only charged for what it uses itself. Nothing is read
+	 * unless the peak is recorded, to keep spawning cheap. */
+	if (measure_memory && host != NULL)
+		inherited_bytes = resident_anon_bytes__(host->zygote.pid);
+	else if (measure_memory && runner->zygote.pid > 0)
+		inherited_bytes = resident_anon_bytes__(runner->zygote.pid);
+	else if (measure_memory && runner->config.spawn != CTEST_SPAWN_WORKER)
+		inherited_bytes = resident_anon_bytes__(getpid());
+
+	if ((pid = runner_spawn_child__(runner, host, testcase, hooks_pipe, output_pipe, testcase == NULL ? request_pair : NULL, cgroup_fd, cpu, p_spawn_ns)) < 0) {
+		failure = ctest_failure_create(CTEST_STAGE_SETUP, "unable to create child process: %s", NULL, NULL, strerror(errno));
+		goto fork_failed;
+	}
+	if (cgroup_fd >= 0)
+		(void)close(cgroup_fd);
+
+	/* Parent: close the write end of the pipe; this ensures we get
+	 * notified when the child exits. */
+	(void)close(hooks_pipe[1]);
+	(void)close(output_pipe[1]);
+	if (request_pair[1] >= 0)
+		(void)close(request_pair[1]);
+
+	child->pid = pid;
+	child->measure_memory = measure_memory;
+	child->inherited_bytes = inherited_bytes;
+	child->request_fd = request_pair[0];
+	child->limits = &runner->config.limits;
+	child->cgroup_root = &runner->cgroup_root;
+	child->cpu = cpu;
+	child_event_consumer_init__(&child->consumer);
+	exec_event_reader_init(&child->event_reader, hooks_pipe[0], &child->consumer.base);
+	output_reader_init(&child->output_reader, output_pipe[0]);
+
+	child->reactor = &runner->reactor;
+	poll_source_init__(&child->event_source, "execution hooks", child, &child->event_reader.poll_handler_base, hooks_pipe[0]);
+	poll_source_init__(&child->output_source, "output", child, &child->output_reader.poll_handler_base, output_pipe[0]);
+	poll_source_init__(&child->exit_source, "exit", child, NULL, pidfd_open__(pid));
+	if (child_watch__(child) != 0) {
+		failure = ctest_failure_create(CTEST_STAGE_SETUP, "unable to watch child process: %s", NULL, NULL, strerror(errno));
+		child_reap__(child, ctest_failure_create(CTEST_STAGE_SETUP, "child unusable", NULL, NULL));
+		return failure;
+	}
+	return NULL;
+
+fork_failed:
+	if (cgroup_fd >= 0) {
+		(void)close(cgroup_fd);
+		cgroup_remove(&runner->cgroup_root, &child->cgroup);
+	}
+cgroup_failed:
+	if (request_pair[0] >= 0) {
+		(void)close(request_pair[0]);
+		(void)close(request_pair[1]);
+	}
+request_pair_failed:
+	(void)close(output_pipe[0]);
+	(void)close(output_pipe[1]);
+output_pipe_failed:
+	(void)close(hooks_pipe[0]);
+	(void)close(hooks_pipe[1]);
+hooks_pipe_failed:
+	return failure;
+}
+
+/**
+ * Arm the watchdog for a deadline, unless it is already armed for an earlier
+ * one.
+ *
+ * @param runner      The runner whose watchdog to arm.
+ * @param deadline_ns The deadline (in nanoseconds, on the monotonic clock), or
+ *                    zero to disarm the watchdog.
+ * @param force       Whether to arm the watchdog for the deadline even if it is
+ *                    armed for an earlier one.
+ */
+CTEST_ALL_NONNULL_ARGS__
+static void runner_arm_watchdog__(forking_runner_t__ *runner, uint64_t deadline_ns, bool force)
+{
+	struct itimerspec spec;
+
+	if (!force && (deadline_ns == 0 || (runner->watchdog_armed_ns != 0 && runner->watchdog_armed_ns <= deadline_ns)))
+		return;
+
+	memset(&spec, 0, sizeof(spec));
+	spec.it_value.tv_sec = deadline_ns / 1000000000u;
+	spec.it_value.tv_nsec = deadline_ns % 1000000000u;
+	if (timerfd_settime(runner->watchdog_fd, TFD_TIMER_ABSTIME, &spec, NULL) == 0)
+		runner->watchdog_armed_ns = deadline_ns;
+}
+
+/**
+ * Hand a job to a child whose process has been started (or is idle, waiting
+ * for its next test case), having the watchdog keep the job to its time limit.
+ *
+ * @param runner     The runner of the child.
+ * @param child      The child to run the job.
+ * @param job        The job.
+ * @param result     The result to populate for the job.
+ * @param timeout_ns The time limit of the job, or zero.
+ * @param start_ns   When (on the monotonic clock) the job's time started.
+ */
+CTEST_ALL_NONNULL_ARGS__
+static void runner_assign_job__(forking_runner_t__ *runner, child_t__ *child, runner_job_t *job, ctest_result_t *result, uint64_t timeout_ns, uint64_t start_ns)
+{
+	child->job = job;
+	child->job_count += 1;
+	child->result = result;
+	result->cpu = child->cpu;
+	result->forked = true;
+	child->timeout_ns = timeout_ns;
+	child->deadline_ns = timeout_ns > 0 ? start_ns + timeout_ns : 0;
+	child->watchdog_signal = 0;
+	child->cancelled = false;
+	runner_arm_watchdog__(runner, child->deadline_ns, false);
+}
+
+/**
+ * Run a fixture operation in the fixture host, recovering when it
+ * short-circuits.
+ *
+ * @return The type of result of the operation.
+ */
+static ctest_result_type_t fixture_host_run__(fixture_host_t__ *host, void (*op)(ctest_fixture_t *, ctest_exec_hooks_t *))
+{
+	sigjmp_buf env;
+
+	host->hooks.env = &env;
+	if (sigsetjmp(env, 1) != 0) {
+		host->hooks.env = NULL;
+		return host->hooks.result_type;
+	}
+	(*op)(host->fixture, &host->hooks.base);
+	host->hooks.env = NULL;
+	return CTEST_RESULT_PASS;
+}
+
+/**
+ * Set up the fixture, in the (newly started) fixture host, before it serves
+ * any request, reporting how it went to the runner.
+ *
+ * @return Zero if the fixture has been set up, non-zero (for the host to exit)
+ *         otherwise.
+ */
+static int fixture_host_op_init__(void *context)
+{
+	fixture_host_t__ *const host = context;
+	const int output_fd = host->output_fd;
+	ctest_result_type_t result_type;
+
+	(void)close(host->event_fds[0]);
+	host->event_fds[0] = -1;
+	host->output_fd = -1;
+	runner_close_inherited__(host->runner);
+	child_redirect__(output_fd);
+
+	exec_hooks_init__(&host->hooks, host->event_fds[1]);
+	/* The test cases forked from the host share its sandbox, so they can
+	 * reach what the fixture sets up in it. */
+	if (host->runner->config.sandbox && sandbox_enter() != 0) {
+		ctest_failure_t failure;
+		char description[128];
+
+		memset(&failure, 0, sizeof(failure));
+		failure.stage = CTEST_STAGE_SETUP;
+		failure.description = description;
+		snprintf(description, sizeof(description), "unable to enter sandbox: %s", strerror(errno));
+		exec_event_writer_on_failure(&host->hooks.writer, &failure);
+		exec_event_writer_on_complete(&host->hooks.writer, CTEST_RESULT_ERROR);
+		exec_hooks_destroy__(&host->hooks);
+		return -1;
+	}
+	sigcapture__(&exec_hooks_on_signal__, &host->hooks);
+	result_type = fixture_host_run__(host, &ctest_fixture_setup);
+	sigrestore__();
+
+	fflush(stdout);
+	fflush(stderr);
+	exec_event_writer_on_complete(&host->hooks.writer, result_type);
+	if (result_type == CTEST_RESULT_PASS)
+		return 0;
+	exec_hooks_destroy__(&host->hooks);
+	return -1;
+}
+
+/**
+ * Tear down the fixture, in the fixture host, once the runner has stopped it,
+ * reporting how it went to the runner.
+ */
+static void fixture_host_op_fini__(void *context)
+{
+	fixture_host_t__ *const host = context;
+	ctest_result_type_t result_type;
+
+	sigcapture__(&exec_hooks_on_signal__, &host->hooks);
+	result_type = fixture_host_run__(host, &ctest_fixture_teardown);
+	sigrestore__();
+
+	fflush(stdout);
+	fflush(stderr);
+	exec_event_writer_on_complete(&host->hooks.writer, result_type);
+	exec_hooks_destroy__(&host->hooks);
+}
+
+/**
+ * Entry point of a child spawned from a fixture host.
+ */
+CTEST_NORETURN__
+static void fixture_host_child_main__(void *context, void *arg, int *fds, size_t fd_count)
+{
+	fixture_host_t__ *const host = context;
+
+	/* Only the host itself reports on the fixture. */
+	(void)close(host->event_fds[1]);
+	zygote_child_run__(host->runner, arg, fds, fd_count, false);
+}
+
+CTEST_ALL_NONNULL_ARGS__
+static void fixture_host_unwatch__(fixture_host_t__ *host)
+{
+	if (!host->watched)
+		return;
+	reactor_remove(&host->runner->reactor, host->event_fds[0], &host->event_handler);
+	host->watched = false;
+}
+
+/**
+ * Read everything the fixture host (which has exited) wrote.
+ *
+ * @return The output, or <code>NULL</code> if there is none (or it couldn't
+ *         be read).
+ */
+CTEST_ALL_NONNULL_ARGS__
+static ctest_output_t *fixture_host_read_output__(fixture_host_t__ *host)
+{
+	output_reader_t reader;
+	ctest_output_t *output = NULL;
+
+	if (lseek(host->output_fd, 0, SEEK_SET) == 0) {
+		output_reader_init(&reader, host->output_fd);
+		if (output_reader_drain(&reader) == 0)
+			output = output_reader_build(&reader);
+		output_reader_destroy(&reader);
+	} else {
+		(void)close(host->output_fd);
+	}
+	host->output_fd = -1;
+	return output;
+}
+
+/**
+ * Complete a job using the fixture of a host that failed to set it up,
+ * without running it.
+ */
+CTEST_ALL_NONNULL_ARGS__
+static void fixture_host_fail_job__(fixture_host_t__ *host, runner_job_t *job, ctest_result_t *result)
+{
+	ctest_output_t *output;
+
+	ctest_result_set_failure(result, host->failure_type, host->failure != NULL ? ctest_failure_clone(host->failure) : NULL);
+	if (host->output != NULL && (output = ctest_output_create(host->output->length)) != NULL) {
+		memcpy(output->data, host->output->data, host->output->length);
+		ctest_result_set_output(result, output);
+	}
+	runner_job_complete(job, result);
+}
+
+/**
+ * Start the child of a job that has been waiting for its fixture host to set
+ * up the fixture or, if it failed to, complete the job without running it.
+ */
+CTEST_ALL_NONNULL_ARGS__
+static void fixture_host_release__(fixture_host_t__ *host, child_t__ *child)
+{
+	runner_job_t *const job = child->job;
+	ctest_result_t *const result = child->result;
+	const uint64_t timeout_ns = child->timeout_ns;
+	ctest_failure_t *failure;
+
+	child->waiting_host = NULL;
+	child->job = NULL;
+	child->result = NULL;
+	if (host->state == FIXTURE_HOST_FAILED) {
+		fixture_host_fail_job__(host, job, result);
+	} else if ((failure = runner_start_child__(host->runner, child, host, job->testcase, &result->spawn_ns)) != NULL) {
+		ctest_result_set_failure(result, CTEST_RESULT_ERROR, failure);
+		runner_job_complete(job, result);
+	} else {
+		/* The time spent waiting doesn't count against the job. */
+		runner_assign_job__(host->runner, child, job, result, timeout_ns, monotonic_ns__());
+	}
+}
+
+/**
+ * Act on a fixture host being done setting up its fixture (or having failed
+ * to), releasing the jobs waiting for it.
+ */
+CTEST_ALL_NONNULL_ARGS__
+static void fixture_host_on_setup__(fixture_host_t__ *host)
+{
+	forking_runner_t__ *const runner = host->runner;
+	child_event_consumer_t__ *const consumer = &host->consumer;
+	const char *const name = ctest_fixture_get_name(host->fixture);
+	size_t i;
+
+	fixture_host_unwatch__(host);
+	host->deadline_ns = 0;
+	if (consumer->completed && consumer->result_type == CTEST_RESULT_PASS && !host->timed_out) {
+		host->state = FIXTURE_HOST_READY;
+	} else {
+		host->state = FIXTURE_HOST_FAILED;
+		if (host->timed_out) {
+			host->failure_type = CTEST_RESULT_TIMEOUT;
+			host->failure = ctest_failure_create(CTEST_STAGE_SETUP, "time limit of %.3fs for setting up shared fixture %s exceeded; killed", NULL, NULL,
+			                                     host->timeout_ns / 1e9, name);
+		} else if (consumer->last_failure != NULL) {
+			/* Without a completion, the host didn't survive. */
+			host->failure_type = consumer->completed ? consumer->result_type : CTEST_RESULT_ERROR;
+			host->failure = consumer->last_failure;
+			consumer->last_failure = NULL;
+		} else {
+			host->failure_type = CTEST_RESULT_ERROR;
+			host->failure = ctest_failure_create(CTEST_STAGE_SETUP, "host of shared fixture %s exited while setting it up", NULL, NULL, name);
+		}
+		/* The host exits on its own (or has been killed). */
+		zygote_stop(&host->zygote);
+		host->output = fixture_host_read_output__(host);
+	}
+
+	for (i = 0; i < runner->child_count; ++i) {
+		child_t__ *const child = runner->children + i;
+		if (child->waiting_host == host)
+			fixture_host_release__(host, child);
+	}
+}
+
+static int fixture_host_op_on_data_available__(poll_handler_t *handler)
+{
+	fixture_host_t__ *const host = containerof(handler, fixture_host_t__, event_handler);
+	int rc;
+
+	if ((rc = poll_handler_on_data_available(&host->event_reader.poll_handler_base)) > 0 && !host->consumer.completed)
+		return rc;
+	fixture_host_on_setup__(host);
+	return rc;
+}
+
+static void fixture_host_op_on_close__(poll_handler_t *unused(handler))
+{
+}
+
+/**
+ * Kill a fixture host that is taking too long to set up its fixture (or
+ * whose run has been cancelled); the jobs waiting for it fail.
+ */
+CTEST_ALL_NONNULL_ARGS__
+static void fixture_host_kill__(fixture_host_t__ *host, bool timed_out)
+{
+	host->timed_out = timed_out;
+	(void)kill(host->zygote.pid, SIGKILL);
+	fixture_host_on_setup__(host);
+}
+
+/**
+ * Get the host of a shared fixture, starting it (setting up the fixture) if
+ * it isn't running yet.
+ *
+ * @param runner     The runner.
+ * @param fixture    The shared fixture.
+ * @param timeout_ns The time limit for setting up the fixture, or zero.
+ *
+ * @return The host (which may still be setting up the fixture, or may have
+ *         failed to), or <code>NULL</code> (with <code>errno</code> set) if
+ *         it couldn't be started.
+ */
+CTEST_ALL_NONNULL_ARGS__
+static fixture_host_t__ *runner_get_fixture_host__(forking_runner_t__ *runner, ctest_fixture_t *fixture, uint64_t timeout_ns)
+{
+	static const zygote_hooks_t hooks = {
+		&fixture_host_op_init__,
+		&fixture_host_op_fini__,
+	};
+	static poll_handler_ops_t ops = {
+		&fixture_host_op_on_data_available__,
+		&fixture_host_op_on_close__,
+	};
+	fixture_host_t__ *host;
+	int saved_errno;
+
+	for (host = runner->hosts; host != NULL; host = host->next) {
+		if (host->fixture == fixture)
+			return host;
+	}
+
+	if ((host = calloc(1, sizeof(*host))) == NULL)
+		goto alloc_failed;
+	host->runner = runner;
+	host->fixture = fixture;
+	host->zygote.pid = -1;
+	host->zygote.control_fd = -1;
+	host->event_handler.ops = &ops;
+	if (pipe2(host->event_fds, O_CLOEXEC) != 0)
+		goto pipe_failed;
+	if ((host->output_fd = memfd_create("ctest-fixture-output", MFD_CLOEXEC)) < 0)
+		goto output_failed;
+	child_event_consumer_init__(&host->consumer);
+
+	if (zygote_start(&host->zygote, &fixture_host_child_main__, &hooks, host) != 0)
+		goto start_failed;
+	(void)close(host->event_fds[1]);
+	host->event_fds[1] = -1;
+	exec_event_reader_init(&host->event_reader, host->event_fds[0], &host->consumer.base);
+	if (reactor_add(&runner->reactor, host->event_fds[0], &host->event_handler) != 0)
+		goto watch_failed;
+
+	host->watched = true;
+	host->state = FIXTURE_HOST_SETTING_UP;
+	host->timeout_ns = timeout_ns;
+	host->deadline_ns = timeout_ns > 0 ? monotonic_ns__() + timeout_ns : 0;
+	runner_arm_watchdog__(runner, host->deadline_ns, false);
+	host->next = runner->hosts;
+	runner->hosts = host;
+	return host;
+
+watch_failed:
+	saved_errno = errno;
+	(void)kill(host->zygote.pid, SIGKILL);
+	zygote_stop(&host->zygote);
+	exec_event_reader_destroy(&host->event_reader);
+	child_event_consumer_destroy__(&host->consumer);
+	(void)close(host->output_fd);
+	(void)free(host);
+	errno = saved_errno;
+	return NULL;
+
+start_failed:
+	child_event_consumer_destroy__(&host->consumer);
+	(void)close(host->output_fd);
+output_failed:
+	saved_errno = errno;
+	(void)close(host->event_fds[0]);
+	(void)close(host->event_fds[1]);
+	errno = saved_errno;
+pipe_failed:
+	(void)free(host);
+alloc_failed:
+	return NULL;
+}
+
+/**
+ * Stop a fixture host that has set up its fixture, waiting (within the time
+ * limit for setting it up) for it to tear the fixture down.
+ *
+ * There's no test case left to blame if tearing the fixture down fails, so
+ * a warning is printed instead.
+ */
+CTEST_ALL_NONNULL_ARGS__
+static void fixture_host_teardown__(fixture_host_t__ *host)
+{
+	child_event_consumer_t__ *const consumer = &host->consumer;
+	const uint64_t deadline_ns = host->timeout_ns > 0 ? monotonic_ns__() + host->timeout_ns : 0;
+	const char *problem;
+	struct pollfd pollfd;
+	int rc;
+
+	child_event_consumer_reset__(consumer);
+	/* The host tears the fixture down once it sees the end of its
+	 * requests. */
+	(void)shutdown(host->zygote.control_fd, SHUT_WR);
+	while (!consumer->completed) {
+		const uint64_t now_ns = monotonic_ns__();
+
+		if (deadline_ns != 0 && now_ns >= deadline_ns) {
+			host->timed_out = true;
+			(void)kill(host->zygote.pid, SIGKILL);
+			break;
+		}
+		memset(&pollfd, 0, sizeof(pollfd));
+		pollfd.fd = host->event_fds[0];
+		pollfd.events = POLLIN;
+		if ((rc = poll(&pollfd, 1, deadline_ns != 0 ? (int)((deadline_ns - now_ns + 999999u) / 1000000u) : -1)) < 0 && errno != EINTR)
+			break;
+		if (rc > 0 && poll_handler_on_data_available(&host->event_reader.poll_handler_base) <= 0)
+			break;
+	}
+	zygote_stop(&host->zygote);
+
+	if (consumer->completed && consumer->result_type == CTEST_RESULT_PASS)
+		return;
+	if (host->timed_out)
+		problem = "time limit exceeded; killed";
+	else if (consumer->last_failure != NULL)
+		problem = consumer->last_failure->description;
+	else
+		problem = "host exited";
+	fprintf(stderr, "warning: tearing down shared fixture %s failed: %s\n", ctest_fixture_get_name(host->fixture), problem);
+}
+
+/**
+ * Stop a fixture host (tearing down its fixture if it was set up) and free
+ * it.
+ */
+CTEST_ALL_NONNULL_ARGS__
+static void fixture_host_destroy__(fixture_host_t__ *host)
+{
+	if (host->state == FIXTURE_HOST_READY) {
+		fixture_host_teardown__(host);
+	} else if (host->zygote.pid > 0) {
+		(void)kill(host->zygote.pid, SIGKILL);
+		zygote_stop(&host->zygote);
+	}
+	fixture_host_unwatch__(host);
+	exec_event_reader_destroy(&host->event_reader);
+	child_event_consumer_destroy__(&host->consumer);
+	if (host->output_fd >= 0)
+		(void)close(host->output_fd);
+	if (host->failure != NULL)
+		ctest_failure_destroy(host->failure);
+	if (host->output != NULL)
+		ctest_output_destroy(host->output);
+	memset(host, 0, sizeof(*host));
+	(void)free(host);
+}
+
+/*
+ * Test Cases Run In-Process
+ */
+
+/**
+ * Determine whether a job has to be run in a child process of its own, rather
+ * than within the runner's process (see <code>CTEST_ISOLATION_AUTO</code>).
+ */
+CTEST_ALL_NONNULL_ARGS__
+static bool runner_needs_child__(forking_runner_t__ *runner, runner_job_t *job)
+{
+	ctest_test_t *const test = ctest_testcase_get_test(job->testcase);
+	ctest_testsuite_t *const testsuite = ctest_test_get_testsuite(test);
+	size_t i;
+
+	/* A time limit can only be enforced on a child, and a retry gets a
+	 * fresh process like it would otherwise. */
+	if (job->attempt > 1 || ctest_test_has_tag(test, "unsafe") || ctest_test_get_timeout_ns(test) > 0)
+		return true;
+	if (runner->config.timings != NULL && ctest_timings_get_crash_count(runner->config.timings, job->testcase) > 0)
+		return true;
+	for (i = 0; i < runner->crashed_count; ++i) {
+		if (runner->crashed[i] == testsuite)
+			return true;
+	}
+	return false;
+}
+
+/**
+ * Note that a test case crashed within the runner's process (or left it
+ * changed, see <code>ctest_runner_config_t.check_state</code>), so the rest of
+ * its suite is run in children, as is the test case itself in later runs.
+ */
+CTEST_ALL_NONNULL_ARGS__
+static void runner_on_crash__(forking_runner_t__ *runner, ctest_testcase_t *testcase)
+{
+	ctest_testsuite_t *const testsuite = ctest_test_get_testsuite(ctest_testcase_get_test(testcase));
+	ctest_testsuite_t **crashed;
+	size_t i;
+
+	if (runner->config.timings != NULL)
+		(void)ctest_timings_record_crash(runner->config.timings, testcase);
+	for (i = 0; i < runner->crashed_count; ++i) {
+		if (runner->crashed[i] == testsuite)
+			return;
+	}
+	/* Without memory, the rest of the suite carries on in-process. */
+	if ((crashed = realloc(runner->crashed, (runner->crashed_count + 1) * sizeof(*crashed))) == NULL)
+		return;
+	crashed[runner->crashed_count++] = testsuite;
+	runner->crashed = crashed;
+}
+
+/**
+ * Run a job within the runner's process, completing it right away.
+ *
+ * @return Zero on success, non-zero on failure.
+ */
+CTEST_ALL_NONNULL_ARGS__
+static int runner_run_in_process__(forking_runner_t__ *runner, runner_job_t *job)
+{
+	ctest_result_t *result;
+	int signum;
+
+	if ((result = direct_runner_execute(runner->direct, job->testcase, &signum)) == NULL) {
+		ctest_failure_t *const failure = ctest_failure_create(CTEST_STAGE_SETUP, "unable to run test case in-process: %s", NULL, NULL, strerror(errno));
+		if ((result = ctest_result_create_empty()) == NULL) {
+			if (failure != NULL)
+				ctest_failure_destroy(failure);
+			return -1;
+		}
+		ctest_result_set_failure(result, CTEST_RESULT_ERROR, failure);
+	}
+	if (signum != 0 || result->type == CTEST_RESULT_ISOLATION_VIOLATION)
+		runner_on_crash__(runner, job->testcase);
+	runner_job_complete(job, result);
+	return 0;
+}
+
+/*
+ * Executor
+ */
+
+CTEST_ALL_NONNULL_ARGS__
+static int executor_op_start__(runner_executor_t *executor, runner_job_t *job)
+{
+	forking_runner_t__ *const runner = upcast_from_runner_executor__(executor);
+	const bool pool = runner->config.pool;
+	const bool pooled = pool || runner->config.isolation == CTEST_ISOLATION_TEST || runner->config.isolation == CTEST_ISOLATION_SUITE;
+	ctest_test_t *const test = ctest_testcase_get_test(job->testcase);
+	ctest_fixture_t *fixture = NULL;
+	fixture_host_t__ *host = NULL;
+	ctest_failure_t *failure;
+	ctest_result_t *result;
+	uint64_t timeout_ns;
+	child_t__ *child;
+
+	/* Each worker of the schedule is a child slot; with a pool, the
+	 * worker's test cases all run in the same child, otherwise those of
+	 * the same group do (the schedule runs a group back to back). */
+	if (job->worker >= runner->child_count || runner->children[job->worker].job != NULL) {
+		errno = EBUSY;
+		return -1;
+	}
+	child = runner->children + job->worker;
+	if (runner->direct != NULL && !runner_needs_child__(runner, job))
+		return runner_run_in_process__(runner, job);
+
+	if ((result = ctest_result_create_empty()) == NULL)
+		return -1;
+	if ((timeout_ns = ctest_test_get_timeout_ns(test)) == 0)
+		timeout_ns = runner->config.timeout_ns;
+
+	/* Pooled children (and spawned workers) have nothing to be spawned
+	 * from but themselves; their test cases set up fixtures of their
+	 * own. */
+	if (!pooled && runner->config.spawn != CTEST_SPAWN_WORKER)
+		fixture = ctest_test_get_shared_fixture(test);
+	if (fixture != NULL && (host = runner_get_fixture_host__(runner, fixture, timeout_ns)) == NULL) {
+		failure = ctest_failure_create(CTEST_STAGE_SETUP, "unable to start host of shared fixture %s: %s", NULL, NULL, ctest_fixture_get_name(fixture), strerror(errno));
+		goto start_failed;
+	}
+	if (host != NULL && host->state == FIXTURE_HOST_FAILED) {
+		fixture_host_fail_job__(host, job, result);
+		return 0;
+	} else if (host != NULL && host->state == FIXTURE_HOST_SETTING_UP) {
+		/* Started once the host is done. */
+		child->job = job;
+		child->result = result;
+		child->timeout_ns = timeout_ns;
+		child->waiting_host = host;
+		return 0;
+	}
+
+	if (child->pid > 0 && (job->attempt > 1 || (!pool && child->group != job->group))) {
+		/* A retry gets a fresh child, so whatever the pooled child was
+		 * left with can't be what made the test case fail again; so
+		 * does a new group. */
+		child_reap__(child, NULL);
+	}
+	if (child->pid > 0 && child_send_testcase__(child, job->testcase) != 0) {
+		/* The idle child went away; replace it. */
+		child_reap__(child, ctest_failure_create(CTEST_STAGE_SETUP, "unable to send test case to child: %s", NULL, NULL, strerror(errno)));
+	}
+	if (child->pid <= 0) {
+		if ((failure = runner_start_child__(runner, child, host, pooled ? NULL : job->testcase, &result->spawn_ns)) != NULL)
+			goto start_failed;
+		child->group = job->attempt > 1 ? SIZE_MAX : job->group;
+		if (pooled && child_send_testcase__(child, job->testcase) != 0) {
+			failure = ctest_failure_create(CTEST_STAGE_SETUP, "unable to send test case to child: %s", NULL, NULL, strerror(errno));
+			child_reap__(child, ctest_failure_create(CTEST_STAGE_SETUP, "child unusable", NULL, NULL));
+			goto start_failed;
+		}
+	}
+
+	runner_assign_job__(runner, child, job, result, timeout_ns, job->start_ns);
+	return 0;
+
+start_failed:
+	ctest_result_set_failure(result, CTEST_RESULT_ERROR, failure);
+	runner_job_complete(job, result);
+	return 0;
+}
+
+/**
+ * Act on every child whose deadline has passed, then rearm the watchdog for
+ * the earliest remaining deadline.
+ */
+static int watchdog_op_on_data_available__(poll_handler_t *handler)
+{
+	forking_runner_t__ *const runner = containerof(handler, forking_runner_t__, watchdog_handler);
+	const uint64_t now_ns = monotonic_ns__();
+	uint64_t expirations, deadline_ns = 0;
+	size_t i;
+
+	fixture_host_t__ *host;
+
+	while (read(runner->watchdog_fd, &expirations, sizeof(expirations)) < 0 && errno == EINTR)
+		;
+	/* Jobs released by a host that is killed get deadlines of their own,
+	 * so hosts go first. */
+	for (host = runner->hosts; host != NULL; host = host->next) {
+		if (host->deadline_ns != 0 && host->deadline_ns <= now_ns)
+			fixture_host_kill__(host, true);
+		if (host->deadline_ns != 0 && (deadline_ns == 0 || host->deadline_ns < deadline_ns))
+			deadline_ns = host->deadline_ns;
+	}
+	for (i = 0; i < runner->child_count; ++i) {
+		child_t__ *const child = runner->children + i;
+		if (child->pid > 0 && child->deadline_ns != 0 && child->deadline_ns <= now_ns)
+			child_on_deadline__(child, now_ns);
+		if (child->pid > 0 && child->deadline_ns != 0 && (deadline_ns == 0 || child->deadline_ns < deadline_ns))
+			deadline_ns = child->deadline_ns;
+	}
+	runner_arm_watchdog__(runner, deadline_ns, true);
+	return 0;
+}
+
+static void watchdog_op_on_close__(poll_handler_t *unused(handler))
+{
+}
+
+CTEST_ALL_NONNULL_ARGS__
+static void runner_unwatch_cancel__(forking_runner_t__ *runner)
+{
+	if (!runner->cancel_watched)
+		return;
+	reactor_remove(&runner->reactor, ctest_cancel_get_fd(runner->executor.cancellation.cancel), &runner->cancel_handler);
+	runner->cancel_watched = false;
+}
+
+/**
+ * Cancellation has been requested; the token is no longer of interest (it
+ * stays readable), but waking up is enough for the plan to notice.
+ */
+static int cancel_op_on_data_available__(poll_handler_t *handler)
+{
+	forking_runner_t__ *const runner = containerof(handler, forking_runner_t__, cancel_handler);
+	runner_unwatch_cancel__(runner);
+	return 0;
+}
+
+static void cancel_op_on_close__(poll_handler_t *unused(handler))
+{
+}
+
+/**
+ * Stop every child with a job in flight, the same way the watchdog stops
+ * one that has run out of time (so it is killed if it doesn't go quietly).
+ */
+CTEST_ALL_NONNULL_ARGS__
+static void executor_op_cancel__(runner_executor_t *executor)
+{
+	forking_runner_t__ *const runner = upcast_from_runner_executor__(executor);
+	const uint64_t now_ns = monotonic_ns__();
+	uint64_t deadline_ns = 0;
+	fixture_host_t__ *host;
+	size_t i;
+
+	/* Jobs still waiting for their fixture host never ran. */
+	for (i = 0; i < runner->child_count; ++i) {
+		child_t__ *const child = runner->children + i;
+		runner_job_t *const job = child->job;
+		ctest_result_t *result = child->result;
+		ctest_result_t *cancelled;
+		if (child->waiting_host == NULL)
+			continue;
+		child->waiting_host = NULL;
+		child->job = NULL;
+		child->result = NULL;
+		if ((cancelled = runner_cancellation_create_result(&runner->executor.cancellation, CTEST_STAGE_SETUP, "not run")) != NULL) {
+			ctest_result_destroy(result);
+			result = cancelled;
+		} else {
+			ctest_result_set_failure(result, CTEST_RESULT_CANCELLED, NULL);
+		}
+		runner_job_complete(job, result);
+	}
+	for (host = runner->hosts; host != NULL; host = host->next) {
+		if (host->state == FIXTURE_HOST_SETTING_UP)
+			fixture_host_kill__(host, false);
+	}
+
+	for (i = 0; i < runner->child_count; ++i) {
+		child_t__ *const child = runner->children + i;
+		if (child->pid <= 0 || child->job == NULL)
+			continue;
+		if (child->watchdog_signal == 0) {
+			child->cancelled = true;
+			child_on_deadline__(child, now_ns);
+		}
+		if (deadline_ns == 0 || child->deadline_ns < deadline_ns)
+			deadline_ns = child->deadline_ns;
+	}
+	runner_arm_watchdog__(runner, deadline_ns, false);
+}
+
+/**
+ * Stop the host of a shared fixture none of the run's test cases need any
+ * more, tearing the fixture down.
+ */
+CTEST_ALL_NONNULL_ARGS__
+static void executor_op_release_fixture__(runner_executor_t *executor, ctest_fixture_t *fixture)
+{
+	forking_runner_t__ *const runner = upcast_from_runner_executor__(executor);
+	fixture_host_t__ **p_host;
+
+	for (p_host = &runner->hosts; *p_host != NULL; p_host = &(*p_host)->next) {
+		fixture_host_t__ *const host = *p_host;
+		if (host->fixture == fixture) {
+			*p_host = host->next;
+			fixture_host_destroy__(host);
+			break;
+		}
+	}
+	if (runner->direct != NULL)
+		direct_runner_release_fixture(runner->direct, fixture);
+}
+
+CTEST_ALL_NONNULL_ARGS__
+static int executor_op_wait__(runner_executor_t *executor)
+{
+	forking_runner_t__ *const runner = upcast_from_runner_executor__(executor);
+	size_t i;
+
+	/* The watchdog is always registered, as is the cancellation token
+	 * while it's being watched; beyond them, there has to be a child to
+	 * wait for. */
+	if (runner->reactor.handler_count <= 1 + (size_t)runner->cancel_watched)
+		return 0;
+
+	if (reactor_dispatch(&runner->reactor, -1) < 0) {
+		const int wait_errno = errno;
+		for (i = 0; i < runner->child_count; ++i) {
+			child_t__ *const child = runner->children + i;
+			if (child->pid > 0)
+				child_reap__(child, ctest_failure_create(child->consumer.stage, "wait for child data failed: %s", NULL, NULL, strerror(wait_errno)));
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * Prepare the runner for a run, opening its cgroup directory and starting the
+ * zygote, if enabled.
+ *
+ * The zygote is started now, rather than when the runner is created, so every
+ * test case of the run has been loaded (and is available in the zygote).
+ *
+ * @return Zero on success, non-zero on failure.
+ */
+CTEST_ALL_NONNULL_ARGS__
+static int runner_begin_run__(forking_runner_t__ *runner)
+{
+	ctest_cancel_t *const cancel = runner->executor.cancellation.cancel;
+
+	/* Children share the pool by inheriting it (from the zygote, too);
+	 * workers are handed its file descriptor. */
+	if (ports_open(runner->config.first_port, runner->config.last_port) != 0)
+		goto ports_failed;
+	if (runner->config.cgroup_path != NULL && cgroup_root_open(&runner->cgroup_root, runner->config.cgroup_path, &runner->config.limits) != 0)
+		goto cgroup_failed;
+	/* Without namespaces, children are forked as they would otherwise. */
+	if (runner->config.sandbox && sandbox_probe() != 0) {
+		fprintf(stderr, "warning: unable to sandbox test cases, running them unsandboxed: %s\n", strerror(errno));
+		runner->config.sandbox = false;
+	}
+	if (cancel != NULL && !ctest_cancel_is_requested(cancel)) {
+		if (reactor_add(&runner->reactor, ctest_cancel_get_fd(cancel), &runner->cancel_handler) != 0)
+			goto watch_cancel_failed;
+		runner->cancel_watched = true;
+	}
+	if (runner->config.spawn == CTEST_SPAWN_ZYGOTE && zygote_start(&runner->zygote, &zygote_child_main__, NULL, runner) != 0)
+		goto zygote_failed;
+	return 0;
+
+zygote_failed:
+	runner_unwatch_cancel__(runner);
+watch_cancel_failed:
+	if (runner->cgroup_root.dir_fd >= 0)
+		cgroup_root_close(&runner->cgroup_root);
+cgroup_failed:
+	ports_close();
+ports_failed:
+	return -1;
+}
+
+CTEST_ALL_NONNULL_ARGS__
+static void runner_end_run__(forking_runner_t__ *runner)
+{
+	size_t i;
+
+	/* Let the pooled children know there's nothing more to run, then
+	 * wait for them to exit. */
+	for (i = 0; i < runner->child_count; ++i) {
+		child_t__ *const child = runner->children + i;
+		if (child->request_fd >= 0) {
+			(void)close(child->request_fd);
+			child->request_fd = -1;
+		}
+	}
+	for (i = 0; i < runner->child_count; ++i) {
+		child_t__ *const child = runner->children + i;
+		if (child->pid > 0)
+			child_reap__(child, NULL);
+	}
+
+	/* Shared fixtures still set up (e.g., the run was cancelled) are torn
+	 * down once no child is using them. */
+	while (runner->hosts != NULL) {
+		fixture_host_t__ *const host = runner->hosts;
+		runner->hosts = host->next;
+		fixture_host_destroy__(host);
+	}
+	if (runner->direct != NULL)
+		direct_runner_release_fixture(runner->direct, NULL);
+	runner->crashed_count = 0;
+	if (runner->zygote.pid > 0)
+		zygote_stop(&runner->zygote);
+	runner_unwatch_cancel__(runner);
+	if (runner->cgroup_root.dir_fd >= 0)
+		cgroup_root_close(&runner->cgroup_root);
+	ports_close();
+}
+
+CTEST_ALL_NONNULL_ARGS__
+static int runner_op_run_testsuites__(ctest_runner_t *ctest_runner, ctest_reporter_t *reporter, ctest_testsuite_t *const* testsuites, size_t testsuite_count)
+{
+	forking_runner_t__ *const runner = upcast_from_ctest_runner__(ctest_runner);
+	int result;
+
+	if (runner_begin_run__(runner) != 0)
+		return -1;
+	result = runner_execute_testsuites(&runner->executor, reporter, testsuites, testsuite_count);
+	runner_end_run__(runner);
+	return result;
+}
+
+CTEST_ALL_NONNULL_ARGS__
+static int runner_op_run_tests__(ctest_runner_t *ctest_runner, ctest_reporter_t *reporter, ctest_test_t *const*tests, size_t test_count)
+{
+	forking_runner_t__ *const runner = upcast_from_ctest_runner__(ctest_runner);
+	int result;
+
+	if (runner_begin_run__(runner) != 0)
+		return -1;
+	result = runner_execute_tests(&runner->executor, reporter, tests, test_count);
+	runner_end_run__(runner);
+	return result;
+}
+
+CTEST_ALL_NONNULL_ARGS__
+static int runner_op_run_testcases__(ctest_runner_t *ctest_runner, ctest_reporter_t *reporter, ctest_testcase_t *const*testcases, size_t testcase_count)
+{
+	forking_runner_t__ *const runner = upcast_from_ctest_runner__(ctest_runner);
+	int result;
+
+	if (runner_begin_run__(runner) != 0)
+		return -1;
+	result = runner_execute_testcases(&runner->executor, reporter, testcases, testcase_count);
+	runner_end_run__(runner);
+	return result;
+}
+
+CTEST_ALL_NONNULL_ARGS__
+static void runner_op_destroy__(ctest_runner_t *ctest_runner)
+{
+	forking_runner_t__ *const runner = upcast_from_ctest_runner__(ctest_runner);
+	if (runner->direct != NULL)
+		ctest_runner_destroy(runner->direct);
+	(void)free(runner->crashed);
+	(void)close(runner->watchdog_fd);
+	reactor_destroy(&runner->reactor);
+	(void)free(runner->children);
+	memset(runner, 0, sizeof(*runner));
+	(void)free(runner);
+}
+
+CTEST_ALL_NONNULL_ARGS__
+ctest_runner_t *ctest_create_forking_runner_with_config(const ctest_runner_config_t *config)
+{
+	static ctest_runner_ops_t ops = {
+		&runner_op_run_testsuites__,
+		&runner_op_run_tests__,
+		&runner_op_run_testcases__,
+		&runner_op_destroy__
+	};
+	static runner_executor_ops_t executor_ops = {
+		&executor_op_start__,
+		&executor_op_wait__,
+		&executor_op_cancel__,
+		&executor_op_release_fixture__,
+		NULL,
+	};
+	static poll_handler_ops_t watchdog_ops = {
+		&watchdog_op_on_data_available__,
+		&watchdog_op_on_close__,
+	};
+	static poll_handler_ops_t cancel_ops = {
+		&cancel_op_on_data_available__,
+		&cancel_op_on_close__,
+	};
+
+	forking_runner_t__ *runner;
+	const size_t child_count = config->jobs > 0 ? config->jobs : 1;
+	size_t i;
+
+	if ((config->pool || config->isolation == CTEST_ISOLATION_TEST || config->isolation == CTEST_ISOLATION_SUITE) && config->spawn == CTEST_SPAWN_WORKER) {
+		errno = EINVAL;
+		goto invalid_config;
+	}
+	if (config->pool && config->isolation == CTEST_ISOLATION_AUTO) {
+		errno = EINVAL;
+		goto invalid_config;
+	}
+
+	if ((runner = calloc(1, sizeof(*runner))) == NULL)
+		goto alloc_runner_failed;
+	if ((runner->children = calloc(child_count, sizeof(*runner->children))) == NULL)
+		goto alloc_children_failed;
+	/* Each child has up to three sources (its pipes and pidfd), along with
+	 * the watchdog and cancellation token. */
+	if (reactor_init(&runner->reactor, 3 * child_count + 2) != 0)
+		goto reactor_init_failed;
+	if ((runner->watchdog_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC)) < 0)
+		goto watchdog_create_failed;
+	runner->watchdog_handler.ops = &watchdog_ops;
+	runner->cancel_handler.ops = &cancel_ops;
+	if (reactor_add(&runner->reactor, runner->watchdog_fd, &runner->watchdog_handler) != 0)
+		goto watchdog_add_failed;
+	if (config->isolation == CTEST_ISOLATION_AUTO && (runner->direct = ctest_create_direct_runner_with_config(config)) == NULL)
+		goto direct_create_failed;
+
+	runner->base.ops = &ops;
+	runner->executor.ops = &executor_ops;
+	runner->executor.capacity = child_count;
+	runner->executor.concurrency = config->concurrency;
+	runner->executor.timings = config->timings;
+	runner->executor.journal = config->journal;
+	runner_cancellation_init(&runner->executor.cancellation, config);
+	runner->executor.retries = config->retries;
+	/* Scheduled like test cases that each run in a child of their own. */
+	runner->executor.isolation = config->isolation == CTEST_ISOLATION_AUTO ? CTEST_ISOLATION_TESTCASE : config->isolation;
+	runner->executor.resources = config->resources;
+	runner->executor.memory_budget_bytes = config->memory_budget_bytes;
+	runner->config = *config;
+	runner->child_count = child_count;
+	runner->zygote.pid = -1;
+	runner->zygote.control_fd = -1;
+	runner->cgroup_root.dir_fd = -1;
+	for (i = 0; i < child_count; ++i)
+		runner->children[i].request_fd = -1;
+	return &runner->base;
+
+direct_create_failed:
+watchdog_add_failed:
+	(void)close(runner->watchdog_fd);
+watchdog_create_failed:
+	reactor_destroy(&runner->reactor);
+reactor_init_failed:
+	(void)free(runner->children);
+alloc_children_failed:
+	(void)free(runner);
+alloc_runner_failed:
+invalid_config:
+	return NULL;
+}
+
+ctest_runner_t *ctest_create_forking_runner(void)
+{
+	ctest_runner_config_t config;
+
+	ctest_runner_config_init(&config);
+	return ctest_create_forking_runner_with_config(&config);
 }
@@ -0,0 +1,653 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <ctest/_annotations.h>
+#include <ctest/exec/failure.h>
+#include <ctest/exec/journal.h>
+#include <ctest/exec/location.h>
+#include <ctest/exec/output.h>
+#include <ctest/exec/result.h>
+#include <ctest/exec/suite.h>
+
+#include "utils.h"
+
+/* Results are synced to disk once this many are pending, or once this long
+ * has passed since they last were. */
+#define SYNC_RECORD_COUNT__     64
+#define SYNC_INTERVAL_NS__      1000000000u
+
+/* The fields of a line, the checksum last. */
+enum {
+	FIELD_SUITE__,
+	FIELD_TESTCASE__,
+	FIELD_TYPE__,
+	FIELD_ATTEMPT__,
+	FIELD_DURATION__,
+	FIELD_STAGE__,
+	FIELD_FILE__,
+	FIELD_LINE__,
+	FIELD_DESCRIPTION__,
+	FIELD_OUTPUT__,
+	FIELD_CHECKSUM__,
+	FIELD_COUNT__,
+};
+
+static const char *const type_names__[] = {
+	[CTEST_RESULT_PASS] = "pass",
+	[CTEST_RESULT_FAIL] = "fail",
+	[CTEST_RESULT_SKIPPED] = "skipped",
+	[CTEST_RESULT_ERROR] = "error",
+	[CTEST_RESULT_TIMEOUT] = "timeout",
+	[CTEST_RESULT_CANCELLED] = "cancelled",
+	[CTEST_RESULT_FLAKY] = "flaky",
+	[CTEST_RESULT_LIMIT_EXCEEDED] = "limit-exceeded",
+	[CTEST_RESULT_ISOLATION_VIOLATION] = "isolation-violation",
+};
+
+static const char *const stage_names__[] = {
+	[CTEST_STAGE_SETUP] = "setup",
+	[CTEST_STAGE_EXECUTION] = "execution",
+	[CTEST_STAGE_TEARDOWN] = "teardown",
+};
+
+/**
+ * A loaded result. The fields are unescaped, and point into the storage that
+ * follows the entry.
+ */
+typedef struct journal_entry__ journal_entry_t__;
+struct journal_entry__ {
+	journal_entry_t__ *next;
+	ctest_result_type_t type;
+	unsigned int attempt;
+	uint64_t duration_ns;
+	bool has_failure;
+	ctest_stage_t stage;
+	int line;
+	const char *suite;
+	const char *testcase;
+	const char *file;
+	const char *description;
+	const char *output;
+	size_t output_length;
+	char storage[];
+};
+
+struct ctest_journal {
+	journal_entry_t__ **buckets;
+	size_t bucket_count;
+	size_t entry_count;
+
+	/* The file results are appended to, or -1. */
+	int fd;
+	size_t unsynced_count;
+	uint64_t synced_ns;
+
+	/* The line being written. */
+	char *line;
+	size_t line_length;
+	size_t line_capacity;
+};
+
+static uint64_t now_ns__(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000000000u + now.tv_nsec;
+}
+
+/* FNV-1a, over the suite name, a separator, and the test case name. */
+static uint64_t hash_key__(const char *suite, const char *testcase)
+{
+	uint64_t hash = UINT64_C(0xcbf29ce484222325);
+	const char *p;
+
+	for (p = suite; *p != '\0'; ++p)
+		hash = (hash ^ (unsigned char)*p) * UINT64_C(0x100000001b3);
+	hash = (hash ^ '\t') * UINT64_C(0x100000001b3);
+	for (p = testcase; *p != '\0'; ++p)
+		hash = (hash ^ (unsigned char)*p) * UINT64_C(0x100000001b3);
+	return hash;
+}
+
+/* FNV-1a (32 bits), over the bytes of a line before its checksum. */
+static uint32_t checksum__(const char *data, size_t length)
+{
+	uint32_t hash = UINT32_C(0x811c9dc5);
+	size_t i;
+
+	for (i = 0; i < length; ++i)
+		hash = (hash ^ (unsigned char)data[i]) * UINT32_C(0x01000193);
+	return hash;
+}
+
+static journal_entry_t__ **find__(const ctest_journal_t *journal, const char *suite, const char *testcase)
+{
+	journal_entry_t__ **p_entry = journal->buckets + hash_key__(suite, testcase) % journal->bucket_count;
+
+	for (; *p_entry != NULL; p_entry = &(*p_entry)->next) {
+		if (strcmp((*p_entry)->suite, suite) == 0 && strcmp((*p_entry)->testcase, testcase) == 0)
+			break;
+	}
+	return p_entry;
+}
+
+static int grow__(ctest_journal_t *journal)
+{
+	const size_t bucket_count = journal->bucket_count * 2;
+	journal_entry_t__ **buckets;
+	size_t i;
+
+	if ((buckets = calloc(bucket_count, sizeof(*buckets))) == NULL)
+		return -1;
+
+	for (i = 0; i < journal->bucket_count; ++i) {
+		journal_entry_t__ *entry, *next;
+		for (entry = journal->buckets[i]; entry != NULL; entry = next) {
+			journal_entry_t__ **const p_bucket = buckets + hash_key__(entry->suite, entry->testcase) % bucket_count;
+			next = entry->next;
+			entry->next = *p_bucket;
+			*p_bucket = entry;
+		}
+	}
+
+	(void)free(journal->buckets);
+	journal->buckets = buckets;
+	journal->bucket_count = bucket_count;
+	return 0;
+}
+
+/**
+ * Add an entry to a journal, replacing that of the same test case (if any).
+ */
+static void put__(ctest_journal_t *journal, journal_entry_t__ *entry)
+{
+	journal_entry_t__ **p_entry = find__(journal, entry->suite, entry->testcase);
+
+	if (*p_entry == NULL && journal->entry_count >= journal->bucket_count && grow__(journal) == 0)
+		p_entry = find__(journal, entry->suite, entry->testcase);
+
+	if (*p_entry != NULL) {
+		journal_entry_t__ *const old = *p_entry;
+		entry->next = old->next;
+		(void)free(old);
+	} else {
+		entry->next = NULL;
+		journal->entry_count += 1;
+	}
+	*p_entry = entry;
+}
+
+/**
+ * Remove the entry of a test case from a journal, if it has one.
+ */
+static void remove__(ctest_journal_t *journal, const char *suite, const char *testcase)
+{
+	journal_entry_t__ **const p_entry = find__(journal, suite, testcase);
+	journal_entry_t__ *const entry = *p_entry;
+
+	if (entry == NULL)
+		return;
+	*p_entry = entry->next;
+	(void)free(entry);
+	journal->entry_count -= 1;
+}
+
+/**
+ * Unescape a field in place.
+ *
+ * @return The length of the unescaped field, or <code>SIZE_MAX</code> if it
+ *         has an invalid escape sequence.
+ */
+static size_t unescape__(char *field)
+{
+	const char *in = field;
+	char *out = field;
+
+	while (*in != '\0') {
+		if (*in != '\\') {
+			*(out++) = *(in++);
+			continue;
+		}
+		switch (in[1]) {
+		case '\\': *(out++) = '\\'; break;
+		case 't': *(out++) = '\t'; break;
+		case 'n': *(out++) = '\n'; break;
+		case 'r': *(out++) = '\r'; break;
+		case '0': *(out++) = '\0'; break;
+		default: return SIZE_MAX;
+		}
+		in += 2;
+	}
+	*out = '\0';
+	return (size_t)(out - field);
+}
+
+static bool parse_name__(const char *const names[], size_t name_count, const char *str, unsigned int *p_value)
+{
+	size_t i;
+
+	for (i = 0; i < name_count; ++i) {
+		if (names[i] != NULL && strcmp(names[i], str) == 0) {
+			*p_value = (unsigned int)i;
+			return true;
+		}
+	}
+	return false;
+}
+
+static bool parse_u64__(const char *str, uint64_t *p_value)
+{
+	unsigned long long value;
+	char *end;
+
+	errno = 0;
+	value = strtoull(str, &end, 10);
+	if (errno != 0 || end == str || *end != '\0')
+		return false;
+	*p_value = value;
+	return true;
+}
+
+/**
+ * Parse a line of a journal (without its newline) into a new entry.
+ *
+ * @return The entry, or <code>NULL</code> if the line is malformed (with
+ *         <code>errno</code> set to <code>EINVAL</code>) or on failure.
+ */
+static journal_entry_t__ *parse_line__(const char *line, size_t length)
+{
+	journal_entry_t__ *entry;
+	char *fields[FIELD_COUNT__], *p;
+	size_t field_lengths[FIELD_COUNT__], i;
+	unsigned int type, stage = CTEST_STAGE_SETUP;
+	uint64_t attempt, duration_ns, line_number = 0;
+	unsigned long checksum;
+	char *end;
+
+	if ((entry = malloc(sizeof(*entry) + length + 1)) == NULL)
+		return NULL;
+	memcpy(entry->storage, line, length);
+	entry->storage[length] = '\0';
+
+	for (i = 0, p = entry->storage; i < FIELD_COUNT__; ++i) {
+		fields[i] = p;
+		if ((p = strchr(p, '\t')) == NULL) {
+			if (i + 1 != FIELD_COUNT__)
+				goto malformed;
+			break;
+		}
+		if (i + 1 == FIELD_COUNT__)
+			goto malformed;
+		*(p++) = '\0';
+	}
+
+	/* The checksum covers everything before its own field. */
+	errno = 0;
+	checksum = strtoul(fields[FIELD_CHECKSUM__], &end, 16);
+	if (errno != 0 || end == fields[FIELD_CHECKSUM__] || *end != '\0' ||
+	    checksum != checksum__(line, (size_t)(fields[FIELD_CHECKSUM__] - entry->storage) - 1))
+		goto malformed;
+
+	for (i = 0; i < FIELD_CHECKSUM__; ++i) {
+		if ((field_lengths[i] = unescape__(fields[i])) == SIZE_MAX)
+			goto malformed;
+	}
+	if (!parse_name__(type_names__, countof(type_names__), fields[FIELD_TYPE__], &type) ||
+	    !parse_u64__(fields[FIELD_ATTEMPT__], &attempt) || attempt == 0 || attempt > UINT_MAX ||
+	    !parse_u64__(fields[FIELD_DURATION__], &duration_ns))
+		goto malformed;
+	entry->has_failure = strcmp(fields[FIELD_STAGE__], "-") != 0;
+	if (entry->has_failure && (!parse_name__(stage_names__, countof(stage_names__), fields[FIELD_STAGE__], &stage) ||
+	    (*fields[FIELD_LINE__] != '\0' && (!parse_u64__(fields[FIELD_LINE__], &line_number) || line_number > INT_MAX))))
+		goto malformed;
+
+	entry->next = NULL;
+	entry->type = (ctest_result_type_t)type;
+	entry->attempt = (unsigned int)attempt;
+	entry->duration_ns = duration_ns;
+	entry->stage = (ctest_stage_t)stage;
+	entry->line = (int)line_number;
+	entry->suite = fields[FIELD_SUITE__];
+	entry->testcase = fields[FIELD_TESTCASE__];
+	entry->file = fields[FIELD_FILE__];
+	entry->description = fields[FIELD_DESCRIPTION__];
+	entry->output = fields[FIELD_OUTPUT__];
+	entry->output_length = field_lengths[FIELD_OUTPUT__];
+	return entry;
+
+malformed:
+	(void)free(entry);
+	errno = EINVAL;
+	return NULL;
+}
+
+/**
+ * Whether a result is that of a test case that passed, and isn't to be run
+ * again when the test cases that didn't pass are rerun (skipped test cases
+ * included, since what they were skipped for may have changed).
+ */
+static bool type_is_pass__(ctest_result_type_t type)
+{
+	return type == CTEST_RESULT_PASS || type == CTEST_RESULT_FLAKY;
+}
+
+static int reserve__(ctest_journal_t *journal, size_t length)
+{
+	char *line;
+	size_t capacity;
+
+	if (journal->line_length + length <= journal->line_capacity)
+		return 0;
+	capacity = journal->line_capacity > 0 ? journal->line_capacity : 256;
+	while (capacity < journal->line_length + length)
+		capacity *= 2;
+	if ((line = realloc(journal->line, capacity)) == NULL)
+		return -1;
+	journal->line = line;
+	journal->line_capacity = capacity;
+	return 0;
+}
+
+/**
+ * Append a field to the line being written, escaped and preceded by a tab
+ * unless it's the first.
+ *
+ * @return Zero on success, non-zero on failure.
+ */
+static int append_field__(ctest_journal_t *journal, const char *data, size_t length)
+{
+	size_t i;
+
+	/* At worst, every byte is escaped. */
+	if (reserve__(journal, 1 + 2 * length) != 0)
+		return -1;
+	if (journal->line_length > 0)
+		journal->line[journal->line_length++] = '\t';
+	for (i = 0; i < length; ++i) {
+		char escape;
+
+		switch (data[i]) {
+		case '\\': escape = '\\'; break;
+		case '\t': escape = 't'; break;
+		case '\n': escape = 'n'; break;
+		case '\r': escape = 'r'; break;
+		case '\0': escape = '0'; break;
+		default:
+			journal->line[journal->line_length++] = data[i];
+			continue;
+		}
+		journal->line[journal->line_length++] = '\\';
+		journal->line[journal->line_length++] = escape;
+	}
+	return 0;
+}
+
+static int append_string__(ctest_journal_t *journal, const char *str)
+{
+	return append_field__(journal, str, strlen(str));
+}
+
+static int append_u64__(ctest_journal_t *journal, uint64_t value)
+{
+	char buf[24];
+
+	snprintf(buf, sizeof(buf), "%" PRIu64, value);
+	return append_string__(journal, buf);
+}
+
+/**
+ * Write all of a buffer to a file descriptor.
+ *
+ * @return Zero on success, non-zero (with <code>errno</code> set) on failure.
+ */
+static int write_fully__(int fd, const char *data, size_t length)
+{
+	while (length > 0) {
+		const ssize_t written = write(fd, data, length);
+		if (written < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		data += written;
+		length -= (size_t)written;
+	}
+	return 0;
+}
+
+ctest_journal_t *ctest_journal_create(void)
+{
+	ctest_journal_t *journal;
+
+	if ((journal = calloc(1, sizeof(*journal))) == NULL)
+		goto alloc_journal_failed;
+	journal->bucket_count = 64;
+	if ((journal->buckets = calloc(journal->bucket_count, sizeof(*journal->buckets))) == NULL)
+		goto alloc_buckets_failed;
+	journal->fd = -1;
+	return journal;
+
+alloc_buckets_failed:
+	(void)free(journal);
+alloc_journal_failed:
+	return NULL;
+}
+
+CTEST_ALL_NONNULL_ARGS__
+void ctest_journal_destroy(ctest_journal_t *journal)
+{
+	size_t i;
+
+	if (journal->fd >= 0) {
+		(void)ctest_journal_sync(journal);
+		(void)close(journal->fd);
+	}
+	for (i = 0; i < journal->bucket_count; ++i) {
+		journal_entry_t__ *entry, *next;
+		for (entry = journal->buckets[i]; entry != NULL; entry = next) {
+			next = entry->next;
+			(void)free(entry);
+		}
+	}
+	(void)free(journal->buckets);
+	(void)free(journal->line);
+	memset(journal, 0, sizeof(*journal));
+	(void)free(journal);
+}
+
+CTEST_ALL_NONNULL_ARGS__
+int ctest_journal_load(ctest_journal_t *journal, const char *filename, bool replay_failed)
+{
+	char *line = NULL;
+	size_t line_capacity = 0;
+	ssize_t length;
+	FILE *fp;
+	int result = 0;
+
+	if ((fp = fopen(filename, "re")) == NULL)
+		return errno == ENOENT ? 0 : -1;
+
+	while ((length = getline(&line, &line_capacity, fp)) >= 0) {
+		journal_entry_t__ *entry;
+
+		/* A line without its newline was cut short. */
+		if (length == 0 || line[length - 1] != '\n' || line[0] == '#')
+			continue;
+		if ((entry = parse_line__(line, (size_t)length - 1)) == NULL) {
+			if (errno == EINVAL)
+				continue;
+			result = -1;
+			break;
+		}
+
+		/* The last line of a test case counts, even if it's one that
+		 * isn't replayed. */
+		if (entry->type == CTEST_RESULT_CANCELLED || (!replay_failed && !type_is_pass__(entry->type))) {
+			remove__(journal, entry->suite, entry->testcase);
+			(void)free(entry);
+			continue;
+		}
+		put__(journal, entry);
+	}
+
+	(void)free(line);
+	(void)fclose(fp);
+	return result;
+}
+
+CTEST_ALL_NONNULL_ARGS__
+int ctest_journal_open(ctest_journal_t *journal, const char *filename)
+{
+	struct stat st;
+	char last;
+	int fd;
+
+	if ((fd = open(filename, O_RDWR | O_APPEND | O_CREAT | O_CLOEXEC, 0644)) < 0)
+		goto open_failed;
+	if (fstat(fd, &st) != 0)
+		goto end_line_failed;
+	/* End a line cut short by a crash, so it doesn't run into the first
+	 * line appended now. */
+	if (st.st_size > 0 && pread(fd, &last, 1, st.st_size - 1) == 1 && last != '\n' && write_fully__(fd, "\n", 1) != 0)
+		goto end_line_failed;
+
+	if (journal->fd >= 0) {
+		(void)ctest_journal_sync(journal);
+		(void)close(journal->fd);
+	}
+	journal->fd = fd;
+	journal->unsynced_count = 0;
+	journal->synced_ns = now_ns__();
+	return 0;
+
+end_line_failed:
+	(void)close(fd);
+open_failed:
+	return -1;
+}
+
+CTEST_ALL_NONNULL_ARGS__
+size_t ctest_journal_get_loaded_count(const ctest_journal_t *journal)
+{
+	return journal->entry_count;
+}
+
+CTEST_ALL_NONNULL_ARGS__
+int ctest_journal_replay(ctest_journal_t *journal, ctest_testcase_t *testcase, ctest_result_t **p_result)
+{
+	const char *const suite_name = ctest_testsuite_get_name(ctest_test_get_testsuite(ctest_testcase_get_test(testcase)));
+	const journal_entry_t__ *const entry = *find__(journal, suite_name, ctest_testcase_get_name(testcase));
+	ctest_result_t *result;
+	ctest_failure_t *failure = NULL;
+	ctest_output_t *output;
+
+	*p_result = NULL;
+	if (entry == NULL)
+		return 0;
+
+	if ((result = ctest_result_create_empty()) == NULL)
+		goto result_create_failed;
+	if (entry->has_failure) {
+		const ctest_location_t location = { entry->file, entry->line };
+		if ((failure = ctest_failure_create(entry->stage, "%s", *entry->file != '\0' ? &location : NULL, NULL, entry->description)) == NULL)
+			goto failure_create_failed;
+	}
+	if (ctest_result_set_failure(result, entry->type, failure) != 0)
+		goto set_failure_failed;
+	failure = NULL;
+	if (entry->output_length > 0) {
+		if ((output = ctest_output_create(entry->output_length)) == NULL)
+			goto output_create_failed;
+		memcpy(output->data, entry->output, entry->output_length);
+		if (ctest_result_set_output(result, output) != 0) {
+			ctest_output_destroy(output);
+			goto output_create_failed;
+		}
+	}
+	result->duration_ns = entry->duration_ns;
+	result->attempt = entry->attempt;
+
+	*p_result = result;
+	return 0;
+
+output_create_failed:
+set_failure_failed:
+	if (failure != NULL)
+		ctest_failure_destroy(failure);
+failure_create_failed:
+	ctest_result_destroy(result);
+result_create_failed:
+	return -1;
+}
+
+CTEST_ALL_NONNULL_ARGS__
+int ctest_journal_record(ctest_journal_t *journal, ctest_testcase_t *testcase, const ctest_result_t *result)
+{
+	const ctest_failure_t *const failure = result->failure;
+	const ctest_location_t *const location = failure != NULL ? failure->location : NULL;
+	char checksum[16];
+
+	if (journal->fd < 0 || result->type == CTEST_RESULT_CANCELLED)
+		return 0;
+	if ((size_t)result->type >= countof(type_names__) || type_names__[result->type] == NULL) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	journal->line_length = 0;
+	if (append_string__(journal, ctest_testsuite_get_name(ctest_test_get_testsuite(ctest_testcase_get_test(testcase)))) != 0 ||
+	    append_string__(journal, ctest_testcase_get_name(testcase)) != 0 ||
+	    append_string__(journal, type_names__[result->type]) != 0 ||
+	    append_u64__(journal, result->attempt > 0 ? result->attempt : 1) != 0 ||
+	    append_u64__(journal, result->duration_ns) != 0)
+		return -1;
+	if (failure != NULL && (size_t)failure->stage < countof(stage_names__)) {
+		if (append_string__(journal, stage_names__[failure->stage]) != 0 ||
+		    append_string__(journal, location != NULL && location->filename != NULL ? location->filename : "") != 0 ||
+		    (location != NULL && location->filename != NULL ? append_u64__(journal, location->line > 0 ? (uint64_t)location->line : 0) : append_string__(journal, "")) != 0 ||
+		    append_string__(journal, failure->description != NULL ? failure->description : "") != 0)
+			return -1;
+	} else {
+		if (append_string__(journal, "-") != 0 || append_string__(journal, "") != 0 ||
+		    append_string__(journal, "") != 0 || append_string__(journal, "") != 0)
+			return -1;
+	}
+	if (append_field__(journal, result->output != NULL ? result->output->data : "", result->output != NULL ? result->output->length : 0) != 0)
+		return -1;
+
+	snprintf(checksum, sizeof(checksum), "\t%08" PRIx32 "\n", checksum__(journal->line, journal->line_length));
+	if (reserve__(journal, strlen(checksum)) != 0)
+		return -1;
+	memcpy(journal->line + journal->line_length, checksum, strlen(checksum));
+	journal->line_length += strlen(checksum);
+
+	/* One write per line, so only the last line can be cut short. */
+	if (write_fully__(journal->fd, journal->line, journal->line_length) != 0)
+		return -1;
+
+	journal->unsynced_count += 1;
+	if (journal->unsynced_count >= SYNC_RECORD_COUNT__ || now_ns__() - journal->synced_ns >= SYNC_INTERVAL_NS__)
+		return ctest_journal_sync(journal);
+	return 0;
+}
+
+CTEST_ALL_NONNULL_ARGS__
+int ctest_journal_sync(ctest_journal_t *journal)
+{
+	if (journal->fd < 0 || journal->unsynced_count == 0)
+		return 0;
+	if (fdatasync(journal->fd) != 0)
+		return -1;
+	journal->unsynced_count = 0;
+	journal->synced_ns = now_ns__();
+	return 0;
+}
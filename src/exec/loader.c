@@ -14,15 +14,32 @@
 #include <ctest/tests/tests.h>
 
 #include "dynamic_ops.h"
+#include "ports.h"
+#include "resources.h"
 #include "utils.h"
 
 /*
  * Test Suite Structures
  */
+typedef struct fixture__ fixture_t__;
 typedef struct testcase__ testcase_t__;
 typedef struct test__ test_t__;
 typedef struct testsuite__ testsuite_t__;
 
+struct fixture__ {
+	ctest_fixture_t base;
+	testsuite_t__ *testsuite;
+	ctest_def_fixture_provider_t__ *provider;
+	const char *name;
+	ctest_fixture_scope_t scope;
+
+	/**
+	 * The state of the fixture, if it has been set up in this process (or
+	 * in the one it was forked from), or <code>NULL</code>.
+	 */
+	void *state;
+};
+
 struct testcase__ {
 	ctest_testcase_t base;
 	test_t__ *test;
@@ -36,15 +53,31 @@ struct test__ {
 	ctest_def_test_t__ *def;
 	ctest_testcase_t *const*testcases;
 	size_t testcase_count;
+	fixture_t__ *shared_fixture;
+
+	/**
+	 * The tests the test depends on (NULL-terminated), or
+	 * <code>NULL</code> if it has none.
+	 */
+	ctest_test_t **prerequisites;
 };
 
 struct testsuite__ {
 	ctest_testsuite_t base;
 	lt_dlhandle handle;
+	const char *filename;
 	ctest_def_suite_t__ *def;
 	ctest_dynamic_ops_t **p_dynamic_ops;
+	ctest_dynamic_ops_locator_t locate_dynamic_ops;
 	ctest_test_t *const*tests;
 	size_t test_count;
+
+	/**
+	 * The shared fixtures of the suite's tests, one for each fixture
+	 * provider.
+	 */
+	fixture_t__ **fixtures;
+	size_t fixture_count;
 };
 
 /*
@@ -135,6 +168,47 @@ static void dynamic_ops_op_abort__(ctest_dynamic_ops_t *ctest_dynamic_ops, ctest
 	dynamic_ops_abort__(upcast_dynamic_ops__(ctest_dynamic_ops), abort_type);
 }
 
+/**
+ * Initialize dynamic operations and hook them into how the module reports
+ * failures (they're automatically unhooked on failure).
+ */
+static void dynamic_ops_init__(loader_dynamic_ops_t__ *dynamic_ops, ctest_exec_hooks_t *hooks, ctest_dynamic_ops_t **p_dynamic_ops, ctest_stage_t stage)
+{
+	static ctest_dynamic_ops_ops_t ops = {
+		&dynamic_ops_op_report_failure__,
+		&dynamic_ops_op_abort__,
+	};
+
+	dynamic_ops->base.ops = &ops;
+	dynamic_ops->hooks = hooks;
+	dynamic_ops->p_dynamic_ops = p_dynamic_ops;
+	dynamic_ops->failure = NULL;
+	dynamic_ops->stage = stage;
+	dynamic_ops->fixture = NULL;
+	dynamic_ops->teardown = NULL;
+	dynamic_ops->abort_type = CTEST_DYNAMIC_OPS_ABORT_NONE;
+	dynamic_ops->free_fixture = false;
+
+	if (p_dynamic_ops != NULL) {
+		dynamic_ops->old_dynamic_ops = *p_dynamic_ops;
+		*p_dynamic_ops = &dynamic_ops->base;
+	}
+}
+
+/**
+ * Remove dynamic operations from the module for reporting failures.
+ */
+static void dynamic_ops_restore__(loader_dynamic_ops_t__ *dynamic_ops)
+{
+	if (dynamic_ops->p_dynamic_ops != NULL)
+		*dynamic_ops->p_dynamic_ops = dynamic_ops->old_dynamic_ops;
+}
+
+static ctest_dynamic_ops_t **testsuite_locate_dynamic_ops__(testsuite_t__ *testsuite)
+{
+	return testsuite->locate_dynamic_ops != NULL ? (*testsuite->locate_dynamic_ops)() : testsuite->p_dynamic_ops;
+}
+
 /*
  * Null Data Provider
  */
@@ -153,6 +227,146 @@ static ctest_def_data_provider_t__ null_data_provider__ = {
 	&null_data_provider_to_string__,
 };
 
+/*
+ * Shared Fixtures
+ */
+
+static inline fixture_t__ *upcast_fixture__(ctest_fixture_t *fixture)
+{
+	return containerof(fixture, fixture_t__, base);
+}
+
+CTEST_ALL_NONNULL_ARGS__ CTEST_RETURNS_NONNULL__
+static const char *fixture_op_get_name__(ctest_fixture_t *ctest_fixture)
+{
+	fixture_t__ *const fixture = upcast_fixture__(ctest_fixture);
+	return fixture->name;
+}
+
+CTEST_ALL_NONNULL_ARGS__
+static ctest_fixture_scope_t fixture_op_get_scope__(ctest_fixture_t *ctest_fixture)
+{
+	fixture_t__ *const fixture = upcast_fixture__(ctest_fixture);
+	return fixture->scope;
+}
+
+CTEST_ALL_NONNULL_ARGS__
+static void fixture_op_setup__(ctest_fixture_t *ctest_fixture, ctest_exec_hooks_t *hooks)
+{
+	fixture_t__ *const fixture = upcast_fixture__(ctest_fixture);
+	ctest_def_fixture_provider_t__ *const provider = fixture->provider;
+	loader_dynamic_ops_t__ dynamic_ops;
+	void *state;
+
+	ctest_exec_hooks_on_stage_change(hooks, CTEST_STAGE_SETUP);
+
+	/* The state outlives this call, so it is never on the stack. */
+	if ((state = calloc(1, provider->size > 0 ? provider->size : 1)) == NULL)
+		ctest_exec_hooks_on_failure(hooks, ctest_failure_create(CTEST_STAGE_SETUP, "fixture allocation failure: %s", NULL, NULL, strerror(errno)));
+
+	dynamic_ops_init__(&dynamic_ops, hooks, testsuite_locate_dynamic_ops__(fixture->testsuite), CTEST_STAGE_SETUP);
+	dynamic_ops.fixture = state;
+	dynamic_ops.teardown = provider->teardown;
+	dynamic_ops.free_fixture = true;
+
+	if (provider->setup != NULL)
+		(*provider->setup)(state);
+	if (dynamic_ops.failure != NULL) {
+		/* An error was reported but not in conjunction with an
+		 * abort; promote to an abort (tearing the fixture down). */
+		dynamic_ops_abort__(&dynamic_ops, CTEST_DYNAMIC_OPS_ABORT_FAIL);
+	}
+
+	dynamic_ops_restore__(&dynamic_ops);
+	fixture->state = state;
+}
+
+CTEST_ALL_NONNULL_ARGS__
+static void fixture_op_teardown__(ctest_fixture_t *ctest_fixture, ctest_exec_hooks_t *hooks)
+{
+	fixture_t__ *const fixture = upcast_fixture__(ctest_fixture);
+	ctest_def_fixture_provider_t__ *const provider = fixture->provider;
+	void *const state = fixture->state;
+	loader_dynamic_ops_t__ dynamic_ops;
+
+	if (state == NULL)
+		return;
+	ctest_exec_hooks_on_stage_change(hooks, CTEST_STAGE_TEARDOWN);
+
+	/* Whatever happens, the fixture is no longer set up. */
+	fixture->state = NULL;
+	dynamic_ops_init__(&dynamic_ops, hooks, testsuite_locate_dynamic_ops__(fixture->testsuite), CTEST_STAGE_TEARDOWN);
+	dynamic_ops.fixture = state;
+	dynamic_ops.free_fixture = true;
+
+	if (provider->teardown != NULL)
+		(*provider->teardown)(state);
+	if (dynamic_ops.failure != NULL)
+		dynamic_ops_abort__(&dynamic_ops, CTEST_DYNAMIC_OPS_ABORT_FAIL);
+
+	dynamic_ops_restore__(&dynamic_ops);
+	(void)free(state);
+}
+
+/**
+ * Determine which test cases share the fixture of a fixture provider.
+ *
+ * @param p_scope Populated with the scope of the fixture, if it is shared.
+ *
+ * @return Whether the fixture is shared (otherwise, each test case sets up its
+ *         own).
+ */
+static bool fixture_provider_get_scope__(testsuite_t__ *testsuite, ctest_def_fixture_provider_t__ *provider, ctest_fixture_scope_t *p_scope)
+{
+	/* Modules built before fixtures had scopes don't have them. */
+	if (testsuite->def->version < 2 || provider->scope == NULL)
+		return false;
+	switch (*provider->scope) {
+	case CTEST_FIXTURE_SCOPE_SUITE__:
+		*p_scope = CTEST_FIXTURE_SCOPE_SUITE;
+		return true;
+	case CTEST_FIXTURE_SCOPE_TEST__:
+		*p_scope = CTEST_FIXTURE_SCOPE_TEST;
+		return true;
+	}
+	return false;
+}
+
+/**
+ * Get the shared fixture of a test for a fixture provider: the suite's, if
+ * another test of the suite already uses it with the scope of the suite, or a
+ * new one otherwise.
+ *
+ * @return The fixture, or <code>NULL</code> on failure.
+ */
+static fixture_t__ *testsuite_get_shared_fixture__(testsuite_t__ *testsuite, ctest_def_fixture_provider_t__ *provider, ctest_fixture_scope_t scope)
+{
+	static ctest_fixture_ops_t ops = {
+		&fixture_op_get_name__,
+		&fixture_op_get_scope__,
+		&fixture_op_setup__,
+		&fixture_op_teardown__,
+	};
+	fixture_t__ *fixture;
+	size_t i;
+
+	for (i = 0; scope == CTEST_FIXTURE_SCOPE_SUITE && i < testsuite->fixture_count; ++i) {
+		if (testsuite->fixtures[i]->provider == provider && testsuite->fixtures[i]->scope == scope)
+			return testsuite->fixtures[i];
+	}
+
+	if ((fixture = calloc(1, sizeof(*fixture))) == NULL)
+		return NULL;
+	fixture->base.ops = &ops;
+	fixture->testsuite = testsuite;
+	fixture->provider = provider;
+	fixture->name = provider->name != NULL ? provider->name : "fixture";
+	fixture->scope = scope;
+	fixture->state = NULL;
+	testsuite->fixtures[testsuite->fixture_count++] = fixture;
+	return fixture;
+}
+
 /*
  * Test case
  */
@@ -179,40 +393,26 @@ static ctest_test_t *testcase_op_get_test__(ctest_testcase_t *ctest_testcase)
 CTEST_ALL_NONNULL_ARGS__ CTEST_RETURNS_NONNULL__
 static void testcase_op_execute__(ctest_testcase_t *ctest_testcase, ctest_exec_hooks_t *hooks)
 {
-	static ctest_dynamic_ops_ops_t ops = {
-		&dynamic_ops_op_report_failure__,
-		&dynamic_ops_op_abort__,
-	};
-	static ctest_def_fixture_provider_t__ default_fixture_provider = { NULL, NULL, 0, };
+	static ctest_def_fixture_provider_t__ default_fixture_provider = { NULL, NULL, 0, NULL, NULL, };
 
 	testcase_t__ *const testcase = upcast_testcase__(ctest_testcase);
 	test_t__*const test = testcase->test;
-	testsuite_t__*const testsuite = test->testsuite;
 	ctest_def_test_t__ *const test_def = test->def;
 	ctest_def_fixture_provider_t__ *const fixture_provider = test_def->fixture_provider ?: &default_fixture_provider;
+	fixture_t__ *const shared_fixture = test->shared_fixture != NULL && test->shared_fixture->state != NULL ? test->shared_fixture : NULL;
 	loader_dynamic_ops_t__ dynamic_ops;
 	char fixture_storage[128];
 
-	dynamic_ops.base.ops = &ops;
-	dynamic_ops.hooks = hooks;
-	dynamic_ops.p_dynamic_ops = testsuite->p_dynamic_ops;
-	dynamic_ops.failure = NULL;
-	dynamic_ops.fixture = NULL;
-	dynamic_ops.teardown = fixture_provider->teardown;
-	dynamic_ops.abort_type = CTEST_DYNAMIC_OPS_ABORT_NONE;
-	dynamic_ops.free_fixture = false;
-
-	/* Hook us into how the module reports failures (it's automatically
-	 * unhooked on failure). */
-	if (testsuite->p_dynamic_ops != NULL) {
-		dynamic_ops.old_dynamic_ops = *(testsuite->p_dynamic_ops);
-		*(testsuite->p_dynamic_ops) = &dynamic_ops.base;
-	}
+	/* A shared fixture that has been set up is torn down once, after all
+	 * the test cases sharing it. */
+	dynamic_ops_init__(&dynamic_ops, hooks, testsuite_locate_dynamic_ops__(test->testsuite), CTEST_STAGE_SETUP);
+	dynamic_ops.teardown = shared_fixture == NULL ? fixture_provider->teardown : NULL;
 
-	dynamic_ops.stage = CTEST_STAGE_SETUP;
 	ctest_exec_hooks_on_stage_change(hooks, CTEST_STAGE_SETUP);
 
-	if (fixture_provider->size > sizeof(fixture_storage)) {
+	if (shared_fixture != NULL) {
+		dynamic_ops.fixture = shared_fixture->state;
+	} else if (fixture_provider->size > sizeof(fixture_storage)) {
 		if ((dynamic_ops.fixture = calloc(1, fixture_provider->size)) == NULL) {
 			ctest_exec_hooks_on_failure(hooks, ctest_failure_create(CTEST_STAGE_SETUP, "fixture allocation failure: %s", NULL, NULL, strerror(errno)));
 			return;
@@ -223,7 +423,7 @@ static void testcase_op_execute__(ctest_testcase_t *ctest_testcase, ctest_exec_h
 		memset(fixture_storage, 0, sizeof(fixture_storage));
 	}
 
-	if (fixture_provider->setup != NULL)
+	if (shared_fixture == NULL && fixture_provider->setup != NULL)
 		(*fixture_provider->setup)(dynamic_ops.fixture);
 
 	dynamic_ops.stage = CTEST_STAGE_EXECUTION;
@@ -246,10 +446,7 @@ static void testcase_op_execute__(ctest_testcase_t *ctest_testcase, ctest_exec_h
 		dynamic_ops_abort__(&dynamic_ops, CTEST_DYNAMIC_OPS_ABORT_FAIL);
 	}
 
-	/* Remove dynamic operations from module for reporting failures. */
-	if (testsuite->p_dynamic_ops != NULL) {
-		*(testsuite->p_dynamic_ops) = dynamic_ops.old_dynamic_ops;
-	}
+	dynamic_ops_restore__(&dynamic_ops);
 
 	if (dynamic_ops.free_fixture)
 		(void)free(dynamic_ops.fixture);
@@ -356,6 +553,58 @@ static ctest_testcase_t *const*test_op_get_testcases__(ctest_test_t *ctest_test)
 	return test->testcases;
 }
 
+CTEST_ALL_NONNULL_ARGS__
+static uint64_t test_op_get_timeout_ns__(ctest_test_t *ctest_test)
+{
+	test_t__ *const test = upcast_test__(ctest_test);
+	double timeout;
+
+	/* Modules built before tests had attributes don't have them. */
+	if (test->testsuite->def->version < 1 || test->def->timeout == NULL)
+		return 0;
+	if ((timeout = *test->def->timeout) <= 0)
+		return 0;
+	return (uint64_t)(timeout * 1e9);
+}
+
+CTEST_ALL_NONNULL_ARGS__
+static ctest_fixture_t *test_op_get_shared_fixture__(ctest_test_t *ctest_test)
+{
+	test_t__ *const test = upcast_test__(ctest_test);
+	return test->shared_fixture != NULL ? &test->shared_fixture->base : NULL;
+}
+
+CTEST_ALL_NONNULL_ARGS__ CTEST_RETURNS_NONNULL__
+static const char *const *test_op_get_tags__(ctest_test_t *ctest_test)
+{
+	static const char *const no_tags[] = { NULL };
+	test_t__ *const test = upcast_test__(ctest_test);
+
+	if (test->testsuite->def->version < 3 || test->def->tags == NULL || *test->def->tags == NULL)
+		return no_tags;
+	return *test->def->tags;
+}
+
+CTEST_ALL_NONNULL_ARGS__ CTEST_RETURNS_NONNULL__
+static ctest_test_t *const *test_op_get_prerequisites__(ctest_test_t *ctest_test)
+{
+	static ctest_test_t *const no_prerequisites[] = { NULL };
+	test_t__ *const test = upcast_test__(ctest_test);
+
+	return test->prerequisites != NULL ? test->prerequisites : no_prerequisites;
+}
+
+CTEST_ALL_NONNULL_ARGS__ CTEST_RETURNS_NONNULL__
+static const char *const *test_op_get_resources__(ctest_test_t *ctest_test)
+{
+	static const char *const no_resources[] = { NULL };
+	test_t__ *const test = upcast_test__(ctest_test);
+
+	if (test->testsuite->def->version < 5 || test->def->resources == NULL || *test->def->resources == NULL)
+		return no_resources;
+	return *test->def->resources;
+}
+
 static test_t__ *test_create__(testsuite_t__ *testsuite, ctest_def_test_t__ *test_def)
 {
 	static ctest_test_ops_t ops = {
@@ -363,9 +612,15 @@ static test_t__ *test_create__(testsuite_t__ *testsuite, ctest_def_test_t__ *tes
 		&test_op_get_testsuite__,
 		&test_op_get_testcase_count__,
 		&test_op_get_testcases__,
+		&test_op_get_timeout_ns__,
+		&test_op_get_shared_fixture__,
+		&test_op_get_tags__,
+		&test_op_get_prerequisites__,
+		&test_op_get_resources__,
 	};
 
 	ctest_def_data_provider_t__ *const data_provider = test_def->data_provider ? test_def->data_provider : &null_data_provider__;
+	ctest_fixture_scope_t scope;
 	test_t__ *result;
 	ctest_testcase_t **testcases;
 	size_t i;
@@ -382,6 +637,10 @@ static test_t__ *test_create__(testsuite_t__ *testsuite, ctest_def_test_t__ *tes
 	result->testcases = testcases;
 	result->testcase_count = data_provider->count;
 
+	if (test_def->fixture_provider != NULL && fixture_provider_get_scope__(testsuite, test_def->fixture_provider, &scope) &&
+	    (result->shared_fixture = testsuite_get_shared_fixture__(testsuite, test_def->fixture_provider, scope)) == NULL)
+		goto shared_fixture_failed;
+
 	for (i = 0; i < data_provider->count; ++i) {
 		testcase_t__ *testcase;
 		if ((testcase = testcase_create__(result, data_provider, i)) == NULL)
@@ -396,6 +655,7 @@ testcase_create_failed:
 		if (testcases[i] != NULL)
 			testcase_destroy__(upcast_testcase__(testcases[i]));
 	}
+shared_fixture_failed:
 	(void)free(testcases);
 testcases_alloc_failed:
 	(void)free(result);
@@ -411,6 +671,7 @@ static void test_destroy__(test_t__ *test)
 		testcase_destroy__(upcast_testcase__(testcases[i]));
 	}
 	(void)free(testcases);
+	(void)free(test->prerequisites);
 	memset(test, 0, sizeof(*test));
 	(void)free(test);
 }
@@ -444,6 +705,176 @@ static ctest_test_t *const*testsuite_op_get_tests__(ctest_testsuite_t *ctest_tes
 	return testsuite->tests;
 }
 
+CTEST_ALL_NONNULL_ARGS__
+static const char *testsuite_op_get_filename__(ctest_testsuite_t *ctest_testsuite)
+{
+	testsuite_t__ *const testsuite = upcast_testsuite__(ctest_testsuite);
+	return testsuite->filename;
+}
+
+/**
+ * Resolve the names of the tests each test of a suite depends on (see
+ * <code>CT_TEST_DEPENDS_ON</code>).
+ *
+ * @return Zero on success, non-zero (having printed why, if a test depends on
+ *         one the suite doesn't have) on failure.
+ */
+CTEST_ALL_NONNULL_ARGS__
+static int testsuite_resolve_prerequisites__(testsuite_t__ *testsuite)
+{
+	size_t i_test, i_name, i_found;
+
+	/* Modules built before tests had dependencies don't have them. */
+	if (testsuite->def->version < 4)
+		return 0;
+
+	for (i_test = 0; i_test < testsuite->test_count; ++i_test) {
+		test_t__ *const test = upcast_test__(testsuite->tests[i_test]);
+		const char *const *names;
+		size_t count;
+
+		if (test->def->depends_on == NULL || (names = *test->def->depends_on) == NULL)
+			continue;
+		for (count = 0; names[count] != NULL; ++count)
+			;
+		if ((test->prerequisites = calloc(count + 1, sizeof(*test->prerequisites))) == NULL)
+			return -1;
+
+		for (i_name = 0; i_name < count; ++i_name) {
+			for (i_found = 0; i_found < testsuite->test_count; ++i_found) {
+				if (strcmp(upcast_test__(testsuite->tests[i_found])->def->name, names[i_name]) == 0)
+					break;
+			}
+			if (i_found == testsuite->test_count) {
+				fprintf(stderr, "test %s:%s depends on unknown test %s\n", testsuite->def->name, test->def->name, names[i_name]);
+				errno = EINVAL;
+				return -1;
+			}
+			test->prerequisites[i_name] = testsuite->tests[i_found];
+		}
+	}
+	return 0;
+}
+
+/**
+ * Check that none of the tests a test (indirectly) depends on depends on the
+ * test itself, by depth-first search.
+ *
+ * @param testsuite The suite of the test.
+ * @param test      The test to check.
+ * @param states    The state of each test of the suite: zero if not visited
+ *                  yet, one if on the path being searched, two if checked.
+ * @param path      The tests on the path being searched.
+ * @param depth     The number of tests on the path.
+ *
+ * @return Zero if there is no cycle, non-zero (having printed it) otherwise.
+ */
+CTEST_ALL_NONNULL_ARGS__
+static int testsuite_check_cycles__(testsuite_t__ *testsuite, test_t__ *test, unsigned char *states, test_t__ **path, size_t depth)
+{
+	ctest_test_t *const *prerequisite;
+	size_t i, i_path;
+
+	for (i = 0; testsuite->tests[i] != &test->base; ++i)
+		;
+	if (states[i] == 2)
+		return 0;
+	if (states[i] == 1) {
+		for (i_path = 0; path[i_path] != test; ++i_path)
+			;
+		fprintf(stderr, "tests of suite %s depend on one another:", testsuite->def->name);
+		for (; i_path < depth; ++i_path)
+			fprintf(stderr, " %s ->", path[i_path]->def->name);
+		fprintf(stderr, " %s\n", test->def->name);
+		errno = EINVAL;
+		return -1;
+	}
+
+	states[i] = 1;
+	path[depth] = test;
+	for (prerequisite = test->prerequisites; prerequisite != NULL && *prerequisite != NULL; ++prerequisite) {
+		if (testsuite_check_cycles__(testsuite, upcast_test__(*prerequisite), states, path, depth + 1) != 0)
+			return -1;
+	}
+	states[i] = 2;
+	return 0;
+}
+
+/**
+ * Resolve the dependencies between the tests of a suite, rejecting those on
+ * tests the suite doesn't have and those that form a cycle.
+ *
+ * @return Zero on success, non-zero on failure.
+ */
+CTEST_ALL_NONNULL_ARGS__
+static int testsuite_link_tests__(testsuite_t__ *testsuite)
+{
+	unsigned char *states;
+	test_t__ **path;
+	size_t i;
+	int result = -1;
+
+	if (testsuite->test_count == 0)
+		return 0;
+	if (testsuite_resolve_prerequisites__(testsuite) != 0)
+		goto resolve_failed;
+
+	if ((states = calloc(testsuite->test_count, sizeof(*states))) == NULL)
+		goto states_alloc_failed;
+	if ((path = calloc(testsuite->test_count, sizeof(*path))) == NULL)
+		goto path_alloc_failed;
+
+	result = 0;
+	for (i = 0; result == 0 && i < testsuite->test_count; ++i)
+		result = testsuite_check_cycles__(testsuite, upcast_test__(testsuite->tests[i]), states, path, 0);
+
+	(void)free(path);
+path_alloc_failed:
+	(void)free(states);
+states_alloc_failed:
+resolve_failed:
+	return result;
+}
+
+/**
+ * Check that the resources each test of a suite uses (see
+ * <code>CT_TEST_RESOURCES</code>) are well formed.
+ *
+ * @return Zero on success, non-zero (having printed the first malformed one)
+ *         on failure.
+ */
+CTEST_ALL_NONNULL_ARGS__
+static int testsuite_check_resources__(testsuite_t__ *testsuite)
+{
+	const char *const *resource;
+	unsigned long amount;
+	size_t i, length;
+
+	for (i = 0; i < testsuite->test_count; ++i) {
+		test_t__ *const test = upcast_test__(testsuite->tests[i]);
+
+		for (resource = test_op_get_resources__(&test->base); *resource != NULL; ++resource) {
+			if (resource_parse(*resource, ':', &length, &amount) != 0) {
+				fprintf(stderr, "test %s:%s has invalid resource %s\n", testsuite->def->name, test->def->name, *resource);
+				return -1;
+			}
+		}
+	}
+	return 0;
+}
+
+/*
+ * A module that can report failures only has one set of dynamic operations to
+ * report them through, unless it can locate each thread's own.
+ */
+CTEST_ALL_NONNULL_ARGS__
+static bool testsuite_op_supports_threads__(ctest_testsuite_t *ctest_testsuite)
+{
+	const testsuite_t__ *const testsuite = upcast_testsuite__(ctest_testsuite);
+
+	return testsuite->locate_dynamic_ops != NULL || testsuite->p_dynamic_ops == NULL;
+}
+
 CTEST_ALL_NONNULL_ARGS__
 static void testsuite_op_destroy__(ctest_testsuite_t *ctest_testsuite)
 {
@@ -455,8 +886,12 @@ static void testsuite_op_destroy__(ctest_testsuite_t *ctest_testsuite)
 	for (i = 0; i < testsuite->test_count; ++i) {
 		test_destroy__(upcast_test__(tests[i]));
 	}
+	for (i = 0; i < testsuite->fixture_count; ++i)
+		(void)free(testsuite->fixtures[i]);
 
+	(void)free(testsuite->fixtures);
 	(void)free(tests);
+	(void)free((char *)testsuite->filename); /* const-cast */
 	memset(testsuite, 0, sizeof(*testsuite));
 	(void)free(testsuite);
 
@@ -470,6 +905,8 @@ ctest_testsuite_t *ctest_load_testsuite(const char *filename)
 		&testsuite_op_get_name__,
 		&testsuite_op_get_test_count__,
 		&testsuite_op_get_tests__,
+		&testsuite_op_get_filename__,
+		&testsuite_op_supports_threads__,
 		&testsuite_op_destroy__,
 	};
 
@@ -478,6 +915,8 @@ ctest_testsuite_t *ctest_load_testsuite(const char *filename)
 	void *sym;
 	ctest_def_suite_t__ *suite_def;
 	ctest_dynamic_ops_t **p_dynamic_ops;
+	ctest_dynamic_ops_locator_t locate_dynamic_ops;
+	ctest_port_leaser_t *p_port_leaser;
 	testsuite_t__ *result;
 	ctest_test_t **tests;
 	size_t i;
@@ -513,7 +952,7 @@ ctest_testsuite_t *ctest_load_testsuite(const char *filename)
 		fprintf(stderr, "module contains bad magic (found:0x%08x expecting:0x%08x)", suite_def->magic, CTEST_SUITE_MAGIC__);
 		goto bad_sym;
 	}
-	if (suite_def->version != CTEST_SUITE_VERSION__) {
+	if (suite_def->version > CTEST_SUITE_VERSION__) {
 		fprintf(stderr, "module contains unknown magic (found:0x%08x expecting:0x%08x)", suite_def->version, CTEST_SUITE_VERSION__);
 		goto bad_sym;
 	}
@@ -521,13 +960,23 @@ ctest_testsuite_t *ctest_load_testsuite(const char *filename)
 	/* dynamic ops are optional and won't be present if the test module doesn't
 	 * have any tests that can fail. */
 	p_dynamic_ops = lt_dlsym(dlhandle, CTEST_STRINGIZE__(CTEST_DYNAMIC_OPS_SYMBOL__));
+	locate_dynamic_ops = (ctest_dynamic_ops_locator_t)lt_dlsym(dlhandle, CTEST_STRINGIZE__(CTEST_DYNAMIC_OPS_LOCATOR_SYMBOL__));
+
+	/* Nor is the port leaser, unless the module leases ports. */
+	if ((p_port_leaser = lt_dlsym(dlhandle, CTEST_STRINGIZE__(CTEST_PORT_LEASER_SYMBOL__))) != NULL)
+		*p_port_leaser = &ports_lease;
 
 	if ((result = calloc(1, sizeof(*result))) == NULL)
 		goto alloc_failed;
+	if ((result->filename = strdup(filename)) == NULL)
+		goto filename_alloc_failed;
 
 	if (suite_def->test_count > 0) {
 		if ((tests = calloc(suite_def->test_count, sizeof(*tests))) == NULL)
 			goto tests_alloc_failed;
+		/* At most one shared fixture for each test. */
+		if ((result->fixtures = calloc(suite_def->test_count, sizeof(*result->fixtures))) == NULL)
+			goto fixtures_alloc_failed;
 	} else {
 		tests = NULL;
 	}
@@ -536,6 +985,7 @@ ctest_testsuite_t *ctest_load_testsuite(const char *filename)
 	result->handle = dlhandle;
 	result->def = suite_def;
 	result->p_dynamic_ops = p_dynamic_ops;
+	result->locate_dynamic_ops = locate_dynamic_ops;
 	result->tests = tests;
 	result->test_count = suite_def->test_count;
 
@@ -547,14 +997,28 @@ ctest_testsuite_t *ctest_load_testsuite(const char *filename)
 		tests[i] = &test->base;
 	}
 
+	if (testsuite_link_tests__(result) != 0)
+		goto link_tests_failed;
+	if (testsuite_check_resources__(result) != 0)
+		goto check_resources_failed;
+
 	return &result->base;
 
+check_resources_failed:
+link_tests_failed:
 test_creation_failed:
 	for (i = 0; i < suite_def->test_count; ++i) {
 		if (tests[i] != NULL)
 			test_destroy__(upcast_test__(tests[i]));
 	}
+	for (i = 0; i < result->fixture_count; ++i)
+		(void)free(result->fixtures[i]);
+	(void)free(result->fixtures);
+fixtures_alloc_failed:
+	(void)free(tests);
 tests_alloc_failed:
+	(void)free((char *)result->filename); /* const-cast */
+filename_alloc_failed:
 	(void)free(result);
 alloc_failed:
 bad_sym:
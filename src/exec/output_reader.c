@@ -1,3 +1,5 @@
+#include <errno.h>
+#include <poll.h>
 #include <string.h>
 #include <unistd.h>
 
@@ -115,3 +117,40 @@ ctest_output_t *output_reader_build(output_reader_t *reader)
 	output->data[length] = '\0';
 	return output;
 }
+
+/**
+ * Read all the data that is immediately available from the file descriptor,
+ * without blocking.
+ *
+ * A process that runs several test cases shares one output pipe between them;
+ * once a test case has completed (and its output flushed), draining the pipe
+ * collects everything the test case wrote before the next one starts writing.
+ *
+ * @param reader The <code>output_reader_t</code> from which to read.
+ *
+ * @return Zero on success, or a negative number if reading from the file
+ *         descriptor failed.
+ */
+CTEST_ALL_NONNULL_ARGS__
+int output_reader_drain(output_reader_t *reader)
+{
+	struct pollfd pollfd;
+	int rc;
+
+	while (1) {
+		memset(&pollfd, 0, sizeof(pollfd));
+		pollfd.fd = reader->fd;
+		pollfd.events = POLLIN;
+
+		if ((rc = poll(&pollfd, 1, 0)) < 0) {
+			if (errno == EINTR)
+				continue;
+			return rc;
+		} else if (rc == 0 || !(pollfd.revents & POLLIN)) {
+			return 0;
+		}
+
+		if ((rc = op_on_data_available__(&reader->poll_handler_base)) <= 0)
+			return rc;
+	}
+}
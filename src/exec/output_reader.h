@@ -44,4 +44,7 @@ extern void output_reader_destroy(output_reader_t *reader);
 CTEST_ALL_NONNULL_ARGS__
 extern ctest_output_t *output_reader_build(output_reader_t *reader);
 
+CTEST_ALL_NONNULL_ARGS__
+extern int output_reader_drain(output_reader_t *reader);
+
 #endif /* PRIVATE__OUTPUT_READER_H__INCLUDED__ */
@@ -0,0 +1,230 @@
+#define _GNU_SOURCE     /* sched_getaffinity */
+#include <errno.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <ctest/_annotations.h>
+#include <ctest/exec/placement.h>
+
+struct ctest_placement {
+	/**
+	 * The CPUs on which children are placed, in the order in which slots
+	 * are placed on them.
+	 */
+	ctest_cpu_t *cpus;
+	size_t cpu_count;
+
+	/**
+	 * The CPUs reserved for the runner.
+	 */
+	ctest_cpu_t *reserved;
+	size_t reserved_count;
+};
+
+/**
+ * A physical core, with its CPUs (SMT siblings).
+ */
+typedef struct core__ core_t__;
+struct core__ {
+	const ctest_cpu_t *cpus;
+	size_t cpu_count;
+
+	/**
+	 * The position of the core among those of its package.
+	 */
+	size_t rank;
+};
+
+/**
+ * Read a topology attribute of a CPU from sysfs.
+ *
+ * @return The value, or <code>fallback</code> if it can't be read (e.g.,
+ *         sysfs isn't mounted).
+ */
+static int read_topology__(int cpu, const char *attribute, int fallback)
+{
+	char path[128];
+	FILE *fp;
+	int value;
+
+	snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/%s", cpu, attribute);
+	if ((fp = fopen(path, "re")) == NULL)
+		return fallback;
+	if (fscanf(fp, "%d", &value) != 1)
+		value = fallback;
+	(void)fclose(fp);
+	return value;
+}
+
+static int compare_cpus__(const void *lhs_ptr, const void *rhs_ptr)
+{
+	const ctest_cpu_t *const lhs = lhs_ptr;
+	const ctest_cpu_t *const rhs = rhs_ptr;
+
+	if (lhs->package != rhs->package)
+		return lhs->package < rhs->package ? -1 : 1;
+	if (lhs->core != rhs->core)
+		return lhs->core < rhs->core ? -1 : 1;
+	return lhs->id < rhs->id ? -1 : lhs->id > rhs->id;
+}
+
+/*
+ * Cores are taken in turns from each package (the first core of each package,
+ * then the second, ...), so consecutive slots land on different packages.
+ */
+static int compare_cores__(const void *lhs_ptr, const void *rhs_ptr)
+{
+	const core_t__ *const lhs = lhs_ptr;
+	const core_t__ *const rhs = rhs_ptr;
+
+	if (lhs->rank != rhs->rank)
+		return lhs->rank < rhs->rank ? -1 : 1;
+	return compare_cpus__(lhs->cpus, rhs->cpus);
+}
+
+/**
+ * Find the CPUs the calling process is allowed to run on, sorted by package,
+ * then core.
+ *
+ * @return The number of CPUs, or zero (with <code>errno</code> set) on
+ *         failure.
+ */
+static size_t find_allowed_cpus__(ctest_cpu_t **p_cpus)
+{
+	cpu_set_t allowed;
+	ctest_cpu_t *cpus;
+	size_t count = 0;
+	int cpu;
+
+	if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+		return 0;
+	if ((cpus = calloc(CPU_COUNT(&allowed), sizeof(*cpus))) == NULL)
+		return 0;
+	for (cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+		if (!CPU_ISSET(cpu, &allowed))
+			continue;
+		cpus[count].id = cpu;
+		cpus[count].package = read_topology__(cpu, "physical_package_id", 0);
+		/* Without topology, treat each CPU as a core of its own. */
+		cpus[count].core = read_topology__(cpu, "core_id", cpu);
+		count += 1;
+	}
+	qsort(cpus, count, sizeof(*cpus), &compare_cpus__);
+
+	*p_cpus = cpus;
+	return count;
+}
+
+ctest_placement_t *ctest_placement_create(unsigned int reserved_cores)
+{
+	ctest_placement_t *placement;
+	ctest_cpu_t *allowed;
+	core_t__ *cores;
+	size_t allowed_count, core_count = 0, i, j, thread, max_threads = 0;
+
+	if ((allowed_count = find_allowed_cpus__(&allowed)) == 0)
+		goto find_cpus_failed;
+	if ((cores = calloc(allowed_count, sizeof(*cores))) == NULL)
+		goto alloc_cores_failed;
+	if ((placement = calloc(1, sizeof(*placement))) == NULL)
+		goto alloc_placement_failed;
+	if ((placement->cpus = calloc(allowed_count, sizeof(*placement->cpus))) == NULL ||
+	    (placement->reserved = calloc(allowed_count, sizeof(*placement->reserved))) == NULL)
+		goto alloc_cpus_failed;
+
+	/* Group the CPUs (sorted by package, then core) into cores. */
+	for (i = 0; i < allowed_count; ++i) {
+		core_t__ *const last = core_count > 0 ? cores + core_count - 1 : NULL;
+		if (last != NULL && last->cpus->package == allowed[i].package && last->cpus->core == allowed[i].core) {
+			last->cpu_count += 1;
+		} else {
+			cores[core_count].cpus = allowed + i;
+			cores[core_count].cpu_count = 1;
+			cores[core_count].rank = last != NULL && last->cpus->package == allowed[i].package ? last->rank + 1 : 0;
+			core_count += 1;
+		}
+	}
+	if (reserved_cores >= core_count) {
+		errno = EINVAL;
+		goto too_many_reserved;
+	}
+
+	/* The lowest numbered cores (of the first package) are reserved. */
+	for (i = 0; i < reserved_cores; ++i) {
+		memcpy(placement->reserved + placement->reserved_count, cores[i].cpus, cores[i].cpu_count * sizeof(*cores[i].cpus));
+		placement->reserved_count += cores[i].cpu_count;
+	}
+
+	/* The first CPU of every core, then the second of every core, ... */
+	qsort(cores + reserved_cores, core_count - reserved_cores, sizeof(*cores), &compare_cores__);
+	for (i = reserved_cores; i < core_count; ++i) {
+		if (cores[i].cpu_count > max_threads)
+			max_threads = cores[i].cpu_count;
+	}
+	for (thread = 0; thread < max_threads; ++thread) {
+		for (j = reserved_cores; j < core_count; ++j) {
+			if (thread < cores[j].cpu_count)
+				placement->cpus[placement->cpu_count++] = cores[j].cpus[thread];
+		}
+	}
+
+	(void)free(cores);
+	(void)free(allowed);
+	return placement;
+
+too_many_reserved:
+alloc_cpus_failed:
+	(void)free(placement->reserved);
+	(void)free(placement->cpus);
+	(void)free(placement);
+alloc_placement_failed:
+	(void)free(cores);
+alloc_cores_failed:
+	(void)free(allowed);
+find_cpus_failed:
+	return NULL;
+}
+
+CTEST_ALL_NONNULL_ARGS__
+void ctest_placement_destroy(ctest_placement_t *placement)
+{
+	(void)free(placement->reserved);
+	(void)free(placement->cpus);
+	memset(placement, 0, sizeof(*placement));
+	(void)free(placement);
+}
+
+CTEST_ALL_NONNULL_ARGS__
+size_t ctest_placement_get_cpu_count(const ctest_placement_t *placement)
+{
+	return placement->cpu_count;
+}
+
+CTEST_ALL_NONNULL_ARGS__ CTEST_RETURNS_NONNULL__
+const ctest_cpu_t *ctest_placement_get_cpu(const ctest_placement_t *placement, size_t slot)
+{
+	return placement->cpus + slot % placement->cpu_count;
+}
+
+CTEST_ALL_NONNULL_ARGS__
+const ctest_cpu_t *ctest_placement_get_reserved(const ctest_placement_t *placement, size_t *p_cpu_count)
+{
+	*p_cpu_count = placement->reserved_count;
+	return placement->reserved;
+}
+
+CTEST_ALL_NONNULL_ARGS__
+int ctest_placement_reserve(const ctest_placement_t *placement)
+{
+	cpu_set_t cpus;
+	size_t i;
+
+	if (placement->reserved_count == 0)
+		return 0;
+	CPU_ZERO(&cpus);
+	for (i = 0; i < placement->reserved_count; ++i)
+		CPU_SET(placement->reserved[i].id, &cpus);
+	return sched_setaffinity(0, sizeof(cpus), &cpus);
+}
@@ -0,0 +1,132 @@
+#define _GNU_SOURCE     /* memfd_create */
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <ctest/_annotations.h>
+
+#include "ports.h"
+
+typedef struct port_pool__ port_pool_t__;
+struct port_pool__ {
+	uint32_t first;
+	uint32_t count;
+	uint32_t next;          /* Updated atomically, by any process. */
+};
+
+static port_pool_t__ *pool__;
+static int pool_fd__ = -1;
+
+/**
+ * Map a pool, replacing the one the calling process had (if any).
+ *
+ * @return Zero on success, non-zero (with <code>errno</code> set) on failure.
+ */
+static int pool_map__(int fd)
+{
+	port_pool_t__ *pool;
+
+	if ((pool = mmap(NULL, sizeof(*pool), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)) == MAP_FAILED)
+		return -1;
+	ports_close();
+	pool__ = pool;
+	pool_fd__ = fd;
+	return 0;
+}
+
+/**
+ * Check whether a port can be bound on the loopback interface.
+ */
+static bool port_is_free__(unsigned int port)
+{
+	struct sockaddr_in addr;
+	const int reuse = 1;
+	bool result = false;
+	int fd;
+
+	if ((fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0)) < 0)
+		return false;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons((uint16_t)port);
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	/* Connections of an earlier lessee lingering in TIME_WAIT don't keep
+	 * the next one from listening on the port. */
+	(void)setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+	if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0)
+		result = true;
+	(void)close(fd);
+	return result;
+}
+
+int ports_open(unsigned int first, unsigned int last)
+{
+	int fd;
+
+	if (first == 0 || last > 65535 || first > last) {
+		errno = EINVAL;
+		return -1;
+	}
+	if ((fd = memfd_create("ctest-ports", MFD_CLOEXEC)) < 0)
+		goto memfd_failed;
+	if (ftruncate(fd, sizeof(*pool__)) != 0)
+		goto truncate_failed;
+	if (pool_map__(fd) != 0)
+		goto map_failed;
+	pool__->first = first;
+	pool__->count = last - first + 1;
+	pool__->next = 0;
+	return 0;
+
+map_failed:
+truncate_failed:
+	(void)close(fd);
+memfd_failed:
+	return -1;
+}
+
+int ports_attach(int fd)
+{
+	if (fcntl(fd, F_SETFD, FD_CLOEXEC) != 0)
+		return -1;
+	return pool_map__(fd);
+}
+
+int ports_get_fd(void)
+{
+	return pool_fd__;
+}
+
+void ports_close(void)
+{
+	if (pool__ == NULL)
+		return;
+	(void)munmap(pool__, sizeof(*pool__));
+	(void)close(pool_fd__);
+	pool__ = NULL;
+	pool_fd__ = -1;
+}
+
+int ports_lease(void)
+{
+	port_pool_t__ *const pool = pool__;
+	uint32_t i;
+
+	if (pool == NULL) {
+		errno = ENOTSUP;
+		return -1;
+	}
+	for (i = 0; i < pool->count; ++i) {
+		const uint32_t port = pool->first + __atomic_fetch_add(&pool->next, 1, __ATOMIC_RELAXED) % pool->count;
+		if (port_is_free__(port))
+			return (int)port;
+	}
+	errno = EADDRNOTAVAIL;
+	return -1;
+}
@@ -0,0 +1,58 @@
+#ifndef PRIVATE__PORTS_H__INCLUDED__
+#define PRIVATE__PORTS_H__INCLUDED__
+
+/**
+ * The pool of loopback ports test cases lease (see <code>CT_LEASE_PORT</code>).
+ *
+ * The pool lives in shared memory, so every process of a run (the runner, its
+ * threads and child processes, and the workers it spawns) leases from the
+ * same one, without a round trip to the runner, and test cases running at the
+ * same time aren't handed the same port (unless there are more of them than
+ * ports). A port is only handed out if it can be bound on the loopback
+ * interface, skipping those in use by other processes.
+ *
+ * There is at most one pool per process; leasing without one fails.
+ */
+
+/**
+ * Create the pool of the calling process, of the ports from
+ * <code>first</code> to <code>last</code> (inclusive), replacing any pool it
+ * already had.
+ *
+ * @return Zero on success, non-zero (with <code>errno</code> set) on failure.
+ */
+extern int ports_open(unsigned int first, unsigned int last);
+
+/**
+ * Share the pool of another process of the run (e.g., the runner that
+ * spawned a worker), given the file descriptor returned by
+ * <code>ports_get_fd</code> in that process.
+ *
+ * @return Zero on success, non-zero (with <code>errno</code> set) on failure.
+ */
+extern int ports_attach(int fd);
+
+/**
+ * Get the file descriptor of the pool of the calling process, to pass along
+ * to a process spawned to share it (it is close-on-exec).
+ *
+ * @return The file descriptor, or -1 if the process has no pool.
+ */
+extern int ports_get_fd(void);
+
+/**
+ * Close the pool of the calling process, if it has one.
+ */
+extern void ports_close(void);
+
+/**
+ * Lease the next port of the pool that can be bound on the loopback
+ * interface. Ports are handed out round robin, so one is only handed out
+ * again once every other port of the pool has been.
+ *
+ * @return The port, or -1 (with <code>errno</code> set) if the process has no
+ *         pool or none of its ports can be bound.
+ */
+extern int ports_lease(void);
+
+#endif /* PRIVATE__PORTS_H__INCLUDED__ */
@@ -0,0 +1,93 @@
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+
+#include <ctest/_annotations.h>
+
+#include "poll_handler.h"
+#include "reactor.h"
+
+CTEST_ALL_NONNULL_ARGS__
+int reactor_init(reactor_t *reactor, size_t event_capacity)
+{
+	memset(reactor, 0, sizeof(*reactor));
+	if (event_capacity == 0)
+		event_capacity = 1;
+
+	if ((reactor->events = calloc(event_capacity, sizeof(*reactor->events))) == NULL)
+		goto alloc_events_failed;
+	if ((reactor->epoll_fd = epoll_create1(EPOLL_CLOEXEC)) < 0)
+		goto epoll_create_failed;
+	reactor->event_capacity = event_capacity;
+	return 0;
+
+epoll_create_failed:
+	(void)free(reactor->events);
+alloc_events_failed:
+	reactor->epoll_fd = -1;
+	return -1;
+}
+
+CTEST_ALL_NONNULL_ARGS__
+void reactor_destroy(reactor_t *reactor)
+{
+	(void)close(reactor->epoll_fd);
+	(void)free(reactor->events);
+	memset(reactor, 0, sizeof(*reactor));
+	reactor->epoll_fd = -1;
+}
+
+CTEST_ALL_NONNULL_ARGS__
+int reactor_add(reactor_t *reactor, int fd, poll_handler_t *handler)
+{
+	struct epoll_event event;
+
+	memset(&event, 0, sizeof(event));
+	event.events = EPOLLIN;
+	event.data.ptr = handler;
+	if (epoll_ctl(reactor->epoll_fd, EPOLL_CTL_ADD, fd, &event) != 0)
+		return -1;
+	reactor->handler_count += 1;
+	return 0;
+}
+
+CTEST_ALL_NONNULL_ARGS__
+void reactor_remove(reactor_t *reactor, int fd, poll_handler_t *handler)
+{
+	size_t i;
+
+	if (epoll_ctl(reactor->epoll_fd, EPOLL_CTL_DEL, fd, NULL) != 0)
+		return;
+	reactor->handler_count -= 1;
+
+	/* The handler (or whatever owns it) may be gone by the time its
+	 * pending event would be dispatched. */
+	for (i = reactor->event_next; i < reactor->event_count; ++i) {
+		if (reactor->events[i].data.ptr == handler)
+			reactor->events[i].data.ptr = NULL;
+	}
+}
+
+CTEST_ALL_NONNULL_ARGS__
+int reactor_dispatch(reactor_t *reactor, int timeout_ms)
+{
+	int rc;
+
+	while ((rc = epoll_wait(reactor->epoll_fd, reactor->events, (int)reactor->event_capacity, timeout_ms)) < 0 && errno == EINTR)
+		;
+	if (rc < 0)
+		return rc;
+
+	reactor->event_count = (size_t)rc;
+	for (reactor->event_next = 0; reactor->event_next < reactor->event_count; ) {
+		poll_handler_t *const handler = reactor->events[reactor->event_next++].data.ptr;
+		if (handler != NULL)
+			(void)poll_handler_on_data_available(handler);
+	}
+	reactor->event_count = 0;
+	reactor->event_next = 0;
+
+	return rc;
+}
@@ -0,0 +1,104 @@
+#ifndef PRIVATE__REACTOR_H__INCLUDED__
+#define PRIVATE__REACTOR_H__INCLUDED__
+
+#include <stddef.h>
+#include <sys/epoll.h>
+
+#include <ctest/_annotations.h>
+
+#include "poll_handler.h"
+
+/**
+ * A reactor waits for any of a set of file descriptors to become ready and
+ * notifies the poll handler registered for each one that is.
+ *
+ * The set is kept by the kernel (with <code>epoll</code>), so the cost of each
+ * wait is proportional to the number of ready file descriptors rather than the
+ * number registered.
+ *
+ * A handler is notified through <code>poll_handler_on_data_available</code>
+ * whenever its file descriptor is readable or has been hung up; it is up to
+ * the handler to detect the end of the stream (and call its own
+ * <code>on_close</code>). Handlers may add and remove registrations
+ * (including their own) while being notified.
+ */
+typedef struct reactor reactor_t;
+struct reactor {
+	int epoll_fd;
+
+	/**
+	 * The number of registered file descriptors.
+	 */
+	size_t handler_count;
+
+	/* The events being dispatched; handlers removed while dispatching are
+	 * cleared from the events not yet dispatched. */
+	struct epoll_event *events;
+	size_t event_capacity;
+	size_t event_count;
+	size_t event_next;
+};
+
+/**
+ * Initialize a reactor.
+ *
+ * @param reactor        The reactor to initialize.
+ * @param event_capacity The maximum number of ready file descriptors handled
+ *                       per wait; more are handled by subsequent waits.
+ *
+ * @return Zero on success, non-zero (with <code>errno</code> set) on failure.
+ */
+CTEST_ALL_NONNULL_ARGS__
+extern int reactor_init(reactor_t *reactor, size_t event_capacity);
+
+/**
+ * Destroy a reactor, previously initialized with <code>reactor_init</code>.
+ *
+ * The registered file descriptors are not closed.
+ *
+ * @param reactor The reactor to destroy.
+ */
+CTEST_ALL_NONNULL_ARGS__
+extern void reactor_destroy(reactor_t *reactor);
+
+/**
+ * Register a file descriptor with a reactor.
+ *
+ * @param reactor The reactor with which to register the file descriptor.
+ * @param fd      The file descriptor to watch for input.
+ * @param handler The handler to notify when <code>fd</code> is ready; it must
+ *                remain valid until removed.
+ *
+ * @return Zero on success, non-zero (with <code>errno</code> set) on failure.
+ */
+CTEST_ALL_NONNULL_ARGS__
+extern int reactor_add(reactor_t *reactor, int fd, poll_handler_t *handler);
+
+/**
+ * Remove a file descriptor from a reactor.
+ *
+ * Once removed, the handler is no longer notified, even if the file descriptor
+ * was found to be ready by the wait being dispatched.
+ *
+ * @param reactor The reactor from which to remove the file descriptor.
+ * @param fd      The file descriptor, which must still be open.
+ * @param handler The handler registered for <code>fd</code>.
+ */
+CTEST_ALL_NONNULL_ARGS__
+extern void reactor_remove(reactor_t *reactor, int fd, poll_handler_t *handler);
+
+/**
+ * Wait for registered file descriptors to become ready, then notify their
+ * handlers.
+ *
+ * @param reactor    The reactor on which to wait.
+ * @param timeout_ms How long to wait (in milliseconds), or <code>-1</code> to
+ *                   wait until at least one file descriptor is ready.
+ *
+ * @return The number of ready file descriptors, or a negative number (with
+ *         <code>errno</code> set) if waiting failed.
+ */
+CTEST_ALL_NONNULL_ARGS__
+extern int reactor_dispatch(reactor_t *reactor, int timeout_ms);
+
+#endif /* PRIVATE__REACTOR_H__INCLUDED__ */
@@ -0,0 +1,35 @@
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <ctest/_annotations.h>
+
+#include "resources.h"
+
+CTEST_ALL_NONNULL_ARGS__
+int resource_parse(const char *spec, char separator, size_t *p_length, unsigned long *p_amount)
+{
+	const char *const amount = strchr(spec, separator);
+	char *end;
+
+	*p_length = amount != NULL ? (size_t)(amount - spec) : strlen(spec);
+	if (*p_length == 0)
+		goto invalid;
+	if (amount == NULL) {
+		*p_amount = 1;
+		return 0;
+	}
+
+	/* strtoul accepts (and negates) a sign; amounts don't have one. */
+	if (amount[1] < '0' || amount[1] > '9')
+		goto invalid;
+	errno = 0;
+	*p_amount = strtoul(amount + 1, &end, 10);
+	if (errno != 0 || *end != '\0' || *p_amount == 0)
+		goto invalid;
+	return 0;
+
+invalid:
+	errno = EINVAL;
+	return -1;
+}
@@ -0,0 +1,25 @@
+#ifndef PRIVATE__RESOURCES_H__INCLUDED__
+#define PRIVATE__RESOURCES_H__INCLUDED__
+
+#include <stddef.h>
+
+#include <ctest/_annotations.h>
+
+/**
+ * Parse the specification of a shared resource (see
+ * <code>CT_TEST_RESOURCES</code>): its name, optionally followed by a
+ * separator and a positive amount, e.g., "bigmem:8" or, for the capacity of a
+ * resource, "bigmem=32".
+ *
+ * @param spec      The specification.
+ * @param separator The character separating the name from the amount.
+ * @param p_length  Where to store the length of the name.
+ * @param p_amount  Where to store the amount (one, if there's none).
+ *
+ * @return Zero on success, non-zero (with <code>errno</code> set to
+ *         <code>EINVAL</code>) if the specification is malformed.
+ */
+CTEST_ALL_NONNULL_ARGS__
+extern int resource_parse(const char *spec, char separator, size_t *p_length, unsigned long *p_amount);
+
+#endif /* PRIVATE__RESOURCES_H__INCLUDED__ */
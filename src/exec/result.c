@@ -13,6 +13,13 @@ ctest_result_t *ctest_result_create_empty(void)
 		result->type = CTEST_RESULT_PASS;
 		result->output = NULL;
 		result->failure = NULL;
+		result->spawn_ns = 0;
+		result->duration_ns = 0;
+		result->peak_memory_bytes = 0;
+		result->cpu = -1;
+		result->forked = false;
+		result->attempt = 1;
+		result->previous_attempt = NULL;
 	}
 
 	return result;
@@ -40,15 +47,30 @@ extern int ctest_result_set_output(ctest_result_t *result, ctest_output_t *outpu
 	return 0;
 }
 
+CTEST_ALL_NONNULL_ARGS__
+int ctest_result_set_previous_attempt(ctest_result_t *result, ctest_result_t *previous)
+{
+	if (result->previous_attempt != NULL)
+		ctest_result_destroy(result->previous_attempt);
+	result->previous_attempt = previous;
+	result->attempt = previous->attempt + 1;
+	return 0;
+}
+
 CTEST_ALL_NONNULL_ARGS__
 void ctest_result_destroy(ctest_result_t *result)
 {
-	if (result->output != NULL)
-		ctest_output_destroy((ctest_output_t *)result->output);
+	while (result != NULL) {
+		ctest_result_t *const previous = result->previous_attempt;
 
-	if (result->failure != NULL)
-		ctest_failure_destroy(result->failure);
+		if (result->output != NULL)
+			ctest_output_destroy((ctest_output_t *)result->output);
 
-	memset(result, 0, sizeof(*result));
-	(void)free(result);
+		if (result->failure != NULL)
+			ctest_failure_destroy(result->failure);
+
+		memset(result, 0, sizeof(*result));
+		(void)free(result);
+		result = previous;
+	}
 }
@@ -0,0 +1,31 @@
+#include <string.h>
+
+#include <ctest/_annotations.h>
+#include <ctest/exec/runner_config.h>
+
+CTEST_ALL_NONNULL_ARGS__
+void ctest_runner_config_init(ctest_runner_config_t *config)
+{
+	memset(config, 0, sizeof(*config));
+	config->jobs = 1;
+	config->concurrency = NULL;
+	config->spawn = CTEST_SPAWN_FORK;
+	config->worker_path = NULL;
+	config->pool = false;
+	config->isolation = CTEST_ISOLATION_TESTCASE;
+	config->timings = NULL;
+	config->journal = NULL;
+	config->timeout_ns = 0;
+	config->fail_fast = 0;
+	config->retries = 0;
+	config->cancel = NULL;
+	memset(&config->limits, 0, sizeof(config->limits));
+	config->cgroup_path = NULL;
+	config->placement = NULL;
+	config->check_state = false;
+	config->sandbox = false;
+	config->resources = NULL;
+	config->first_port = 20000;
+	config->last_port = 29999;
+	config->memory_budget_bytes = 0;
+}
@@ -1,12 +1,120 @@
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 #include <ctest/_annotations.h>
+#include <ctest/exec/cancel.h>
+#include <ctest/exec/failure.h>
 #include <ctest/exec/reporter.h>
+#include <ctest/exec/result.h>
 #include <ctest/exec/runner.h>
+#include <ctest/exec/runner_config.h>
+#include <ctest/exec/stage.h>
 #include <ctest/exec/suite.h>
 
+#include "resources.h"
 #include "runner_utils.h"
+#include "utils.h"
+
+/*
+ * Prerequisites
+ */
+
+/**
+ * Whether a test depends on another (directly).
+ */
+CTEST_ALL_NONNULL_ARGS__
+static bool test_depends_on__(ctest_test_t *test, ctest_test_t *other)
+{
+	ctest_test_t *const *prerequisite;
+
+	for (prerequisite = ctest_test_get_prerequisites(test); *prerequisite != NULL; ++prerequisite) {
+		if (*prerequisite == other)
+			return true;
+	}
+	return false;
+}
+
+/**
+ * Reorder a collection of tests so that each comes after the prerequisites it
+ * has among them.
+ *
+ * Each test keeps its place unless one of its prerequisites comes after it,
+ * in which case the first test that has none of its prerequisites left to
+ * place is moved ahead of it. Since prerequisites belong to the same suite,
+ * the tests of a suite stay contiguous.
+ */
+CTEST_ALL_NONNULL_ARGS__
+static void order_tests__(ctest_test_t **tests, size_t test_count)
+{
+	size_t i_write, i_read, i;
+
+	for (i_write = 0; i_write < test_count; ++i_write) {
+		ctest_test_t *read_test;
+
+		for (i_read = i_write; i_read < test_count; ++i_read) {
+			for (i = i_write; i < test_count; ++i) {
+				if (test_depends_on__(tests[i_read], tests[i]))
+					break;
+			}
+			if (i == test_count)
+				break;
+		}
+		/* Only a cycle (rejected when the suite is loaded) would leave
+		 * no test to place. */
+		if (i_read == i_write || i_read == test_count)
+			continue;
+
+		read_test = tests[i_read];
+		memmove(tests + i_write + 1, tests + i_write, (i_read - i_write) * sizeof(*tests));
+		tests[i_write] = read_test;
+	}
+}
+
+/**
+ * Reorder a collection of test cases, already grouped by test, so that the
+ * test cases of each test come after those of the prerequisites it has among
+ * them, just like <code>order_tests__</code>.
+ */
+CTEST_ALL_NONNULL_ARGS__
+static void order_testcases__(ctest_testcase_t **testcases, size_t testcase_count)
+{
+	size_t i_write, i_read, i;
+
+	for (i_write = 0; i_write < testcase_count; ) {
+		ctest_test_t *test = NULL;
+
+		for (i_read = i_write; i_read < testcase_count; ++i_read) {
+			if (ctest_testcase_get_test(testcases[i_read]) == test)
+				continue;
+			test = ctest_testcase_get_test(testcases[i_read]);
+			for (i = i_write; i < testcase_count; ++i) {
+				if (test_depends_on__(test, ctest_testcase_get_test(testcases[i])))
+					break;
+			}
+			if (i == testcase_count)
+				break;
+		}
+		/* Only a cycle (rejected when the suite is loaded) would leave
+		 * no test to place. */
+		if (i_read == testcase_count)
+			test = ctest_testcase_get_test(testcases[i_write]);
+
+		/* Move the test cases of the test to place forward, one by
+		 * one, keeping their order. */
+		for (i_read = i_write; i_read < testcase_count && ctest_testcase_get_test(testcases[i_read]) != test; ++i_read)
+			;
+		for (; i_read < testcase_count && ctest_testcase_get_test(testcases[i_read]) == test; ++i_read) {
+			ctest_testcase_t *const read_testcase = testcases[i_read];
+			if (i_read != i_write) {
+				memmove(testcases + i_write + 1, testcases + i_write, (i_read - i_write) * sizeof(*testcases));
+				testcases[i_write] = read_testcase;
+			}
+			i_write += 1;
+		}
+	}
+}
 
 CTEST_ALL_NONNULL_ARGS__
 static ctest_test_t *const* repartition_tests__(ctest_test_t *const*tests, size_t test_count)
@@ -39,6 +147,7 @@ static ctest_test_t *const* repartition_tests__(ctest_test_t *const*tests, size_
 		}
 	}
 
+	order_tests__(sorted_tests, test_count);
 	return sorted_tests;
 }
 
@@ -114,9 +223,403 @@ static ctest_testcase_t *const* repartition_testcases__(ctest_testcase_t *const*
 		};
 	}
 
+	order_testcases__(sorted_testcases, testcase_count);
 	return sorted_testcases;
 }
 
+/*
+ * Cancellation
+ */
+
+CTEST_ALL_NONNULL_ARGS__
+void runner_cancellation_init(runner_cancellation_t *cancellation, const ctest_runner_config_t *config)
+{
+	memset(cancellation, 0, sizeof(*cancellation));
+	cancellation->cancel = config->cancel;
+	cancellation->fail_fast = config->fail_fast;
+}
+
+CTEST_ALL_NONNULL_ARGS__
+bool runner_cancellation_check(runner_cancellation_t *cancellation)
+{
+	if (!cancellation->cancelled && cancellation->cancel != NULL && ctest_cancel_is_requested(cancellation->cancel))
+		cancellation->cancelled = true;
+	return cancellation->cancelled;
+}
+
+CTEST_ALL_NONNULL_ARGS__
+void runner_cancellation_cancel(runner_cancellation_t *cancellation)
+{
+	cancellation->cancelled = true;
+	if (cancellation->cancel != NULL)
+		ctest_cancel_request(cancellation->cancel);
+}
+
+CTEST_ALL_NONNULL_ARGS__
+void runner_cancellation_record(runner_cancellation_t *cancellation, bool failed)
+{
+	if (!failed)
+		return;
+	cancellation->failure_count += 1;
+	if (cancellation->fail_fast > 0 && cancellation->failure_count == cancellation->fail_fast)
+		runner_cancellation_cancel(cancellation);
+}
+
+CTEST_ALL_NONNULL_ARGS__
+ctest_result_t *runner_cancellation_create_result(const runner_cancellation_t *cancellation, ctest_stage_t stage, const char *action)
+{
+	ctest_result_t *result;
+	ctest_failure_t *failure;
+
+	if ((result = ctest_result_create_empty()) == NULL)
+		goto result_create_failed;
+	if (cancellation->fail_fast > 0 && cancellation->failure_count >= cancellation->fail_fast)
+		failure = ctest_failure_create(stage, "%s; run cancelled after %u failed test case%s", NULL, NULL, action, cancellation->failure_count, cancellation->failure_count == 1 ? "" : "s");
+	else
+		failure = ctest_failure_create(stage, "%s; run cancelled", NULL, NULL, action);
+	if (failure == NULL)
+		goto failure_create_failed;
+	if (ctest_result_set_failure(result, CTEST_RESULT_CANCELLED, failure) != 0)
+		goto set_failure_failed;
+	return result;
+
+set_failure_failed:
+	ctest_failure_destroy(failure);
+failure_create_failed:
+	ctest_result_destroy(result);
+result_create_failed:
+	return NULL;
+}
+
+/*
+ * Retries
+ */
+
+/**
+ * Whether a result is a failure, as far as the run is concerned (the test
+ * case was retried successfully if flaky, and didn't get to fail if skipped
+ * or cancelled).
+ */
+static bool result_is_failure__(const ctest_result_t *result)
+{
+	switch (result->type) {
+	case CTEST_RESULT_PASS:
+	case CTEST_RESULT_SKIPPED:
+	case CTEST_RESULT_CANCELLED:
+	case CTEST_RESULT_FLAKY:
+		return false;
+	case CTEST_RESULT_FAIL:
+	case CTEST_RESULT_ERROR:
+	case CTEST_RESULT_TIMEOUT:
+	case CTEST_RESULT_LIMIT_EXCEEDED:
+	case CTEST_RESULT_ISOLATION_VIOLATION:
+		break;
+	}
+	return true;
+}
+
+/**
+ * Combine the result of an attempt at running a test case with the results
+ * of the failed attempts before it.
+ *
+ * @param failed The result of the last failed attempt (which holds those of
+ *               the attempts before it), or <code>NULL</code> if this was the
+ *               first attempt.
+ * @param result The result of the attempt.
+ *
+ * @return The result of the test case. Ownership of both results passes on
+ *         to it.
+ */
+CTEST_NONNULL_ARGS__(2)
+static ctest_result_t *merge_attempts__(ctest_result_t *failed, ctest_result_t *result)
+{
+	if (failed == NULL)
+		return result;
+	if (result->type == CTEST_RESULT_CANCELLED) {
+		/* The retry didn't get to finish; the test case failed. */
+		ctest_result_destroy(result);
+		return failed;
+	}
+	(void)ctest_result_set_previous_attempt(result, failed);
+	if (result->type == CTEST_RESULT_PASS)
+		(void)ctest_result_set_failure(result, CTEST_RESULT_FLAKY, NULL);
+	return result;
+}
+
+/**
+ * A test case reporter that holds on to the result of a single attempt at
+ * running a test case, so it can be retried before the result is reported.
+ */
+typedef struct attempt_reporter__ attempt_reporter_t__;
+struct attempt_reporter__ {
+	ctest_testcase_reporter_t base;
+	ctest_result_t *result;
+};
+
+CTEST_ALL_NONNULL_ARGS__
+static void attempt_reporter_op_start__(ctest_testcase_reporter_t *unused(reporter))
+{
+}
+
+CTEST_ALL_NONNULL_ARGS__
+static void attempt_reporter_op_complete__(ctest_testcase_reporter_t *ctest_reporter, ctest_result_t *result)
+{
+	attempt_reporter_t__ *const reporter = containerof(ctest_reporter, attempt_reporter_t__, base);
+
+	if (reporter->result != NULL)
+		ctest_result_destroy(reporter->result);
+	reporter->result = result;
+}
+
+CTEST_ALL_NONNULL_ARGS__
+static void attempt_reporter_op_destroy__(ctest_testcase_reporter_t *unused(reporter))
+{
+}
+
+/**
+ * Run a test case, retrying it right away each time it fails (up to
+ * <code>retries</code> times), and report its result.
+ *
+ * @return Zero if the test case passed (possibly once retried), was skipped,
+ *         a positive value if it failed (or was cancelled), or a negative
+ *         value if an error was encountered.
+ */
+CTEST_ALL_NONNULL_ARGS__
+static int run_testcase_with_retries__(ctest_runner_t *runner, ctest_testcase_reporter_t *reporter, ctest_testcase_t *testcase, runner_cancellation_t *cancellation, unsigned int retries, int (*run_testcase)(ctest_runner_t *, ctest_testcase_reporter_t *, ctest_testcase_t *))
+{
+	static ctest_testcase_reporter_ops_t attempt_reporter_ops = {
+		&attempt_reporter_op_start__,
+		&attempt_reporter_op_complete__,
+		&attempt_reporter_op_destroy__,
+	};
+	ctest_result_t *failed = NULL, *result;
+	unsigned int attempt;
+	int rc;
+
+	if (retries == 0)
+		return (*run_testcase)(runner, reporter, testcase);
+
+	ctest_testcase_reporter_start(reporter);
+	for (attempt = 0; ; ++attempt) {
+		attempt_reporter_t__ attempt_reporter = { { &attempt_reporter_ops }, NULL };
+
+		if ((*run_testcase)(runner, &attempt_reporter.base, testcase) < 0 || attempt_reporter.result == NULL) {
+			if (attempt_reporter.result != NULL)
+				ctest_result_destroy(attempt_reporter.result);
+			if (failed != NULL)
+				ctest_result_destroy(failed);
+			return -1;
+		}
+		result = attempt_reporter.result;
+
+		if (attempt == retries || !result_is_failure__(result) || runner_cancellation_check(cancellation))
+			break;
+		if (failed != NULL)
+			(void)ctest_result_set_previous_attempt(result, failed);
+		failed = result;
+	}
+
+	result = merge_attempts__(failed, result);
+	rc = result_is_failure__(result) || result->type == CTEST_RESULT_CANCELLED;
+	ctest_testcase_reporter_complete(reporter, result);
+	return rc;
+}
+
+/**
+ * Report a test case that won't be run because the run has been cancelled.
+ *
+ * @return One (the test case counts as failed), or -1 if an error was
+ *         encountered.
+ */
+CTEST_ALL_NONNULL_ARGS__
+static int report_cancelled__(const runner_cancellation_t *cancellation, ctest_testcase_reporter_t *reporter)
+{
+	ctest_result_t *result;
+
+	if ((result = runner_cancellation_create_result(cancellation, CTEST_STAGE_SETUP, "not run")) == NULL)
+		return -1;
+	ctest_testcase_reporter_start(reporter);
+	ctest_testcase_reporter_complete(reporter, result);
+	return 1;
+}
+
+/*
+ * Dependencies
+ */
+
+/**
+ * Create the result of a test case that is skipped because a prerequisite of
+ * its test didn't pass.
+ *
+ * @return The result, or <code>NULL</code> on failure.
+ */
+CTEST_ALL_NONNULL_ARGS__
+static ctest_result_t *create_skipped_result__(ctest_test_t *prerequisite)
+{
+	ctest_result_t *result;
+	ctest_failure_t *failure;
+
+	if ((result = ctest_result_create_empty()) == NULL)
+		goto result_create_failed;
+	if ((failure = ctest_failure_create(CTEST_STAGE_SETUP, "not run; prerequisite %s:%s did not pass", NULL, NULL, ctest_testsuite_get_name(ctest_test_get_testsuite(prerequisite)), ctest_test_get_name(prerequisite))) == NULL)
+		goto failure_create_failed;
+	if (ctest_result_set_failure(result, CTEST_RESULT_SKIPPED, failure) != 0)
+		goto set_failure_failed;
+	return result;
+
+set_failure_failed:
+	ctest_failure_destroy(failure);
+failure_create_failed:
+	ctest_result_destroy(result);
+result_create_failed:
+	return NULL;
+}
+
+/**
+ * Whether the result of a test case lets the tests that depend on its test
+ * run.
+ */
+static bool result_is_pass__(const ctest_result_t *result)
+{
+	return result->type == CTEST_RESULT_PASS || result->type == CTEST_RESULT_FLAKY;
+}
+
+/**
+ * The tests of a sequential run that didn't pass, each with the prerequisite
+ * whose failure its dependents are skipped for: the test itself, or, if it
+ * was skipped for a prerequisite of its own, the same one.
+ */
+typedef struct failed_tests__ failed_tests_t__;
+struct failed_tests__ {
+	ctest_test_t **tests;
+	ctest_test_t **causes;
+	size_t count;
+	size_t capacity;
+};
+
+static void failed_tests_destroy__(failed_tests_t__ *failed)
+{
+	(void)free(failed->causes);
+	(void)free(failed->tests);
+	memset(failed, 0, sizeof(*failed));
+}
+
+/**
+ * Record a test that didn't pass.
+ *
+ * @return Zero on success, non-zero on failure.
+ */
+CTEST_ALL_NONNULL_ARGS__
+static int failed_tests_add__(failed_tests_t__ *failed, ctest_test_t *test, ctest_test_t *cause)
+{
+	if (failed->count == failed->capacity) {
+		const size_t capacity = failed->capacity > 0 ? failed->capacity * 2 : 8;
+		ctest_test_t **tests, **causes;
+
+		if ((tests = realloc(failed->tests, capacity * sizeof(*tests))) == NULL)
+			return -1;
+		failed->tests = tests;
+		if ((causes = realloc(failed->causes, capacity * sizeof(*causes))) == NULL)
+			return -1;
+		failed->causes = causes;
+		failed->capacity = capacity;
+	}
+	failed->tests[failed->count] = test;
+	failed->causes[failed->count] = cause;
+	failed->count += 1;
+	return 0;
+}
+
+/**
+ * Find why the test cases of a test should be skipped.
+ *
+ * @return The prerequisite that didn't pass, or <code>NULL</code> if none of
+ *         the test's prerequisites has failed (so far).
+ */
+CTEST_ALL_NONNULL_ARGS__
+static ctest_test_t *failed_tests_find_cause__(const failed_tests_t__ *failed, ctest_test_t *test)
+{
+	size_t i;
+
+	for (i = 0; i < failed->count; ++i) {
+		if (test_depends_on__(test, failed->tests[i]))
+			return failed->causes[i];
+	}
+	return NULL;
+}
+
+/**
+ * A test case reporter that passes the result of a test case on to another
+ * reporter, noting whether it passed, and recording it in the journal of the
+ * run (if any).
+ */
+typedef struct outcome_reporter__ outcome_reporter_t__;
+struct outcome_reporter__ {
+	ctest_testcase_reporter_t base;
+	ctest_testcase_reporter_t *reporter;
+	bool passed;
+	ctest_journal_t *journal;
+	ctest_testcase_t *testcase;
+};
+
+CTEST_ALL_NONNULL_ARGS__
+static void outcome_reporter_op_start__(ctest_testcase_reporter_t *ctest_reporter)
+{
+	outcome_reporter_t__ *const reporter = containerof(ctest_reporter, outcome_reporter_t__, base);
+	ctest_testcase_reporter_start(reporter->reporter);
+}
+
+CTEST_ALL_NONNULL_ARGS__
+static void outcome_reporter_op_complete__(ctest_testcase_reporter_t *ctest_reporter, ctest_result_t *result)
+{
+	outcome_reporter_t__ *const reporter = containerof(ctest_reporter, outcome_reporter_t__, base);
+
+	reporter->passed = result_is_pass__(result);
+	if (reporter->journal != NULL)
+		(void)ctest_journal_record(reporter->journal, reporter->testcase, result);
+	ctest_testcase_reporter_complete(reporter->reporter, result);
+}
+
+CTEST_ALL_NONNULL_ARGS__
+static void outcome_reporter_op_destroy__(ctest_testcase_reporter_t *unused(reporter))
+{
+}
+
+/**
+ * Report a test case that won't be run because a prerequisite of its test
+ * didn't pass.
+ *
+ * @return Zero (the test case counts as skipped), or -1 if an error was
+ *         encountered.
+ */
+CTEST_ALL_NONNULL_ARGS__
+static int report_skipped__(ctest_test_t *prerequisite, ctest_testcase_reporter_t *reporter)
+{
+	ctest_result_t *result;
+
+	if ((result = create_skipped_result__(prerequisite)) == NULL)
+		return -1;
+	ctest_testcase_reporter_start(reporter);
+	ctest_testcase_reporter_complete(reporter, result);
+	return 0;
+}
+
+/**
+ * Report a test case that won't be run because its result was loaded into the
+ * journal of the run.
+ *
+ * @return Zero if the result is a pass (or skip), one if it's a failure.
+ */
+CTEST_ALL_NONNULL_ARGS__
+static int report_replayed__(ctest_result_t *result, ctest_testcase_reporter_t *reporter)
+{
+	const int rc = result_is_failure__(result);
+
+	ctest_testcase_reporter_start(reporter);
+	ctest_testcase_reporter_complete(reporter, result);
+	return rc;
+}
+
 /**
  * Run one or more test cases associated with a single test.
  *
@@ -125,31 +628,73 @@ static ctest_testcase_t *const* repartition_testcases__(ctest_testcase_t *const*
  *                       each test case.
  * @param testcases      The test cases to run.
  * @param testcase_count The number of test cases in <tt>testcases</tt>.
+ * @param cancellation   The cancellation state of the run.
+ * @param retries        How many times to retry a test case that fails.
  * @param run_testcase   The runner-specific callback for running an individual
  *                       test case.
- * @return The number of test cases that failed, or -1 if an error was
- *          encountered.
+ * @param failed         The tests of the run that didn't pass so far; the
+ *                       test cases are skipped if one of them is a
+ *                       prerequisite of the test, and the test is added if
+ *                       one of its test cases doesn't pass.
+ * @param journal        The journal of the run, or <code>NULL</code>; test
+ *                       cases with a loaded result are reported with it
+ *                       instead of being run, and the results of the others
+ *                       are recorded.
+ * @return The number of test cases that failed (or were cancelled), or -1 if
+ *          an error was encountered.
  */
-CTEST_ALL_NONNULL_ARGS__
-static int run_testcases_in_test__(ctest_runner_t *runner, ctest_test_reporter_t *reporter, ctest_testcase_t *const*testcases, size_t testcase_count, int (*run_testcase)(ctest_runner_t *, ctest_testcase_reporter_t *, ctest_testcase_t *))
+CTEST_NONNULL_ARGS__(1, 2, 3, 5, 7, 8)
+static int run_testcases_in_test__(ctest_runner_t *runner, ctest_test_reporter_t *reporter, ctest_testcase_t *const*testcases, size_t testcase_count, runner_cancellation_t *cancellation, unsigned int retries, int (*run_testcase)(ctest_runner_t *, ctest_testcase_reporter_t *, ctest_testcase_t *), failed_tests_t__ *failed, ctest_journal_t *journal)
 {
+	static ctest_testcase_reporter_ops_t outcome_reporter_ops = {
+		&outcome_reporter_op_start__,
+		&outcome_reporter_op_complete__,
+		&outcome_reporter_op_destroy__,
+	};
+	ctest_test_t *test, *cause;
+	bool passed = true;
 	int result = 0;
 	size_t i;
+
+	if (testcase_count == 0)
+		return 0;
+	test = ctest_testcase_get_test(testcases[0]);
+	cause = failed_tests_find_cause__(failed, test);
+
 	for (i = 0; i < testcase_count; ++i) {
 		ctest_testcase_t *const testcase = testcases[i];
-		ctest_testcase_reporter_t *testcase_reporter;
+		outcome_reporter_t__ outcome_reporter = { { &outcome_reporter_ops }, NULL, false, journal, testcase };
+		ctest_result_t *replayed = NULL;
 		int rc;
 
-		if ((testcase_reporter = ctest_test_reporter_report_testcase(reporter, testcase)) == NULL)
+		if ((outcome_reporter.reporter = ctest_test_reporter_report_testcase(reporter, testcase)) == NULL)
 			return -1;
 
-		rc = (*run_testcase)(runner, testcase_reporter, testcase);
-		ctest_testcase_reporter_destroy(testcase_reporter);
+		if (journal != NULL && ctest_journal_replay(journal, testcase, &replayed) != 0) {
+			rc = -1;
+		} else if (replayed != NULL) {
+			/* Already in the journal. */
+			outcome_reporter.journal = NULL;
+			rc = report_replayed__(replayed, &outcome_reporter.base);
+		} else if (runner_cancellation_check(cancellation)) {
+			rc = report_cancelled__(cancellation, &outcome_reporter.base);
+		} else if (cause != NULL) {
+			rc = report_skipped__(cause, &outcome_reporter.base);
+		} else {
+			rc = run_testcase_with_retries__(runner, &outcome_reporter.base, testcase, cancellation, retries, run_testcase);
+			if (rc >= 0)
+				runner_cancellation_record(cancellation, rc > 0);
+		}
+		ctest_testcase_reporter_destroy(outcome_reporter.reporter);
 
 		if (rc < 0)
 			return -1;
 		result += (rc > 0);
+		passed = passed && outcome_reporter.passed;
 	}
+
+	if (!passed && failed_tests_add__(failed, test, cause != NULL ? cause : test) != 0)
+		return -1;
 	return result;
 }
 
@@ -161,13 +706,17 @@ static int run_testcases_in_test__(ctest_runner_t *runner, ctest_test_reporter_t
  *                     each test case.
  * @param tests        The tests to run.
  * @param test_count   The number of tests in <tt>tests</tt>.
+ * @param cancellation The cancellation state of the run.
+ * @param retries      How many times to retry a test case that fails.
  * @param run_testcase The runner-specific callback for running an individual
  *                     test case.
+ * @param failed       The tests of the run that didn't pass so far.
+ * @param journal      The journal of the run, or <code>NULL</code>.
  * @return The number of test cases that failed, or -1 if an error was
  *         encountered.
  */
-CTEST_ALL_NONNULL_ARGS__
-static int run_tests_in_testsuite__(ctest_runner_t *runner, ctest_testsuite_reporter_t *reporter, ctest_test_t *const*tests, size_t test_count, int (*run_testcase)(ctest_runner_t *, ctest_testcase_reporter_t *, ctest_testcase_t *))
+CTEST_NONNULL_ARGS__(1, 2, 3, 5, 7, 8)
+static int run_tests_in_testsuite__(ctest_runner_t *runner, ctest_testsuite_reporter_t *reporter, ctest_test_t *const*tests, size_t test_count, runner_cancellation_t *cancellation, unsigned int retries, int (*run_testcase)(ctest_runner_t *, ctest_testcase_reporter_t *, ctest_testcase_t *), failed_tests_t__ *failed, ctest_journal_t *journal)
 {
 	int result = 0;
 	size_t i;
@@ -179,7 +728,7 @@ static int run_tests_in_testsuite__(ctest_runner_t *runner, ctest_testsuite_repo
 		if ((test_reporter = ctest_testsuite_reporter_report_test(reporter, test)) == NULL)
 			return -1;
 
-		rc = run_testcases_in_test__(runner, test_reporter, ctest_test_get_testcases(test), ctest_test_get_testcase_count(test), run_testcase);
+		rc = run_testcases_in_test__(runner, test_reporter, ctest_test_get_testcases(test), ctest_test_get_testcase_count(test), cancellation, retries, run_testcase, failed, journal);
 		ctest_test_reporter_destroy(test_reporter);
 
 		if (rc < 0)
@@ -189,9 +738,10 @@ static int run_tests_in_testsuite__(ctest_runner_t *runner, ctest_testsuite_repo
 	return result;
 }
 
-CTEST_ALL_NONNULL_ARGS__
-int runner_run_testcases(ctest_runner_t *runner, ctest_reporter_t *reporter, ctest_testcase_t *const*testcases, size_t testcase_count, int (*run_testcase)(ctest_runner_t *, ctest_testcase_reporter_t *, ctest_testcase_t *))
+CTEST_NONNULL_ARGS__(1, 2, 3, 5, 7)
+int runner_run_testcases(ctest_runner_t *runner, ctest_reporter_t *reporter, ctest_testcase_t *const*testcases, size_t testcase_count, runner_cancellation_t *cancellation, unsigned int retries, int (*run_testcase)(ctest_runner_t *, ctest_testcase_reporter_t *, ctest_testcase_t *), ctest_journal_t *journal)
 {
+	failed_tests_t__ failed = { NULL, NULL, 0, 0 };
 	ctest_testsuite_t *testsuite;
 	ctest_testsuite_reporter_t *testsuite_reporter;
 	size_t i_testcase;
@@ -235,7 +785,7 @@ int runner_run_testcases(ctest_runner_t *runner, ctest_reporter_t *reporter, cte
 			break;
 		}
 
-		rc = run_testcases_in_test__(runner, test_reporter, testcases + i_first_testcase, i_testcase - i_first_testcase, run_testcase);
+		rc = run_testcases_in_test__(runner, test_reporter, testcases + i_first_testcase, i_testcase - i_first_testcase, cancellation, retries, run_testcase, &failed, journal);
 		ctest_test_reporter_destroy(test_reporter);
 		if (rc < 0) {
 			result = -1;
@@ -246,14 +796,16 @@ int runner_run_testcases(ctest_runner_t *runner, ctest_reporter_t *reporter, cte
 
 	if (testsuite_reporter != NULL)
 		ctest_testsuite_reporter_destroy(testsuite_reporter);
+	failed_tests_destroy__(&failed);
 	(void)free((void*)testcases);
 repartition_testcases_failed:
 	return result;
 }
 
-CTEST_ALL_NONNULL_ARGS__
-int runner_run_tests(ctest_runner_t *runner, ctest_reporter_t *reporter, ctest_test_t *const*tests, size_t test_count, int (*run_testcase)(ctest_runner_t *, ctest_testcase_reporter_t *, ctest_testcase_t *))
+CTEST_NONNULL_ARGS__(1, 2, 3, 5, 7)
+int runner_run_tests(ctest_runner_t *runner, ctest_reporter_t *reporter, ctest_test_t *const*tests, size_t test_count, runner_cancellation_t *cancellation, unsigned int retries, int (*run_testcase)(ctest_runner_t *, ctest_testcase_reporter_t *, ctest_testcase_t *), ctest_journal_t *journal)
 {
+	failed_tests_t__ failed = { NULL, NULL, 0, 0 };
 	size_t i_test;
 	int result = -1;
 
@@ -281,7 +833,7 @@ int runner_run_tests(ctest_runner_t *runner, ctest_reporter_t *reporter, ctest_t
 			break;
 		}
 
-		rc = run_tests_in_testsuite__(runner, testsuite_reporter, tests + i_first_test, i_test - i_first_test, run_testcase);
+		rc = run_tests_in_testsuite__(runner, testsuite_reporter, tests + i_first_test, i_test - i_first_test, cancellation, retries, run_testcase, &failed, journal);
 		ctest_testsuite_reporter_destroy(testsuite_reporter);
 		if (rc < 0) {
 			result = -1;
@@ -290,29 +842,1369 @@ int runner_run_tests(ctest_runner_t *runner, ctest_reporter_t *reporter, ctest_t
 		result += rc;
 	}
 
+	failed_tests_destroy__(&failed);
 	(void)free((void*)tests);
 repartition_tests_failed:
 	return result;
 }
 
-int runner_run_testsuites(ctest_runner_t *runner, ctest_reporter_t *reporter, ctest_testsuite_t *const*testsuites, size_t testsuite_count, int (*run_testcase)(ctest_runner_t *, ctest_testcase_reporter_t *, ctest_testcase_t *))
+int runner_run_testsuites(ctest_runner_t *runner, ctest_reporter_t *reporter, ctest_testsuite_t *const*testsuites, size_t testsuite_count, runner_cancellation_t *cancellation, unsigned int retries, int (*run_testcase)(ctest_runner_t *, ctest_testcase_reporter_t *, ctest_testcase_t *), ctest_journal_t *journal)
 {
+	failed_tests_t__ failed = { NULL, NULL, 0, 0 };
 	int result = 0;
 	size_t i;
 	for (i = 0; i < testsuite_count; ++i) {
 		ctest_testsuite_t *const testsuite = testsuites[i];
+		const size_t test_count = ctest_testsuite_get_test_count(testsuite);
 		ctest_testsuite_reporter_t *testsuite_reporter;
-		int rc;
+		ctest_test_t *const*tests = NULL;
+		int rc = -1;
 
+		/* The suite's own order, except that tests come after their
+		 * prerequisites. */
+		if (test_count > 0 && (tests = repartition_tests__(ctest_testsuite_get_tests(testsuite), test_count)) == NULL)
+			goto repartition_tests_failed;
 		if ((testsuite_reporter = ctest_reporter_report_testsuite(reporter, testsuite)) == NULL)
-			return -1;
+			goto report_testsuite_failed;
 
-		rc = run_tests_in_testsuite__(runner, testsuite_reporter, ctest_testsuite_get_tests(testsuite), ctest_testsuite_get_test_count(testsuite), run_testcase);
+		rc = run_tests_in_testsuite__(runner, testsuite_reporter, tests != NULL ? tests : ctest_testsuite_get_tests(testsuite), test_count, cancellation, retries, run_testcase, &failed, journal);
 		ctest_testsuite_reporter_destroy(testsuite_reporter);
 
-		if (rc < 0)
-			return rc;
+report_testsuite_failed:
+		(void)free((void *)tests);
+repartition_tests_failed:
+		if (rc < 0) {
+			result = -1;
+			break;
+		}
 		result += rc;
 	}
+	failed_tests_destroy__(&failed);
+	return result;
+}
+
+/*
+ * Asynchronous Execution
+ */
+
+typedef struct plan_testsuite__ plan_testsuite_t__;
+struct plan_testsuite__ {
+	ctest_testsuite_t *testsuite;
+	ctest_testsuite_reporter_t *reporter;
+	size_t pending;         /* Test cases not yet reported. */
+};
+
+typedef struct plan_test__ plan_test_t__;
+struct plan_test__ {
+	ctest_test_t *test;
+	size_t i_testsuite;
+	ctest_test_reporter_t *reporter;
+	size_t pending;         /* Test cases not yet reported. */
+	size_t unfinished;      /* Test cases without a final result. */
+	bool failed;            /* Whether a final result wasn't a pass. */
+
+	/* The prerequisites of the test that are part of the plan (a range
+	 * of the plan's prerequisites), how many of them are unfinished, and
+	 * the one that didn't pass (SIZE_MAX if none), whose failure the
+	 * test's test cases are skipped for. */
+	size_t prerequisites;
+	size_t prerequisite_count;
+	size_t waiting;
+	size_t failed_prerequisite;
+
+	/* The resources each test case of the test holds while in flight (a
+	 * range of the plan's claims). */
+	size_t claims;
+	size_t claim_count;
+
+	/* Whether each test case of the test is run with no other job in
+	 * flight (see runner_executor_runs_alone). */
+	bool alone;
+};
+
+/**
+ * A shared resource used by test cases of the plan (see
+ * <code>ctest_test_get_resources</code>): how much of it there is, and how
+ * much of it the jobs in flight hold.
+ */
+typedef struct plan_resource__ plan_resource_t__;
+struct plan_resource__ {
+	const char *name;       /* Not NUL-terminated. */
+	size_t length;
+	unsigned long capacity;
+	unsigned long in_use;
+};
+
+/**
+ * The amount of a resource each test case of a test holds while in flight,
+ * never more than the resource's capacity.
+ */
+typedef struct plan_claim__ plan_claim_t__;
+struct plan_claim__ {
+	size_t i_resource;
+	unsigned long amount;
+};
+
+/**
+ * A shared fixture used by jobs of the plan, and how many of them don't have
+ * their final result yet; once none are left, the fixture is queued (through
+ * <code>next_released</code>) to be released.
+ */
+typedef struct plan_fixture__ plan_fixture_t__;
+struct plan_fixture__ {
+	ctest_fixture_t *fixture;
+	size_t pending;
+	size_t next_released;
+};
+
+/**
+ * The jobs left to a worker of the executor: a contiguous range of the plan's
+ * jobs, taken from the front by the worker itself and from the back by idle
+ * workers stealing from it.
+ */
+typedef struct plan_worker__ plan_worker_t__;
+struct plan_worker__ {
+	size_t begin;
+	size_t end;
+	bool busy;
+};
+
+/**
+ * The execution plan for a collection of test cases.
+ *
+ * The jobs of a plan are ordered such that all jobs for the same test are
+ * contiguous and all tests of the same test suite are contiguous; results are
+ * reported in this order, no matter the order in which the jobs complete.
+ *
+ * Jobs are scheduled by work stealing: each worker starts with a contiguous
+ * range of the jobs (split on test boundaries where possible), so the test
+ * cases of a test tend to run back to back on the same worker, and a worker
+ * that runs out of jobs steals the back half of the largest remaining range.
+ *
+ * When durations of the test cases have been recorded, jobs are instead all
+ * taken from a single queue, longest first (LPT), since a long job started
+ * late dominates the duration of the run.
+ *
+ * When the executor isolates groups of test cases (tests or test suites),
+ * ranges are only ever split at the start of a group, so every group is run
+ * whole, in order, on a single worker; jobs are never taken longest first.
+ *
+ * A job is only started once every test case of the prerequisites of its test
+ * has a final result, and is completed as skipped (without being started on
+ * the executor) if one of them didn't pass. Tests come after their
+ * prerequisites in the plan; a worker whose next job has to wait does, unless
+ * jobs are taken from a single queue (which they then are, even without
+ * recorded durations), in which case the first job that can be started is.
+ *
+ * Likewise, a job is only started once the resources its test uses are
+ * available: the jobs in flight never hold more of a resource than there is,
+ * so a job may have to wait for others to complete (and jobs are then taken
+ * from a single queue as well). So is a job's expected memory use, given a
+ * memory budget, except that the first job of the queue waiting for memory
+ * holds back the jobs after it, so they don't keep taking the memory it is
+ * waiting for. A job the executor runs alone waits for every job in flight to
+ * complete (holding back the jobs after it the same way), and no other job is
+ * started while it is in flight.
+ *
+ * A job whose result was loaded into the journal of the run is completed with
+ * that result as soon as it's taken, without being started.
+ */
+typedef struct runner_plan__ runner_plan_t__;
+struct runner_plan__ {
+	plan_testsuite_t__ *testsuites;
+	size_t testsuite_count;
+	plan_test_t__ *tests;
+	size_t test_count;
+	plan_fixture_t__ *fixtures;
+	size_t fixture_count;
+	size_t released;        /* First fixture to release, or SIZE_MAX. */
+	size_t *prerequisites;  /* Indices of tests, or NULL if none have any. */
+	plan_resource_t__ *resources;
+	size_t resource_count;
+	plan_claim_t__ *claims; /* NULL if no test uses any resources. */
+	uint64_t memory_budget; /* Zero for no limit. */
+	uint64_t memory_in_use;
+	bool has_alone;         /* Whether any test is run alone. */
+	size_t claimed_count;   /* Jobs in flight. */
+	bool alone_claimed;     /* Whether a job run alone is in flight. */
+	runner_job_t *jobs;
+	size_t job_count;
+	plan_worker_t__ *workers;
+	size_t worker_count;
+
+	/* The index of the first job of each group, followed by the number
+	 * of jobs. */
+	size_t *group_begins;
+	size_t group_count;
+
+	/* The timing database, if jobs are started longest first (in the
+	 * order of start_order) rather than by work stealing. */
+	ctest_timings_t *timings;
+	size_t *start_order;
+	size_t next_start;
+
+	/* The journal of the run, if any. */
+	ctest_journal_t *journal;
+
+	size_t started;         /* Number of jobs started. */
+	size_t completed;       /* Number of jobs completed. */
+	size_t reported;        /* Number of jobs reported (in order). */
+	int failures;           /* Number of jobs reported as failed. */
+
+	/* The cancellation state of the executor, and whether the plan has
+	 * acted on the run being cancelled. */
+	runner_cancellation_t *cancellation;
+	bool cancelled;
+
+	/* How many times a failed job is retried, and the jobs waiting to be
+	 * retried (a ring of job indices, in the order they failed). */
+	unsigned int retries;
+	size_t *retry_queue;
+	size_t retry_head;
+	size_t retry_count;
+};
+
+static void plan_destroy__(runner_plan_t__ *plan)
+{
+	size_t i;
+
+	for (i = 0; i < plan->job_count; ++i) {
+		runner_job_t *const job = plan->jobs + i;
+		if (job->result != NULL)
+			ctest_result_destroy(job->result);
+		if (job->failed_attempt != NULL)
+			ctest_result_destroy(job->failed_attempt);
+		if (job->reporter != NULL)
+			ctest_testcase_reporter_destroy(job->reporter);
+	}
+	for (i = 0; i < plan->test_count; ++i) {
+		if (plan->tests[i].reporter != NULL)
+			ctest_test_reporter_destroy(plan->tests[i].reporter);
+	}
+	for (i = 0; i < plan->testsuite_count; ++i) {
+		if (plan->testsuites[i].reporter != NULL)
+			ctest_testsuite_reporter_destroy(plan->testsuites[i].reporter);
+	}
+
+	(void)free(plan->claims);
+	(void)free(plan->resources);
+	(void)free(plan->prerequisites);
+	(void)free(plan->retry_queue);
+	(void)free(plan->group_begins);
+	(void)free(plan->start_order);
+	(void)free(plan->workers);
+	(void)free(plan->jobs);
+	(void)free(plan->fixtures);
+	(void)free(plan->tests);
+	(void)free(plan->testsuites);
+	memset(plan, 0, sizeof(*plan));
+}
+
+/**
+ * Find the index of a shared fixture among those of a plan, adding it if it
+ * isn't there yet.
+ */
+CTEST_ALL_NONNULL_ARGS__
+static size_t plan_add_fixture__(runner_plan_t__ *plan, ctest_fixture_t *fixture)
+{
+	size_t i;
+
+	for (i = 0; i < plan->fixture_count; ++i) {
+		if (plan->fixtures[i].fixture == fixture)
+			return i;
+	}
+	plan->fixtures[i].fixture = fixture;
+	plan->fixtures[i].pending = 0;
+	plan->fixtures[i].next_released = SIZE_MAX;
+	plan->fixture_count += 1;
+	return i;
+}
+
+/**
+ * Release the shared fixtures none of whose jobs are left to run.
+ */
+CTEST_ALL_NONNULL_ARGS__
+static void plan_release_fixtures__(runner_plan_t__ *plan, runner_executor_t *executor)
+{
+	while (plan->released != SIZE_MAX) {
+		plan_fixture_t__ *const fixture = plan->fixtures + plan->released;
+		plan->released = fixture->next_released;
+		runner_executor_release_fixture(executor, fixture->fixture);
+	}
+}
+
+/**
+ * Split the jobs of a plan into one contiguous range per worker.
+ *
+ * Each range ends on a test boundary, if there's one within half a range's
+ * length of the even split point, so a test's test cases start out on one
+ * worker; otherwise (e.g., a test with many more test cases than the others)
+ * the test is split evenly. A range that would end within a group is extended
+ * to the end of the group.
+ */
+CTEST_ALL_NONNULL_ARGS__
+static void plan_seed_workers__(runner_plan_t__ *plan)
+{
+	const size_t share = plan->job_count / plan->worker_count;
+	size_t i, begin = 0;
+
+	for (i = 0; i < plan->worker_count; ++i) {
+		plan_worker_t__ *const worker = plan->workers + i;
+		size_t end = (plan->job_count * (i + 1)) / plan->worker_count;
+
+		if (end < begin) {
+			end = begin;
+		} else if (i + 1 < plan->worker_count) {
+			size_t boundary;
+			for (boundary = end; boundary < plan->job_count && boundary < end + share / 2; ++boundary) {
+				if (plan->jobs[boundary].i_test != plan->jobs[boundary - 1].i_test)
+					break;
+			}
+			if (boundary < plan->job_count && boundary > 0 && plan->jobs[boundary].i_test != plan->jobs[boundary - 1].i_test)
+				end = boundary;
+		}
+		if (end < plan->job_count && plan->group_begins[plan->jobs[end].group] < end)
+			end = plan->group_begins[plan->jobs[end].group + 1];
+
+		worker->begin = begin;
+		worker->end = end;
+		worker->busy = false;
+		begin = end;
+	}
+}
+
+/**
+ * Find where to split the jobs left to a worker, so another worker can steal
+ * the back of them: at the start of the group in the middle of the range or,
+ * if the worker has already started on that group, of the next one.
+ *
+ * @return The first job to steal, or the end of the range if none can be.
+ */
+CTEST_ALL_NONNULL_ARGS__
+static size_t plan_find_split__(const runner_plan_t__ *plan, const plan_worker_t__ *worker)
+{
+	size_t group;
+
+	if (worker->begin == worker->end)
+		return worker->end;
+	group = plan->jobs[worker->begin + (worker->end - worker->begin) / 2].group;
+	if (plan->group_begins[group] >= worker->begin)
+		return plan->group_begins[group];
+	return plan->group_begins[group + 1] < worker->end ? plan->group_begins[group + 1] : worker->end;
+}
+
+/**
+ * Whether the resources a test's test cases use are available, in the amounts
+ * each of them holds while in flight.
+ */
+CTEST_ALL_NONNULL_ARGS__
+static bool plan_claims_fit__(const runner_plan_t__ *plan, const plan_test_t__ *plan_test)
+{
+	size_t i;
+
+	for (i = plan_test->claims; i < plan_test->claims + plan_test->claim_count; ++i) {
+		const plan_claim_t__ *const claim = plan->claims + i;
+		const plan_resource_t__ *const resource = plan->resources + claim->i_resource;
+		if (resource->in_use + claim->amount > resource->capacity)
+			return false;
+	}
+	return true;
+}
+
+/**
+ * Whether the memory a job is expected to use fits in the budget, along with
+ * that of the jobs in flight.
+ */
+CTEST_ALL_NONNULL_ARGS__
+static bool plan_memory_fits__(const runner_plan_t__ *plan, const runner_job_t *job)
+{
+	return plan->memory_budget == 0 || plan->memory_in_use + job->memory_bytes <= plan->memory_budget;
+}
+
+/**
+ * Whether a test's test cases may run alongside the jobs in flight: unless
+ * one of those is run alone, or its own test cases are and any job is in
+ * flight.
+ */
+CTEST_ALL_NONNULL_ARGS__
+static bool plan_alone_fits__(const runner_plan_t__ *plan, const plan_test_t__ *plan_test)
+{
+	return !plan->alone_claimed && (!plan_test->alone || plan->claimed_count == 0);
+}
+
+/**
+ * Whether a job can be taken: once the prerequisites of its test are finished
+ * and the resources and memory it uses are available (or as soon as one of
+ * the prerequisites didn't pass, so it's skipped).
+ */
+CTEST_ALL_NONNULL_ARGS__
+static bool plan_job_ready__(const runner_plan_t__ *plan, const runner_job_t *job)
+{
+	const plan_test_t__ *const plan_test = plan->tests + job->i_test;
+
+	if (plan_test->failed_prerequisite != SIZE_MAX)
+		return true;
+	return plan_test->waiting == 0 && plan_claims_fit__(plan, plan_test) && plan_memory_fits__(plan, job) && plan_alone_fits__(plan, plan_test);
+}
+
+/**
+ * Whether a job could be taken, if only there were the memory for it, or no
+ * other job in flight for one run alone; the jobs after it in the queue are
+ * then held back until it is.
+ */
+CTEST_ALL_NONNULL_ARGS__
+static bool plan_job_holds_back__(const runner_plan_t__ *plan, const runner_job_t *job)
+{
+	const plan_test_t__ *const plan_test = plan->tests + job->i_test;
+
+	if (plan_test->failed_prerequisite != SIZE_MAX || plan_test->waiting > 0 || !plan_claims_fit__(plan, plan_test))
+		return false;
+	if (!plan_memory_fits__(plan, job))
+		return true;
+	return plan_test->alone && !plan->alone_claimed && plan->claimed_count > 0;
+}
+
+/**
+ * Have a job about to be started hold the resources its test uses, and the
+ * memory it is expected to use, until it completes (see
+ * <code>plan_release_claims__</code>).
+ */
+CTEST_ALL_NONNULL_ARGS__
+static void plan_acquire_claims__(runner_plan_t__ *plan, runner_job_t *job)
+{
+	const plan_test_t__ *const plan_test = plan->tests + job->i_test;
+	size_t i;
+
+	for (i = plan_test->claims; i < plan_test->claims + plan_test->claim_count; ++i)
+		plan->resources[plan->claims[i].i_resource].in_use += plan->claims[i].amount;
+	plan->memory_in_use += job->memory_bytes;
+	plan->claimed_count += 1;
+	if (plan_test->alone)
+		plan->alone_claimed = true;
+	job->claimed = true;
+}
+
+/**
+ * Release the resources held by a job that is no longer in flight, if any.
+ */
+CTEST_ALL_NONNULL_ARGS__
+static void plan_release_claims__(runner_plan_t__ *plan, runner_job_t *job)
+{
+	const plan_test_t__ *const plan_test = plan->tests + job->i_test;
+	size_t i;
+
+	if (!job->claimed)
+		return;
+	for (i = plan_test->claims; i < plan_test->claims + plan_test->claim_count; ++i)
+		plan->resources[plan->claims[i].i_resource].in_use -= plan->claims[i].amount;
+	plan->memory_in_use -= job->memory_bytes;
+	plan->claimed_count -= 1;
+	if (plan_test->alone)
+		plan->alone_claimed = false;
+	job->claimed = false;
+}
+
+/**
+ * Take the next job for an idle worker: the first job of its own range or,
+ * once that's exhausted, the first job of the back half of the largest range
+ * it steals from another worker (that can be split between groups).
+ *
+ * @return The job, or <code>NULL</code> if no jobs are left to start (or the
+ *         next one has to wait for its prerequisites or resources).
+ */
+CTEST_ALL_NONNULL_ARGS__
+static runner_job_t *plan_take_job__(runner_plan_t__ *plan, size_t i_worker)
+{
+	plan_worker_t__ *const worker = plan->workers + i_worker;
+
+	if (plan->start_order != NULL) {
+		size_t i;
+
+		/* Jobs are taken once they're started (or completed). */
+		while (plan->next_start < plan->job_count && (plan->jobs[plan->start_order[plan->next_start]].attempt > 0 || plan->jobs[plan->start_order[plan->next_start]].completed))
+			plan->next_start += 1;
+		for (i = plan->next_start; i < plan->job_count; ++i) {
+			runner_job_t *const job = plan->jobs + plan->start_order[i];
+			if (job->attempt > 0 || job->completed)
+				continue;
+			if (plan_job_ready__(plan, job))
+				return job;
+			if (plan_job_holds_back__(plan, job))
+				break;
+		}
+		return NULL;
+	}
+
+	if (worker->begin == worker->end) {
+		plan_worker_t__ *victim = NULL;
+		size_t i, split = 0;
+
+		for (i = 0; i < plan->worker_count; ++i) {
+			plan_worker_t__ *const candidate = plan->workers + i;
+			const size_t candidate_split = plan_find_split__(plan, candidate);
+			if (candidate_split < candidate->end && (victim == NULL || candidate->end - candidate->begin > victim->end - victim->begin)) {
+				victim = candidate;
+				split = candidate_split;
+			}
+		}
+		if (victim == NULL)
+			return NULL;
+
+		worker->begin = split;
+		worker->end = victim->end;
+		victim->end = split;
+	}
+
+	if (!plan_job_ready__(plan, plan->jobs + worker->begin))
+		return NULL;
+	return plan->jobs + worker->begin++;
+}
+
+/**
+ * Queue a job that failed to be retried.
+ */
+CTEST_ALL_NONNULL_ARGS__
+static void plan_queue_retry__(runner_plan_t__ *plan, runner_job_t *job)
+{
+	/* A job is queued at most once at a time, so the ring never fills. */
+	plan->retry_queue[(plan->retry_head + plan->retry_count++) % plan->job_count] = (size_t)(job - plan->jobs);
+}
+
+/**
+ * Whether the next job to retry can be taken (see
+ * <code>plan_take_retry__</code>): once the resources it uses are available.
+ */
+CTEST_ALL_NONNULL_ARGS__
+static bool plan_retry_ready__(const runner_plan_t__ *plan)
+{
+	return plan->retry_count > 0 && plan_job_ready__(plan, plan->jobs + plan->retry_queue[plan->retry_head]);
+}
+
+/**
+ * Take the next job to retry, for an idle worker that has no first attempts
+ * left to start.
+ *
+ * @return The job, or <code>NULL</code> if no jobs are waiting to be retried.
+ */
+CTEST_ALL_NONNULL_ARGS__
+static runner_job_t *plan_take_retry__(runner_plan_t__ *plan)
+{
+	runner_job_t *job;
+
+	if (plan->retry_count == 0)
+		return NULL;
+	job = plan->jobs + plan->retry_queue[plan->retry_head];
+	plan->retry_head = (plan->retry_head + 1) % plan->job_count;
+	plan->retry_count -= 1;
+	return job;
+}
+
+/**
+ * Find the prerequisites of each test of a plan among the plan's tests;
+ * prerequisites that aren't part of the plan (e.g., left out of the run)
+ * don't hold a test back.
+ *
+ * @return Zero on success, non-zero on failure.
+ */
+CTEST_ALL_NONNULL_ARGS__
+static int plan_link_tests__(runner_plan_t__ *plan)
+{
+	ctest_test_t *const *prerequisite;
+	size_t i, j, count = 0;
+
+	for (i = 0; i < plan->test_count; ++i) {
+		plan->tests[i].failed_prerequisite = SIZE_MAX;
+		for (prerequisite = ctest_test_get_prerequisites(plan->tests[i].test); *prerequisite != NULL; ++prerequisite)
+			count += 1;
+	}
+	if (count == 0)
+		return 0;
+	if ((plan->prerequisites = calloc(count, sizeof(*plan->prerequisites))) == NULL)
+		return -1;
+
+	count = 0;
+	for (i = 0; i < plan->test_count; ++i) {
+		plan_test_t__ *const plan_test = plan->tests + i;
+
+		plan_test->prerequisites = count;
+		for (prerequisite = ctest_test_get_prerequisites(plan_test->test); *prerequisite != NULL; ++prerequisite) {
+			for (j = 0; j < plan->test_count; ++j) {
+				if (plan->tests[j].test == *prerequisite) {
+					plan->prerequisites[count++] = j;
+					break;
+				}
+			}
+		}
+		plan_test->prerequisite_count = count - plan_test->prerequisites;
+		plan_test->waiting = plan_test->prerequisite_count;
+	}
+	return 0;
+}
+
+/**
+ * Account for a test of a plan all of whose test cases have their final
+ * result, letting the tests that depend on it go ahead (or be skipped, if it
+ * didn't pass).
+ */
+CTEST_ALL_NONNULL_ARGS__
+static void plan_finish_test__(runner_plan_t__ *plan, size_t i_test)
+{
+	const plan_test_t__ *const finished = plan->tests + i_test;
+	size_t i, j;
+
+	for (i = 0; i < plan->test_count; ++i) {
+		plan_test_t__ *const plan_test = plan->tests + i;
+
+		for (j = plan_test->prerequisites; j < plan_test->prerequisites + plan_test->prerequisite_count; ++j) {
+			if (plan->prerequisites[j] != i_test)
+				continue;
+			plan_test->waiting -= 1;
+			/* Point at the prerequisite that actually failed, if
+			 * this one was only skipped for it. */
+			if (finished->failed && plan_test->failed_prerequisite == SIZE_MAX)
+				plan_test->failed_prerequisite = finished->failed_prerequisite != SIZE_MAX ? finished->failed_prerequisite : i_test;
+		}
+	}
+}
+
+/**
+ * Find the resource of a plan with the given name, adding it (with the
+ * capacity given for it, or one) if it isn't there yet.
+ *
+ * @return The index of the resource, or <code>SIZE_MAX</code> (with
+ *         <code>errno</code> set) if a capacity is malformed.
+ */
+CTEST_NONNULL_ARGS__(1, 2)
+static size_t plan_add_resource__(runner_plan_t__ *plan, const char *name, size_t length, const char *const *capacities)
+{
+	plan_resource_t__ *resource;
+	unsigned long capacity = 1, amount;
+	size_t i, capacity_length;
+
+	for (i = 0; i < plan->resource_count; ++i) {
+		resource = plan->resources + i;
+		if (resource->length == length && memcmp(resource->name, name, length) == 0)
+			return i;
+	}
+	for (; capacities != NULL && *capacities != NULL; ++capacities) {
+		if (resource_parse(*capacities, '=', &capacity_length, &amount) != 0)
+			return SIZE_MAX;
+		if (capacity_length == length && memcmp(*capacities, name, length) == 0)
+			capacity = amount;
+	}
+
+	resource = plan->resources + plan->resource_count++;
+	resource->name = name;
+	resource->length = length;
+	resource->capacity = capacity;
+	resource->in_use = 0;
+	return plan->resource_count - 1;
+}
+
+/**
+ * Find the resources used by each test of a plan, and how much of each its
+ * test cases hold while in flight. A test case needing more of a resource
+ * than there is (e.g., of one without a capacity) uses all of it.
+ *
+ * @param plan       The plan.
+ * @param capacities The capacities of the resources, as a
+ *                   <code>NULL</code>-terminated array of "name=capacity",
+ *                   or <code>NULL</code>.
+ *
+ * @return Zero on success, non-zero on failure.
+ */
+CTEST_NONNULL_ARGS__(1)
+static int plan_link_resources__(runner_plan_t__ *plan, const char *const *capacities)
+{
+	const char *const *spec;
+	unsigned long amount;
+	size_t i, j, length, i_resource, count = 0;
+
+	for (i = 0; i < plan->test_count; ++i) {
+		for (spec = ctest_test_get_resources(plan->tests[i].test); *spec != NULL; ++spec)
+			count += 1;
+	}
+	if (count == 0)
+		return 0;
+	if ((plan->claims = calloc(count, sizeof(*plan->claims))) == NULL)
+		goto claims_alloc_failed;
+	if ((plan->resources = calloc(count, sizeof(*plan->resources))) == NULL)
+		goto resources_alloc_failed;
+
+	count = 0;
+	for (i = 0; i < plan->test_count; ++i) {
+		plan_test_t__ *const plan_test = plan->tests + i;
+
+		plan_test->claims = count;
+		for (spec = ctest_test_get_resources(plan_test->test); *spec != NULL; ++spec) {
+			/* The loader rejects malformed resources. */
+			if (resource_parse(*spec, ':', &length, &amount) != 0)
+				goto parse_failed;
+			if ((i_resource = plan_add_resource__(plan, *spec, length, capacities)) == SIZE_MAX)
+				goto parse_failed;
+
+			/* A resource listed twice is used twice over. */
+			for (j = plan_test->claims; j < count && plan->claims[j].i_resource != i_resource; ++j)
+				;
+			if (j == count) {
+				plan->claims[count].i_resource = i_resource;
+				plan->claims[count++].amount = 0;
+			}
+			plan->claims[j].amount += amount;
+		}
+		plan_test->claim_count = count - plan_test->claims;
+		for (j = plan_test->claims; j < count; ++j) {
+			const unsigned long capacity = plan->resources[plan->claims[j].i_resource].capacity;
+			if (plan->claims[j].amount > capacity)
+				plan->claims[j].amount = capacity;
+		}
+	}
+	return 0;
+
+parse_failed:
+	(void)free(plan->resources);
+	plan->resources = NULL;
+	plan->resource_count = 0;
+resources_alloc_failed:
+	(void)free(plan->claims);
+	plan->claims = NULL;
+claims_alloc_failed:
+	return -1;
+}
+
+/**
+ * Work out how much memory each job of a plan is expected to use: as much as
+ * its test case did when last measured or, if it hasn't been, as much as the
+ * most any test case of the plan did, but no less than an even share of the
+ * budget among the workers. A job expected to use more than the budget is
+ * only ever run on its own.
+ */
+CTEST_NONNULL_ARGS__(1)
+static void plan_predict_memory__(runner_plan_t__ *plan, ctest_timings_t *timings, uint64_t budget)
+{
+	uint64_t unknown_bytes = budget / plan->worker_count;
+	size_t i;
+
+	plan->memory_budget = budget;
+	if (budget == 0)
+		return;
+
+	for (i = 0; timings != NULL && i < plan->job_count; ++i) {
+		runner_job_t *const job = plan->jobs + i;
+		if (!ctest_timings_lookup_memory(timings, job->testcase, &job->memory_bytes))
+			job->memory_bytes = 0;
+		if (job->memory_bytes > unknown_bytes)
+			unknown_bytes = job->memory_bytes;
+	}
+	for (i = 0; i < plan->job_count; ++i) {
+		runner_job_t *const job = plan->jobs + i;
+		if (job->memory_bytes == 0)
+			job->memory_bytes = unknown_bytes;
+		if (job->memory_bytes > budget)
+			job->memory_bytes = budget;
+	}
+}
+
+/**
+ * Initialize a plan from a collection of test cases that is already grouped
+ * by test and test suite (and ordered such that tests come after their
+ * prerequisites).
+ *
+ * @param plan           The plan to initialize.
+ * @param executor       The executor that is to run the plan.
+ * @param testcases      The grouped test cases.
+ * @param testcase_count The number of test cases in <tt>testcases</tt>.
+ * @param worker_count   The number of workers on which to schedule the test
+ *                       cases.
+ * @param timings        The recorded durations of test cases, or
+ *                       <code>NULL</code>.
+ * @param journal        The journal of the run, or <code>NULL</code>.
+ * @param cancellation   The cancellation state of the run.
+ * @param retries        How many times to retry a job that fails.
+ * @param isolation      Which test cases form a group.
+ * @param capacities     The capacities of the resources test cases use (see
+ *                       <code>plan_link_resources__</code>).
+ * @param memory_budget  How much memory the jobs in flight may be expected
+ *                       to use together, or zero for no limit.
+ *
+ * @return Zero on success, non-zero on failure.
+ */
+CTEST_NONNULL_ARGS__(1, 2, 3, 8)
+static int plan_init__(runner_plan_t__ *plan, runner_executor_t *executor, ctest_testcase_t *const*testcases, size_t testcase_count, size_t worker_count, ctest_timings_t *timings, ctest_journal_t *journal, runner_cancellation_t *cancellation, unsigned int retries, ctest_isolation_t isolation, const char *const *capacities, uint64_t memory_budget)
+{
+	ctest_testsuite_t *testsuite = NULL;
+	ctest_test_t *test = NULL;
+	size_t i, i_fixture = SIZE_MAX;
+
+	memset(plan, 0, sizeof(*plan));
+	plan->cancellation = cancellation;
+	plan->released = SIZE_MAX;
+	if (testcase_count == 0)
+		return 0;
+
+	if ((plan->jobs = calloc(testcase_count, sizeof(*plan->jobs))) == NULL)
+		goto jobs_alloc_failed;
+	if ((plan->tests = calloc(testcase_count, sizeof(*plan->tests))) == NULL)
+		goto tests_alloc_failed;
+	/* At most one shared fixture for each test. */
+	if ((plan->fixtures = calloc(testcase_count, sizeof(*plan->fixtures))) == NULL)
+		goto fixtures_alloc_failed;
+	if ((plan->testsuites = calloc(testcase_count, sizeof(*plan->testsuites))) == NULL)
+		goto testsuites_alloc_failed;
+	if ((plan->workers = calloc(worker_count, sizeof(*plan->workers))) == NULL)
+		goto workers_alloc_failed;
+	if ((plan->group_begins = calloc(testcase_count + 1, sizeof(*plan->group_begins))) == NULL)
+		goto group_begins_alloc_failed;
+	if (retries > 0 && (plan->retry_queue = calloc(testcase_count, sizeof(*plan->retry_queue))) == NULL)
+		goto retry_queue_alloc_failed;
+
+	for (i = 0; i < testcase_count; ++i) {
+		ctest_testcase_t *const testcase = testcases[i];
+		ctest_test_t *const this_test = ctest_testcase_get_test(testcase);
+		ctest_testsuite_t *const this_testsuite = ctest_test_get_testsuite(this_test);
+		runner_job_t *const job = plan->jobs + i;
+		bool new_group = isolation == CTEST_ISOLATION_TESTCASE;
+
+		if (this_testsuite != testsuite || plan->testsuite_count == 0) {
+			plan->testsuites[plan->testsuite_count++].testsuite = this_testsuite;
+			testsuite = this_testsuite;
+			test = NULL;
+			new_group = true;
+		}
+		if (this_test != test) {
+			plan_test_t__ *const plan_test = plan->tests + plan->test_count++;
+			ctest_fixture_t *const fixture = ctest_test_get_shared_fixture(this_test);
+			plan_test->test = this_test;
+			plan_test->i_testsuite = plan->testsuite_count - 1;
+			plan_test->alone = runner_executor_runs_alone(executor, this_test);
+			plan->has_alone = plan->has_alone || plan_test->alone;
+			test = this_test;
+			new_group = new_group || isolation == CTEST_ISOLATION_TEST;
+			i_fixture = fixture != NULL ? plan_add_fixture__(plan, fixture) : SIZE_MAX;
+		}
+		if (new_group)
+			plan->group_begins[plan->group_count++] = i;
+		job->group = plan->group_count - 1;
+
+		job->testcase = testcase;
+		job->plan = plan;
+		job->i_test = plan->test_count - 1;
+		job->i_fixture = i_fixture;
+		if (i_fixture != SIZE_MAX)
+			plan->fixtures[i_fixture].pending += 1;
+		plan->tests[job->i_test].pending += 1;
+		plan->tests[job->i_test].unfinished += 1;
+		plan->testsuites[plan->tests[job->i_test].i_testsuite].pending += 1;
+	}
+	plan->group_begins[plan->group_count] = testcase_count;
+	plan->job_count = testcase_count;
+	plan->worker_count = worker_count;
+	plan->timings = timings;
+	plan->journal = journal;
+	plan->retries = retries;
+	if (plan_link_tests__(plan) != 0)
+		goto link_tests_failed;
+	if (plan_link_resources__(plan, capacities) != 0)
+		goto link_resources_failed;
+	plan_predict_memory__(plan, timings, memory_budget);
+	plan_seed_workers__(plan);
+
+	/* Without any recorded durations (or the memory to sort by them),
+	 * work stealing keeps the locality of the grouped test cases, unless
+	 * jobs may have to wait for others, which would hold up the rest of
+	 * a worker's range. */
+	if ((timings != NULL || plan->prerequisites != NULL || plan->claims != NULL || memory_budget > 0 || plan->has_alone) && worker_count > 1 && isolation == CTEST_ISOLATION_TESTCASE && (plan->start_order = calloc(testcase_count, sizeof(*plan->start_order))) != NULL) {
+		if (timings == NULL || ctest_timings_order(timings, testcases, testcase_count, plan->start_order, NULL) == 0) {
+			for (i = 0; i < testcase_count; ++i)
+				plan->start_order[i] = i;
+			if (plan->prerequisites == NULL && plan->claims == NULL && memory_budget == 0 && !plan->has_alone) {
+				(void)free(plan->start_order);
+				plan->start_order = NULL;
+			}
+		}
+	}
+	return 0;
+
+link_resources_failed:
+	(void)free(plan->prerequisites);
+link_tests_failed:
+	(void)free(plan->retry_queue);
+retry_queue_alloc_failed:
+	(void)free(plan->group_begins);
+group_begins_alloc_failed:
+	(void)free(plan->workers);
+workers_alloc_failed:
+	(void)free(plan->testsuites);
+testsuites_alloc_failed:
+	(void)free(plan->fixtures);
+fixtures_alloc_failed:
+	(void)free(plan->tests);
+tests_alloc_failed:
+	(void)free(plan->jobs);
+jobs_alloc_failed:
+	memset(plan, 0, sizeof(*plan));
+	plan->cancellation = cancellation;
+	return -1;
+}
+
+/**
+ * Create the reporters required to report the progress of a job.
+ *
+ * Test suite and test reporters are created the first time a job belonging
+ * to them is started and are kept until the last of their jobs is reported.
+ *
+ * @return Zero on success, non-zero on failure.
+ */
+CTEST_ALL_NONNULL_ARGS__
+static int plan_open_job__(runner_plan_t__ *plan, ctest_reporter_t *reporter, runner_job_t *job)
+{
+	plan_test_t__ *const plan_test = plan->tests + job->i_test;
+	plan_testsuite_t__ *const plan_testsuite = plan->testsuites + plan_test->i_testsuite;
+
+	if (plan_testsuite->reporter == NULL) {
+		if ((plan_testsuite->reporter = ctest_reporter_report_testsuite(reporter, plan_testsuite->testsuite)) == NULL)
+			return -1;
+	}
+	if (plan_test->reporter == NULL) {
+		if ((plan_test->reporter = ctest_testsuite_reporter_report_test(plan_testsuite->reporter, plan_test->test)) == NULL)
+			return -1;
+	}
+	if ((job->reporter = ctest_test_reporter_report_testcase(plan_test->reporter, job->testcase)) == NULL)
+		return -1;
+
+	return 0;
+}
+
+/**
+ * Report the results of all completed jobs that can be reported without
+ * violating the ordering of the plan.
+ */
+CTEST_ALL_NONNULL_ARGS__
+static void plan_report_completed__(runner_plan_t__ *plan)
+{
+	while (plan->reported < plan->job_count && plan->jobs[plan->reported].completed) {
+		runner_job_t *const job = plan->jobs + plan->reported++;
+		plan_test_t__ *const plan_test = plan->tests + job->i_test;
+		plan_testsuite_t__ *const plan_testsuite = plan->testsuites + plan_test->i_testsuite;
+		ctest_result_t *const result = job->result;
+
+		job->result = NULL;
+		if (result_is_failure__(result) || result->type == CTEST_RESULT_CANCELLED)
+			plan->failures += 1;
+		if (plan->journal != NULL && !job->replayed)
+			(void)ctest_journal_record(plan->journal, job->testcase, result);
+		if (plan->timings != NULL && !job->replayed && result->type != CTEST_RESULT_SKIPPED && result->type != CTEST_RESULT_ERROR && result->type != CTEST_RESULT_CANCELLED) {
+			(void)ctest_timings_record(plan->timings, job->testcase, result->duration_ns);
+			if (result->peak_memory_bytes > 0)
+				(void)ctest_timings_record_memory(plan->timings, job->testcase, result->peak_memory_bytes);
+		}
+		ctest_testcase_reporter_complete(job->reporter, result);
+		ctest_testcase_reporter_destroy(job->reporter);
+		job->reporter = NULL;
+
+		if (--plan_test->pending == 0) {
+			ctest_test_reporter_destroy(plan_test->reporter);
+			plan_test->reporter = NULL;
+		}
+		if (--plan_testsuite->pending == 0) {
+			ctest_testsuite_reporter_destroy(plan_testsuite->reporter);
+			plan_testsuite->reporter = NULL;
+		}
+	}
+}
+
+static uint64_t now_ns__(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000000000u + now.tv_nsec;
+}
+
+/**
+ * Complete a job with its final result, letting the jobs that wait for it
+ * (through their tests' prerequisites, or for its fixture to be released) go
+ * ahead.
+ */
+CTEST_ALL_NONNULL_ARGS__
+static void plan_finish_job__(runner_plan_t__ *plan, runner_job_t *job, ctest_result_t *result)
+{
+	plan_test_t__ *const plan_test = plan->tests + job->i_test;
+
+	job->result = result;
+	job->completed = true;
+	plan->completed += 1;
+
+	plan_test->failed = plan_test->failed || !result_is_pass__(result);
+	if (--plan_test->unfinished == 0 && plan->prerequisites != NULL)
+		plan_finish_test__(plan, job->i_test);
+
+	if (job->i_fixture != SIZE_MAX && --plan->fixtures[job->i_fixture].pending == 0) {
+		plan->fixtures[job->i_fixture].next_released = plan->released;
+		plan->released = job->i_fixture;
+	}
+}
+
+CTEST_ALL_NONNULL_ARGS__
+void runner_job_complete(runner_job_t *job, ctest_result_t *result)
+{
+	runner_plan_t__ *const plan = job->plan;
+
+	if (job->completed) {
+		ctest_result_destroy(result);
+		return;
+	}
+	result->duration_ns = now_ns__() - job->start_ns;
+	result->attempt = job->attempt;
+	plan->workers[job->worker].busy = false;
+	plan_release_claims__(plan, job);
+
+	if (job->attempt <= plan->retries && result_is_failure__(result) && !runner_cancellation_check(plan->cancellation)) {
+		if (job->failed_attempt != NULL)
+			(void)ctest_result_set_previous_attempt(result, job->failed_attempt);
+		job->failed_attempt = result;
+		plan_queue_retry__(plan, job);
+		/* No longer in flight, until it's started again. */
+		plan->started -= 1;
+		return;
+	}
+
+	result = merge_attempts__(job->failed_attempt, result);
+	job->failed_attempt = NULL;
+	runner_cancellation_record(plan->cancellation, result_is_failure__(result));
+	plan_finish_job__(plan, job, result);
+}
+
+/**
+ * Complete a job with the result loaded for its test case into the journal of
+ * the run, if there is one, without starting it on the executor.
+ *
+ * @return Zero on success (with <code>*p_replayed</code> set to whether the
+ *         job was completed), non-zero on failure.
+ */
+CTEST_ALL_NONNULL_ARGS__
+static int plan_replay_job__(runner_plan_t__ *plan, runner_job_t *job, bool *p_replayed)
+{
+	ctest_result_t *result;
+
+	*p_replayed = false;
+	if (plan->journal == NULL)
+		return 0;
+	if (ctest_journal_replay(plan->journal, job->testcase, &result) != 0)
+		return -1;
+	if (result == NULL)
+		return 0;
+
+	plan->started += 1;
+	job->attempt = result->attempt;
+	job->replayed = true;
+	ctest_testcase_reporter_start(job->reporter);
+	plan_finish_job__(plan, job, result);
+	*p_replayed = true;
+	return 0;
+}
+
+/**
+ * Act on the run having been cancelled: stop the jobs in flight and complete
+ * every job that was never started as cancelled, so the report of the run is
+ * still complete.
+ *
+ * @return Zero on success, non-zero on failure.
+ */
+CTEST_ALL_NONNULL_ARGS__
+static int plan_cancel__(runner_plan_t__ *plan, runner_executor_t *executor, ctest_reporter_t *reporter)
+{
+	size_t i;
+
+	runner_job_t *retry;
+
+	plan->cancelled = true;
+	runner_executor_cancel(executor);
+
+	/* Jobs waiting to be retried have failed already. */
+	while ((retry = plan_take_retry__(plan)) != NULL) {
+		retry->result = retry->failed_attempt;
+		retry->failed_attempt = NULL;
+		retry->completed = true;
+		plan->started += 1;
+		plan->completed += 1;
+	}
+
+	for (i = 0; i < plan->job_count; ++i) {
+		runner_job_t *const job = plan->jobs + i;
+		ctest_result_t *result;
+		bool replayed;
+
+		/* Started jobs have a reporter until they're reported. */
+		if (job->completed || job->reporter != NULL)
+			continue;
+
+		if (plan_open_job__(plan, reporter, job) != 0 || plan_replay_job__(plan, job, &replayed) != 0)
+			return -1;
+		if (replayed)
+			continue;
+		if ((result = runner_cancellation_create_result(plan->cancellation, CTEST_STAGE_SETUP, "not run")) == NULL)
+			return -1;
+		ctest_testcase_reporter_start(job->reporter);
+		job->result = result;
+		job->completed = true;
+		plan->started += 1;
+		plan->completed += 1;
+	}
+	return 0;
+}
+
+/**
+ * Complete a job as skipped, without starting it on the executor, because a
+ * prerequisite of its test didn't pass.
+ *
+ * @return Zero on success, non-zero on failure.
+ */
+CTEST_ALL_NONNULL_ARGS__
+static int plan_skip_job__(runner_plan_t__ *plan, runner_job_t *job, size_t i_worker)
+{
+	ctest_result_t *result;
+
+	if ((result = create_skipped_result__(plan->tests[plan->tests[job->i_test].failed_prerequisite].test)) == NULL)
+		return -1;
+	plan->started += 1;
+	job->worker = i_worker;
+	job->attempt = 1;
+	job->start_ns = now_ns__();
+	ctest_testcase_reporter_start(job->reporter);
+	runner_job_complete(job, result);
+	return 0;
+}
+
+/**
+ * Take the next job to start on an idle worker: a first attempt if there's
+ * one it can take, or a retry, skipping the jobs whose tests' prerequisites
+ * didn't pass along the way.
+ *
+ * @return Zero on success (with <code>*p_job</code> set to <code>NULL</code>
+ *         if there's no job to start), non-zero on failure.
+ */
+CTEST_ALL_NONNULL_ARGS__
+static int plan_take_next__(runner_plan_t__ *plan, ctest_reporter_t *reporter, size_t i_worker, runner_job_t **p_job)
+{
+	runner_job_t *job;
+
+	/* First attempts go ahead of retries, so retries only ever take up
+	 * otherwise idle workers. A worker may find nothing to take while
+	 * another still has jobs of its own (the rest of a group it can't
+	 * steal, or jobs waiting for their prerequisites or resources). */
+	while ((job = plan_take_job__(plan, i_worker)) != NULL || (plan_retry_ready__(plan) && (job = plan_take_retry__(plan)) != NULL)) {
+		if (job->attempt == 0) {
+			bool replayed;
+
+			if (plan_open_job__(plan, reporter, job) != 0 || plan_replay_job__(plan, job, &replayed) != 0)
+				return -1;
+			if (replayed)
+				continue;
+		}
+		if (plan->tests[job->i_test].failed_prerequisite == SIZE_MAX)
+			break;
+		if (plan_skip_job__(plan, job, i_worker) != 0)
+			return -1;
+	}
+	*p_job = job;
+	return 0;
+}
+
+/**
+ * Run every job in a plan.
+ *
+ * @return The number of test cases that failed, or a negative number if an
+ *         error was encountered.
+ */
+CTEST_ALL_NONNULL_ARGS__
+static int plan_execute__(runner_plan_t__ *plan, runner_executor_t *executor, ctest_reporter_t *reporter)
+{
+	int result = 0;
+	size_t i;
+
+	while (plan->reported < plan->job_count) {
+		const size_t limit = executor->concurrency != NULL ? ctest_concurrency_update(executor->concurrency, plan->started - plan->completed) : plan->worker_count;
+
+		for (i = 0; result == 0 && !runner_cancellation_check(plan->cancellation) && i < plan->worker_count; ++i) {
+			runner_job_t *job;
+
+			if (plan->started - plan->completed >= limit)
+				break;
+			if (plan->workers[i].busy)
+				continue;
+			if (plan_take_next__(plan, reporter, i, &job) != 0) {
+				result = -1;
+				break;
+			}
+			if (job == NULL)
+				continue;
+
+			plan->started += 1;
+			job->worker = i;
+			job->attempt += 1;
+			job->start_ns = now_ns__();
+			plan->workers[i].busy = true;
+			plan_acquire_claims__(plan, job);
+			if (job->attempt == 1)
+				ctest_testcase_reporter_start(job->reporter);
+			if (runner_executor_start(executor, job) < 0) {
+				/* The job never ran; don't wait for it. */
+				plan_release_claims__(plan, job);
+				job->completed = true;
+				plan->completed += 1;
+				plan->workers[i].busy = false;
+				result = -1;
+			}
+		}
+
+		/* Let the controller know how many jobs the limit let start,
+		 * as some may already have completed when it is next asked. */
+		if (executor->concurrency != NULL)
+			(void)ctest_concurrency_update(executor->concurrency, plan->started - plan->completed);
+
+		/* Act on cancellation before waiting on the jobs in flight,
+		 * which may then never complete on their own. */
+		if (result == 0 && !plan->cancelled && runner_cancellation_check(plan->cancellation)) {
+			if (plan_cancel__(plan, executor, reporter) != 0)
+				result = -1;
+		}
+
+		if (plan->started == plan->completed) {
+			/* Nothing in flight; either everything has been
+			 * reported or an error stopped new jobs from being
+			 * started. */
+			if (result < 0)
+				break;
+		} else if (runner_executor_wait(executor) < 0) {
+			result = -1;
+			break;
+		}
+
+		if (result == 0) {
+			plan_release_fixtures__(plan, executor);
+			plan_report_completed__(plan);
+		}
+	}
+
+	return result < 0 ? result : plan->failures;
+}
+
+CTEST_ALL_NONNULL_ARGS__
+static int execute_grouped_testcases__(runner_executor_t *executor, ctest_reporter_t *reporter, ctest_testcase_t *const*testcases, size_t testcase_count)
+{
+	runner_plan_t__ plan;
+	int result;
+
+	if (plan_init__(&plan, executor, testcases, testcase_count, executor->capacity > 0 ? executor->capacity : 1, executor->timings, executor->journal, &executor->cancellation, executor->retries, executor->isolation, executor->resources, executor->memory_budget_bytes) != 0)
+		return -1;
+
+	result = plan_execute__(&plan, executor, reporter);
+	plan_destroy__(&plan);
+	return result;
+}
+
+/**
+ * Flatten a collection of tests into their test cases.
+ *
+ * @return The test cases (to be freed by the caller), or <code>NULL</code> on
+ *         error.
+ */
+CTEST_ALL_NONNULL_ARGS__
+static ctest_testcase_t **flatten_tests__(ctest_test_t *const*tests, size_t test_count, size_t *p_testcase_count)
+{
+	ctest_testcase_t **testcases;
+	size_t i, testcase_count = 0;
+
+	for (i = 0; i < test_count; ++i)
+		testcase_count += ctest_test_get_testcase_count(tests[i]);
+
+	if ((testcases = calloc(testcase_count > 0 ? testcase_count : 1, sizeof(*testcases))) == NULL)
+		return NULL;
+
+	testcase_count = 0;
+	for (i = 0; i < test_count; ++i) {
+		const size_t count = ctest_test_get_testcase_count(tests[i]);
+		if (count > 0)
+			memcpy(testcases + testcase_count, ctest_test_get_testcases(tests[i]), count * sizeof(*testcases));
+		testcase_count += count;
+	}
+
+	*p_testcase_count = testcase_count;
+	return testcases;
+}
+
+CTEST_ALL_NONNULL_ARGS__
+int runner_execute_testcases(runner_executor_t *executor, ctest_reporter_t *reporter, ctest_testcase_t *const*testcases, size_t testcase_count)
+{
+	int result;
+
+	if (testcase_count == 0)
+		return 0;
+
+	if ((testcases = repartition_testcases__(testcases, testcase_count)) == NULL)
+		return -1;
+
+	result = execute_grouped_testcases__(executor, reporter, testcases, testcase_count);
+	(void)free((void *)testcases);
+	return result;
+}
+
+CTEST_ALL_NONNULL_ARGS__
+int runner_execute_tests(runner_executor_t *executor, ctest_reporter_t *reporter, ctest_test_t *const*tests, size_t test_count)
+{
+	ctest_testcase_t **testcases;
+	size_t testcase_count;
+	int result = -1;
+
+	if (test_count == 0)
+		return 0;
+
+	if ((tests = repartition_tests__(tests, test_count)) == NULL)
+		goto repartition_tests_failed;
+	if ((testcases = flatten_tests__(tests, test_count, &testcase_count)) == NULL)
+		goto flatten_failed;
+
+	result = execute_grouped_testcases__(executor, reporter, testcases, testcase_count);
+
+	(void)free(testcases);
+flatten_failed:
+	(void)free((void *)tests);
+repartition_tests_failed:
+	return result;
+}
+
+CTEST_ALL_NONNULL_ARGS__
+int runner_execute_testsuites(runner_executor_t *executor, ctest_reporter_t *reporter, ctest_testsuite_t *const*testsuites, size_t testsuite_count)
+{
+	ctest_test_t **tests;
+	ctest_testcase_t **testcases;
+	size_t i, test_count = 0, testcase_count;
+	int result = -1;
+
+	for (i = 0; i < testsuite_count; ++i)
+		test_count += ctest_testsuite_get_test_count(testsuites[i]);
+
+	if ((tests = calloc(test_count > 0 ? test_count : 1, sizeof(*tests))) == NULL)
+		goto tests_alloc_failed;
+
+	test_count = 0;
+	for (i = 0; i < testsuite_count; ++i) {
+		const size_t count = ctest_testsuite_get_test_count(testsuites[i]);
+		if (count > 0)
+			memcpy(tests + test_count, ctest_testsuite_get_tests(testsuites[i]), count * sizeof(*tests));
+		test_count += count;
+	}
+	order_tests__(tests, test_count);
+
+	if ((testcases = flatten_tests__(tests, test_count, &testcase_count)) == NULL)
+		goto flatten_failed;
+
+	result = execute_grouped_testcases__(executor, reporter, testcases, testcase_count);
+
+	(void)free(testcases);
+flatten_failed:
+	(void)free(tests);
+tests_alloc_failed:
 	return result;
 }
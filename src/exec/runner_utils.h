@@ -1,10 +1,81 @@
 #ifndef PRIVATE__REPORTER_UTILS_H__INCLUDED__
 #define PRIVATE__REPORTER_UTILS_H__INCLUDED__
 
+#include <stdbool.h>
+#include <stddef.h>
+
 #include <ctest/_annotations.h>
+#include <ctest/exec/cancel.h>
+#include <ctest/exec/concurrency.h>
+#include <ctest/exec/journal.h>
 #include <ctest/exec/reporter.h>
+#include <ctest/exec/result.h>
 #include <ctest/exec/runner.h>
+#include <ctest/exec/runner_config.h>
+#include <ctest/exec/stage.h>
 #include <ctest/exec/suite.h>
+#include <ctest/exec/timings.h>
+
+/*
+ * Cancellation
+ */
+
+/**
+ * The cancellation state of a runner: whether its run has been cancelled,
+ * either through the token of its configuration or by the runner itself once
+ * too many test cases have failed.
+ */
+typedef struct runner_cancellation runner_cancellation_t;
+struct runner_cancellation {
+	ctest_cancel_t *cancel;
+	unsigned int fail_fast;
+	unsigned int failure_count;
+	bool cancelled;
+};
+
+/**
+ * Initialize the cancellation state of a runner from its configuration.
+ */
+CTEST_ALL_NONNULL_ARGS__
+extern void runner_cancellation_init(runner_cancellation_t *cancellation, const ctest_runner_config_t *config);
+
+/**
+ * Check whether the run has been cancelled.
+ *
+ * @return Whether the run has been cancelled; once it has, it stays that way.
+ */
+CTEST_ALL_NONNULL_ARGS__
+extern bool runner_cancellation_check(runner_cancellation_t *cancellation);
+
+/**
+ * Cancel the run, requesting cancellation through the token (if any), so the
+ * caller of the runner can tell the run was cut short.
+ */
+CTEST_ALL_NONNULL_ARGS__
+extern void runner_cancellation_cancel(runner_cancellation_t *cancellation);
+
+/**
+ * Account for a test case that has completed, cancelling the run if it was
+ * one failure too many.
+ *
+ * @param cancellation The cancellation state of the run.
+ * @param failed       Whether the test case failed (test cases that were
+ *                     skipped or cancelled didn't).
+ */
+CTEST_ALL_NONNULL_ARGS__
+extern void runner_cancellation_record(runner_cancellation_t *cancellation, bool failed);
+
+/**
+ * Create the result of a test case that was cancelled, describing why.
+ *
+ * @param cancellation The cancellation state of the run.
+ * @param stage        The stage the test case was in when cancelled.
+ * @param action       What happened to the test case (e.g., "not run").
+ *
+ * @return The result, or <code>NULL</code> on failure.
+ */
+CTEST_ALL_NONNULL_ARGS__
+extern ctest_result_t *runner_cancellation_create_result(const runner_cancellation_t *cancellation, ctest_stage_t stage, const char *action);
 
 /**
  * Run a collection of test cases associated with different tests.
@@ -14,7 +85,10 @@
  * the same suite together, running them in a group. As much as possible, the
  * ordering of the tests is preserved. The ordering of test cases within a
  * given test is preserved as is the ordering of tests and suites (based on the
- * first occurrence of a test case that belongs to the test or suite).
+ * first occurrence of a test case that belongs to the test or suite), except
+ * that tests are moved after their prerequisites (see
+ * <code>ctest_test_get_prerequisites</code>). The test cases of a test one of
+ * whose prerequisites didn't pass are reported as skipped instead of run.
  *
  * @param runner          The runner in which the tests will be run.
  * @param reporter        The reporter to use to for reporting the results of
@@ -22,14 +96,24 @@
  * @param testcases       The collection of test cases to partition.
  * @param testcases_count The length of the collection of tests cases to
  *                        partition.
+ * @param cancellation    The cancellation state of the run; once cancelled,
+ *                        the remaining test cases are reported as cancelled
+ *                        instead of being run.
+ * @param retries         How many times to retry a test case that fails;
+ *                        retries are run right away, and the result of the
+ *                        test case is only reported once it's final.
  * @param run_testcase    A callback to invoke for each test case that
  *                        implements the runner-specific logic. The callback
  *                        should return 0 if the test succeeded, positive value
  *                        if the test failed, and a negative value if an error
  *                        was encountered while running the test.
+ * @param journal         The journal of the run, or <code>NULL</code>; test
+ *                        cases with a loaded result are reported with it
+ *                        instead of being run, and the results of the others
+ *                        are recorded in it.
  */
-CTEST_ALL_NONNULL_ARGS__
-int runner_run_testcases(ctest_runner_t *runner, ctest_reporter_t *reporter, ctest_testcase_t *const*testcases, size_t testcase_count, int (*run_testcase)(ctest_runner_t *, ctest_testcase_reporter_t *, ctest_testcase_t *));
+CTEST_NONNULL_ARGS__(1, 2, 3, 5, 7)
+int runner_run_testcases(ctest_runner_t *runner, ctest_reporter_t *reporter, ctest_testcase_t *const*testcases, size_t testcase_count, runner_cancellation_t *cancellation, unsigned int retries, int (*run_testcase)(ctest_runner_t *, ctest_testcase_reporter_t *, ctest_testcase_t *), ctest_journal_t *journal);
 
 /**
  * Run a collection of tests associated with different suites.
@@ -45,16 +129,19 @@ int runner_run_testcases(ctest_runner_t *runner, ctest_reporter_t *reporter, cte
  *                     tests.
  * @param tests        The collection of tests to run.
  * @param test_count   The number of tests in the collection.
+ * @param cancellation The cancellation state of the run.
+ * @param retries      How many times to retry a test case that fails.
  * @param run_testcase A callback to invoke for each test case that implements
  *                     the runner-specific logic. The callback should return
  *                     0 if the test succeeded, positive value if the test
  *                     failed, and a negative value if an error was encountered
  *                     while running the test.
+ * @param journal      The journal of the run, or <code>NULL</code>.
  * @return The number of test cases that failed, or a negative number if an
  *         error was encountered.
  */
-CTEST_ALL_NONNULL_ARGS__
-int runner_run_tests(ctest_runner_t *runner, ctest_reporter_t *reporter, ctest_test_t *const*tests, size_t test_count, int (*run_testcase)(ctest_runner_t *, ctest_testcase_reporter_t *, ctest_testcase_t *));
+CTEST_NONNULL_ARGS__(1, 2, 3, 5, 7)
+int runner_run_tests(ctest_runner_t *runner, ctest_reporter_t *reporter, ctest_test_t *const*tests, size_t test_count, runner_cancellation_t *cancellation, unsigned int retries, int (*run_testcase)(ctest_runner_t *, ctest_testcase_reporter_t *, ctest_testcase_t *), ctest_journal_t *journal);
 
 /**
  * Run a collection of test suites.
@@ -67,15 +154,357 @@ int runner_run_tests(ctest_runner_t *runner, ctest_reporter_t *reporter, ctest_t
  *                        the tests.
  * @param testsuites      The collection of tests to run.
  * @param testsuite_count The number of tests in the collection.
+ * @param cancellation    The cancellation state of the run.
+ * @param retries         How many times to retry a test case that fails.
  * @param run_testcase    A callback to invoke for each test case that
  *                        implements the runner-specific logic. The callback
  *                        should return 0 if the test succeeded, positive value
  *                        if the test failed, and a negative value if an error
  *                        was encountered while running the test.
+ * @param journal         The journal of the run, or <code>NULL</code>.
+ * @return The number of test cases that failed, or a negative number if an
+ *         error was encountered.
+ */
+CTEST_NONNULL_ARGS__(1, 2, 3, 5, 7)
+int runner_run_testsuites(ctest_runner_t *runner, ctest_reporter_t *reporter, ctest_testsuite_t *const*testsuites, size_t testsuite_count, runner_cancellation_t *cancellation, unsigned int retries, int (*run_testcase)(ctest_runner_t *, ctest_testcase_reporter_t *, ctest_testcase_t *), ctest_journal_t *journal);
+
+/*
+ * Asynchronous Execution
+ */
+
+/**
+ * A single test case scheduled for execution by a
+ * <code>runner_executor_t</code>.
+ *
+ * Jobs are created and owned by the <code>runner_execute_xxx</code>
+ * functions; executors only ever see the jobs passed to
+ * <code>runner_executor_start</code>.
+ */
+typedef struct runner_job runner_job_t;
+struct runner_job {
+	/**
+	 * The test case to execute.
+	 */
+	ctest_testcase_t *testcase;
+
+	/**
+	 * The reporter for the test case. The test case has already been
+	 * reported as started when the job is passed to the executor.
+	 */
+	ctest_testcase_reporter_t *reporter;
+
+	/**
+	 * The result of the test case, set by <code>runner_job_complete</code>.
+	 */
+	ctest_result_t *result;
+
+	/**
+	 * The worker (slot) of the executor on which to run the job; less than
+	 * the executor's <code>capacity</code>, and never busy with another job
+	 * when the job is started. Consecutive jobs of a worker are usually
+	 * consecutive test cases of the same test, so executors that keep
+	 * per-worker state (e.g., a pooled child process) should run the job
+	 * on that worker.
+	 */
+	size_t worker;
+
+	/**
+	 * Which attempt at running the test case the job is, counting from
+	 * one; later attempts retry a test case that failed, and should be
+	 * run afresh (e.g., not in a pooled child process that has already
+	 * run other test cases).
+	 */
+	unsigned int attempt;
+
+	/**
+	 * The isolation group of the job (see
+	 * <code>runner_executor_t.isolation</code>), numbered in plan order.
+	 * The first attempts of a group's jobs are all started on the same
+	 * worker, in order, with no job of another group in between; an
+	 * executor that isolates groups should start a new child process
+	 * whenever the group of a worker's job changes.
+	 */
+	size_t group;
+
+	/* Private to runner_utils. */
+	struct runner_plan__ *plan;
+	size_t i_test;
+	size_t i_fixture;
+	bool completed;
+	bool claimed;
+	bool replayed;
+	uint64_t memory_bytes;
+	uint64_t start_ns;
+	ctest_result_t *failed_attempt;
+};
+
+/**
+ * An executor runs the test cases (jobs) handed to it, possibly concurrently,
+ * and notifies the caller as each completes.
+ *
+ * An executor is driven by the <code>runner_execute_xxx</code> functions: up to
+ * <code>capacity</code> jobs are started using
+ * <code>runner_executor_start</code> and, when no more jobs can be started,
+ * <code>runner_executor_wait</code> is called to wait for one or more jobs to
+ * complete. The executor reports each completed job with
+ * <code>runner_job_complete</code>; jobs may complete in any order, results
+ * are delivered to the reporter in suite/test/test case order regardless.
+ *
+ * Jobs are scheduled on <code>capacity</code> workers, each owning a
+ * contiguous range of the (grouped) test cases; a worker that runs out of
+ * test cases steals the back half of the largest remaining range. If the
+ * executor has a timing database, jobs are instead started longest first
+ * (unless it isolates groups of test cases), and the measured duration of
+ * each job is recorded in the database.
+ *
+ * A job is only started once every test case of the prerequisites of its test
+ * (see <code>ctest_test_get_prerequisites</code>) has its final result; if
+ * one of them didn't pass, the job is completed as skipped without ever being
+ * passed to the executor. Nor is a job started while the jobs in flight hold
+ * too much of a resource its test uses (see
+ * <code>ctest_test_get_resources</code>), or its expected memory use doesn't
+ * fit in the executor's memory budget. A job the executor must run alone (see
+ * <code>runner_executor_runs_alone</code>) is only started once no other job
+ * is in flight, and no other job is started until it completes.
+ *
+ * Given a journal, a job whose result was loaded into it is completed with
+ * that result without ever being passed to the executor, and the result of
+ * every other job is recorded in it once final.
+ *
+ * Given a concurrency controller, no more jobs are started while as many are
+ * in flight as the controller allows; the controller is consulted whenever
+ * jobs are about to be started, i.e., at the start of the run and after each
+ * wait.
+ */
+typedef struct runner_executor runner_executor_t;
+typedef const struct runner_executor_ops runner_executor_ops_t;
+struct runner_executor_ops {
+	CTEST_ALL_NONNULL_ARGS__
+	int (*start)(runner_executor_t *, runner_job_t *);
+
+	CTEST_ALL_NONNULL_ARGS__
+	int (*wait)(runner_executor_t *);
+
+	CTEST_ALL_NONNULL_ARGS__
+	void (*cancel)(runner_executor_t *);
+
+	/* Optional. */
+	CTEST_ALL_NONNULL_ARGS__
+	void (*release_fixture)(runner_executor_t *, ctest_fixture_t *);
+
+	/* Optional. */
+	CTEST_ALL_NONNULL_ARGS__
+	bool (*runs_alone)(runner_executor_t *, ctest_test_t *);
+};
+struct runner_executor {
+	runner_executor_ops_t *ops;
+
+	/**
+	 * The maximum number of jobs that may be in flight at once.
+	 */
+	size_t capacity;
+
+	/**
+	 * The controller that decides how many of the <code>capacity</code>
+	 * jobs may be in flight at any one time, or <code>NULL</code> (see
+	 * <code>ctest_runner_config_t.concurrency</code>).
+	 */
+	ctest_concurrency_t *concurrency;
+
+	/**
+	 * The recorded durations of test cases, or <code>NULL</code>.
+	 */
+	ctest_timings_t *timings;
+
+	/**
+	 * The cancellation state of the executor's runs. Once cancelled, no
+	 * more jobs are started, <code>runner_executor_cancel</code> is called
+	 * and the jobs that were never started are completed as cancelled.
+	 */
+	runner_cancellation_t cancellation;
+
+	/**
+	 * How many times a job that fails is retried. Retries are only
+	 * started once there are no first attempts left to start, and the
+	 * result of a job is only reported once it's final.
+	 */
+	unsigned int retries;
+
+	/**
+	 * Which test cases form a group (see <code>runner_job_t.group</code>).
+	 * With anything but <code>CTEST_ISOLATION_TESTCASE</code>, ranges of
+	 * jobs are only ever split (or stolen) between groups.
+	 */
+	ctest_isolation_t isolation;
+
+	/**
+	 * The capacities of the resources test cases use, as a
+	 * <code>NULL</code>-terminated array of "name=capacity", or
+	 * <code>NULL</code> (see <code>ctest_runner_config_t.resources</code>).
+	 */
+	const char *const *resources;
+
+	/**
+	 * How much memory the jobs in flight are expected to use together, at
+	 * most, or zero for no limit (see
+	 * <code>ctest_runner_config_t.memory_budget_bytes</code>).
+	 */
+	uint64_t memory_budget_bytes;
+
+	/**
+	 * The journal of the run, or <code>NULL</code> (see
+	 * <code>ctest_runner_config_t.journal</code>).
+	 */
+	ctest_journal_t *journal;
+};
+
+/**
+ * Start executing a job.
+ *
+ * Failures to run the test case itself (e.g., failing to create a child
+ * process) should be reported by completing the job with an error result,
+ * rather than by returning an error.
+ *
+ * @param executor The executor with which to start the job.
+ * @param job      The job to start.
+ *
+ * @return Zero if the job was started (or completed), a negative number if
+ *         an error was encountered that prevents any further jobs from
+ *         being run.
+ */
+CTEST_ALL_NONNULL_ARGS__
+static inline int runner_executor_start(runner_executor_t *executor, runner_job_t *job)
+{
+	return (*executor->ops->start)(executor, job);
+}
+
+/**
+ * Wait for at least one in-flight job to complete.
+ *
+ * @param executor The executor on which to wait.
+ *
+ * @return Zero on success, a negative number if an error was encountered that
+ *         prevents any further jobs from being run.
+ */
+CTEST_ALL_NONNULL_ARGS__
+static inline int runner_executor_wait(runner_executor_t *executor)
+{
+	return (*executor->ops->wait)(executor);
+}
+
+/**
+ * Stop the jobs in flight as soon as possible, because the run has been
+ * cancelled.
+ *
+ * Jobs must still be completed (usually as cancelled, unless they completed
+ * some other way first); executors that can't interrupt a job let it finish.
+ * Executors that block in <code>runner_executor_wait</code> should also wake
+ * up when cancellation is requested through the token of
+ * <code>cancellation</code>, if they can.
+ *
+ * @param executor The executor whose jobs to stop.
+ */
+CTEST_ALL_NONNULL_ARGS__
+static inline void runner_executor_cancel(runner_executor_t *executor)
+{
+	(*executor->ops->cancel)(executor);
+}
+
+/**
+ * Let the executor know that none of the jobs left in the run use a shared
+ * fixture (see <code>ctest_test_get_shared_fixture</code>), so it can tear the
+ * fixture down if it set it up. A fixture is only released once the results
+ * of its jobs are final (i.e., none of them will be retried), and never from
+ * within the executor's own operations.
+ *
+ * Fixtures still set up when the run ends (e.g., because it was cancelled)
+ * are up to the executor to tear down.
+ *
+ * @param executor The executor that ran the jobs.
+ * @param fixture  The fixture no longer in use.
+ */
+CTEST_ALL_NONNULL_ARGS__
+static inline void runner_executor_release_fixture(runner_executor_t *executor, ctest_fixture_t *fixture)
+{
+	if (executor->ops->release_fixture != NULL)
+		(*executor->ops->release_fixture)(executor, fixture);
+}
+
+/**
+ * Determine whether the executor must run the test cases of a test with no
+ * other job in flight, e.g., because it runs them within its own process and
+ * they change state of the process other test cases depend on.
+ *
+ * @param executor The executor that is to run the test cases.
+ * @param test     The test whose test cases are to be run.
+ *
+ * @return Whether each test case of the test is to be run alone.
+ */
+CTEST_ALL_NONNULL_ARGS__
+static inline bool runner_executor_runs_alone(runner_executor_t *executor, ctest_test_t *test)
+{
+	return executor->ops->runs_alone != NULL && (*executor->ops->runs_alone)(executor, test);
+}
+
+/**
+ * Report a job, previously started with <code>runner_executor_start</code>,
+ * as completed.
+ *
+ * @param job    The job that has completed.
+ * @param result The result of the test case. Ownership of the result is
+ *               transferred to the job.
+ */
+CTEST_ALL_NONNULL_ARGS__
+extern void runner_job_complete(runner_job_t *job, ctest_result_t *result);
+
+/**
+ * Run a collection of test cases using an executor.
+ *
+ * Test cases are grouped and ordered just like
+ * <code>runner_run_testcases</code>.
+ *
+ * @param executor       The executor with which to run the test cases.
+ * @param reporter       The reporter to use to for reporting the results of
+ *                       the test cases.
+ * @param testcases      The collection of test cases to run.
+ * @param testcase_count The number of test cases in the collection.
+ *
+ * @return The number of test cases that failed, or a negative number if an
+ *         error was encountered.
+ */
+CTEST_ALL_NONNULL_ARGS__
+extern int runner_execute_testcases(runner_executor_t *executor, ctest_reporter_t *reporter, ctest_testcase_t *const*testcases, size_t testcase_count);
+
+/**
+ * Run a collection of tests using an executor.
+ *
+ * Tests are grouped and ordered just like <code>runner_run_tests</code>.
+ *
+ * @param executor   The executor with which to run the tests.
+ * @param reporter   The reporter to use to for reporting the results of the
+ *                   tests.
+ * @param tests      The collection of tests to run.
+ * @param test_count The number of tests in the collection.
+ *
+ * @return The number of test cases that failed, or a negative number if an
+ *         error was encountered.
+ */
+CTEST_ALL_NONNULL_ARGS__
+extern int runner_execute_tests(runner_executor_t *executor, ctest_reporter_t *reporter, ctest_test_t *const*tests, size_t test_count);
+
+/**
+ * Run a collection of test suites using an executor.
+ *
+ * @param executor        The executor with which to run the test suites.
+ * @param reporter        The reporter to use to for reporting the results of
+ *                        the tests.
+ * @param testsuites      The collection of test suites to run.
+ * @param testsuite_count The number of test suites in the collection.
+ *
  * @return The number of test cases that failed, or a negative number if an
  *         error was encountered.
  */
 CTEST_ALL_NONNULL_ARGS__
-int runner_run_testsuites(ctest_runner_t *runner, ctest_reporter_t *reporter, ctest_testsuite_t *const*testsuites, size_t testsuite_count, int (*run_testcase)(ctest_runner_t *, ctest_testcase_reporter_t *, ctest_testcase_t *));
+extern int runner_execute_testsuites(runner_executor_t *executor, ctest_reporter_t *reporter, ctest_testsuite_t *const*testsuites, size_t testsuite_count);
 
 #endif /* PRIVATE__REPORTER_UTILS_H__INCLUDED__ */
@@ -0,0 +1,135 @@
+#define _GNU_SOURCE     /* unshare */
+#include <errno.h>
+#include <fcntl.h>
+#include <net/if.h>
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/mount.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <ctest/_annotations.h>
+
+#include "sandbox.h"
+
+#define SANDBOX_NAMESPACES__    (CLONE_NEWUSER | CLONE_NEWNET | CLONE_NEWNS)
+#define SANDBOX_TMP__           "/tmp"
+
+/**
+ * Write a string to a file (of <code>/proc</code>), in one go.
+ *
+ * @return Zero on success, non-zero (with <code>errno</code> set) on failure.
+ */
+CTEST_ALL_NONNULL_ARGS__
+static int write_file__(const char *path, const char *data)
+{
+	const size_t len = strlen(data);
+	ssize_t rc;
+	int fd, saved_errno;
+
+	if ((fd = open(path, O_WRONLY | O_CLOEXEC)) < 0)
+		return -1;
+	rc = write(fd, data, len);
+	saved_errno = errno;
+	(void)close(fd);
+	if (rc != (ssize_t)len) {
+		errno = rc < 0 ? saved_errno : EIO;
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * Map the user and group of the calling process (before it entered its user
+ * namespace) to themselves.
+ */
+static int map_identity__(uid_t uid, gid_t gid)
+{
+	char map[64];
+
+	snprintf(map, sizeof(map), "%lu %lu 1\n", (unsigned long)uid, (unsigned long)uid);
+	if (write_file__("/proc/self/uid_map", map) != 0)
+		return -1;
+	/* An unprivileged process may only map its group once it has given
+	 * up changing its supplementary groups. */
+	if (write_file__("/proc/self/setgroups", "deny") != 0 && errno != ENOENT)
+		return -1;
+	snprintf(map, sizeof(map), "%lu %lu 1\n", (unsigned long)gid, (unsigned long)gid);
+	return write_file__("/proc/self/gid_map", map);
+}
+
+/**
+ * Bring up the loopback interface of the calling process's (new) network
+ * namespace, which starts out down.
+ */
+static int loopback_up__(void)
+{
+	struct ifreq ifr;
+	int fd, rc = -1, saved_errno;
+
+	if ((fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0)) < 0)
+		return -1;
+	memset(&ifr, 0, sizeof(ifr));
+	strncpy(ifr.ifr_name, "lo", sizeof(ifr.ifr_name) - 1);
+	if (ioctl(fd, SIOCGIFFLAGS, &ifr) == 0) {
+		ifr.ifr_flags |= IFF_UP | IFF_RUNNING;
+		rc = ioctl(fd, SIOCSIFFLAGS, &ifr);
+	}
+	saved_errno = errno;
+	(void)close(fd);
+	errno = saved_errno;
+	return rc;
+}
+
+/**
+ * Mount a private <code>tmpfs</code> over <code>/tmp</code>, in the calling
+ * process's (new) mount namespace.
+ */
+static int mount_tmp__(void)
+{
+	/* Keep the mount from propagating back to the runner's namespace. */
+	if (mount(NULL, "/", NULL, MS_REC | MS_PRIVATE, NULL) != 0)
+		return -1;
+	return mount("tmpfs", SANDBOX_TMP__, "tmpfs", MS_NOSUID | MS_NODEV, "mode=1777");
+}
+
+int sandbox_probe(void)
+{
+	int status;
+	pid_t pid;
+
+	if ((pid = fork()) < 0)
+		return -1;
+	if (pid == 0)
+		_exit(sandbox_enter() == 0 ? 0 : errno & 0xff);
+	while (waitpid(pid, &status, 0) < 0) {
+		if (errno != EINTR)
+			return -1;
+	}
+	if (!WIFEXITED(status)) {
+		errno = ECHILD;
+		return -1;
+	}
+	if (WEXITSTATUS(status) != 0) {
+		errno = WEXITSTATUS(status);
+		return -1;
+	}
+	return 0;
+}
+
+int sandbox_enter(void)
+{
+	const uid_t uid = geteuid();
+	const gid_t gid = getegid();
+
+	if (unshare(SANDBOX_NAMESPACES__) != 0)
+		return -1;
+	if (map_identity__(uid, gid) != 0)
+		return -1;
+	if (loopback_up__() != 0)
+		return -1;
+	return mount_tmp__();
+}
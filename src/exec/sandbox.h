@@ -0,0 +1,34 @@
+#ifndef PRIVATE__SANDBOX_H__INCLUDED__
+#define PRIVATE__SANDBOX_H__INCLUDED__
+
+/**
+ * The sandbox of a child process: unprivileged user, network and mount
+ * namespaces of its own, with a loopback interface and a <code>/tmp</code>
+ * (a <code>tmpfs</code>) that no other child sees, so test cases that bind
+ * fixed ports or write fixed paths can run concurrently.
+ *
+ * The user namespace maps the child's user and group to themselves, so the
+ * test case runs as the same user, but with the privileges (within its own
+ * namespaces) needed to set the others up.
+ */
+
+/**
+ * Check whether the calling process could enter a sandbox, by having a child
+ * process try to.
+ *
+ * @return Zero if it could, non-zero (with <code>errno</code> set) otherwise.
+ */
+extern int sandbox_probe(void);
+
+/**
+ * Move the calling process into a sandbox of its own. Its children (and
+ * threads) started afterwards share it.
+ *
+ * Only meant for a newly started child process: once the namespaces have been
+ * entered, a failure leaves the process partly sandboxed.
+ *
+ * @return Zero on success, non-zero (with <code>errno</code> set) on failure.
+ */
+extern int sandbox_enter(void);
+
+#endif /* PRIVATE__SANDBOX_H__INCLUDED__ */
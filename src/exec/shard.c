@@ -0,0 +1,176 @@
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <ctest/_annotations.h>
+#include <ctest/exec/shard.h>
+#include <ctest/exec/suite.h>
+#include <ctest/exec/timings.h>
+
+static const char *get_suite_name__(ctest_testcase_t *testcase)
+{
+	return ctest_testsuite_get_name(ctest_test_get_testsuite(ctest_testcase_get_test(testcase)));
+}
+
+/**
+ * The number of test cases of the same test before this one with the same
+ * name (test cases from a data provider aren't guaranteed distinct names).
+ */
+static size_t get_name_ordinal__(ctest_testcase_t *testcase)
+{
+	ctest_test_t *const test = ctest_testcase_get_test(testcase);
+	ctest_testcase_t *const*const testcases = ctest_test_get_testcases(test);
+	const size_t testcase_count = ctest_test_get_testcase_count(test);
+	const char *const name = ctest_testcase_get_name(testcase);
+	size_t i, ordinal = 0;
+
+	for (i = 0; i < testcase_count && testcases[i] != testcase; ++i) {
+		if (strcmp(ctest_testcase_get_name(testcases[i]), name) == 0)
+			ordinal += 1;
+	}
+	return ordinal;
+}
+
+/*
+ * FNV-1a, over "suite:testcase" (and, for a duplicate name, its ordinal),
+ * followed by a final mix so that names that differ only in their last few
+ * characters (e.g., test_foo_1, test_foo_2) still spread evenly when taken
+ * modulo a small number of shards.
+ */
+static uint64_t hash_testcase__(ctest_testcase_t *testcase, size_t ordinal)
+{
+	uint64_t hash = UINT64_C(0xcbf29ce484222325);
+	const char *p;
+
+	for (p = get_suite_name__(testcase); *p != '\0'; ++p)
+		hash = (hash ^ (unsigned char)*p) * UINT64_C(0x100000001b3);
+	hash = (hash ^ ':') * UINT64_C(0x100000001b3);
+	for (p = ctest_testcase_get_name(testcase); *p != '\0'; ++p)
+		hash = (hash ^ (unsigned char)*p) * UINT64_C(0x100000001b3);
+	for (; ordinal > 0; ordinal >>= 8)
+		hash = (hash ^ (ordinal & 0xff)) * UINT64_C(0x100000001b3);
+
+	hash ^= hash >> 33;
+	hash *= UINT64_C(0xff51afd7ed558ccd);
+	hash ^= hash >> 33;
+	return hash;
+}
+
+typedef struct shard_entry__ shard_entry_t__;
+struct shard_entry__ {
+	uint64_t predicted_ns;
+	uint64_t hash;
+	ctest_testcase_t *testcase;
+	size_t ordinal;
+	size_t index;
+};
+
+static int compare_shard_entries__(const void *lhs_ptr, const void *rhs_ptr)
+{
+	const shard_entry_t__ *const lhs = lhs_ptr;
+	const shard_entry_t__ *const rhs = rhs_ptr;
+	int rc;
+
+	/* Longest first; ties are broken by name (never by position), so the
+	 * order of the suites on the command line doesn't matter. */
+	if (lhs->predicted_ns != rhs->predicted_ns)
+		return lhs->predicted_ns > rhs->predicted_ns ? -1 : 1;
+	if (lhs->hash != rhs->hash)
+		return lhs->hash < rhs->hash ? -1 : 1;
+	if ((rc = strcmp(get_suite_name__(lhs->testcase), get_suite_name__(rhs->testcase))) != 0)
+		return rc;
+	if ((rc = strcmp(ctest_testcase_get_name(lhs->testcase), ctest_testcase_get_name(rhs->testcase))) != 0)
+		return rc;
+	return lhs->ordinal < rhs->ordinal ? -1 : lhs->ordinal > rhs->ordinal;
+}
+
+/**
+ * Assign each test case to a shard, balancing the predicted duration of the
+ * shards.
+ *
+ * @param shards Filled in with the shard of each test case.
+ *
+ * @return The number of test cases with a recorded duration (if none, the
+ *         shards are left untouched), or <code>(size_t)-1</code> on failure.
+ */
+static size_t balance__(const ctest_timings_t *timings, ctest_testcase_t *const*testcases, size_t testcase_count, unsigned int count, unsigned int *shards)
+{
+	shard_entry_t__ *entries = NULL;
+	uint64_t *predicted_ns = NULL, *loads_ns = NULL;
+	size_t *order = NULL, i, known = (size_t)-1;
+	unsigned int i_shard;
+
+	if ((order = calloc(testcase_count, sizeof(*order))) == NULL ||
+	    (predicted_ns = calloc(testcase_count, sizeof(*predicted_ns))) == NULL ||
+	    (entries = calloc(testcase_count, sizeof(*entries))) == NULL ||
+	    (loads_ns = calloc(count, sizeof(*loads_ns))) == NULL)
+		goto alloc_failed;
+
+	if ((known = ctest_timings_order(timings, testcases, testcase_count, order, predicted_ns)) == 0)
+		goto no_timings;
+
+	for (i = 0; i < testcase_count; ++i) {
+		entries[i].predicted_ns = predicted_ns[i];
+		entries[i].ordinal = get_name_ordinal__(testcases[i]);
+		entries[i].hash = hash_testcase__(testcases[i], entries[i].ordinal);
+		entries[i].testcase = testcases[i];
+		entries[i].index = i;
+	}
+	qsort(entries, testcase_count, sizeof(*entries), &compare_shard_entries__);
+
+	for (i = 0; i < testcase_count; ++i) {
+		unsigned int i_least = 0;
+		for (i_shard = 1; i_shard < count; ++i_shard) {
+			if (loads_ns[i_shard] < loads_ns[i_least])
+				i_least = i_shard;
+		}
+		shards[entries[i].index] = i_least;
+		loads_ns[i_least] += entries[i].predicted_ns;
+	}
+
+no_timings:
+alloc_failed:
+	(void)free(loads_ns);
+	(void)free(entries);
+	(void)free(predicted_ns);
+	(void)free(order);
+	return known;
+}
+
+CTEST_NONNULL_ARGS__(6, 7)
+int ctest_shard_select(const ctest_timings_t *timings, ctest_testcase_t *const*testcases, size_t testcase_count, unsigned int index, unsigned int count, ctest_testcase_t **selected, size_t *p_selected_count)
+{
+	unsigned int *shards;
+	size_t i, known = 0, selected_count = 0;
+
+	if (count == 0 || index >= count) {
+		errno = EINVAL;
+		return -1;
+	}
+	if (testcase_count == 0) {
+		*p_selected_count = 0;
+		return 0;
+	}
+
+	if ((shards = calloc(testcase_count, sizeof(*shards))) == NULL)
+		return -1;
+
+	if (timings != NULL && count > 1 && (known = balance__(timings, testcases, testcase_count, count, shards)) == (size_t)-1) {
+		(void)free(shards);
+		return -1;
+	}
+	if (known == 0) {
+		for (i = 0; i < testcase_count; ++i)
+			shards[i] = (unsigned int)(hash_testcase__(testcases[i], get_name_ordinal__(testcases[i])) % count);
+	}
+
+	for (i = 0; i < testcase_count; ++i) {
+		if (shards[i] == index)
+			selected[selected_count++] = testcases[i];
+	}
+
+	(void)free(shards);
+	*p_selected_count = selected_count;
+	return 0;
+}
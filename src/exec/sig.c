@@ -1,4 +1,5 @@
 #include <errno.h>
+#include <pthread.h>
 #include <signal.h>
 #include <string.h>
 
@@ -39,18 +40,46 @@ static const int signals__[] = {
 	SIGTTOU,
  };
 
+/*
+ * The signal handlers are process wide, but each thread captures signals with
+ * its own handler: the process-wide handlers are installed by the first thread
+ * to capture signals and restored by the last one; synchronous signals (e.g.,
+ * SIGSEGV) are delivered to the thread that raised them, and so to its
+ * handler.
+ */
+static pthread_mutex_t lock__ = PTHREAD_MUTEX_INITIALIZER;
+static unsigned int capture_count__;
 static saved_sigaction_t__ saved_sigaction__[countof(signals__)];
-static void (*handler__)(int, void*);
-static void *cookie__;
+static __thread void (*handler__)(int, void*);
+static __thread void *cookie__;
 
 static void sighandler__(int signum, siginfo_t *unused(siginfo), void *unused(context))
 {
-	(*handler__)(signum, cookie__);
+	size_t i;
+
+	if (handler__ != NULL) {
+		(*handler__)(signum, cookie__);
+		return;
+	}
+
+	/* Delivered to a thread that isn't capturing signals (e.g., an
+	 * asynchronous signal sent to the process); it's meant for the
+	 * process, so give it the handling it had before being captured. */
+	for (i = 0; i < countof(signals__); ++i) {
+		if (signals__[i] == signum && saved_sigaction__[i].f_saved) {
+			sigaction(signum, &saved_sigaction__[i].sigaction, NULL);
+			raise(signum);
+			break;
+		}
+	}
 }
 
 /**
  * Capture all signals that can be caught, invoking the specified handler.
  *
+ * Signals are captured for the calling thread only; each thread capturing
+ * signals may use a different handler.
+ *
  * @param handler The function to invoke on signal capture; the first parameter
  *                is the signal number, the second is the provided cookie.
  * @param cookie  The cookie to pass to <code>handler</code>.
@@ -77,11 +106,12 @@ int sigcapture__(void (*handler)(int, void *), void *cookie)
 	/* Block signals so we can manipulate variables shared with the
 	 * handlers. */
 	sigfillset(&sigset);
-	if (sigprocmask(SIG_BLOCK, &sigset, &sigoldset) != 0) {
+	if (pthread_sigmask(SIG_BLOCK, &sigset, &sigoldset) != 0) {
 		return -1;
 	}
+	pthread_mutex_lock(&lock__);
 
-	for (i = 0; i < countof(signals__); ++i) {
+	for (i = 0; capture_count__ == 0 && i < countof(signals__); ++i) {
 		const int signum = signals__[i];
 		saved_sigaction_t__ *const saved = saved_sigaction__ + i;
 		struct sigaction *const old_sigact = saved->f_saved ? NULL : &saved->sigaction;
@@ -103,15 +133,16 @@ int sigcapture__(void (*handler)(int, void *), void *cookie)
 		}
 	}
 
+	++capture_count__;
 	handler__ = handler;
 	cookie__ = cookie;
 
-	sigprocmask(SIG_SETMASK, &sigoldset, NULL);
+	pthread_mutex_unlock(&lock__);
+	pthread_sigmask(SIG_SETMASK, &sigoldset, NULL);
 	errno = 0;
 	return 0;
 
 failure:
-	sigprocmask(SIG_SETMASK, &sigoldset, NULL);
 
 	/* An error occurred while attempting to register a signal handler,
 	 * restore all registered handlers. */
@@ -127,10 +158,18 @@ failure:
 		}
 	}
 
+	pthread_mutex_unlock(&lock__);
+	pthread_sigmask(SIG_SETMASK, &sigoldset, NULL);
 	errno = result_errno;
 	return result;
 }
 
+/**
+ * Stop capturing signals in the calling thread, restoring the original
+ * handlers once no thread is capturing signals.
+ *
+ * @return Zero on success, non-zero on failure.
+ */
 extern int sigrestore__(void)
 {
 	size_t i;
@@ -142,11 +181,17 @@ extern int sigrestore__(void)
 	/* Block signals so we can manipulate variables shared with the
 	 * handlers. */
 	sigfillset(&sigset);
-	if (sigprocmask(SIG_BLOCK, &sigset, &sigoldset) != 0) {
+	if (pthread_sigmask(SIG_BLOCK, &sigset, &sigoldset) != 0) {
 		return -1;
 	}
+	if (handler__ == NULL) {
+		/* Not capturing signals; nothing to restore. */
+		pthread_sigmask(SIG_SETMASK, &sigoldset, NULL);
+		return 0;
+	}
+	pthread_mutex_lock(&lock__);
 
-	for (i = 0; i < countof(signals__); ++i) {
+	for (i = 0; capture_count__ == 1 && i < countof(signals__); ++i) {
 		const int signum = signals__[i];
 		saved_sigaction_t__ *const saved = saved_sigaction__ + i;
 		int rc;
@@ -163,11 +208,13 @@ extern int sigrestore__(void)
 	}
 
 	if (result == 0) {
+		--capture_count__;
 		handler__ = NULL;
 		cookie__ = NULL;
 	}
 
-	sigprocmask(SIG_SETMASK, &sigoldset, NULL);
+	pthread_mutex_unlock(&lock__);
+	pthread_sigmask(SIG_SETMASK, &sigoldset, NULL);
 	errno = result_errno;
 	return result;
 }
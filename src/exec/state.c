@@ -0,0 +1,426 @@
+#define _GNU_SOURCE     /* dl_iterate_phdr, getcwd(NULL, 0) */
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <link.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <ctest/_annotations.h>
+
+#include "state.h"
+
+/* FNV-1a, a word at a time. */
+#define CHECKSUM_OFFSET__       UINT64_C(0xcbf29ce484222325)
+#define CHECKSUM_PRIME__        UINT64_C(0x100000001b3)
+
+/**
+ * How many file descriptors are looked at when they can't be listed (without
+ * <code>/proc</code>).
+ */
+#define MAX_SCANNED_FDS__       1024
+
+extern char **environ;
+
+/* An address within the module of the runner itself. */
+static const void *const self_anchor__ = (const void *)&state_snapshot_take;
+
+static uint64_t checksum__(uint64_t hash, uintptr_t start, uintptr_t end)
+{
+	uint64_t word;
+
+	for (; start + sizeof(word) <= end; start += sizeof(word)) {
+		memcpy(&word, (const void *)start, sizeof(word));
+		hash = (hash ^ word) * CHECKSUM_PRIME__;
+	}
+	for (; start < end; ++start)
+		hash = (hash ^ *(const unsigned char *)start) * CHECKSUM_PRIME__;
+	return hash;
+}
+
+/**
+ * Checksum a range of memory, except for the part of it that overlaps another.
+ */
+static uint64_t checksum_except__(uint64_t hash, uintptr_t start, uintptr_t end, uintptr_t skip_start, uintptr_t skip_end)
+{
+	if (skip_start >= skip_end || skip_start >= end || skip_end <= start)
+		return checksum__(hash, start, end);
+	if (skip_start > start)
+		hash = checksum__(hash, start, skip_start);
+	if (skip_end < end)
+		hash = checksum__(hash, skip_end, end);
+	return hash;
+}
+
+CTEST_ALL_NONNULL_ARGS__
+static bool module_contains_any__(const struct dl_phdr_info *info, const void *const *anchors, size_t anchor_count)
+{
+	ElfW(Half) i;
+	size_t j;
+
+	for (i = 0; i < info->dlpi_phnum; ++i) {
+		const ElfW(Phdr) *const phdr = info->dlpi_phdr + i;
+		const uintptr_t start = info->dlpi_addr + phdr->p_vaddr;
+
+		if (phdr->p_type != PT_LOAD)
+			continue;
+		for (j = 0; j < anchor_count; ++j) {
+			if ((uintptr_t)anchors[j] >= start && (uintptr_t)anchors[j] < start + phdr->p_memsz)
+				return true;
+		}
+	}
+	return false;
+}
+
+/**
+ * Find the entries of the global offset table that the dynamic linker fills in
+ * lazily, as each function of another module is first called, which would
+ * otherwise pass for data written by test cases.
+ */
+CTEST_ALL_NONNULL_ARGS__
+static void module_find_plt_got__(const struct dl_phdr_info *info, uintptr_t *p_start, uintptr_t *p_end)
+{
+	ElfW(Half) i;
+
+	*p_start = *p_end = 0;
+	for (i = 0; i < info->dlpi_phnum; ++i) {
+		const ElfW(Phdr) *const phdr = info->dlpi_phdr + i;
+		const ElfW(Dyn) *dyn;
+		uintptr_t plt_got = 0;
+		size_t rel_size = 0, rel_entry_size = sizeof(ElfW(Rela));
+
+		if (phdr->p_type != PT_DYNAMIC)
+			continue;
+		for (dyn = (const ElfW(Dyn) *)(info->dlpi_addr + phdr->p_vaddr); dyn->d_tag != DT_NULL; ++dyn) {
+			switch (dyn->d_tag) {
+			case DT_PLTGOT:
+				plt_got = dyn->d_un.d_ptr;
+				break;
+			case DT_PLTRELSZ:
+				rel_size = dyn->d_un.d_val;
+				break;
+			case DT_PLTREL:
+				rel_entry_size = dyn->d_un.d_val == DT_REL ? sizeof(ElfW(Rel)) : sizeof(ElfW(Rela));
+				break;
+			}
+		}
+		if (plt_got == 0)
+			return;
+		/* glibc relocates the dynamic section in place, but not every
+		 * dynamic linker does. */
+		if (plt_got < info->dlpi_addr)
+			plt_got += info->dlpi_addr;
+		/* Three reserved entries, then one for each function. */
+		*p_start = plt_got;
+		*p_end = plt_got + (3 + rel_size / rel_entry_size) * sizeof(void *);
+		return;
+	}
+}
+
+/**
+ * Checksum the writable data of a module, except for what the dynamic linker
+ * writes: the part made read-only after relocation (<code>RELRO</code>) and
+ * the lazily bound entries of the global offset table.
+ */
+CTEST_ALL_NONNULL_ARGS__
+static uint64_t module_checksum__(const struct dl_phdr_info *info)
+{
+	uintptr_t relro_start = 0, relro_end = 0, got_start, got_end;
+	uint64_t hash = CHECKSUM_OFFSET__;
+	ElfW(Half) i;
+
+	for (i = 0; i < info->dlpi_phnum; ++i) {
+		const ElfW(Phdr) *const phdr = info->dlpi_phdr + i;
+		if (phdr->p_type == PT_GNU_RELRO) {
+			relro_start = info->dlpi_addr + phdr->p_vaddr;
+			relro_end = relro_start + phdr->p_memsz;
+		}
+	}
+	module_find_plt_got__(info, &got_start, &got_end);
+
+	for (i = 0; i < info->dlpi_phnum; ++i) {
+		const ElfW(Phdr) *const phdr = info->dlpi_phdr + i;
+		uintptr_t start = info->dlpi_addr + phdr->p_vaddr;
+		const uintptr_t end = start + phdr->p_memsz;
+
+		if (phdr->p_type != PT_LOAD || (phdr->p_flags & PF_W) == 0)
+			continue;
+		/* RELRO is at the start of the writable segment. */
+		if (relro_start <= start && relro_end > start)
+			start = relro_end < end ? relro_end : end;
+		hash = checksum_except__(hash, start, end, got_start, got_end);
+	}
+	return hash;
+}
+
+typedef struct find_modules__ find_modules_t__;
+struct find_modules__ {
+	state_snapshot_t *snapshot;
+	const void *const *anchors;
+	size_t anchor_count;
+};
+
+static int find_modules_callback__(struct dl_phdr_info *info, size_t size, void *cookie)
+{
+	find_modules_t__ *const find = cookie;
+	state_snapshot_t *const snapshot = find->snapshot;
+	state_module_t *modules, *module;
+
+	(void)size;
+	if (!module_contains_any__(info, find->anchors, find->anchor_count))
+		return 0;
+	/* The runner writes to its own data while running test cases. */
+	if (module_contains_any__(info, &self_anchor__, 1))
+		return 0;
+	if ((modules = realloc(snapshot->modules, (snapshot->module_count + 1) * sizeof(*modules))) == NULL)
+		return -1;
+	snapshot->modules = modules;
+	module = modules + snapshot->module_count++;
+	module->name = info->dlpi_name;
+	module->base = info->dlpi_addr;
+	module->checksum = module_checksum__(info);
+	return 0;
+}
+
+static int compare_fds__(const void *lhs_ptr, const void *rhs_ptr)
+{
+	const int lhs = *(const int *)lhs_ptr;
+	const int rhs = *(const int *)rhs_ptr;
+	return lhs < rhs ? -1 : lhs > rhs;
+}
+
+static int add_fd__(state_snapshot_t *snapshot, int fd)
+{
+	int *fds;
+
+	if ((fds = realloc(snapshot->fds, (snapshot->fd_count + 1) * sizeof(*fds))) == NULL)
+		return -1;
+	fds[snapshot->fd_count++] = fd;
+	snapshot->fds = fds;
+	return 0;
+}
+
+CTEST_ALL_NONNULL_ARGS__
+static int find_fds__(state_snapshot_t *snapshot)
+{
+	struct dirent *entry;
+	DIR *dir;
+	int fd;
+
+	if ((dir = opendir("/proc/self/fd")) == NULL) {
+		for (fd = 0; fd < MAX_SCANNED_FDS__; ++fd) {
+			if (fcntl(fd, F_GETFD) != -1 && add_fd__(snapshot, fd) != 0)
+				return -1;
+		}
+		return 0;
+	}
+	while ((entry = readdir(dir)) != NULL) {
+		if (entry->d_name[0] == '.')
+			continue;
+		fd = atoi(entry->d_name);
+		if (fd != dirfd(dir) && add_fd__(snapshot, fd) != 0) {
+			(void)closedir(dir);
+			return -1;
+		}
+	}
+	(void)closedir(dir);
+	qsort(snapshot->fds, snapshot->fd_count, sizeof(*snapshot->fds), &compare_fds__);
+	return 0;
+}
+
+static size_t count_threads__(void)
+{
+	struct dirent *entry;
+	size_t count = 0;
+	DIR *dir;
+
+	if ((dir = opendir("/proc/self/task")) == NULL)
+		return 0;
+	while ((entry = readdir(dir)) != NULL) {
+		if (entry->d_name[0] != '.')
+			count += 1;
+	}
+	(void)closedir(dir);
+	return count;
+}
+
+static size_t variable_name_len__(const char *entry)
+{
+	return strcspn(entry, "=");
+}
+
+static int compare_variables__(const char *lhs, const char *rhs)
+{
+	const size_t lhs_len = variable_name_len__(lhs);
+	const size_t rhs_len = variable_name_len__(rhs);
+	const int rc = memcmp(lhs, rhs, lhs_len < rhs_len ? lhs_len : rhs_len);
+	return rc != 0 ? rc : lhs_len < rhs_len ? -1 : lhs_len > rhs_len;
+}
+
+static int compare_variable_ptrs__(const void *lhs_ptr, const void *rhs_ptr)
+{
+	return compare_variables__(*(char *const *)lhs_ptr, *(char *const *)rhs_ptr);
+}
+
+CTEST_ALL_NONNULL_ARGS__
+static int copy_environment__(state_snapshot_t *snapshot)
+{
+	size_t count = 0;
+
+	while (environ != NULL && environ[count] != NULL)
+		count += 1;
+	if (count == 0)
+		return 0;
+	if ((snapshot->environment = calloc(count, sizeof(*snapshot->environment))) == NULL)
+		return -1;
+	for (; snapshot->environment_count < count; ++snapshot->environment_count) {
+		char **const copy = snapshot->environment + snapshot->environment_count;
+		if ((*copy = strdup(environ[snapshot->environment_count])) == NULL)
+			return -1;
+	}
+	qsort(snapshot->environment, count, sizeof(*snapshot->environment), &compare_variable_ptrs__);
+	return 0;
+}
+
+CTEST_NONNULL_ARGS__(1)
+int state_snapshot_take(state_snapshot_t *snapshot, const void *const *anchors, size_t anchor_count)
+{
+	find_modules_t__ find = { snapshot, anchors, anchor_count };
+	int saved_errno;
+
+	memset(snapshot, 0, sizeof(*snapshot));
+	if (anchor_count > 0 && dl_iterate_phdr(&find_modules_callback__, &find) != 0)
+		goto failed;
+	if (find_fds__(snapshot) != 0)
+		goto failed;
+	/* A working directory that has been removed can't be compared. */
+	if ((snapshot->cwd = getcwd(NULL, 0)) == NULL && errno != ENOENT)
+		goto failed;
+	if (copy_environment__(snapshot) != 0)
+		goto failed;
+	snapshot->thread_count = count_threads__();
+	return 0;
+
+failed:
+	saved_errno = errno;
+	state_snapshot_clear(snapshot);
+	errno = saved_errno;
+	return -1;
+}
+
+CTEST_PRINTF__(4, 5)
+static void describe__(char *buf, size_t size, size_t *p_count, const char *fmt, ...)
+{
+	const size_t len = strnlen(buf, size);
+	va_list args;
+
+	*p_count += 1;
+	if (len + 2 >= size)
+		return;
+	if (len > 0)
+		snprintf(buf + len, size - len, "; ");
+	va_start(args, fmt);
+	vsnprintf(buf + strlen(buf), size - strlen(buf), fmt, args);
+	va_end(args);
+}
+
+CTEST_ALL_NONNULL_ARGS__
+static void diff_modules__(const state_snapshot_t *before, const state_snapshot_t *after, char *buf, size_t size, size_t *p_count)
+{
+	size_t i, j;
+
+	for (i = 0; i < before->module_count; ++i) {
+		for (j = 0; j < after->module_count; ++j) {
+			if (after->modules[j].base == before->modules[i].base && after->modules[j].checksum != before->modules[i].checksum)
+				describe__(buf, size, p_count, "wrote to the static data of %s", before->modules[i].name);
+		}
+	}
+}
+
+CTEST_ALL_NONNULL_ARGS__
+static void diff_fds__(const state_snapshot_t *before, const state_snapshot_t *after, char *buf, size_t size, size_t *p_count)
+{
+	size_t i = 0, j = 0;
+
+	while (i < before->fd_count || j < after->fd_count) {
+		if (j == after->fd_count || (i < before->fd_count && before->fds[i] < after->fds[j])) {
+			describe__(buf, size, p_count, "closed file descriptor %d", before->fds[i]);
+			i += 1;
+		} else if (i == before->fd_count || after->fds[j] < before->fds[i]) {
+			char path[32], target[256];
+			ssize_t len;
+
+			snprintf(path, sizeof(path), "/proc/self/fd/%d", after->fds[j]);
+			if ((len = readlink(path, target, sizeof(target) - 1)) >= 0) {
+				target[len] = '\0';
+				describe__(buf, size, p_count, "left file descriptor %d open (%s)", after->fds[j], target);
+			} else {
+				describe__(buf, size, p_count, "left file descriptor %d open", after->fds[j]);
+			}
+			j += 1;
+		} else {
+			i += 1;
+			j += 1;
+		}
+	}
+}
+
+CTEST_ALL_NONNULL_ARGS__
+static void diff_environments__(const state_snapshot_t *before, const state_snapshot_t *after, char *buf, size_t size, size_t *p_count)
+{
+	size_t i = 0, j = 0;
+
+	while (i < before->environment_count || j < after->environment_count) {
+		const char *const old = i < before->environment_count ? before->environment[i] : NULL;
+		const char *const new = j < after->environment_count ? after->environment[j] : NULL;
+		const int rc = old == NULL ? 1 : new == NULL ? -1 : compare_variables__(old, new);
+
+		if (rc < 0) {
+			describe__(buf, size, p_count, "unset environment variable %.*s", (int)variable_name_len__(old), old);
+			i += 1;
+		} else if (rc > 0) {
+			describe__(buf, size, p_count, "set environment variable %.*s", (int)variable_name_len__(new), new);
+			j += 1;
+		} else {
+			if (strcmp(old, new) != 0)
+				describe__(buf, size, p_count, "changed environment variable %.*s", (int)variable_name_len__(new), new);
+			i += 1;
+			j += 1;
+		}
+	}
+}
+
+CTEST_ALL_NONNULL_ARGS__
+size_t state_snapshot_compare(const state_snapshot_t *before, const state_snapshot_t *after, char *buf, size_t size)
+{
+	size_t count = 0;
+
+	if (size > 0)
+		buf[0] = '\0';
+	diff_modules__(before, after, buf, size, &count);
+	diff_fds__(before, after, buf, size, &count);
+	if (before->cwd != NULL && (after->cwd == NULL || strcmp(before->cwd, after->cwd) != 0))
+		describe__(buf, size, &count, "changed the working directory to %s", after->cwd != NULL ? after->cwd : "(removed)");
+	diff_environments__(before, after, buf, size, &count);
+	if (before->thread_count > 0 && after->thread_count > before->thread_count)
+		describe__(buf, size, &count, "left %zu thread(s) running", after->thread_count - before->thread_count);
+	return count;
+}
+
+CTEST_ALL_NONNULL_ARGS__
+void state_snapshot_clear(state_snapshot_t *snapshot)
+{
+	size_t i;
+
+	for (i = 0; i < snapshot->environment_count; ++i)
+		(void)free(snapshot->environment[i]);
+	(void)free(snapshot->environment);
+	(void)free(snapshot->cwd);
+	(void)free(snapshot->fds);
+	(void)free(snapshot->modules);
+	memset(snapshot, 0, sizeof(*snapshot));
+}
@@ -0,0 +1,96 @@
+#ifndef PRIVATE__STATE_H__INCLUDED__
+#define PRIVATE__STATE_H__INCLUDED__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <ctest/_annotations.h>
+
+/**
+ * The writable data (<code>.data</code> and <code>.bss</code>) of a loaded
+ * module, as a checksum.
+ */
+typedef struct state_module state_module_t;
+struct state_module {
+	/**
+	 * The name of the module, as given by the dynamic linker; it remains
+	 * valid for as long as the module is loaded.
+	 */
+	const char *name;
+	uintptr_t base;
+	uint64_t checksum;
+};
+
+/**
+ * The state of the calling process that test cases run within it are expected
+ * to leave as they found it: the writable data of some of its modules (those
+ * of the test suites), its open file descriptors, its working directory, its
+ * environment, and its number of threads.
+ *
+ * A snapshot is taken before a test case and another after it; the
+ * differences between the two are what the test case left behind.
+ */
+typedef struct state_snapshot state_snapshot_t;
+struct state_snapshot {
+	state_module_t *modules;
+	size_t module_count;
+
+	/**
+	 * The open file descriptors, in ascending order.
+	 */
+	int *fds;
+	size_t fd_count;
+
+	char *cwd;
+
+	/**
+	 * Copies of the environment's entries, sorted by name.
+	 */
+	char **environment;
+	size_t environment_count;
+
+	/**
+	 * The number of threads, or zero if unknown (without
+	 * <code>/proc</code>).
+	 */
+	size_t thread_count;
+};
+
+/**
+ * Take a snapshot of the state of the calling process.
+ *
+ * @param snapshot      Populated with the snapshot, which must be cleared
+ *                      with <code>state_snapshot_clear</code> once done.
+ * @param anchors       Addresses within the modules of which to checksum the
+ *                      writable data; each module is only checksummed once,
+ *                      and that of the runner itself never is.
+ * @param anchor_count  The number of addresses.
+ *
+ * @return Zero on success, non-zero (with <code>errno</code> set) on failure.
+ */
+CTEST_NONNULL_ARGS__(1)
+extern int state_snapshot_take(state_snapshot_t *snapshot, const void *const *anchors, size_t anchor_count);
+
+/**
+ * Describe how the state of the process changed between two snapshots.
+ *
+ * @param before The earlier snapshot.
+ * @param after  The later snapshot.
+ * @param buf    Populated with a description of the changes, separated by
+ *               semicolons, truncated if it doesn't fit.
+ * @param size   The size of <code>buf</code>.
+ *
+ * @return The number of changes, zero if the state is the same.
+ */
+CTEST_ALL_NONNULL_ARGS__
+extern size_t state_snapshot_compare(const state_snapshot_t *before, const state_snapshot_t *after, char *buf, size_t size);
+
+/**
+ * Free the resources held by a snapshot.
+ *
+ * @param snapshot The snapshot to clear.
+ */
+CTEST_ALL_NONNULL_ARGS__
+extern void state_snapshot_clear(state_snapshot_t *snapshot);
+
+#endif /* PRIVATE__STATE_H__INCLUDED__ */
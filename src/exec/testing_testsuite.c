@@ -216,6 +216,29 @@ static ctest_testcase_t *const*test_op_get_testcases__(ctest_test_t *ctest_test)
 	return test->testcases;
 }
 
+static uint64_t test_op_get_timeout_ns__(ctest_test_t *unused(ctest_test)) {
+	return 0;
+}
+
+static ctest_fixture_t *test_op_get_shared_fixture__(ctest_test_t *unused(ctest_test)) {
+	return NULL;
+}
+
+static const char *const *test_op_get_tags__(ctest_test_t *unused(ctest_test)) {
+	static const char *const no_tags[] = { NULL };
+	return no_tags;
+}
+
+static ctest_test_t *const *test_op_get_prerequisites__(ctest_test_t *unused(ctest_test)) {
+	static ctest_test_t *const no_prerequisites[] = { NULL };
+	return no_prerequisites;
+}
+
+static const char *const *test_op_get_resources__(ctest_test_t *unused(ctest_test)) {
+	static const char *const no_resources[] = { NULL };
+	return no_resources;
+}
+
 static void test_destroy__(test_t__ *test) {
 	size_t i;
 
@@ -235,6 +258,11 @@ static test_t__ *test_create__(size_t testcase_count, ctest_testsuite_t *testsui
 		&test_op_get_testsuite__,
 		&test_op_get_testcase_count__,
 		&test_op_get_testcases__,
+		&test_op_get_timeout_ns__,
+		&test_op_get_shared_fixture__,
+		&test_op_get_tags__,
+		&test_op_get_prerequisites__,
+		&test_op_get_resources__,
 	};
 
 	va_list args;
@@ -299,6 +327,14 @@ static ctest_test_t *const*testsuite_op_get_tests__(ctest_testsuite_t *ctest_tes
 	return testsuite->tests;
 }
 
+static const char *testsuite_op_get_filename__(ctest_testsuite_t *unused(ctest_testsuite)) {
+	return NULL;
+}
+
+static bool testsuite_op_supports_threads__(ctest_testsuite_t *unused(ctest_testsuite)) {
+	return true;
+}
+
 static void testsuite_op_destroy__(ctest_testsuite_t *ctest_testsuite) {
 	testsuite_t__ * const testsuite = upcast_testsuite__(ctest_testsuite);
 	size_t i;
@@ -318,6 +354,8 @@ static testsuite_t__ *testsuite_create__(size_t test_count, const char *fmt, ...
 		&testsuite_op_get_name__,
 		&testsuite_op_get_test_count__,
 		&testsuite_op_get_tests__,
+		&testsuite_op_get_filename__,
+		&testsuite_op_supports_threads__,
 		&testsuite_op_destroy__,
 	};
 
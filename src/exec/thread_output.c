@@ -0,0 +1,200 @@
+#define _GNU_SOURCE     /* fopencookie */
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "thread_output.h"
+#include "utils.h"
+
+typedef struct capture__ capture_t__;
+struct capture__ {
+	bool active;
+	ctest_output_t *output;
+	size_t length;
+};
+
+/**
+ * A capturing stream's original stream, and the file its descriptor referred
+ * to when the stream was installed (if it referred to one).
+ */
+typedef struct stream__ stream_t__;
+struct stream__ {
+	FILE *original;
+	bool identified;
+	dev_t dev;
+	ino_t ino;
+};
+
+static pthread_mutex_t lock__ = PTHREAD_MUTEX_INITIALIZER;
+static unsigned int install_count__;
+static FILE *saved_stdout__;
+static FILE *saved_stderr__;
+static __thread capture_t__ capture__;
+
+/**
+ * Append data to the calling thread's capture buffer.
+ *
+ * @return The number of bytes consumed; when the buffer can't grow, the data
+ *         is dropped (but still consumed), like the forking runner does.
+ */
+static ssize_t capture_append__(capture_t__ *capture, const char *buf, size_t size)
+{
+	size_t capacity = capture->output != NULL ? capture->output->length : 0;
+
+	if (capture->length + size > capacity) {
+		ctest_output_t *output = capture->output;
+
+		if (capacity == 0)
+			capacity = 128;
+		while (capacity < capture->length + size)
+			capacity *= 2;
+		if (ctest_output_resize(&output, capacity) != 0)
+			return size;
+		capture->output = output;
+	}
+
+	memcpy(capture->output->data + capture->length, buf, size);
+	capture->length += size;
+	return size;
+}
+
+/**
+ * Whether the descriptor of a stream's original stream has been redirected
+ * since the stream was installed (e.g., by a test case that dup2()s a file
+ * onto it, expecting what it prints to end up there).
+ */
+static bool stream_redirected__(const stream_t__ *stream)
+{
+	struct stat st;
+
+	if (!stream->identified)
+		return false;
+	return fstat(fileno(stream->original), &st) != 0 || st.st_dev != stream->dev || st.st_ino != stream->ino;
+}
+
+static ssize_t stream_write__(void *cookie, const char *buf, size_t size)
+{
+	stream_t__ *const stream = cookie;
+
+	if (capture__.active && !stream_redirected__(stream))
+		return capture_append__(&capture__, buf, size);
+	if (fwrite(buf, 1, size, stream->original) != size)
+		return -1;
+	fflush(stream->original);
+	return size;
+}
+
+static int stream_close__(void *cookie)
+{
+	(void)free(cookie);
+	return 0;
+}
+
+static FILE *stream_create__(FILE *original)
+{
+	static const cookie_io_functions_t functions = {
+		NULL,
+		&stream_write__,
+		NULL,
+		&stream_close__,
+	};
+	stream_t__ *cookie;
+	struct stat st;
+	FILE *stream;
+
+	if ((cookie = calloc(1, sizeof(*cookie))) == NULL)
+		return NULL;
+	cookie->original = original;
+	if (fstat(fileno(original), &st) == 0) {
+		cookie->identified = true;
+		cookie->dev = st.st_dev;
+		cookie->ino = st.st_ino;
+	}
+
+	if ((stream = fopencookie(cookie, "w", functions)) == NULL) {
+		(void)free(cookie);
+		return NULL;
+	}
+
+	/* Each write must reach stream_write__ on the writing thread, so
+	 * nothing can be left buffered for another thread to flush. */
+	setvbuf(stream, NULL, _IONBF, 0);
+	return stream;
+}
+
+extern int thread_output_install(void)
+{
+	FILE *new_stdout, *new_stderr;
+
+	pthread_mutex_lock(&lock__);
+	if (install_count__ > 0)
+		goto installed;
+
+	fflush(stdout);
+	fflush(stderr);
+	if ((new_stdout = stream_create__(stdout)) == NULL)
+		goto stdout_create_failed;
+	if ((new_stderr = stream_create__(stderr)) == NULL)
+		goto stderr_create_failed;
+
+	saved_stdout__ = stdout;
+	saved_stderr__ = stderr;
+	stdout = new_stdout;
+	stderr = new_stderr;
+
+installed:
+	++install_count__;
+	pthread_mutex_unlock(&lock__);
+	return 0;
+
+stderr_create_failed:
+	(void)fclose(new_stdout);
+stdout_create_failed:
+	pthread_mutex_unlock(&lock__);
+	return -1;
+}
+
+extern void thread_output_uninstall(void)
+{
+	pthread_mutex_lock(&lock__);
+	if (install_count__ > 0 && --install_count__ == 0) {
+		FILE *const new_stdout = stdout;
+		FILE *const new_stderr = stderr;
+
+		stdout = saved_stdout__;
+		stderr = saved_stderr__;
+		saved_stdout__ = NULL;
+		saved_stderr__ = NULL;
+		(void)fclose(new_stdout);
+		(void)fclose(new_stderr);
+	}
+	pthread_mutex_unlock(&lock__);
+}
+
+extern void thread_output_begin(void)
+{
+	capture__.active = true;
+	capture__.length = 0;
+}
+
+extern ctest_output_t *thread_output_end(void)
+{
+	ctest_output_t *output = capture__.output;
+	const size_t length = capture__.length;
+
+	memset(&capture__, 0, sizeof(capture__));
+	if (output == NULL)
+		return NULL;
+	if (length == 0) {
+		ctest_output_destroy(output);
+		return NULL;
+	}
+
+	ctest_output_resize(&output, length+1);
+	output->data[length] = '\0';
+	return output;
+}
@@ -0,0 +1,52 @@
+#ifndef PRIVATE__THREAD_OUTPUT_H__INCLUDED__
+#define PRIVATE__THREAD_OUTPUT_H__INCLUDED__
+
+#include <ctest/_annotations.h>
+#include <ctest/exec/output.h>
+
+/**
+ * Per-thread capture of the output written to <code>stdout</code> and
+ * <code>stderr</code>.
+ *
+ * Redirecting the standard file descriptors (like the direct runner does)
+ * affects every thread in the process. Instead, while installed, the
+ * <code>stdout</code> and <code>stderr</code> streams are replaced with
+ * streams that append what is written to them to a buffer belonging to the
+ * writing thread, if it is capturing output, or pass it through to the
+ * original streams otherwise.
+ *
+ * Only output written through the standard streams is captured; data written
+ * directly to the file descriptors is not. Nor is output written while the
+ * stream's file descriptor is redirected elsewhere (e.g., by a test case
+ * that dup2()s a file onto it): that goes where the descriptor now leads.
+ */
+
+/**
+ * Replace the standard streams with capturing streams.
+ *
+ * Installations nest; the original streams are restored once every
+ * installation has been undone with <code>thread_output_uninstall</code>.
+ *
+ * @return Zero on success, non-zero (with <code>errno</code> set) on failure.
+ */
+extern int thread_output_install(void);
+
+/**
+ * Undo an installation made with <code>thread_output_install</code>.
+ */
+extern void thread_output_uninstall(void);
+
+/**
+ * Start capturing the output written by the calling thread.
+ */
+extern void thread_output_begin(void);
+
+/**
+ * Stop capturing the output written by the calling thread.
+ *
+ * @return The output captured since <code>thread_output_begin</code>, or
+ *         <code>NULL</code> if nothing was written.
+ */
+extern ctest_output_t *thread_output_end(void);
+
+#endif /* PRIVATE__THREAD_OUTPUT_H__INCLUDED__ */
@@ -0,0 +1,697 @@
+#include <errno.h>
+#include <pthread.h>
+#include <setjmp.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <ctest/_annotations.h>
+#include <ctest/exec/result.h>
+#include <ctest/exec/runner.h>
+#include <ctest/exec/runner_config.h>
+#include <ctest/exec/stage.h>
+#include <ctest/exec.h>
+#include "ports.h"
+#include "runner_utils.h"
+#include "sig.h"
+#include "thread_output.h"
+#include "utils.h"
+
+
+/* Return values from setjmp indicating how the test completed. */
+#define RESULT_TYPE_NORMAL__		1
+#define RESULT_TYPE_SIGNAL__		2
+
+/*
+ * Failure Hooks
+ *
+ * Each thread runs its test case with its own hooks; a failure unwinds to the
+ * point the running thread set up, leaving the other threads alone.
+ */
+
+typedef struct exec_hooks__ exec_hooks_t__;
+struct exec_hooks__ {
+	ctest_exec_hooks_t base;
+
+	sigjmp_buf env;
+	ctest_result_t *result;
+	int signum;
+	ctest_stage_t stage;
+};
+
+static inline exec_hooks_t__ *upcast_ctest_exec_hooks__(ctest_exec_hooks_t *hooks)
+{
+	return containerof(hooks, exec_hooks_t__, base);
+}
+
+CTEST_NONNULL_ARGS__(1) CTEST_NORETURN__
+static void exec_hooks_on_short_circuit__(ctest_exec_hooks_t *ctest_hooks, ctest_result_type_t type, ctest_failure_t *failure)
+{
+	exec_hooks_t__ *const hooks = upcast_ctest_exec_hooks__(ctest_hooks);
+
+	ctest_result_set_failure(hooks->result, type, failure);
+	siglongjmp(hooks->env, RESULT_TYPE_NORMAL__);
+}
+
+static void exec_hooks_op_on_stage_change__(ctest_exec_hooks_t *ctest_hooks, ctest_stage_t stage)
+{
+	exec_hooks_t__ *const hooks = upcast_ctest_exec_hooks__(ctest_hooks);
+	hooks->stage = stage;
+}
+
+CTEST_NONNULL_ARGS__(1) CTEST_NORETURN__
+static void exec_hooks_op_on_skip__(ctest_exec_hooks_t *hooks, ctest_failure_t *failure)
+{
+	exec_hooks_on_short_circuit__(hooks, CTEST_RESULT_SKIPPED, failure);
+}
+
+CTEST_NONNULL_ARGS__(1) CTEST_NORETURN__
+static void exec_hooks_op_on_failure__(ctest_exec_hooks_t *hooks, ctest_failure_t *failure)
+{
+	exec_hooks_on_short_circuit__(hooks, CTEST_RESULT_FAIL, failure);
+}
+
+static void exec_hooks_init__(exec_hooks_t__ *hooks, ctest_result_t *result)
+{
+	static ctest_exec_hooks_ops_t ops = {
+		&exec_hooks_op_on_stage_change__,
+		&exec_hooks_op_on_skip__,
+		&exec_hooks_op_on_failure__,
+	};
+
+	hooks->base.ops = &ops;
+	hooks->result = result;
+	hooks->signum = 0;
+	hooks->stage = CTEST_STAGE_SETUP;
+}
+
+static void handle_signal__(int signum, void *cookie)
+{
+	exec_hooks_t__ *const hooks = cookie;
+	hooks->signum = signum;
+	siglongjmp(hooks->env, RESULT_TYPE_SIGNAL__);
+}
+
+/*
+ * Operations run with a thread's failure hooks: executing a test case, or
+ * setting up or tearing down a shared fixture.
+ */
+
+static void testcase_execute__(void *testcase, ctest_exec_hooks_t *hooks)
+{
+	ctest_testcase_execute(testcase, hooks);
+}
+
+static void fixture_setup__(void *fixture, ctest_exec_hooks_t *hooks)
+{
+	ctest_fixture_setup(fixture, hooks);
+}
+
+static void fixture_teardown__(void *fixture, ctest_exec_hooks_t *hooks)
+{
+	ctest_fixture_teardown(fixture, hooks);
+}
+
+/**
+ * Execute an operation on the calling thread.
+ *
+ * @return Zero if the operation passed, otherwise one of the
+ *         <code>RESULT_TYPE_xxx__</code> values describing how it was cut
+ *         short.
+ */
+static int execute__(exec_hooks_t__ *hooks, void (*op)(void *, ctest_exec_hooks_t *), void *subject)
+{
+	int rc;
+
+	if ((rc = sigsetjmp(hooks->env, 1)) != 0)
+		return rc;
+	(*op)(subject, &hooks->base);
+	return 0;
+}
+
+/**
+ * Run an operation (usually, executing a test case) on the calling thread,
+ * capturing its output.
+ *
+ * @return The result of the operation, or <code>NULL</code> if one couldn't
+ *         be allocated.
+ */
+static ctest_result_t *run__(void (*op)(void *, ctest_exec_hooks_t *), void *subject)
+{
+	exec_hooks_t__ exec_hooks;
+	ctest_result_t *result;
+	int rc;
+
+	if ((result = ctest_result_create_empty()) == NULL)
+		return NULL;
+	exec_hooks_init__(&exec_hooks, result);
+
+	thread_output_begin();
+	if (sigcapture__(&handle_signal__, &exec_hooks) != 0) {
+		ctest_failure_t *const failure = ctest_failure_create(CTEST_STAGE_SETUP, "unable to capture signals: %s", NULL, NULL, strerror(errno));
+		ctest_result_set_failure(result, CTEST_RESULT_ERROR, failure);
+		ctest_result_set_output(result, thread_output_end());
+		return result;
+	}
+
+	switch (rc = execute__(&exec_hooks, op, subject)) {
+	case 0:
+		result->type = CTEST_RESULT_PASS;
+		break;
+
+	case RESULT_TYPE_NORMAL__:
+		/* return from siglongjmp normally (result is filled in) */
+		break;
+
+	case RESULT_TYPE_SIGNAL__:
+		/* return from siglongjmp due to caught signal. */
+		{
+			ctest_failure_t *const failure = ctest_failure_create(exec_hooks.stage, "Caught unexpected signal: %d", NULL, NULL, exec_hooks.signum);
+			ctest_result_set_failure(result, CTEST_RESULT_FAIL, failure);
+		}
+		break;
+
+	default:
+		/* return from siglongjmp for unknown reason */
+		{
+			ctest_failure_t *const failure = ctest_failure_create(exec_hooks.stage, "unexpected return from longjmp: %d", NULL, NULL, rc);
+			ctest_result_set_failure(result, CTEST_RESULT_ERROR, failure);
+		}
+		break;
+	}
+	sigrestore__();
+
+	ctest_result_set_output(result, thread_output_end());
+	return result;
+}
+
+/*
+ * Runner
+ */
+
+/**
+ * A job that has been run, waiting to be completed on the runner's thread.
+ */
+typedef struct completion__ completion_t__;
+struct completion__ {
+	runner_job_t *job;
+	ctest_result_t *result;
+};
+
+/**
+ * A shared fixture, set up on the runner's thread before the first job using
+ * it is started, and handed to the test cases using it as is.
+ */
+typedef struct shared_fixture__ shared_fixture_t__;
+struct shared_fixture__ {
+	ctest_fixture_t *fixture;
+	shared_fixture_t__ *next;
+
+	/**
+	 * The result of setting the fixture up; unless it passed, each test
+	 * case using the fixture is completed with a copy of it, without
+	 * being run.
+	 */
+	ctest_result_t *setup_result;
+};
+
+/**
+ * A pool thread, running the jobs scheduled on one worker.
+ */
+typedef struct thread_slot__ thread_slot_t__;
+struct thread_slot__ {
+	struct threaded_runner__ *runner;
+	pthread_t thread;
+	pthread_cond_t job_available;
+
+	/* The job to run next, if any. */
+	runner_job_t *job;
+};
+
+/**
+ * A <code>ctest_runner_t</code> implementation that runs test cases
+ * concurrently on a pool of threads, all within the runner's own process.
+ *
+ * This avoids the cost of a process per test case, but test cases aren't
+ * isolated from each other: only test cases that don't share (or leave
+ * behind) state should be run this way, or be tagged "unsafe" so they're run
+ * with no other test case in flight. Each thread has its own failure hooks,
+ * signal handler, dynamic operations, and output capture, so a failing test
+ * case only unwinds its own thread.
+ *
+ * Results are completed (and so reported) on the thread running the tests; the
+ * pool threads only ever run test cases.
+ */
+typedef struct threaded_runner__ threaded_runner_t__;
+struct threaded_runner__ {
+	ctest_runner_t base;
+	runner_executor_t executor;
+
+	/**
+	 * The pool threads, one for each worker of the schedule; only running
+	 * for the duration of a run.
+	 */
+	thread_slot_t__ *threads;
+	size_t thread_count;
+	size_t threads_started;
+
+	pthread_mutex_t lock;
+	pthread_cond_t job_completed;
+	bool stopping;
+
+	/* Jobs run, waiting to be completed; completed_scratch holds the jobs
+	 * being completed (outside the lock). */
+	completion_t__ *completed;
+	completion_t__ *completed_scratch;
+	size_t completed_count;
+
+	/**
+	 * The shared fixtures in use, only ever touched on the runner's
+	 * thread.
+	 */
+	shared_fixture_t__ *fixtures;
+
+	/**
+	 * The range of loopback ports test cases lease during a run.
+	 */
+	unsigned int first_port;
+	unsigned int last_port;
+};
+
+static threaded_runner_t__ *upcast_from_ctest_runner__(ctest_runner_t *runner)
+{
+	return containerof(runner, threaded_runner_t__, base);
+}
+
+static threaded_runner_t__ *upcast_from_runner_executor__(runner_executor_t *executor)
+{
+	return containerof(executor, threaded_runner_t__, executor);
+}
+
+static void *thread_main__(void *arg)
+{
+	thread_slot_t__ *const slot = arg;
+	threaded_runner_t__ *const runner = slot->runner;
+	sigset_t sigset;
+
+	/* Leave signals meant for the process to the runner's thread, so they
+	 * aren't mistaken for a failure of the test case being run. */
+	sigemptyset(&sigset);
+	sigaddset(&sigset, SIGHUP);
+	sigaddset(&sigset, SIGINT);
+	sigaddset(&sigset, SIGQUIT);
+	sigaddset(&sigset, SIGTERM);
+	pthread_sigmask(SIG_BLOCK, &sigset, NULL);
+
+	pthread_mutex_lock(&runner->lock);
+	while (1) {
+		runner_job_t *job;
+		ctest_result_t *result;
+
+		while (!runner->stopping && slot->job == NULL)
+			pthread_cond_wait(&slot->job_available, &runner->lock);
+		if (slot->job == NULL)
+			break;
+
+		job = slot->job;
+		slot->job = NULL;
+		pthread_mutex_unlock(&runner->lock);
+
+		result = run__(&testcase_execute__, job->testcase);
+
+		pthread_mutex_lock(&runner->lock);
+		runner->completed[runner->completed_count++] = (completion_t__){ job, result };
+		pthread_cond_signal(&runner->job_completed);
+	}
+	pthread_mutex_unlock(&runner->lock);
+
+	return NULL;
+}
+
+/**
+ * Get a shared fixture, setting it up (on the calling thread) if no test case
+ * has used it yet.
+ *
+ * @return The shared fixture, or <code>NULL</code> if it couldn't be
+ *         allocated.
+ */
+CTEST_ALL_NONNULL_ARGS__
+static shared_fixture_t__ *runner_get_fixture__(threaded_runner_t__ *runner, ctest_fixture_t *fixture)
+{
+	shared_fixture_t__ *shared;
+
+	for (shared = runner->fixtures; shared != NULL; shared = shared->next) {
+		if (shared->fixture == fixture)
+			return shared;
+	}
+
+	if ((shared = calloc(1, sizeof(*shared))) == NULL)
+		return NULL;
+	if ((shared->setup_result = run__(&fixture_setup__, fixture)) == NULL) {
+		(void)free(shared);
+		return NULL;
+	}
+	shared->fixture = fixture;
+	shared->next = runner->fixtures;
+	runner->fixtures = shared;
+	return shared;
+}
+
+/**
+ * Create the result of a test case whose shared fixture failed to be set up.
+ *
+ * @return The result, or <code>NULL</code> if it couldn't be allocated.
+ */
+CTEST_ALL_NONNULL_ARGS__
+static ctest_result_t *shared_fixture_create_result__(const shared_fixture_t__ *shared)
+{
+	const ctest_result_t *const setup_result = shared->setup_result;
+	ctest_result_t *result;
+	ctest_output_t *output;
+
+	if ((result = ctest_result_create_empty()) == NULL)
+		return NULL;
+	ctest_result_set_failure(result, setup_result->type, setup_result->failure != NULL ? ctest_failure_clone(setup_result->failure) : NULL);
+	if (setup_result->output != NULL && (output = ctest_output_create(setup_result->output->length)) != NULL) {
+		memcpy(output->data, setup_result->output->data, setup_result->output->length);
+		ctest_result_set_output(result, output);
+	}
+	return result;
+}
+
+/**
+ * Tear down a shared fixture (if it was set up) and free it.
+ *
+ * There's no test case left to blame if tearing the fixture down fails, so
+ * a warning is printed instead.
+ */
+CTEST_ALL_NONNULL_ARGS__
+static void shared_fixture_destroy__(shared_fixture_t__ *shared)
+{
+	ctest_result_t *result;
+
+	if (shared->setup_result->type == CTEST_RESULT_PASS && (result = run__(&fixture_teardown__, shared->fixture)) != NULL) {
+		if (result->type != CTEST_RESULT_PASS)
+			fprintf(stderr, "warning: tearing down shared fixture %s failed: %s\n", ctest_fixture_get_name(shared->fixture),
+			        result->failure != NULL ? result->failure->description : "unknown failure");
+		ctest_result_destroy(result);
+	}
+	ctest_result_destroy(shared->setup_result);
+	memset(shared, 0, sizeof(*shared));
+	(void)free(shared);
+}
+
+CTEST_ALL_NONNULL_ARGS__
+static int executor_op_start__(runner_executor_t *executor, runner_job_t *job)
+{
+	threaded_runner_t__ *const runner = upcast_from_runner_executor__(executor);
+	ctest_fixture_t *const fixture = ctest_test_get_shared_fixture(ctest_testcase_get_test(job->testcase));
+	shared_fixture_t__ *shared;
+	ctest_result_t *result;
+	thread_slot_t__ *slot;
+
+	if (job->worker >= runner->thread_count) {
+		errno = EBUSY;
+		return -1;
+	}
+	slot = runner->threads + job->worker;
+
+	/* The fixture is set up before any thread uses it, so the threads
+	 * only ever read it (through the lock handing them the job). */
+	if (fixture != NULL) {
+		if ((shared = runner_get_fixture__(runner, fixture)) == NULL)
+			return -1;
+		if (shared->setup_result->type != CTEST_RESULT_PASS) {
+			if ((result = shared_fixture_create_result__(shared)) == NULL)
+				return -1;
+			runner_job_complete(job, result);
+			return 0;
+		}
+	}
+
+	pthread_mutex_lock(&runner->lock);
+	if (slot->job != NULL) {
+		pthread_mutex_unlock(&runner->lock);
+		errno = EBUSY;
+		return -1;
+	}
+	slot->job = job;
+	pthread_cond_signal(&slot->job_available);
+	pthread_mutex_unlock(&runner->lock);
+
+	return 0;
+}
+
+CTEST_ALL_NONNULL_ARGS__
+static int executor_op_wait__(runner_executor_t *executor)
+{
+	threaded_runner_t__ *const runner = upcast_from_runner_executor__(executor);
+	completion_t__ *const completed = runner->completed_scratch;
+	size_t i, completed_count;
+	bool failed = false;
+
+	pthread_mutex_lock(&runner->lock);
+	while (runner->completed_count == 0)
+		pthread_cond_wait(&runner->job_completed, &runner->lock);
+	completed_count = runner->completed_count;
+	memcpy(completed, runner->completed, completed_count * sizeof(*completed));
+	runner->completed_count = 0;
+	pthread_mutex_unlock(&runner->lock);
+
+	/* Complete the rest of the batch even if a result couldn't be
+	 * created, rather than lose the results that were. */
+	for (i = 0; i < completed_count; ++i) {
+		ctest_result_t *result = completed[i].result;
+
+		if (result == NULL) {
+			failed = true;
+			continue;
+		}
+		runner_job_complete(completed[i].job, result);
+	}
+
+	if (failed) {
+		errno = ENOMEM;
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ * Test cases run within this process can't be stopped part way through;
+ * those in flight are left to finish (and are reported as they do).
+ */
+CTEST_ALL_NONNULL_ARGS__
+static void executor_op_cancel__(runner_executor_t *unused(executor))
+{
+}
+
+/**
+ * Tear down a shared fixture none of the run's test cases need any more.
+ */
+CTEST_ALL_NONNULL_ARGS__
+static void executor_op_release_fixture__(runner_executor_t *executor, ctest_fixture_t *fixture)
+{
+	threaded_runner_t__ *const runner = upcast_from_runner_executor__(executor);
+	shared_fixture_t__ **p_shared;
+
+	for (p_shared = &runner->fixtures; *p_shared != NULL; p_shared = &(*p_shared)->next) {
+		shared_fixture_t__ *const shared = *p_shared;
+		if (shared->fixture == fixture) {
+			*p_shared = shared->next;
+			shared_fixture_destroy__(shared);
+			break;
+		}
+	}
+}
+
+/**
+ * Run the test cases of tests tagged "unsafe" with no other test case in
+ * flight, the closest this runner comes to a process of their own: they may
+ * change state of the process (e.g., redirect its standard file descriptors)
+ * that other test cases depend on. So are those of suites that don't support
+ * threads, which would otherwise report their failures through each other's
+ * dynamic operations.
+ */
+CTEST_ALL_NONNULL_ARGS__
+static bool executor_op_runs_alone__(runner_executor_t *unused(executor), ctest_test_t *test)
+{
+	return ctest_test_has_tag(test, "unsafe") || !ctest_testsuite_supports_threads(ctest_test_get_testsuite(test));
+}
+
+/**
+ * Stop the pool threads, waiting for them to exit.
+ */
+CTEST_ALL_NONNULL_ARGS__
+static void runner_end_run__(threaded_runner_t__ *runner)
+{
+	size_t i;
+
+	pthread_mutex_lock(&runner->lock);
+	runner->stopping = true;
+	for (i = 0; i < runner->threads_started; ++i)
+		pthread_cond_signal(&runner->threads[i].job_available);
+	pthread_mutex_unlock(&runner->lock);
+
+	for (i = 0; i < runner->threads_started; ++i)
+		(void)pthread_join(runner->threads[i].thread, NULL);
+	runner->threads_started = 0;
+	runner->stopping = false;
+
+	/* Shared fixtures still set up (e.g., the run was cancelled). */
+	while (runner->fixtures != NULL) {
+		shared_fixture_t__ *const shared = runner->fixtures;
+		runner->fixtures = shared->next;
+		shared_fixture_destroy__(shared);
+	}
+
+	thread_output_uninstall();
+	ports_close();
+}
+
+/**
+ * Start the pool threads for a run.
+ *
+ * @return Zero on success, non-zero (with <code>errno</code> set) on failure.
+ */
+CTEST_ALL_NONNULL_ARGS__
+static int runner_begin_run__(threaded_runner_t__ *runner)
+{
+	int rc;
+
+	if (ports_open(runner->first_port, runner->last_port) != 0)
+		return -1;
+	if (thread_output_install() != 0) {
+		ports_close();
+		return -1;
+	}
+
+	for (runner->threads_started = 0; runner->threads_started < runner->thread_count; ++runner->threads_started) {
+		thread_slot_t__ *const slot = runner->threads + runner->threads_started;
+		if ((rc = pthread_create(&slot->thread, NULL, &thread_main__, slot)) != 0) {
+			runner_end_run__(runner);
+			errno = rc;
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+CTEST_ALL_NONNULL_ARGS__
+static int runner_op_run_testsuites__(ctest_runner_t *ctest_runner, ctest_reporter_t *reporter, ctest_testsuite_t *const* testsuites, size_t testsuite_count)
+{
+	threaded_runner_t__ *const runner = upcast_from_ctest_runner__(ctest_runner);
+	int result;
+
+	if (runner_begin_run__(runner) != 0)
+		return -1;
+	result = runner_execute_testsuites(&runner->executor, reporter, testsuites, testsuite_count);
+	runner_end_run__(runner);
+	return result;
+}
+
+CTEST_ALL_NONNULL_ARGS__
+static int runner_op_run_tests__(ctest_runner_t *ctest_runner, ctest_reporter_t *reporter, ctest_test_t *const*tests, size_t test_count)
+{
+	threaded_runner_t__ *const runner = upcast_from_ctest_runner__(ctest_runner);
+	int result;
+
+	if (runner_begin_run__(runner) != 0)
+		return -1;
+	result = runner_execute_tests(&runner->executor, reporter, tests, test_count);
+	runner_end_run__(runner);
+	return result;
+}
+
+CTEST_ALL_NONNULL_ARGS__
+static int runner_op_run_testcases__(ctest_runner_t *ctest_runner, ctest_reporter_t *reporter, ctest_testcase_t *const*testcases, size_t testcase_count)
+{
+	threaded_runner_t__ *const runner = upcast_from_ctest_runner__(ctest_runner);
+	int result;
+
+	if (runner_begin_run__(runner) != 0)
+		return -1;
+	result = runner_execute_testcases(&runner->executor, reporter, testcases, testcase_count);
+	runner_end_run__(runner);
+	return result;
+}
+
+CTEST_ALL_NONNULL_ARGS__
+static void runner_op_destroy__(ctest_runner_t *ctest_runner)
+{
+	threaded_runner_t__ *const runner = upcast_from_ctest_runner__(ctest_runner);
+	size_t i;
+
+	for (i = 0; i < runner->thread_count; ++i)
+		pthread_cond_destroy(&runner->threads[i].job_available);
+	pthread_cond_destroy(&runner->job_completed);
+	pthread_mutex_destroy(&runner->lock);
+	(void)free(runner->completed_scratch);
+	(void)free(runner->completed);
+	(void)free(runner->threads);
+	memset(runner, 0, sizeof(*runner));
+	(void)free(runner);
+}
+
+CTEST_ALL_NONNULL_ARGS__
+ctest_runner_t *ctest_create_threaded_runner_with_config(const ctest_runner_config_t *config)
+{
+	static ctest_runner_ops_t ops = {
+		&runner_op_run_testsuites__,
+		&runner_op_run_tests__,
+		&runner_op_run_testcases__,
+		&runner_op_destroy__
+	};
+	static runner_executor_ops_t executor_ops = {
+		&executor_op_start__,
+		&executor_op_wait__,
+		&executor_op_cancel__,
+		&executor_op_release_fixture__,
+		&executor_op_runs_alone__,
+	};
+
+	threaded_runner_t__ *runner;
+	const size_t thread_count = config->jobs > 0 ? config->jobs : 1;
+	size_t i;
+
+	if ((runner = calloc(1, sizeof(*runner))) == NULL)
+		goto alloc_runner_failed;
+	if ((runner->threads = calloc(thread_count, sizeof(*runner->threads))) == NULL)
+		goto alloc_threads_failed;
+	if ((runner->completed = calloc(thread_count, sizeof(*runner->completed))) == NULL)
+		goto alloc_completed_failed;
+	if ((runner->completed_scratch = calloc(thread_count, sizeof(*runner->completed_scratch))) == NULL)
+		goto alloc_completed_scratch_failed;
+
+	runner->base.ops = &ops;
+	runner->executor.ops = &executor_ops;
+	runner->executor.capacity = thread_count;
+	runner->executor.concurrency = config->concurrency;
+	runner->executor.timings = config->timings;
+	runner->executor.journal = config->journal;
+	runner_cancellation_init(&runner->executor.cancellation, config);
+	runner->executor.retries = config->retries;
+	runner->executor.resources = config->resources;
+	runner->thread_count = thread_count;
+	runner->first_port = config->first_port;
+	runner->last_port = config->last_port;
+	pthread_mutex_init(&runner->lock, NULL);
+	pthread_cond_init(&runner->job_completed, NULL);
+	for (i = 0; i < thread_count; ++i) {
+		runner->threads[i].runner = runner;
+		pthread_cond_init(&runner->threads[i].job_available, NULL);
+	}
+	return &runner->base;
+
+alloc_completed_scratch_failed:
+	(void)free(runner->completed);
+alloc_completed_failed:
+	(void)free(runner->threads);
+alloc_threads_failed:
+	(void)free(runner);
+alloc_runner_failed:
+	return NULL;
+}
@@ -0,0 +1,415 @@
+#include <errno.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <ctest/_annotations.h>
+#include <ctest/exec/suite.h>
+#include <ctest/exec/timings.h>
+
+#include "utils.h"
+
+typedef struct timing_entry__ timing_entry_t__;
+struct timing_entry__ {
+	timing_entry_t__ *next;
+	uint64_t duration_ns;
+	unsigned int crash_count;
+	uint64_t peak_memory_bytes;     /* Zero if never measured. */
+	const char *testcase;
+	char suite[];           /* Followed by the test case name. */
+};
+
+struct ctest_timings {
+	timing_entry_t__ **buckets;
+	size_t bucket_count;
+	size_t entry_count;
+	uint64_t total_ns;
+};
+
+/* FNV-1a, over the suite name, a separator, and the test case name. */
+static uint64_t hash_key__(const char *suite, const char *testcase)
+{
+	uint64_t hash = UINT64_C(0xcbf29ce484222325);
+	const char *p;
+
+	for (p = suite; *p != '\0'; ++p)
+		hash = (hash ^ (unsigned char)*p) * UINT64_C(0x100000001b3);
+	hash = (hash ^ '\t') * UINT64_C(0x100000001b3);
+	for (p = testcase; *p != '\0'; ++p)
+		hash = (hash ^ (unsigned char)*p) * UINT64_C(0x100000001b3);
+	return hash;
+}
+
+static timing_entry_t__ **find__(const ctest_timings_t *timings, const char *suite, const char *testcase)
+{
+	timing_entry_t__ **p_entry = timings->buckets + hash_key__(suite, testcase) % timings->bucket_count;
+
+	for (; *p_entry != NULL; p_entry = &(*p_entry)->next) {
+		if (strcmp((*p_entry)->suite, suite) == 0 && strcmp((*p_entry)->testcase, testcase) == 0)
+			break;
+	}
+	return p_entry;
+}
+
+static int grow__(ctest_timings_t *timings)
+{
+	const size_t bucket_count = timings->bucket_count * 2;
+	timing_entry_t__ **buckets;
+	size_t i;
+
+	if ((buckets = calloc(bucket_count, sizeof(*buckets))) == NULL)
+		return -1;
+
+	for (i = 0; i < timings->bucket_count; ++i) {
+		timing_entry_t__ *entry, *next;
+		for (entry = timings->buckets[i]; entry != NULL; entry = next) {
+			timing_entry_t__ **const p_bucket = buckets + hash_key__(entry->suite, entry->testcase) % bucket_count;
+			next = entry->next;
+			entry->next = *p_bucket;
+			*p_bucket = entry;
+		}
+	}
+
+	(void)free(timings->buckets);
+	timings->buckets = buckets;
+	timings->bucket_count = bucket_count;
+	return 0;
+}
+
+/**
+ * Find the entry of a test case, adding one (without a duration) if there
+ * isn't one yet.
+ *
+ * @return The entry, or <code>NULL</code> on failure.
+ */
+static timing_entry_t__ *get__(ctest_timings_t *timings, const char *suite, const char *testcase)
+{
+	timing_entry_t__ **p_entry = find__(timings, suite, testcase);
+	timing_entry_t__ *entry;
+	size_t suite_length, testcase_length;
+
+	if (*p_entry != NULL)
+		return *p_entry;
+
+	if (timings->entry_count >= timings->bucket_count && grow__(timings) == 0)
+		p_entry = find__(timings, suite, testcase);
+
+	suite_length = strlen(suite);
+	testcase_length = strlen(testcase);
+	if ((entry = malloc(sizeof(*entry) + suite_length + 1 + testcase_length + 1)) == NULL)
+		return NULL;
+	memcpy(entry->suite, suite, suite_length + 1);
+	memcpy(entry->suite + suite_length + 1, testcase, testcase_length + 1);
+	entry->testcase = entry->suite + suite_length + 1;
+	entry->duration_ns = 0;
+	entry->crash_count = 0;
+	entry->peak_memory_bytes = 0;
+	entry->next = NULL;
+
+	*p_entry = entry;
+	timings->entry_count += 1;
+	return entry;
+}
+
+static int set__(ctest_timings_t *timings, const char *suite, const char *testcase, uint64_t duration_ns)
+{
+	timing_entry_t__ *entry;
+
+	if ((entry = get__(timings, suite, testcase)) == NULL)
+		return -1;
+	timings->total_ns -= entry->duration_ns;
+	timings->total_ns += duration_ns;
+	entry->duration_ns = duration_ns;
+	return 0;
+}
+
+/**
+ * Get the names under which a test case is recorded, which can't contain the
+ * separators of the file format.
+ *
+ * @return Zero on success, non-zero (with <code>errno</code> set) if the test
+ *         case can't be recorded.
+ */
+static int testcase_key__(ctest_testcase_t *testcase, const char **p_suite, const char **p_testcase)
+{
+	*p_suite = ctest_testsuite_get_name(ctest_test_get_testsuite(ctest_testcase_get_test(testcase)));
+	*p_testcase = ctest_testcase_get_name(testcase);
+	if (strpbrk(*p_suite, "\t\n") != NULL || strpbrk(*p_testcase, "\t\n") != NULL) {
+		errno = EINVAL;
+		return -1;
+	}
+	return 0;
+}
+
+ctest_timings_t *ctest_timings_create(void)
+{
+	ctest_timings_t *timings;
+
+	if ((timings = calloc(1, sizeof(*timings))) == NULL)
+		goto alloc_timings_failed;
+	timings->bucket_count = 64;
+	if ((timings->buckets = calloc(timings->bucket_count, sizeof(*timings->buckets))) == NULL)
+		goto alloc_buckets_failed;
+	return timings;
+
+alloc_buckets_failed:
+	(void)free(timings);
+alloc_timings_failed:
+	return NULL;
+}
+
+CTEST_ALL_NONNULL_ARGS__
+void ctest_timings_destroy(ctest_timings_t *timings)
+{
+	size_t i;
+
+	for (i = 0; i < timings->bucket_count; ++i) {
+		timing_entry_t__ *entry, *next;
+		for (entry = timings->buckets[i]; entry != NULL; entry = next) {
+			next = entry->next;
+			(void)free(entry);
+		}
+	}
+	(void)free(timings->buckets);
+	memset(timings, 0, sizeof(*timings));
+	(void)free(timings);
+}
+
+CTEST_ALL_NONNULL_ARGS__
+int ctest_timings_load(ctest_timings_t *timings, const char *filename)
+{
+	char *line = NULL;
+	size_t line_capacity = 0;
+	ssize_t length;
+	FILE *fp;
+	int result = 0;
+
+	if ((fp = fopen(filename, "r")) == NULL)
+		return errno == ENOENT ? 0 : -1;
+
+	while ((length = getline(&line, &line_capacity, fp)) >= 0) {
+		char *suite = line, *testcase, *duration, *crashes, *memory, *end;
+		unsigned long long duration_ns, peak_memory_bytes = 0;
+		unsigned long crash_count = 0;
+		timing_entry_t__ *entry;
+
+		if (length > 0 && line[length - 1] == '\n')
+			line[length - 1] = '\0';
+		if ((testcase = strchr(suite, '\t')) == NULL)
+			continue;
+		*(testcase++) = '\0';
+		if ((duration = strchr(testcase, '\t')) == NULL)
+			continue;
+		*(duration++) = '\0';
+		if ((crashes = strchr(duration, '\t')) != NULL) {
+			*(crashes++) = '\0';
+			if ((memory = strchr(crashes, '\t')) != NULL) {
+				*(memory++) = '\0';
+				errno = 0;
+				peak_memory_bytes = strtoull(memory, &end, 10);
+				if (errno != 0 || end == memory || *end != '\0')
+					continue;
+			}
+			errno = 0;
+			crash_count = strtoul(crashes, &end, 10);
+			if (errno != 0 || end == crashes || *end != '\0' || crash_count > UINT_MAX)
+				continue;
+		}
+
+		errno = 0;
+		duration_ns = strtoull(duration, &end, 10);
+		if (errno != 0 || end == duration || *end != '\0')
+			continue;
+
+		if (set__(timings, suite, testcase, duration_ns) != 0) {
+			result = -1;
+			break;
+		}
+		entry = get__(timings, suite, testcase);
+		entry->crash_count = (unsigned int)crash_count;
+		entry->peak_memory_bytes = peak_memory_bytes;
+	}
+
+	(void)free(line);
+	(void)fclose(fp);
+	return result;
+}
+
+CTEST_ALL_NONNULL_ARGS__
+int ctest_timings_save(const ctest_timings_t *timings, const char *filename)
+{
+	const size_t filename_length = strlen(filename);
+	char *tmpfile;
+	FILE *fp;
+	size_t i;
+
+	/* Write to a temporary file, then rename it into place, so an
+	 * interrupted (or concurrent) run never leaves a truncated file. */
+	if ((tmpfile = malloc(filename_length + sizeof(".XXXXXX"))) == NULL)
+		goto tmpfile_alloc_failed;
+	memcpy(tmpfile, filename, filename_length);
+	memcpy(tmpfile + filename_length, ".XXXXXX", sizeof(".XXXXXX"));
+	{
+		const int fd = mkstemp(tmpfile);
+		if (fd < 0)
+			goto mkstemp_failed;
+		if ((fp = fdopen(fd, "w")) == NULL) {
+			(void)close(fd);
+			goto fdopen_failed;
+		}
+	}
+
+	for (i = 0; i < timings->bucket_count; ++i) {
+		const timing_entry_t__ *entry;
+		for (entry = timings->buckets[i]; entry != NULL; entry = entry->next) {
+			fprintf(fp, "%s\t%s\t%" PRIu64, entry->suite, entry->testcase, entry->duration_ns);
+			if (entry->crash_count > 0 || entry->peak_memory_bytes > 0)
+				fprintf(fp, "\t%u", entry->crash_count);
+			if (entry->peak_memory_bytes > 0)
+				fprintf(fp, "\t%" PRIu64, entry->peak_memory_bytes);
+			fputc('\n', fp);
+		}
+	}
+
+	if (fclose(fp) != 0)
+		goto write_failed;
+	if (rename(tmpfile, filename) != 0)
+		goto write_failed;
+
+	(void)free(tmpfile);
+	return 0;
+
+write_failed:
+fdopen_failed:
+	(void)unlink(tmpfile);
+mkstemp_failed:
+	(void)free(tmpfile);
+tmpfile_alloc_failed:
+	return -1;
+}
+
+CTEST_ALL_NONNULL_ARGS__
+int ctest_timings_record(ctest_timings_t *timings, ctest_testcase_t *testcase, uint64_t duration_ns)
+{
+	const char *suite_name, *testcase_name;
+
+	if (testcase_key__(testcase, &suite_name, &testcase_name) != 0)
+		return -1;
+	return set__(timings, suite_name, testcase_name, duration_ns);
+}
+
+CTEST_ALL_NONNULL_ARGS__
+int ctest_timings_record_crash(ctest_timings_t *timings, ctest_testcase_t *testcase)
+{
+	const char *suite_name, *testcase_name;
+	timing_entry_t__ *entry;
+
+	if (testcase_key__(testcase, &suite_name, &testcase_name) != 0)
+		return -1;
+	if ((entry = get__(timings, suite_name, testcase_name)) == NULL)
+		return -1;
+	if (entry->crash_count < UINT_MAX)
+		entry->crash_count += 1;
+	return 0;
+}
+
+CTEST_ALL_NONNULL_ARGS__
+int ctest_timings_record_memory(ctest_timings_t *timings, ctest_testcase_t *testcase, uint64_t peak_memory_bytes)
+{
+	const char *suite_name, *testcase_name;
+	timing_entry_t__ *entry;
+
+	if (testcase_key__(testcase, &suite_name, &testcase_name) != 0)
+		return -1;
+	if ((entry = get__(timings, suite_name, testcase_name)) == NULL)
+		return -1;
+	entry->peak_memory_bytes = peak_memory_bytes;
+	return 0;
+}
+
+CTEST_ALL_NONNULL_ARGS__
+bool ctest_timings_lookup(const ctest_timings_t *timings, ctest_testcase_t *testcase, uint64_t *p_duration_ns)
+{
+	const char *const suite_name = ctest_testsuite_get_name(ctest_test_get_testsuite(ctest_testcase_get_test(testcase)));
+	const timing_entry_t__ *const entry = *find__(timings, suite_name, ctest_testcase_get_name(testcase));
+
+	if (entry == NULL)
+		return false;
+	*p_duration_ns = entry->duration_ns;
+	return true;
+}
+
+CTEST_ALL_NONNULL_ARGS__
+unsigned int ctest_timings_get_crash_count(const ctest_timings_t *timings, ctest_testcase_t *testcase)
+{
+	const char *const suite_name = ctest_testsuite_get_name(ctest_test_get_testsuite(ctest_testcase_get_test(testcase)));
+	const timing_entry_t__ *const entry = *find__(timings, suite_name, ctest_testcase_get_name(testcase));
+
+	return entry != NULL ? entry->crash_count : 0;
+}
+
+CTEST_ALL_NONNULL_ARGS__
+bool ctest_timings_lookup_memory(const ctest_timings_t *timings, ctest_testcase_t *testcase, uint64_t *p_peak_memory_bytes)
+{
+	const char *const suite_name = ctest_testsuite_get_name(ctest_test_get_testsuite(ctest_testcase_get_test(testcase)));
+	const timing_entry_t__ *const entry = *find__(timings, suite_name, ctest_testcase_get_name(testcase));
+
+	if (entry == NULL || entry->peak_memory_bytes == 0)
+		return false;
+	*p_peak_memory_bytes = entry->peak_memory_bytes;
+	return true;
+}
+
+typedef struct order_entry__ order_entry_t__;
+struct order_entry__ {
+	uint64_t predicted_ns;
+	size_t index;
+};
+
+static int compare_order_entries__(const void *lhs_ptr, const void *rhs_ptr)
+{
+	const order_entry_t__ *const lhs = lhs_ptr;
+	const order_entry_t__ *const rhs = rhs_ptr;
+
+	/* Longest first; the original order breaks ties. */
+	if (lhs->predicted_ns != rhs->predicted_ns)
+		return lhs->predicted_ns > rhs->predicted_ns ? -1 : 1;
+	return lhs->index < rhs->index ? -1 : lhs->index > rhs->index;
+}
+
+CTEST_NONNULL_ARGS__(1, 4)
+size_t ctest_timings_order(const ctest_timings_t *timings, ctest_testcase_t *const*testcases, size_t testcase_count, size_t *order, uint64_t *predicted_ns)
+{
+	const uint64_t average_ns = timings->entry_count > 0 ? timings->total_ns / timings->entry_count : 0;
+	order_entry_t__ *entries;
+	size_t i, known = 0;
+
+	for (i = 0; i < testcase_count; ++i)
+		order[i] = i;
+	if (testcase_count == 0 || (entries = calloc(testcase_count, sizeof(*entries))) == NULL) {
+		/* Without memory to sort, keep the original order. */
+		for (i = 0; predicted_ns != NULL && i < testcase_count; ++i)
+			predicted_ns[i] = average_ns;
+		return 0;
+	}
+
+	for (i = 0; i < testcase_count; ++i) {
+		entries[i].index = i;
+		if (ctest_timings_lookup(timings, testcases[i], &entries[i].predicted_ns))
+			known += 1;
+		else
+			entries[i].predicted_ns = average_ns;
+		if (predicted_ns != NULL)
+			predicted_ns[i] = entries[i].predicted_ns;
+	}
+
+	qsort(entries, testcase_count, sizeof(*entries), &compare_order_entries__);
+	for (i = 0; i < testcase_count; ++i)
+		order[i] = entries[i].index;
+
+	(void)free(entries);
+	return known;
+}
@@ -0,0 +1,378 @@
+#define _GNU_SOURCE     /* pipe2 */
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/prctl.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+#include <ctest/_annotations.h>
+
+#include "zygote.h"
+#include "utils.h"
+
+/*
+ * Control Protocol
+ *
+ * Each request is a single datagram (on a SOCK_SEQPACKET socket) holding a
+ * zygote_request_t__, with the file descriptors to hand to the child attached
+ * as SCM_RIGHTS. The zygote answers each request with a zygote_response_t__.
+ */
+
+typedef struct zygote_request__ zygote_request_t__;
+struct zygote_request__ {
+	void *arg;
+	int cpu;
+};
+
+typedef struct zygote_response__ zygote_response_t__;
+struct zygote_response__ {
+	pid_t pid;
+	int error;
+	uint64_t spawn_ns;
+};
+
+static uint64_t elapsed_ns__(const struct timespec *start, const struct timespec *end)
+{
+	return (uint64_t)(end->tv_sec - start->tv_sec) * 1000000000u + end->tv_nsec - start->tv_nsec;
+}
+
+/**
+ * Wait for a child of the zygote to exit.
+ *
+ * @return Zero if the child exited with a status of zero, non-zero otherwise.
+ */
+static int reap__(pid_t pid)
+{
+	int status;
+	pid_t rc;
+
+	while ((rc = waitpid(pid, &status, 0)) < 0 && errno == EINTR)
+		;
+	return rc == pid && WIFEXITED(status) && WEXITSTATUS(status) == 0 ? 0 : -1;
+}
+
+/**
+ * Fork a child to be adopted by our parent.
+ *
+ * The child is forked with <code>fork()</code>, so the handlers registered
+ * with <code>pthread_atfork()</code> run as they would for any other child,
+ * from an intermediate process that exits right away: the child is then
+ * adopted by our parent, which is its subreaper while the request is served
+ * (see <code>zygote_spawn</code>). The intermediate process is cloned with the
+ * raw system call, which runs none of the handlers (they run once, around the
+ * fork of the child); the zygote is single threaded, so none of the C
+ * library's locks can be held.
+ *
+ * The child holds off until it has been adopted, since it may ask to be
+ * signalled when its parent goes away (and would be, as soon as the
+ * intermediate process exits).
+ *
+ * @param pid_fds The pipe over which the intermediate process hands back the
+ *                child's PID.
+ *
+ * @return The PID of the child in the zygote, zero in the child, or
+ *         <code>-1</code> (with <code>errno</code> set) on failure.
+ */
+static pid_t fork_for_parent__(const int pid_fds[2])
+{
+	int adopted_fds[2];
+	int reply[2];
+	pid_t intermediate, pid;
+	char c;
+
+	if (pipe2(adopted_fds, O_CLOEXEC) != 0)
+		return -1;
+
+	if ((intermediate = (pid_t)syscall(SYS_clone, SIGCHLD, NULL, NULL, NULL, NULL)) == 0) {
+		if ((pid = fork()) == 0) {
+			/* Hold off until the zygote closes its end, once the
+			 * intermediate process is gone. */
+			(void)close(adopted_fds[1]);
+			while (read(adopted_fds[0], &c, 1) < 0 && errno == EINTR)
+				;
+			(void)close(adopted_fds[0]);
+			(void)close(pid_fds[0]);
+			(void)close(pid_fds[1]);
+			return 0;
+		}
+		reply[0] = pid;
+		reply[1] = pid < 0 ? errno : 0;
+		_exit(write(pid_fds[1], reply, sizeof(reply)) == (ssize_t)sizeof(reply) ? EXIT_SUCCESS : EXIT_FAILURE);
+	}
+
+	(void)close(adopted_fds[0]);
+	if (intermediate < 0) {
+		pid = -1;
+	} else if (reap__(intermediate) != 0 || read(pid_fds[0], reply, sizeof(reply)) != (ssize_t)sizeof(reply)) {
+		pid = -1;
+		errno = ECHILD;
+	} else if ((pid = reply[0]) < 0) {
+		errno = reply[1];
+	}
+	(void)close(adopted_fds[1]);
+	return pid;
+}
+
+/**
+ * Restrict the calling process to a single CPU.
+ */
+static void pin_to_cpu__(int cpu)
+{
+	cpu_set_t cpus;
+
+	CPU_ZERO(&cpus);
+	CPU_SET(cpu, &cpus);
+	(void)sched_setaffinity(0, sizeof(cpus), &cpus);
+}
+
+/**
+ * Receive a request from the parent.
+ *
+ * @return The number of bytes received, zero if the parent closed the
+ *         control socket, or negative on error.
+ */
+static ssize_t zygote_receive__(int control_fd, zygote_request_t__ *request, int *fds, size_t *p_fd_count)
+{
+	union {
+		struct cmsghdr align;
+		char buf[CMSG_SPACE(sizeof(int) * ZYGOTE_MAX_FDS)];
+	} control;
+	struct iovec iov = { request, sizeof(*request) };
+	struct msghdr msg;
+	struct cmsghdr *cmsg;
+	ssize_t rc;
+
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control.buf;
+	msg.msg_controllen = sizeof(control.buf);
+
+	while ((rc = recvmsg(control_fd, &msg, 0)) < 0 && errno == EINTR)
+		;
+
+	*p_fd_count = 0;
+	for (cmsg = CMSG_FIRSTHDR(&msg); rc > 0 && cmsg != NULL; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+		if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+			const size_t count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+			memcpy(fds, CMSG_DATA(cmsg), count * sizeof(int));
+			*p_fd_count = count;
+		}
+	}
+
+	return rc;
+}
+
+/**
+ * Prepare the zygote to spawn children.
+ *
+ * Hand back any memory the allocator is holding on to, so it isn't mapped
+ * into every child, and exercise the fork path once so the first real spawn
+ * doesn't pay for lazy symbol binding and stack growth.
+ */
+static void zygote_warm_up__(void)
+{
+	pid_t pid;
+
+#ifdef __GLIBC__
+	(void)malloc_trim(0);
+#endif
+	if ((pid = fork()) == 0)
+		_exit(0);
+	else if (pid > 0)
+		(void)waitpid(pid, NULL, 0);
+}
+
+CTEST_NORETURN__
+static void zygote_serve__(int control_fd, zygote_main_t child_main, const zygote_hooks_t *hooks, void *context)
+{
+	struct sigaction ignore, saved_sigint, saved_sigpipe;
+	int pid_fds[2];
+
+	/* The runner deals with interruptions; the zygote just goes away
+	 * when its control socket is closed. */
+	memset(&ignore, 0, sizeof(ignore));
+	ignore.sa_handler = SIG_IGN;
+	sigemptyset(&ignore.sa_mask);
+	sigaction(SIGINT, &ignore, &saved_sigint);
+	sigaction(SIGPIPE, &ignore, &saved_sigpipe);
+	if (pipe2(pid_fds, O_CLOEXEC) != 0)
+		_exit(0);
+	if (hooks != NULL && hooks->init != NULL && (*hooks->init)(context) != 0)
+		_exit(0);
+	zygote_warm_up__();
+
+	while (1) {
+		zygote_request_t__ request;
+		zygote_response_t__ response;
+		int fds[ZYGOTE_MAX_FDS];
+		size_t i, fd_count;
+		struct timespec start, end;
+		ssize_t rc;
+
+		if ((rc = zygote_receive__(control_fd, &request, fds, &fd_count)) <= 0)
+			break;
+
+		memset(&response, 0, sizeof(response));
+		if ((size_t)rc != sizeof(request)) {
+			response.pid = -1;
+			response.error = EPROTO;
+		} else {
+			clock_gettime(CLOCK_MONOTONIC, &start);
+			if ((response.pid = fork_for_parent__(pid_fds)) == 0) {
+				(void)close(control_fd);
+				sigaction(SIGINT, &saved_sigint, NULL);
+				sigaction(SIGPIPE, &saved_sigpipe, NULL);
+				if (request.cpu >= 0)
+					pin_to_cpu__(request.cpu);
+				(*child_main)(context, request.arg, fds, fd_count);
+				_exit(EXIT_FAILURE);
+			}
+			clock_gettime(CLOCK_MONOTONIC, &end);
+			response.error = response.pid < 0 ? errno : 0;
+			response.spawn_ns = elapsed_ns__(&start, &end);
+		}
+
+		for (i = 0; i < fd_count; ++i)
+			(void)close(fds[i]);
+		if (send(control_fd, &response, sizeof(response), 0) < 0)
+			break;
+	}
+
+	if (hooks != NULL && hooks->fini != NULL)
+		(*hooks->fini)(context);
+	_exit(0);
+}
+
+CTEST_NONNULL_ARGS__(1, 2)
+int zygote_start(zygote_t *zygote, zygote_main_t child_main, const zygote_hooks_t *hooks, void *context)
+{
+	int control_fds[2];
+	pid_t pid;
+
+	if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, control_fds) != 0)
+		goto socketpair_failed;
+
+	/* Don't let the zygote inherit (and flush a second time) anything
+	 * buffered by the parent. */
+	fflush(stdout);
+	fflush(stderr);
+
+	if ((pid = fork()) < 0) {
+		goto fork_failed;
+	} else if (pid == 0) {
+		(void)close(control_fds[0]);
+		zygote_serve__(control_fds[1], child_main, hooks, context);
+	}
+
+	(void)close(control_fds[1]);
+	zygote->pid = pid;
+	zygote->control_fd = control_fds[0];
+	zygote->child_main = child_main;
+	zygote->hooks = hooks;
+	zygote->context = context;
+	return 0;
+
+fork_failed:
+	(void)close(control_fds[0]);
+	(void)close(control_fds[1]);
+socketpair_failed:
+	return -1;
+}
+
+CTEST_NONNULL_ARGS__(1)
+pid_t zygote_spawn(zygote_t *zygote, void *arg, const int *fds, size_t fd_count, int cpu, uint64_t *p_spawn_ns)
+{
+	union {
+		struct cmsghdr align;
+		char buf[CMSG_SPACE(sizeof(int) * ZYGOTE_MAX_FDS)];
+	} control;
+	zygote_request_t__ request;
+	zygote_response_t__ response;
+	struct iovec iov = { &request, sizeof(request) };
+	struct msghdr msg;
+	ssize_t rc;
+	int subreaper;
+
+	if (fd_count > ZYGOTE_MAX_FDS) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	memset(&request, 0, sizeof(request));
+	request.arg = arg;
+	request.cpu = cpu;
+
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	if (fd_count > 0) {
+		struct cmsghdr *cmsg;
+
+		memset(&control, 0, sizeof(control));
+		msg.msg_control = control.buf;
+		msg.msg_controllen = CMSG_SPACE(sizeof(int) * fd_count);
+		cmsg = CMSG_FIRSTHDR(&msg);
+		cmsg->cmsg_level = SOL_SOCKET;
+		cmsg->cmsg_type = SCM_RIGHTS;
+		cmsg->cmsg_len = CMSG_LEN(sizeof(int) * fd_count);
+		memcpy(CMSG_DATA(cmsg), fds, sizeof(int) * fd_count);
+	}
+
+	/* Adopt the child, which is orphaned as it is spawned; only for as
+	 * long as it takes, so nothing else orphaned below us is adopted. */
+	if (prctl(PR_GET_CHILD_SUBREAPER, &subreaper) != 0 || (!subreaper && prctl(PR_SET_CHILD_SUBREAPER, 1) != 0))
+		return -1;
+
+	while ((rc = sendmsg(zygote->control_fd, &msg, MSG_NOSIGNAL)) < 0 && errno == EINTR)
+		;
+	if (rc >= 0) {
+		while ((rc = recv(zygote->control_fd, &response, sizeof(response), 0)) < 0 && errno == EINTR)
+			;
+	}
+
+	if (!subreaper) {
+		const int error = errno;
+
+		(void)prctl(PR_SET_CHILD_SUBREAPER, 0);
+		errno = error;
+	}
+	if (rc < 0) {
+		return -1;
+	} else if ((size_t)rc != sizeof(response)) {
+		/* The zygote went away. */
+		errno = rc == 0 ? ECHILD : EPROTO;
+		return -1;
+	}
+
+	if (response.pid < 0) {
+		errno = response.error;
+		return -1;
+	}
+	if (p_spawn_ns != NULL)
+		*p_spawn_ns = response.spawn_ns;
+	return response.pid;
+}
+
+CTEST_ALL_NONNULL_ARGS__
+void zygote_stop(zygote_t *zygote)
+{
+	(void)close(zygote->control_fd);
+	while (waitpid(zygote->pid, NULL, 0) < 0 && errno == EINTR)
+		;
+	memset(zygote, 0, sizeof(*zygote));
+	zygote->control_fd = -1;
+	zygote->pid = -1;
+}
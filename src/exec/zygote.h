@@ -0,0 +1,127 @@
+#ifndef PRIVATE__ZYGOTE_H__INCLUDED__
+#define PRIVATE__ZYGOTE_H__INCLUDED__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <ctest/_annotations.h>
+
+/**
+ * The maximum number of file descriptors that can be handed to a child
+ * spawned from a zygote.
+ */
+#define ZYGOTE_MAX_FDS 4
+
+/**
+ * The entry point of a child spawned from a zygote.
+ *
+ * The function must not return; the child should exit once it is done.
+ *
+ * @param context  The context passed to <code>zygote_start</code>.
+ * @param arg      The argument passed to <code>zygote_spawn</code>. Since the
+ *                 zygote is a fork of the process that started it, any
+ *                 pointer that was valid when the zygote was started is
+ *                 valid in the child.
+ * @param fds      The file descriptors passed to <code>zygote_spawn</code>,
+ *                 now owned by the child.
+ * @param fd_count The number of file descriptors in <code>fds</code>.
+ */
+typedef void (*zygote_main_t)(void *context, void *arg, int *fds, size_t fd_count);
+
+/**
+ * Functions run in a zygote itself, around serving requests; e.g., to prepare
+ * state the children then inherit.
+ */
+typedef struct zygote_hooks zygote_hooks_t;
+struct zygote_hooks {
+	/**
+	 * Called (with the context passed to <code>zygote_start</code>) before
+	 * the zygote serves any request. If it returns non-zero, the zygote
+	 * exits right away, without calling <code>fini</code>.
+	 */
+	int (*init)(void *context);
+
+	/**
+	 * Called once the control socket has been closed, before the zygote
+	 * exits.
+	 */
+	void (*fini)(void *context);
+};
+
+/**
+ * A small template process from which child processes are forked.
+ *
+ * The cost of forking a process grows with the size of its page tables. The
+ * process running the tests only grows over a run (loaded suites, results,
+ * captured output, ...), so instead of forking every child from it, a zygote
+ * is forked once, before the run, and the children are forked from the zygote
+ * on request (over a control socket). This keeps the cost of each fork flat
+ * for the whole run.
+ *
+ * Children are forked (with <code>fork()</code>, so handlers registered with
+ * <code>pthread_atfork()</code> run in them as usual) by an intermediate
+ * process that exits right away, so they are adopted by the process that
+ * started the zygote (rather than being children of the zygote itself) and
+ * are waited for with <code>waitpid</code> as usual.
+ */
+typedef struct zygote zygote_t;
+struct zygote {
+	pid_t pid;
+	int control_fd;
+	zygote_main_t child_main;
+	const zygote_hooks_t *hooks;
+	void *context;
+};
+
+/**
+ * Start a zygote.
+ *
+ * @param zygote     The zygote to start.
+ * @param child_main The entry point of each child spawned from the zygote.
+ * @param hooks      The functions to run in the zygote itself, or
+ *                   <code>NULL</code>; either function may also be
+ *                   <code>NULL</code>.
+ * @param context    The context passed to every child's entry point (e.g.,
+ *                   settings shared by all the children), and to the hooks.
+ *
+ * @return Zero on success, non-zero (with <code>errno</code> set) on failure.
+ */
+CTEST_NONNULL_ARGS__(1, 2)
+extern int zygote_start(zygote_t *zygote, zygote_main_t child_main, const zygote_hooks_t *hooks, void *context);
+
+/**
+ * Spawn a child from a zygote.
+ *
+ * The calling process is made a child subreaper (see
+ * <code>PR_SET_CHILD_SUBREAPER</code>) until the child has been adopted, so it
+ * may also adopt other processes orphaned in the meantime below it.
+ *
+ * @param zygote     The zygote from which to spawn the child.
+ * @param arg        The argument to pass to the child's entry point.
+ * @param fds        The file descriptors to hand to the child. These remain
+ *                   open (and owned by the caller) in this process.
+ * @param fd_count   The number of file descriptors in <code>fds</code>; at
+ *                   most <code>ZYGOTE_MAX_FDS</code>.
+ * @param cpu        The CPU to which to restrict the child, or
+ *                   <code>-1</code> to leave it on those of the zygote.
+ * @param p_spawn_ns If not <code>NULL</code>, updated with the time (in
+ *                   nanoseconds) the zygote spent forking the child.
+ *
+ * @return The PID of the new child, or <code>-1</code> (with
+ *         <code>errno</code> set) on failure.
+ */
+CTEST_NONNULL_ARGS__(1)
+extern pid_t zygote_spawn(zygote_t *zygote, void *arg, const int *fds, size_t fd_count, int cpu, uint64_t *p_spawn_ns);
+
+/**
+ * Stop a zygote, waiting for it to exit.
+ *
+ * Children already spawned from the zygote are not affected.
+ *
+ * @param zygote The zygote to stop.
+ */
+CTEST_ALL_NONNULL_ARGS__
+extern void zygote_stop(zygote_t *zygote);
+
+#endif /* PRIVATE__ZYGOTE_H__INCLUDED__ */
@@ -7,6 +7,27 @@
 
 #define CTEST_DYNAMIC_OPS_SYMBOL__ ctest_dynamic_ops
 
+/**
+ * The function, exported by each test module, that locates the calling
+ * thread's instance of <code>CTEST_DYNAMIC_OPS_SYMBOL__</code>.
+ *
+ * The dynamic operations are thread local, so that test cases of the same
+ * module can run concurrently on different threads. Looking up the variable
+ * itself only ever yields the instance of the thread doing the lookup, so the
+ * loader uses this function instead when it is available (modules built
+ * against an older stub only export the, then global, variable).
+ */
+#define CTEST_DYNAMIC_OPS_LOCATOR_SYMBOL__ ctest_dynamic_ops_locate
+
+/**
+ * The variable, exported by each test module that leases ports (see
+ * <code>CT_LEASE_PORT</code>), through which the loader hands it the function
+ * that leases a port from the pool of the run (see
+ * <code>ctest_port_leaser_t</code>). It is left <code>NULL</code> by runners
+ * that don't have a pool.
+ */
+#define CTEST_PORT_LEASER_SYMBOL__ ctest_port_leaser
+
 typedef enum ctest_dynamic_ops_abort_type__ ctest_dynamic_ops_abort_type_t;
 enum ctest_dynamic_ops_abort_type__ {
 	CTEST_DYNAMIC_OPS_ABORT_NONE = 0,
@@ -49,6 +70,17 @@ static inline void ctest_dynamic_ops_report_failure(ctest_dynamic_ops_t *dynamic
 	va_end(fmt_params);
 }
 
+/**
+ * The signature of <code>CTEST_DYNAMIC_OPS_LOCATOR_SYMBOL__</code>.
+ */
+typedef ctest_dynamic_ops_t **(*ctest_dynamic_ops_locator_t)(void);
+
+/**
+ * The type of <code>CTEST_PORT_LEASER_SYMBOL__</code>: a function returning
+ * the leased port, or -1 (with <code>errno</code> set) if none can be.
+ */
+typedef int (*ctest_port_leaser_t)(void);
+
 CTEST_NORETURN__
 static inline void ctest_dynamic_ops_abort(ctest_dynamic_ops_t *dynamic_ops, ctest_dynamic_ops_abort_type_t abort_type)
 {
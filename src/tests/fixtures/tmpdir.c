@@ -78,6 +78,8 @@ ctest_def_fixture_provider_t__ CTEST_FIXTURE_NAME__(ctest_tmpdir) = {
 	&setup__,
 	&teardown__,
 	sizeof(ctest_tmpdir_fixture_t),
+	"ctest_tmpdir",
+	NULL,
 };
 
 int ctest_tmpdir_init(ctest_tmpdir_fixture_t *fixture)
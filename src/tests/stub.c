@@ -1,8 +1,17 @@
+#include <errno.h>
+#include <string.h>
+
 #include <ctest/tests/assert.h>
+#include <ctest/tests/ports.h>
 
 #include "dynamic_ops.h"
 
-ctest_dynamic_ops_t *CTEST_DYNAMIC_OPS_SYMBOL__;
+__thread ctest_dynamic_ops_t *CTEST_DYNAMIC_OPS_SYMBOL__;
+
+extern ctest_dynamic_ops_t **CTEST_DYNAMIC_OPS_LOCATOR_SYMBOL__(void)
+{
+	return &CTEST_DYNAMIC_OPS_SYMBOL__;
+}
 
 CTEST_PRINTF__(3, 4) CTEST_NORETURN__
 extern void ctest_fail(const char *file, int line, const char *fmt, ...)
@@ -21,3 +30,16 @@ extern void ctest_skip(const char *file, int line, const char *fmt, ...)
 	ctest_dynamic_ops_report_failure_va(CTEST_DYNAMIC_OPS_SYMBOL__, file, line, fmt, fmt_params);
 	ctest_dynamic_ops_abort(CTEST_DYNAMIC_OPS_SYMBOL__, CTEST_DYNAMIC_OPS_ABORT_SKIP);
 }
+
+ctest_port_leaser_t CTEST_PORT_LEASER_SYMBOL__;
+
+extern int ctest_lease_port(const char *file, int line)
+{
+	int port;
+
+	if (CTEST_PORT_LEASER_SYMBOL__ == NULL)
+		ctest_fail(file, line, "unable to lease a port: not supported by the runner");
+	if ((port = (*CTEST_PORT_LEASER_SYMBOL__)()) < 0)
+		ctest_fail(file, line, "unable to lease a port: %s", strerror(errno));
+	return port;
+}